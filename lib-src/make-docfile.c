@@ -1394,6 +1394,10 @@ scan_lisp_file (const char *filename, const char *mode)
 		    memory_exhausted ();
 		}
 
+	      /* #@00 skips the rest of the file, which holds the image
+		 of the file that the byte compiler appends to it.  */
+	      if (length == 0)
+		break;
 	      if (length <= 1)
 		fatal ("invalid dynamic doc string length");
 
@@ -260,6 +260,16 @@ This option is enabled by default because it reduces Emacs memory usage."
   :type 'boolean)
 ;;;###autoload(put 'byte-compile-dynamic-docstrings 'safe-local-variable 'booleanp)
 
+(defcustom byte-compile-elc-image nil
+  "If non-nil, append to compiled files an image of their contents.
+`load' makes the objects in a compiled file from its image faster
+than it can parse the text of the file.  The text is left as it is,
+so the file can still be loaded without the image, but the file is
+about twice as large.  See `load-elc-images'."
+  :group 'bytecomp
+  :type 'boolean
+  :version "26.1")
+
 (defconst byte-compile-log-buffer "*Compile-Log*"
   "Name of the byte-compiler's log buffer.")
 
@@ -1881,6 +1891,8 @@ The value is non-nil if there were no errors, nil if errors."
 		      (cons (lambda () (ignore-errors (delete-file tempfile)))
 			    kill-emacs-hook)))
 		(write-region (point-min) (point-max) tempfile nil 1)
+		(when byte-compile-elc-image
+		  (lread--write-elc-image tempfile))
 		;; This has the intentional side effect that any
 		;; hard-links to target-file continue to
 		;; point to the old file (this makes it possible
@@ -4803,6 +4815,161 @@ already up-to-date."
                   (prin1-to-string (cdr err)))
          nil)))))
 
+;; Compiling each file in a fresh Emacs, as `batch-byte-compile' is
+;; used by the Makefiles, spends most of the time starting Emacs and
+;; loading the compiler.  `batch-byte-compile-parallel' loads it once
+;; and forks a copy of Emacs for each file, which starts from the same
+;; clean state as a fresh Emacs, and several copies run at a time.
+
+(defcustom byte-compile-parallel-jobs nil
+  "Number of files `batch-byte-compile-parallel' compiles at a time.
+nil means as many as there are processors."
+  :group 'bytecomp
+  :type '(choice (const :tag "One per processor" nil) integer)
+  :version "26.1")
+
+(defcustom byte-compile-write-dependencies nil
+  "Non-nil means `batch-byte-compile-parallel' writes dependency files.
+For each file FOO.el that it compiles to FOO.elc, it writes FOO.d,
+which says in the syntax of Make that FOO.elc depends on FOO.el and
+on the files loaded while compiling it."
+  :group 'bytecomp
+  :type 'boolean
+  :version "26.1")
+
+(defun byte-compile--processors ()
+  "Return the number of processors online, or 1 if it is unknown."
+  (max 1 (or (ignore-errors
+               (string-to-number
+                (car (process-lines "getconf" "_NPROCESSORS_ONLN"))))
+             1)))
+
+(defun byte-compile--write-dependencies (file history)
+  "Write the dependency file for FILE, which has just been compiled.
+HISTORY is the value `load-history' had before it was compiled."
+  (let ((dest (byte-compile-dest-file file))
+        (escape (lambda (name)
+                 (replace-regexp-in-string
+                  "\\$" "$$" (replace-regexp-in-string
+                              "[ #]" "\\\\\\&" (file-relative-name name)))))
+        (deps nil))
+    (dolist (entry load-history)
+      (if (eq entry (car history))
+          (setq history nil)
+        (when (and history (stringp (car entry)))
+          (push (car entry) deps))))
+    (with-temp-buffer
+      (insert (funcall escape dest) ":")
+      (dolist (dep (cons file deps))
+        (insert " \\\n  " (funcall escape dep)))
+      (insert "\n")
+      (write-region nil nil (concat (file-name-sans-extension dest) ".d")
+                    nil 1))))
+
+(defun batch-byte-compile--file-args (noforce)
+  "Return the list of files to compile named on the command line.
+A directory stands for the files in it that need recompiling, as in
+`batch-byte-compile', and an argument \"-\" for the file names read
+from standard input, one per line.  If NOFORCE is non-nil, leave out
+the files whose compiled file is up to date."
+  (let ((files nil)
+        (line nil))
+    (dolist (arg command-line-args-left)
+      (cond
+       ((file-directory-p (expand-file-name arg))
+        (dolist (file (directory-files arg))
+          (let ((source (expand-file-name file arg)))
+            (when (and (string-match emacs-lisp-file-regexp file)
+                       (not (auto-save-file-name-p file))
+                       (file-exists-p (byte-compile-dest-file source))
+                       (file-newer-than-file-p
+                        source (byte-compile-dest-file source)))
+              (push source files)))))
+       ((equal arg "-")
+        (while (setq line (ignore-errors (read-from-minibuffer "")))
+          (unless (equal line "")
+            (push line files))))
+       (t (push arg files))))
+    (setq command-line-args-left nil)
+    (nreverse
+     (if (not noforce)
+         files
+       (delq nil (mapcar (lambda (source)
+                           (let ((dest (byte-compile-dest-file source)))
+                             (and (or (not (file-exists-p dest))
+                                      (file-newer-than-file-p source dest))
+                                  source)))
+                         files))))))
+
+(defun batch-byte-compile--one (file)
+  "Compile FILE as `batch-byte-compile' does, and return non-nil on success.
+Write its dependency file if `byte-compile-write-dependencies' is non-nil."
+  (let ((history load-history))
+    (when (batch-byte-compile-file file)
+      (when (and byte-compile-write-dependencies
+                 (file-exists-p (byte-compile-dest-file file)))
+        (byte-compile--write-dependencies file history))
+      t)))
+
+;;;###autoload
+(defun batch-byte-compile-parallel (&optional noforce)
+  "Like `batch-byte-compile', but compile several files at a time.
+Compile each file remaining on the command line in a copy of this
+Emacs made with `process--fork', so that it is compiled in the same
+environment as by a fresh Emacs, without loading the compiler again.
+Run at most `byte-compile-parallel-jobs' copies at a time.
+An argument \"-\" means to read file names from standard input, one
+per line.  If NOFORCE is non-nil, don't recompile a file that seems to
+be already up-to-date.
+For example, invoke \"emacs -batch -l bytecomp -f batch-byte-compile-parallel *.el\"."
+  (defvar command-line-args-left)	;Avoid 'free variable' warning
+  (if (not noninteractive)
+      (error "`batch-byte-compile-parallel' is to be used only with -batch"))
+  (let ((files (batch-byte-compile--file-args noforce))
+        (jobs (or byte-compile-parallel-jobs (byte-compile--processors)))
+        (running nil)
+        (error nil))
+    (if (not (fboundp 'process--fork))
+        (dolist (file files)
+          (unless (batch-byte-compile--one file)
+            (setq error t)))
+      (let ((file
+             (catch 'batch-byte-compile--copy
+               (letrec ((start
+                         (lambda ()
+                           (while (and files (< (length running) jobs))
+                             (let ((proc (process--fork)))
+                               (when (eq proc 0)
+                                 ;; This is the copy; leave the loop, and
+                                 ;; any sentinel it is forked from.
+                                 (throw 'batch-byte-compile--copy
+                                        (car files)))
+                               (set-process-sentinel proc sentinel)
+                               (push proc running)
+                               (setq files (cdr files))))))
+                        (sentinel
+                         (lambda (proc _event)
+                           (unless (process-live-p proc)
+                             (unless (and (eq (process-status proc) 'exit)
+                                          (eq (process-exit-status proc) 0))
+                               (setq error t))
+                             (setq running (delq proc running))
+                             (funcall start)))))
+                 (funcall start)
+                 ;; The sentinels start new copies as others exit.
+                 (while running
+                   (accept-process-output (car running)))
+                 nil))))
+        (when file
+          (kill-emacs (if (ignore-errors (batch-byte-compile--one file))
+                          0 1)))))
+    (kill-emacs (if error 1 0))))
+
+;;;###autoload
+(defun batch-byte-compile-parallel-if-not-done ()
+  "Like `batch-byte-compile-parallel', but don't recompile up-to-date files."
+  (batch-byte-compile-parallel t))
+
 (defun byte-compile-refresh-preloaded ()
   "Reload any Lisp file that was changed since Emacs was dumped.
 Use with caution."
@@ -652,11 +652,7 @@ This is a destructive function; it reuses the storage of SEQ if possible.
   (if (nlistp cl-seq)
       (cl-replace cl-seq (apply 'cl-sort (append cl-seq nil) cl-pred cl-keys))
     (cl--parsing-keywords (:key) ()
-      (if (memq cl-key '(nil identity))
-	  (sort cl-seq cl-pred)
-	(sort cl-seq (function (lambda (cl-x cl-y)
-				 (funcall cl-pred (funcall cl-key cl-x)
-					  (funcall cl-key cl-y)))))))))
+      (sort cl-seq cl-pred (unless (memq cl-key '(nil identity)) cl-key)))))
 
 ;;;###autoload
 (defun cl-stable-sort (cl-seq cl-pred &rest cl-keys)
@@ -147,7 +147,8 @@ Fourth and fifth args, BEG and LEN, specify which part of the output
 to keep: LEN chars starting BEG chars from the beginning."
   (let ((start (point))
 	(prefix beg))
-    (if (and jka-compr-use-shell jka-compr-dd-program)
+    (if (and jka-compr-use-shell jka-compr-dd-program
+	     (not (jka-compr-zlib-format prog args infile)))
 	;; Put the uncompression output through dd
 	;; to discard the part we don't want.
 	(let ((skip (/ beg jka-compr-dd-blocksize))
@@ -199,7 +200,94 @@ to keep: LEN chars starting BEG chars from the beginning."
     (delete-region start (+ start prefix))))
 
 
+(defcustom jka-compr-use-zlib t
+  "Non-nil means compress and uncompress gzip data with zlib.
+When Emacs is built with zlib, this avoids running the gzip program
+for files in gzip format."
+  :type 'boolean
+  :version "26.1"
+  :group 'jka-compr)
+
+(defvar jka-compr-zlib-chunk-size (* 64 1024)
+  "Number of bytes of a file that zlib is given at a time.")
+
+(declare-function zlib-make-compressor "decompress.c"
+                  (buffer &optional format level))
+(declare-function zlib-make-decompressor "decompress.c"
+                  (buffer &optional format))
+(declare-function zlib-stream-feed "decompress.c" (stream data))
+(declare-function zlib-stream-finish "decompress.c" (stream))
+
+(defun jka-compr-zlib-format (prog args infile)
+  "Return how zlib can do what PROG does to INFILE with ARGS.
+The value is `compress' or `uncompress' if PROG is gzip, and nil if
+zlib cannot be used.  Files that gzip uncompresses but that are not
+in gzip format, such as files made by compress, are left to gzip."
+  (and jka-compr-use-zlib
+       (fboundp 'zlib-stream-feed)
+       (zlib-available-p)
+       (equal (file-name-nondirectory prog) "gzip")
+       (file-readable-p infile)
+       (cond ((member "-d" args)
+              (and (equal (with-temp-buffer
+                            (set-buffer-multibyte nil)
+                            (insert-file-contents-literally infile nil 0 2)
+                            (buffer-string))
+                          "\037\213")
+                   'uncompress))
+             ((equal args '("-c" "-q"))
+              'compress))))
+
+(defun jka-compr-zlib-call (format message infile output)
+  "Compress or uncompress INFILE with zlib, as FORMAT says.
+FORMAT is a value of `jka-compr-zlib-format'.  MESSAGE and OUTPUT are
+as for `jka-compr-call-process'.  INFILE is read a piece at a time,
+and the output is inserted as it comes."
+  (let* ((outbuf (cond ((stringp output)
+                        (generate-new-buffer " *jka-compr-zlib-output*"))
+                       ((eq output t) (current-buffer))
+                       (t output)))
+         (stream (if (eq format 'compress)
+                     (zlib-make-compressor outbuf 'gzip)
+                   (zlib-make-decompressor outbuf 'gzip)))
+         (input (generate-new-buffer " *jka-compr-zlib-input*"))
+         (pos 0))
+    (unwind-protect
+        (progn
+          (with-current-buffer input
+            (set-buffer-multibyte nil))
+          ;; Errors reading INFILE are file errors, as they would be
+          ;; with `call-process'; invalid data is not a file error.
+          (condition-case err
+              (progn
+                (while (> (cadr (with-current-buffer input
+                                  (erase-buffer)
+                                  (insert-file-contents-literally
+                                   infile nil pos
+                                   (+ pos jka-compr-zlib-chunk-size))))
+                          0)
+                  (setq pos (+ pos (buffer-size input)))
+                  (zlib-stream-feed stream input))
+                (zlib-stream-finish stream))
+            (zlib-data-error
+             (signal (car err) (append (cdr err) (list infile)))))
+          (when (stringp output)
+            (with-current-buffer outbuf
+              (let ((coding-system-for-write 'no-conversion))
+                (write-region (point-min) (point-max) output nil
+                              'silent)))))
+      (kill-buffer input)
+      (when (stringp output)
+        (kill-buffer outbuf)))
+    t))
+
 (defun jka-compr-call-process (prog message infile output temp args)
+  (let ((format (jka-compr-zlib-format prog args infile)))
+    (if format
+        (jka-compr-zlib-call format message infile output)
+      (jka-compr-call-process-1 prog message infile output temp args))))
+
+(defun jka-compr-call-process-1 (prog message infile output temp args)
   ;; call-process barfs if default-directory is inaccessible.
   (let ((default-directory
 	  (if (and default-directory
@@ -349,6 +349,8 @@ no_sanitize_memcpy (void *dest, void const *src, size_t size)
 #endif /* MAX_SAVE_STACK > 0 */
 
 static void mark_terminals (void);
+static void start_parallel_marking (void);
+static void finish_parallel_marking (void);
 static void gc_sweep (void);
 static Lisp_Object make_pure_vector (ptrdiff_t);
 static void mark_buffer (struct buffer *);
@@ -2576,14 +2578,53 @@ make_formatted_string (char *buf, const char *format, ...)
      - (sizeof (struct Lisp_Float) - sizeof (bits_word))) * CHAR_BIT) \
    / (sizeof (struct Lisp_Float) * CHAR_BIT + 1))
 
-#define GETMARKBIT(block,n)				\
-  (((block)->gcmarkbits[(n) / BITS_PER_BITS_WORD]	\
-    >> ((n) % BITS_PER_BITS_WORD))			\
-   & 1)
+/* Conses and floats can be marked by several threads at once; see
+   start_parallel_marking.  */
+#if (defined THREADS_ENABLED && defined HAVE_PTHREAD \
+     && (GNUC_PREREQ (4, 7, 0) || defined __clang__))
+# define PARALLEL_MARKING
+#endif
 
-#define SETMARKBIT(block,n)				\
-  ((block)->gcmarkbits[(n) / BITS_PER_BITS_WORD]	\
-   |= (bits_word) 1 << ((n) % BITS_PER_BITS_WORD))
+#ifdef PARALLEL_MARKING
+/* True while other threads mark conses and floats.  */
+static bool parallel_marking;
+#endif
+
+/* Return bit N of the mark bits BITS.  */
+static bool
+mark_bit_p (bits_word *bits, int n)
+{
+  bits_word *word = &bits[n / BITS_PER_BITS_WORD];
+#ifdef PARALLEL_MARKING
+  bits_word w = __atomic_load_n (word, __ATOMIC_RELAXED);
+#else
+  bits_word w = *word;
+#endif
+  return (w >> (n % BITS_PER_BITS_WORD)) & 1;
+}
+
+/* Set bit N of the mark bits BITS, and return true if it was clear.
+   While marking is parallel, other threads can be setting other bits
+   of the same word, so do it atomically then.  */
+static bool
+set_mark_bit (bits_word *bits, int n)
+{
+  bits_word *word = &bits[n / BITS_PER_BITS_WORD];
+  bits_word bit = (bits_word) 1 << (n % BITS_PER_BITS_WORD);
+
+#ifdef PARALLEL_MARKING
+  if (parallel_marking)
+    return ! (__atomic_fetch_or (word, bit, __ATOMIC_RELAXED) & bit);
+#endif
+  if (*word & bit)
+    return false;
+  *word |= bit;
+  return true;
+}
+
+#define GETMARKBIT(block,n) mark_bit_p ((block)->gcmarkbits, n)
+
+#define SETMARKBIT(block,n) set_mark_bit ((block)->gcmarkbits, n)
 
 #define UNSETMARKBIT(block,n)				\
   ((block)->gcmarkbits[(n) / BITS_PER_BITS_WORD]	\
@@ -3214,6 +3255,12 @@ cleanup_vector (struct Lisp_Vector *vector)
     finalize_one_mutex ((struct Lisp_Mutex *) vector);
   else if (PSEUDOVECTOR_TYPEP (&vector->header, PVEC_CONDVAR))
     finalize_one_condvar ((struct Lisp_CondVar *) vector);
+  else if (PSEUDOVECTOR_TYPEP (&vector->header, PVEC_HASH_TABLE))
+    free_hash_table_arrays ((struct Lisp_Hash_Table *) vector);
+#ifdef HAVE_ZLIB
+  else if (PSEUDOVECTOR_TYPEP (&vector->header, PVEC_ZLIB_STREAM))
+    finalize_zlib_stream (vector);
+#endif
 }
 
 /* Reclaim space used by unmarked vectors.  */
@@ -3803,18 +3850,20 @@ free_save_value (Lisp_Object save)
   free_misc (save);
 }
 
-/* Return a Lisp_Misc_Overlay object with specified START, END and PLIST.  */
+/* Return a Lisp_Misc_Overlay object with the specified insertion types
+   and PLIST, not yet in any buffer.  */
 
 Lisp_Object
-build_overlay (Lisp_Object start, Lisp_Object end, Lisp_Object plist)
+build_overlay (bool front_advance, bool rear_advance, Lisp_Object plist)
 {
-  register Lisp_Object overlay;
+  Lisp_Object overlay;
+  struct itree_node *node = xmalloc (sizeof *node);
 
   overlay = allocate_misc (Lisp_Misc_Overlay);
-  OVERLAY_START (overlay) = start;
-  OVERLAY_END (overlay) = end;
+  itree_node_init (node, front_advance, rear_advance, overlay);
+  XOVERLAY (overlay)->buffer = NULL;
+  XOVERLAY (overlay)->interval = node;
   set_overlay_plist (overlay, plist);
-  XOVERLAY (overlay)->next = NULL;
   return overlay;
 }
 
@@ -5519,6 +5568,9 @@ purecopy (Lisp_Object obj)
       memcpy (vec, objp, nbytes);
       for (i = 0; i < size; i++)
 	vec->contents[i] = purecopy (vec->contents[i]);
+      if (HASH_TABLE_P (obj))
+	copy_hash_table_arrays ((struct Lisp_Hash_Table *) vec,
+				XHASH_TABLE (obj));
       XSETVECTOR (obj, vec);
     }
   else if (SYMBOLP (obj))
@@ -5757,6 +5809,7 @@ garbage_collect_1 (void *end)
   bool message_p;
   ptrdiff_t count = SPECPDL_INDEX ();
   struct timespec start;
+  double pause;
   Lisp_Object retval = Qnil;
   size_t tot_before = 0;
 
@@ -5832,6 +5885,8 @@ garbage_collect_1 (void *end)
 
   gc_in_progress = 1;
 
+  start_parallel_marking ();
+
   /* Mark all the special slots that serve as the roots of accessibility.  */
 
   mark_buffer (&buffer_defaults);
@@ -5847,6 +5902,7 @@ garbage_collect_1 (void *end)
   mark_terminals ();
   mark_kboards ();
   mark_threads ();
+  mark_regexp_cache ();
 
 #ifdef USE_GTK
   xg_mark_data ();
@@ -5856,6 +5912,8 @@ garbage_collect_1 (void *end)
   mark_fringe_data ();
 #endif
 
+  finish_parallel_marking ();
+
   /* Everything is now marked, except for the data in font caches,
      undo lists, and finalizers.  The first two are compacted by
      removing an items which aren't reachable otherwise.  */
@@ -5914,12 +5972,21 @@ garbage_collect_1 (void *end)
 	}
     }
 
+  /* The collection proper is over; what follows no longer keeps the
+     user waiting.  */
+  pause = timespectod (timespec_sub (current_timespec (), start));
+
   if (garbage_collection_messages && NILP (Vmemory_full))
     {
       if (message_p || minibuf_level > 0)
 	restore_message ();
       else
-	message1_nolog ("Garbage collecting...done");
+	{
+	  char done[64];
+	  snprintf (done, sizeof done, "Garbage collecting...done (%.3fs)",
+		    pause);
+	  message1_nolog (done);
+	}
     }
 
   unbind_to (count, Qnil);
@@ -5980,6 +6047,11 @@ garbage_collect_1 (void *end)
 				+ timespectod (since_start));
     }
 
+  if (FLOATP (Vgc_pause_last))
+    Vgc_pause_last = make_float (pause);
+  if (FLOATP (Vgc_pause_max) && XFLOAT_DATA (Vgc_pause_max) < pause)
+    Vgc_pause_max = make_float (pause);
+
   gcs_done++;
 
   /* Collect profiling data.  */
@@ -6174,12 +6246,9 @@ mark_compiled (struct Lisp_Vector *ptr)
 static void
 mark_overlay (struct Lisp_Overlay *ptr)
 {
-  for (; ptr && !ptr->gcmarkbit; ptr = ptr->next)
+  if (!ptr->gcmarkbit)
     {
       ptr->gcmarkbit = 1;
-      /* These two are always markers and can be marked fast.  */
-      XMARKER (ptr->start)->gcmarkbit = 1;
-      XMARKER (ptr->end)->gcmarkbit = 1;
       mark_object (ptr->plist);
     }
 }
@@ -6200,8 +6269,13 @@ mark_buffer (struct buffer *buffer)
      a special way just before the sweep phase, and after stripping
      some of its elements that are not needed any more.  */
 
-  mark_overlay (buffer->overlays_before);
-  mark_overlay (buffer->overlays_after);
+  {
+    struct itree_iterator it;
+    struct itree_node *node;
+
+    ITREE_FOREACH (node, it, &buffer->overlays, PTRDIFF_MIN, PTRDIFF_MAX)
+      mark_overlay (XOVERLAY (node->data));
+  }
 
   /* If this is an indirect buffer, mark its base buffer.  */
   if (buffer->base_buffer && !VECTOR_MARKED_P (buffer->base_buffer))
@@ -6302,6 +6376,439 @@ mark_discard_killed_buffers (Lisp_Object list)
   return list;
 }
 
+#ifdef PARALLEL_MARKING
+
+/* Parallel marking.
+
+   Most of a big heap is usually made of conses, and marking a cons
+   does nothing but set its mark bit.  So while the main thread marks
+   from the roots, helper threads mark the conses it finds, and what
+   these lead to.  They leave the objects of other types to the main
+   thread, since marking them can have side effects; conversely, the
+   main thread leaves to the helpers the conses it finds.  Objects are
+   passed around in packets, on lists protected by MARK_MUTEX.  */
+
+/* The number of objects in a packet.  */
+enum { MARK_PACKET_SIZE = 512 };
+
+/* The most helper threads to start.  */
+enum { MAX_MARK_HELPERS = 64 };
+
+/* Don't bother with helper threads unless the last GC found at least
+   this many conses and floats.  */
+enum { PARALLEL_MARKING_THRESHOLD = 256 * 1024 };
+
+struct mark_packet
+{
+  struct mark_packet *next;
+  int n;
+  Lisp_Object objs[MARK_PACKET_SIZE];
+};
+
+static sys_mutex_t mark_mutex;
+
+/* Broadcast when a packet is queued or freed, or a thread is done
+   with a packet.  */
+static sys_cond_t mark_cond;
+
+/* Packets of conses for any thread to mark, packets of other objects
+   for the main thread to mark, and free packets.  */
+static struct mark_packet *mark_queue, *mark_main_queue, *mark_free_packets;
+
+/* The number of helper threads started, the number of threads marking
+   a packet, and the number of helpers waiting for one.  */
+static int mark_helpers, mark_busy, mark_idle;
+
+/* The helper threads, which are joined when they are stopped.  */
+static pthread_t mark_helper_threads[MAX_MARK_HELPERS];
+
+/* Helper threads whose index is at least this stop; see
+   stop_mark_helpers.  */
+static int mark_helpers_wanted;
+
+/* The packet the main thread fills with the conses it finds.  */
+static struct mark_packet *main_mark_packet;
+
+/* Put PACKET on the list *QUEUE.  MARK_MUTEX must be held.  */
+
+static void
+queue_mark_packet (struct mark_packet **queue, struct mark_packet *packet)
+{
+  packet->next = *queue;
+  *queue = packet;
+  sys_cond_broadcast (&mark_cond);
+}
+
+/* Return an empty packet.  If there is none and no memory for one,
+   wait for one if WAIT, and otherwise return NULL.  MARK_MUTEX must
+   be held.  */
+
+static struct mark_packet *
+get_mark_packet (bool wait)
+{
+  while (true)
+    {
+      struct mark_packet *packet = mark_free_packets;
+
+      if (packet)
+	mark_free_packets = packet->next;
+      else
+	packet = malloc (sizeof *packet);
+      if (packet)
+	{
+	  packet->n = 0;
+	  return packet;
+	}
+      if (!wait)
+	return NULL;
+      sys_cond_wait (&mark_cond, &mark_mutex);
+    }
+}
+
+/* Add OBJ to the packet *FOREIGN of objects for the main thread, and
+   queue that packet if it is full.  */
+
+static void
+hand_to_main_thread (Lisp_Object obj, struct mark_packet **foreign)
+{
+  if (!*foreign)
+    {
+      sys_mutex_lock (&mark_mutex);
+      *foreign = get_mark_packet (true);
+      sys_mutex_unlock (&mark_mutex);
+    }
+  (*foreign)->objs[(*foreign)->n++] = obj;
+  if ((*foreign)->n == MARK_PACKET_SIZE)
+    {
+      sys_mutex_lock (&mark_mutex);
+      queue_mark_packet (&mark_main_queue, *foreign);
+      sys_mutex_unlock (&mark_mutex);
+      *foreign = NULL;
+    }
+}
+
+/* Give away the older half of the mark stack STACK to idle threads,
+   if there is a packet to spare.  */
+
+static void
+share_mark_stack (struct mark_packet *stack)
+{
+  struct mark_packet *packet;
+  int half = stack->n / 2;
+
+  sys_mutex_lock (&mark_mutex);
+  packet = get_mark_packet (false);
+  if (packet)
+    {
+      memcpy (packet->objs, stack->objs, half * sizeof *stack->objs);
+      packet->n = half;
+      memmove (stack->objs, stack->objs + half,
+	       (stack->n - half) * sizeof *stack->objs);
+      stack->n -= half;
+      queue_mark_packet (&mark_queue, packet);
+    }
+  sys_mutex_unlock (&mark_mutex);
+}
+
+/* Mark OBJ, which is not a cons, on behalf of mark_conses.  */
+
+static void
+mark_cons_element (Lisp_Object obj, struct mark_packet **foreign)
+{
+  switch (XTYPE (obj))
+    {
+    case Lisp_Float:
+      if (!PURE_P (XFLOAT (obj)))
+	FLOAT_MARK (XFLOAT (obj));
+      break;
+
+    case_Lisp_Int:
+      break;
+
+    case Lisp_Symbol:
+      /* The main thread marks the builtin symbols anyway.  */
+      if (c_symbol_p (XSYMBOL (obj)))
+	break;
+      /* Fall through.  */
+    default:
+      if (foreign)
+	hand_to_main_thread (obj, foreign);
+      else
+	mark_object (obj);
+    }
+}
+
+/* Mark the conses in the packet STACK, and what they lead to, using
+   STACK as the mark stack.  If FOREIGN is null, this runs in the main
+   thread; otherwise, leave the objects that are not conses or floats
+   to the main thread by adding them to the packet *FOREIGN.  */
+
+static void
+mark_conses (struct mark_packet *stack, struct mark_packet **foreign)
+{
+  while (stack->n > 0)
+    {
+      Lisp_Object obj = stack->objs[--stack->n];
+
+      if (stack->n > 1 && __atomic_load_n (&mark_idle, __ATOMIC_RELAXED))
+	share_mark_stack (stack);
+
+      /* Follow cars, and push cdrs.  */
+      while (true)
+	{
+	  struct Lisp_Cons *ptr;
+	  Lisp_Object cdr;
+
+	  if (!CONSP (obj))
+	    {
+	      mark_cons_element (obj, foreign);
+	      break;
+	    }
+	  ptr = XCONS (obj);
+	  if (PURE_P (ptr) || !CONS_MARK (ptr))
+	    break;
+	  cdr = ptr->u.cdr;
+	  if (!CONSP (cdr))
+	    mark_cons_element (cdr, foreign);
+	  else if (stack->n < MARK_PACKET_SIZE)
+	    stack->objs[stack->n++] = cdr;
+	  else if (foreign)
+	    hand_to_main_thread (cdr, foreign);
+	  else
+	    mark_object (cdr);
+	  obj = ptr->car;
+	}
+    }
+}
+
+/* The body of the helper thread whose index is ARG.  */
+
+static void *
+mark_helper (void *arg)
+{
+  int index = (intptr_t) arg;
+  struct mark_packet *foreign = NULL;
+
+  sys_mutex_lock (&mark_mutex);
+  while (true)
+    {
+      struct mark_packet *packet;
+
+      __atomic_add_fetch (&mark_idle, 1, __ATOMIC_RELAXED);
+      while (!mark_queue && index < mark_helpers_wanted)
+	sys_cond_wait (&mark_cond, &mark_mutex);
+      __atomic_sub_fetch (&mark_idle, 1, __ATOMIC_RELAXED);
+      if (index >= mark_helpers_wanted)
+	break;
+      packet = mark_queue;
+      mark_queue = packet->next;
+      mark_busy++;
+      sys_mutex_unlock (&mark_mutex);
+
+      mark_conses (packet, &foreign);
+
+      sys_mutex_lock (&mark_mutex);
+      queue_mark_packet (&mark_free_packets, packet);
+      if (foreign)
+	{
+	  queue_mark_packet (&mark_main_queue, foreign);
+	  foreign = NULL;
+	}
+      mark_busy--;
+    }
+  sys_mutex_unlock (&mark_mutex);
+  return NULL;
+}
+
+/* Stop all but the first KEEP helper threads, and wait for them to
+   exit.  This must not be called while marking.  */
+
+void
+stop_mark_helpers (int keep)
+{
+  int i;
+
+  if (mark_helpers <= keep)
+    return;
+  sys_mutex_lock (&mark_mutex);
+  mark_helpers_wanted = keep;
+  sys_cond_broadcast (&mark_cond);
+  sys_mutex_unlock (&mark_mutex);
+  for (i = keep; i < mark_helpers; i++)
+    pthread_join (mark_helper_threads[i], NULL);
+  mark_helpers = keep;
+}
+
+/* Forget the helper threads, in a child made by fork, which has none
+   of them.  The next GC starts new ones.  */
+
+void
+forget_mark_helpers (void)
+{
+  mark_helpers = mark_helpers_wanted = 0;
+  mark_busy = mark_idle = 0;
+}
+
+/* Queue the packet of conses the main thread has filled, if any.  */
+
+static void
+flush_main_mark_packet (void)
+{
+  if (main_mark_packet)
+    {
+      sys_mutex_lock (&mark_mutex);
+      queue_mark_packet (&mark_queue, main_mark_packet);
+      sys_mutex_unlock (&mark_mutex);
+      main_mark_packet = NULL;
+    }
+}
+
+/* Leave the cons OBJ to the helper threads.  Return false if there is
+   no memory for that, in which case the caller should mark OBJ.  */
+
+static bool
+queue_parallel_mark (Lisp_Object obj)
+{
+  if (!main_mark_packet)
+    {
+      sys_mutex_lock (&mark_mutex);
+      main_mark_packet = get_mark_packet (false);
+      sys_mutex_unlock (&mark_mutex);
+      if (!main_mark_packet)
+	return false;
+    }
+  main_mark_packet->objs[main_mark_packet->n++] = obj;
+  if (main_mark_packet->n == MARK_PACKET_SIZE)
+    flush_main_mark_packet ();
+  return true;
+}
+
+/* Start helper threads marking conses, if the heap is big enough to
+   make it worthwhile.  */
+
+static void
+start_parallel_marking (void)
+{
+  int helpers = clip_to_bounds (0, gc_mark_threads, MAX_MARK_HELPERS);
+  int i;
+
+  /* Stop the helpers no longer wanted, even if this GC is to do
+     without them.  */
+  stop_mark_helpers (helpers);
+
+  if (!initialized || helpers == 0 || !NILP (Vmemory_full)
+      || total_conses + total_floats < PARALLEL_MARKING_THRESHOLD)
+    return;
+
+  if (mark_helpers == 0)
+    {
+      sys_mutex_init (&mark_mutex);
+      sys_cond_init (&mark_cond);
+    }
+  if (mark_helpers < helpers)
+    {
+      /* Signals are for the main thread.  */
+      sigset_t blocked, oldset;
+
+      sys_mutex_lock (&mark_mutex);
+      mark_helpers_wanted = helpers;
+      sys_mutex_unlock (&mark_mutex);
+      sigfillset (&blocked);
+      pthread_sigmask (SIG_SETMASK, &blocked, &oldset);
+      while (mark_helpers < helpers
+	     && (pthread_create (&mark_helper_threads[mark_helpers], NULL,
+				 mark_helper, (void *) (intptr_t) mark_helpers)
+		 == 0))
+	mark_helpers++;
+      pthread_sigmask (SIG_SETMASK, &oldset, NULL);
+      if (mark_helpers == 0)
+	return;
+    }
+
+  /* Each helper holds at most two packets, and the main thread one;
+     set aside enough free packets that no thread waits for one while
+     the others do too.  */
+  sys_mutex_lock (&mark_mutex);
+  for (i = 0; i < 2 * mark_helpers + 2; i++)
+    {
+      struct mark_packet *packet = malloc (sizeof *packet);
+      if (!packet)
+	break;
+      packet->next = mark_free_packets;
+      mark_free_packets = packet;
+    }
+  parallel_marking = i == 2 * mark_helpers + 2;
+  sys_mutex_unlock (&mark_mutex);
+}
+
+/* Mark, with the help of the helper threads, everything left to mark,
+   and wait for them to be done.  */
+
+static void
+finish_parallel_marking (void)
+{
+  if (!parallel_marking)
+    return;
+
+  flush_main_mark_packet ();
+  sys_mutex_lock (&mark_mutex);
+  while (true)
+    {
+      struct mark_packet *packet;
+      bool foreign = mark_main_queue != NULL;
+
+      if (foreign)
+	{
+	  packet = mark_main_queue;
+	  mark_main_queue = packet->next;
+	}
+      else if (mark_queue)
+	{
+	  packet = mark_queue;
+	  mark_queue = packet->next;
+	}
+      else if (mark_busy == 0)
+	break;
+      else
+	{
+	  sys_cond_wait (&mark_cond, &mark_mutex);
+	  continue;
+	}
+      sys_mutex_unlock (&mark_mutex);
+
+      if (foreign)
+	{
+	  int i;
+	  for (i = 0; i < packet->n; i++)
+	    mark_object (packet->objs[i]);
+	}
+      else
+	mark_conses (packet, NULL);
+      flush_main_mark_packet ();
+
+      sys_mutex_lock (&mark_mutex);
+      queue_mark_packet (&mark_free_packets, packet);
+    }
+
+  parallel_marking = false;
+  while (mark_free_packets)
+    {
+      struct mark_packet *packet = mark_free_packets;
+      mark_free_packets = packet->next;
+      free (packet);
+    }
+  sys_mutex_unlock (&mark_mutex);
+}
+
+#else  /* !PARALLEL_MARKING */
+
+static void start_parallel_marking (void) {}
+static void finish_parallel_marking (void) {}
+void stop_mark_helpers (int keep) {}
+void forget_mark_helpers (void) {}
+
+#endif /* !PARALLEL_MARKING */
+
 /* Determine type of generic Lisp_Object and mark it accordingly.
 
    This function implements a straightforward depth-first marking
@@ -6614,6 +7121,10 @@ mark_object (Lisp_Object arg)
     case Lisp_Cons:
       {
 	register struct Lisp_Cons *ptr = XCONS (obj);
+#ifdef PARALLEL_MARKING
+	if (parallel_marking && queue_parallel_mark (obj))
+	  break;
+#endif
 	if (CONS_MARKED_P (ptr))
 	  break;
 	CHECK_ALLOCATED_AND_LIVE (live_cons_p);
@@ -6984,6 +7495,8 @@ sweep_misc (void)
                 unchain_marker (&mblk->markers[i].m.u_marker);
               else if (mblk->markers[i].m.u_any.type == Lisp_Misc_Finalizer)
                 unchain_finalizer (&mblk->markers[i].m.u_finalizer);
+	      else if (mblk->markers[i].m.u_any.type == Lisp_Misc_Overlay)
+		xfree (mblk->markers[i].m.u_overlay.interval);
 #ifdef HAVE_MODULES
 	      else if (mblk->markers[i].m.u_any.type == Lisp_Misc_User_Ptr)
 		{
@@ -7376,8 +7889,17 @@ init_alloc (void)
   setjmp_tested_p = longjmps_done = 0;
 #endif
   Vgc_elapsed = make_float (0.0);
+  Vgc_pause_last = make_float (0.0);
+  Vgc_pause_max = make_float (0.0);
   gcs_done = 0;
 
+#if defined PARALLEL_MARKING && defined _SC_NPROCESSORS_ONLN
+  {
+    long nprocs = sysconf (_SC_NPROCESSORS_ONLN);
+    gc_mark_threads = clip_to_bounds (0, nprocs - 1, 7);
+  }
+#endif
+
 #if USE_VALGRIND
   valgrind_p = RUNNING_ON_VALGRIND != 0;
 #endif
@@ -7483,6 +8005,27 @@ The time is in seconds as a floating point value.  */);
   DEFVAR_INT ("gcs-done", gcs_done,
               doc: /* Accumulated number of garbage collections done.  */);
 
+  DEFVAR_LISP ("gc-pause-last", Vgc_pause_last,
+	       doc: /* Time spent marking and sweeping in the last garbage collection.
+The time is in seconds as a floating point value.  Unlike `gc-elapsed',
+this does not include the time spent running `post-gc-hook' and
+finalizers, during which Emacs can already respond to input.  */);
+  DEFVAR_LISP ("gc-pause-max", Vgc_pause_max,
+	       doc: /* Longest value of `gc-pause-last' seen so far.
+The time is in seconds as a floating point value.  Set this to 0.0 to
+start measuring afresh.  */);
+
+  DEFVAR_INT ("gc-mark-threads", gc_mark_threads,
+	      doc: /* Number of helper threads that mark objects during garbage collection.
+When the heap is big, threads other than the main one mark the cons
+cells and floats that are reachable; this makes garbage collection
+take less time on machines with several processors.  Zero means to
+mark objects in the main thread only.  The helper threads no longer
+needed when this is lowered stop at the next garbage collection.  The
+default is one less than the number of processors, up to 7.  This has
+no effect unless Emacs was built with thread support.  */);
+  gc_mark_threads = 0;
+
   defsubr (&Scons);
   defsubr (&Slist);
   defsubr (&Svector);
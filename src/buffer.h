@@ -26,6 +26,7 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
 
 #include "character.h"
 #include "lisp.h"
+#include "itree.h"
 
 INLINE_HEADER_BEGIN
 
@@ -469,6 +470,15 @@ struct buffer_text
     /* Properties of this buffer's text.  */
     INTERVAL intervals;
 
+    /* The interval find_interval found last in INTERVALS, or NULL,
+       and the position where it starts.  Lookups at the same or a
+       neighboring position start there instead of at the root.  This
+       is valid while interval_tree_modiff equals
+       CACHED_INTERVAL_MODIFF, and is reset when INTERVALS changes.  */
+    INTERVAL cached_interval;
+    ptrdiff_t cached_interval_pos;
+    EMACS_INT cached_interval_modiff;
+
     /* The markers that refer to this buffer.
        This is actually a single marker ---
        successive elements in its marker `chain'
@@ -855,6 +865,10 @@ struct buffer
   struct region_cache *width_run_cache;
   struct region_cache *bidi_paragraph_cache;
 
+  /* If the long line scan cache is enabled and long scans were made
+     in this buffer, the index of its lines; see line-index.h.  */
+  struct line_index *line_index;
+
   /* Non-zero means disable redisplay optimizations when rebuilding the glyph
      matrices (but not when redrawing).  */
   bool_bf prevent_redisplay_optimizations_p : 1;
@@ -862,16 +876,9 @@ struct buffer
   /* Non-zero whenever the narrowing is changed in this buffer.  */
   bool_bf clip_changed : 1;
 
-  /* List of overlays that end at or before the current center,
-     in order of end-position.  */
-  struct Lisp_Overlay *overlays_before;
-
-  /* List of overlays that end after  the current center,
-     in order of start-position.  */
-  struct Lisp_Overlay *overlays_after;
-
-  /* Position where the overlay lists are centered.  */
-  ptrdiff_t overlay_center;
+  /* The overlays of this buffer, in an interval tree ordered by
+     start position.  */
+  struct itree_tree overlays;
 
   /* Changes in the buffer are recorded here for undo, and t means
      don't record anything.  This information belongs to the base
@@ -1076,16 +1083,16 @@ extern void reset_buffer (struct buffer *);
 extern void compact_buffer (struct buffer *);
 extern void evaporate_overlays (ptrdiff_t);
 extern ptrdiff_t overlays_at (EMACS_INT, bool, Lisp_Object **,
-			      ptrdiff_t *, ptrdiff_t *, ptrdiff_t *, bool);
+			      ptrdiff_t *, ptrdiff_t *);
+extern ptrdiff_t next_overlay_change (ptrdiff_t);
+extern ptrdiff_t previous_overlay_change (ptrdiff_t);
 extern ptrdiff_t sort_overlays (Lisp_Object *, ptrdiff_t, struct window *);
-extern void recenter_overlay_lists (struct buffer *, ptrdiff_t);
 extern ptrdiff_t overlay_strings (ptrdiff_t, struct window *, unsigned char **);
 extern void validate_region (Lisp_Object *, Lisp_Object *);
 extern void set_buffer_internal_1 (struct buffer *);
 extern void set_buffer_temp (struct buffer *);
 extern Lisp_Object buffer_local_value (Lisp_Object, Lisp_Object);
 extern void record_buffer (Lisp_Object);
-extern void fix_overlays_before (struct buffer *, ptrdiff_t, ptrdiff_t);
 extern void mmap_set_vars (bool);
 extern void restore_buffer (Lisp_Object);
 extern void set_buffer_if_live (Lisp_Object);
@@ -1124,21 +1131,20 @@ record_unwind_current_buffer (void)
 }
 
 /* Get overlays at POSN into array OVERLAYS with NOVERLAYS elements.
-   If NEXTP is non-NULL, return next overlay there.
-   See overlay_at arg CHANGE_REQ for meaning of CHRQ arg.  */
+   If NEXTP is non-NULL, return next overlay there.  */
 
-#define GET_OVERLAYS_AT(posn, overlays, noverlays, nextp, chrq)		\
+#define GET_OVERLAYS_AT(posn, overlays, noverlays, nextp)		\
   do {									\
     ptrdiff_t maxlen = 40;						\
     SAFE_NALLOCA (overlays, 1, maxlen);					\
     (noverlays) = overlays_at (posn, false, &(overlays), &maxlen,	\
-			       nextp, NULL, chrq);			\
+			       nextp);					\
     if ((noverlays) > maxlen)						\
       {									\
 	maxlen = noverlays;						\
 	SAFE_NALLOCA (overlays, 1, maxlen);				\
 	(noverlays) = overlays_at (posn, false, &(overlays), &maxlen,	\
-				   nextp, NULL, chrq);			\
+				   nextp);				\
       }									\
   } while (false)
 
@@ -1166,6 +1172,7 @@ set_buffer_intervals (struct buffer *b, INTERVAL i)
 {
   eassert (b->text != NULL);
   b->text->intervals = i;
+  b->text->cached_interval = NULL;
 }
 
 /* Non-zero if current buffer has overlays.  */
@@ -1173,7 +1180,7 @@ set_buffer_intervals (struct buffer *b, INTERVAL i)
 INLINE bool
 buffer_has_overlays (void)
 {
-  return current_buffer->overlays_before || current_buffer->overlays_after;
+  return !itree_empty_p (&current_buffer->overlays);
 }
 
 /* Return character code of multi-byte form at byte position POS.  If POS
@@ -1213,23 +1220,37 @@ buffer_window_count (struct buffer *b)
 
 /* Overlays */
 
-/* Return the marker that stands for where OV starts in the buffer.  */
+/* Return the buffer OV belongs to, or NULL if it has been deleted.  */
 
-#define OVERLAY_START(OV) XOVERLAY (OV)->start
+INLINE struct buffer *
+OVERLAY_BUFFER (Lisp_Object ov)
+{
+  return XOVERLAY (ov)->buffer;
+}
 
-/* Return the marker that stands for where OV ends in the buffer.  */
+/* Return the position where OV starts in its buffer, or -1 if OV has
+   been deleted.  */
 
-#define OVERLAY_END(OV) XOVERLAY (OV)->end
+INLINE ptrdiff_t
+OVERLAY_START (Lisp_Object ov)
+{
+  struct Lisp_Overlay *o = XOVERLAY (ov);
+  return o->buffer ? itree_node_begin (o->interval) : -1;
+}
 
-/* Return the plist of overlay OV.  */
+/* Return the position where OV ends in its buffer, or -1 if OV has
+   been deleted.  */
 
-#define OVERLAY_PLIST(OV) XOVERLAY (OV)->plist
+INLINE ptrdiff_t
+OVERLAY_END (Lisp_Object ov)
+{
+  struct Lisp_Overlay *o = XOVERLAY (ov);
+  return o->buffer ? itree_node_end (o->interval) : -1;
+}
 
-/* Return the actual buffer position for the marker P.
-   We assume you know which buffer it's pointing into.  */
+/* Return the plist of overlay OV.  */
 
-#define OVERLAY_POSITION(P) \
- (MARKERP (P) ? marker_position (P) : (emacs_abort (), 0))
+#define OVERLAY_PLIST(OV) XOVERLAY (OV)->plist
 
 
 /***********************************************************************
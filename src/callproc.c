@@ -750,8 +750,8 @@ call_process (ptrdiff_t nargs, Lisp_Object *args, int filefd,
 	  nread = carryover;
 	  while (nread < bufsize - 1024)
 	    {
-	      int this_read = emacs_read (fd0, buf + nread,
-					  bufsize - nread);
+	      int this_read = emacs_read_without_lock (fd0, buf + nread,
+						       bufsize - nread);
 
 	      if (this_read < 0)
 		goto give_up;
@@ -1144,6 +1144,40 @@ alloc_destination (struct coding_system *coding, ptrdiff_t nbytes,
 #define UTF_8_BOM_2 0xBB
 #define UTF_8_BOM_3 0xBF
 
+/* Return a pointer to the first word of the bytes from P up to END
+   that contains a control character (a byte less than 0x20) or, if
+   ASCII, a byte that is not ASCII.  Words are looked at as a whole,
+   so the returned pointer is P plus a multiple of the word size, and
+   bytes before it are all printable; it may be at most a word short
+   of END even if there is no such byte.
+
+   Almost all text is plain ASCII but for line ends, and the callers
+   below use this to skip it a word at a time rather than byte by
+   byte.  See count_newlines for how the bytes of a word are tested
+   in parallel: subtracting 0x20 from each byte borrows from its high
+   bit exactly when the byte is less than 0x20, unless the byte had
+   its high bit set already.  */
+
+static const unsigned char *
+skip_plain_words (const unsigned char *p, const unsigned char *end,
+		  bool ascii)
+{
+  unsigned long const ones = ULONG_MAX / UCHAR_MAX;
+  unsigned long const highs = ones << 7;
+  unsigned long const controls = ones * 0x20;
+
+  while (end - p >= (ptrdiff_t) sizeof (unsigned long))
+    {
+      unsigned long w;
+
+      memcpy (&w, p, sizeof w);
+      if ((ascii && (w & highs)) || ((w - controls) & ~w & highs))
+	break;
+      p += sizeof w;
+    }
+  return p;
+}
+
 /* Unlike the other detect_coding_XXX, this function counts the number
    of characters and checks the EOL format.  */
 
@@ -1178,6 +1212,12 @@ detect_coding_utf_8 (struct coding_system *coding,
     {
       int c, c1, c2, c3, c4;
 
+      if (! multibytep)
+	{
+	  const unsigned char *plain = skip_plain_words (src, src_end, true);
+	  nchars += plain - src;
+	  src = plain;
+	}
       src_base = src;
       ONE_MORE_BYTE (c);
       if (c < 0 || UTF_8_1_OCTET_P (c))
@@ -6207,7 +6247,8 @@ check_ascii (struct coding_system *coding)
       || SYMBOLP (eol_type))
     {
       /* We don't have to check EOL format.  */
-      while (src < end && !( *src & 0x80))
+      while ((src = skip_plain_words (src, end, true)) < end
+	     && !( *src & 0x80))
 	{
 	  if (*src++ == '\n')
 	    eol_seen |= EOL_SEEN_LF;
@@ -6216,7 +6257,7 @@ check_ascii (struct coding_system *coding)
   else
     {
       end--;		    /* We look ahead one byte for "CR LF".  */
-      while (src < end)
+      while ((src = skip_plain_words (src, end, true)) < end)
 	{
 	  int c = *src;
 
@@ -6281,7 +6322,14 @@ check_utf_8 (struct coding_system *coding)
   eol_seen = coding->eol_seen;
   while (src < end)
     {
-      int c = *src;
+      const unsigned char *plain = skip_plain_words (src, end, true);
+      int c;
+
+      nchars += plain - src;
+      src = plain;
+      if (src == end)
+	break;
+      c = *src;
 
       if (UTF_8_1_OCTET_P (*src))
 	{
@@ -6526,6 +6574,14 @@ detect_coding (struct coding_system *coding)
       detect_info.checked = detect_info.found = detect_info.rejected = 0;
       for (src = coding->source; src < src_end; src++)
 	{
+	  const unsigned char *plain
+	    = skip_plain_words (src, src_end, !eight_bit_found);
+
+	  if (! eight_bit_found)
+	    coding->head_ascii += plain - src;
+	  src = plain;
+	  if (src == src_end)
+	    break;
 	  c = *src;
 	  if (c & 0x80)
 	    {
@@ -7860,6 +7916,82 @@ coding_restore_undo_list (Lisp_Object arg)
   bset_undo_list (buf, undo_list);
 }
 
+/* Return true if decoding the NBYTES bytes at SRC with CODING into a
+   multibyte buffer would leave them as they are.  This is so for
+   ASCII text if CODING is ASCII compatible and does no EOL
+   conversion, and for valid UTF-8 text if CODING is moreover a UTF-8
+   coding system that does not handle a BOM.  CODING must not need
+   detection, and SRC must start and end at character boundaries.  */
+
+bool
+decoding_preserves_bytes_p (struct coding_system *coding,
+			    const unsigned char *src, ptrdiff_t nbytes)
+{
+  Lisp_Object attrs = CODING_ID_ATTRS (coding->id);
+  const unsigned char *end = src + nbytes;
+  bool utf_8;
+
+  if (NILP (CODING_ATTR_ASCII_COMPAT (attrs))
+      || ! NILP (CODING_ATTR_POST_READ (attrs))
+      || ! NILP (get_translation_table (attrs, 0, NULL))
+      || ! (inhibit_eol_conversion
+	    || EQ (CODING_ID_EOL_TYPE (coding->id), Qunix)))
+    return false;
+  utf_8 = (EQ (CODING_ATTR_TYPE (attrs), Qutf_8)
+	   && CODING_UTF_8_BOM (coding) == utf_without_bom);
+
+  while (src < end)
+    {
+      int c = *src;
+
+      if (UTF_8_1_OCTET_P (c))
+	{
+	  src++;
+	  continue;
+	}
+      if (! utf_8)
+	return false;
+      if (UTF_8_2_OCTET_LEADING_P (c))
+	{
+	  if (c < 0xC2		/* overlong sequence */
+	      || end - src < 2
+	      || ! UTF_8_EXTRA_OCTET_P (src[1]))
+	    return false;
+	  src += 2;
+	}
+      else if (UTF_8_3_OCTET_LEADING_P (c))
+	{
+	  if (end - src < 3
+	      || ! (UTF_8_EXTRA_OCTET_P (src[1])
+		    && UTF_8_EXTRA_OCTET_P (src[2])))
+	    return false;
+	  c = (((c & 0xF) << 12)
+	       | ((src[1] & 0x3F) << 6) | (src[2] & 0x3F));
+	  if (c < 0x800			      /* overlong sequence */
+	      || (c >= 0xd800 && c < 0xe000)) /* surrogates (invalid) */
+	    return false;
+	  src += 3;
+	}
+      else if (UTF_8_4_OCTET_LEADING_P (c))
+	{
+	  if (end - src < 4
+	      || ! (UTF_8_EXTRA_OCTET_P (src[1])
+		    && UTF_8_EXTRA_OCTET_P (src[2])
+		    && UTF_8_EXTRA_OCTET_P (src[3])))
+	    return false;
+	  c = (((c & 0x7) << 18) | ((src[1] & 0x3F) << 12)
+	       | ((src[2] & 0x3F) << 6) | (src[3] & 0x3F));
+	  if (c < 0x10000	/* overlong sequence */
+	      || c >= 0x110000)	/* non-Unicode character  */
+	    return false;
+	  src += 4;
+	}
+      else
+	return false;
+    }
+  return true;
+}
+
 void
 decode_coding_gap (struct coding_system *coding,
 		   ptrdiff_t chars, ptrdiff_t bytes)
@@ -7897,13 +8029,15 @@ decode_coding_gap (struct coding_system *coding,
 	{
 	  /* There exists a non-ASCII byte.  */
 	  if (EQ (CODING_ATTR_TYPE (attrs), Qutf_8)
-	      && coding->detected_utf8_bytes == coding->src_bytes)
+	      && (coding->detected_utf8_bytes < 0
+		  || coding->detected_utf8_bytes == coding->src_bytes))
 	    {
 	      if (coding->detected_utf8_chars >= 0)
 		chars = coding->detected_utf8_chars;
 	      else
 		chars = check_utf_8 (coding);
-	      if (CODING_UTF_8_BOM (coding) != utf_without_bom
+	      if (chars >= 0
+		  && CODING_UTF_8_BOM (coding) != utf_without_bom
 		  && coding->head_ascii == 0
 		  && coding->source[0] == UTF_8_BOM_1
 		  && coding->source[1] == UTF_8_BOM_2
@@ -711,6 +711,8 @@ extern bool raw_text_coding_system_p (struct coding_system *);
 extern Lisp_Object coding_inherit_eol_type (Lisp_Object, Lisp_Object);
 extern Lisp_Object complement_process_encoding_system (Lisp_Object);
 
+extern bool decoding_preserves_bytes_p (struct coding_system *,
+					const unsigned char *, ptrdiff_t);
 extern void decode_coding_gap (struct coding_system *,
 			       ptrdiff_t, ptrdiff_t);
 extern void decode_coding_object (struct coding_system *,
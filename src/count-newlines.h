@@ -0,0 +1,96 @@
+/* Counting newlines a word at a time.
+
+Copyright (C) 2017 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef EMACS_COUNT_NEWLINES_H
+#define EMACS_COUNT_NEWLINES_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <string.h>
+
+INLINE_HEADER_BEGIN
+
+/* Return the number of newlines in the N bytes at P.
+
+   This looks at a whole word at a time.  In X = W ^ NEWLINES, the
+   bytes that are zero are those where the word W holds a newline, and
+   ~(((X & LOWS) + LOWS) | X | LOWS) has the high bit of exactly those
+   bytes set: adding 0x7f to the low seven bits of a byte carries into
+   its high bit unless they are all zero, and never into the next
+   byte.  Shifted down, these bits are added up byte by byte in ACC,
+   which is folded into the total before any byte can overflow.
+   Where a block of words turns out to hold few newlines, the lines
+   are long and the following stretch is left to memchr.  */
+
+INLINE ptrdiff_t
+count_newlines (unsigned char const *p, ptrdiff_t n)
+{
+  unsigned long const ones = ULONG_MAX / UCHAR_MAX;
+  unsigned long const lows = ones * 0x7f;
+  unsigned long const newlines = ones * '\n';
+  unsigned char const *lim = p + n;
+  ptrdiff_t count = 0;
+
+  while (lim - p >= (ptrdiff_t) sizeof (unsigned long))
+    {
+      unsigned long acc = 0;
+      ptrdiff_t block_count = 0;
+      unsigned char const *block = p;
+      int i;
+
+      for (i = 0; i < UCHAR_MAX && lim - p >= (ptrdiff_t) sizeof acc; i++)
+	{
+	  unsigned long w, x;
+
+	  memcpy (&w, p, sizeof w);
+	  x = w ^ newlines;
+	  acc += ~(((x & lows) + lows) | x | lows) >> 7;
+	  p += sizeof w;
+	}
+
+      for (; acc; acc >>= CHAR_BIT)
+	block_count += acc & UCHAR_MAX;
+      count += block_count;
+
+      /* If lines are long, memchr, which the C library usually
+	 vectorizes, finds newlines faster than this loop counts
+	 them; let it do the next stretch.  */
+      if (block_count * 128 < p - block)
+	{
+	  unsigned char const *stretch_lim
+	    = lim - p < 64 * 1024 ? lim : p + 64 * 1024;
+
+	  while ((p = memchr (p, '\n', stretch_lim - p)))
+	    {
+	      count++;
+	      p++;
+	    }
+	  p = stretch_lim;
+	}
+    }
+
+  for (; p < lim; p++)
+    count += *p == '\n';
+
+  return count;
+}
+
+INLINE_HEADER_END
+
+#endif /* EMACS_COUNT_NEWLINES_H */
@@ -264,6 +264,8 @@ for example, (type-of 1) returns `integer'.  */)
 	return Qmutex;
       if (CONDVARP (object))
 	return Qcondition_variable;
+      if (ZLIB_STREAMP (object))
+	return Qzlib_stream;
       return Qvector;
 
     case Lisp_Float:
@@ -3792,6 +3794,7 @@ syms_of_data (void)
   DEFSYM (Qthread, "thread");
   DEFSYM (Qmutex, "mutex");
   DEFSYM (Qcondition_variable, "condition-variable");
+  DEFSYM (Qzlib_stream, "zlib-stream");
 
   DEFSYM (Qdefun, "defun");
 
@@ -36,6 +36,13 @@ DEF_DLL_FN (int, inflateInit2_,
 	     int stream_size));
 DEF_DLL_FN (int, inflate, (z_streamp strm, int flush));
 DEF_DLL_FN (int, inflateEnd, (z_streamp strm));
+DEF_DLL_FN (int, inflateReset, (z_streamp strm));
+DEF_DLL_FN (int, deflateInit2_,
+	    (z_streamp strm, int level, int method, int windowBits,
+	     int memLevel, int strategy, const char *version,
+	     int stream_size));
+DEF_DLL_FN (int, deflate, (z_streamp strm, int flush));
+DEF_DLL_FN (int, deflateEnd, (z_streamp strm));
 
 static bool zlib_initialized;
 
@@ -50,16 +57,28 @@ init_zlib_functions (void)
   LOAD_DLL_FN (library, inflateInit2_);
   LOAD_DLL_FN (library, inflate);
   LOAD_DLL_FN (library, inflateEnd);
+  LOAD_DLL_FN (library, inflateReset);
+  LOAD_DLL_FN (library, deflateInit2_);
+  LOAD_DLL_FN (library, deflate);
+  LOAD_DLL_FN (library, deflateEnd);
   return true;
 }
 
 # undef inflate
 # undef inflateEnd
 # undef inflateInit2_
+# undef inflateReset
+# undef deflate
+# undef deflateEnd
+# undef deflateInit2_
 
 # define inflate fn_inflate
 # define inflateEnd fn_inflateEnd
 # define inflateInit2_ fn_inflateInit2_
+# define inflateReset fn_inflateReset
+# define deflate fn_deflate
+# define deflateEnd fn_deflateEnd
+# define deflateInit2_ fn_deflateInit2_
 
 #endif	/* WINDOWSNT */
 
@@ -107,6 +126,19 @@ DEFUN ("zlib-available-p", Fzlib_available_p, Szlib_available_p, 0, 0, 0,
 #endif
 }
 
+struct inflate_args
+{
+  z_stream *stream;
+  int status;
+};
+
+static void
+call_inflate (void *arg)
+{
+  struct inflate_args *args = arg;
+  args->status = inflate (args->stream, Z_NO_FLUSH);
+}
+
 DEFUN ("zlib-decompress-region", Fzlib_decompress_region,
        Szlib_decompress_region,
        2, 2, 0,
@@ -120,6 +152,7 @@ This function can be called only in unibyte buffers.  */)
   z_stream stream;
   int inflate_status;
   struct decompress_unwind_data unwind_data;
+  Lisp_Object output_markers = Qnil;
   ptrdiff_t count = SPECPDL_INDEX ();
 
   validate_region (&start, &end);
@@ -175,21 +208,77 @@ This function can be called only in unibyte buffers.  */)
       int avail_out = 16 * 1024;
       int decompressed;
 
-      if (GAP_SIZE < avail_out)
-	make_gap (avail_out - GAP_SIZE);
-      stream.next_in = BYTE_POS_ADDR (pos_byte);
-      stream.avail_in = avail_in;
-      stream.next_out = GPT_ADDR;
-      stream.avail_out = avail_out;
-      inflate_status = inflate (&stream, Z_NO_FLUSH);
+      if (other_threads_p ())
+	{
+	  /* Let other threads run while inflating.  As they could
+	     change the buffer meanwhile, inflate a copy of the input
+	     into a separate area.  */
+	  unsigned char in[16 * 1024], out[sizeof in];
+	  EMACS_INT modiff = MODIFF;
+	  ptrdiff_t output_end = iend + unwind_data.nbytes;
+	  struct inflate_args args;
+
+	  /* Track the output inserted so far, so that it can be
+	     deleted even if another thread moves it.  */
+	  if (NILP (output_markers))
+	    {
+	      output_markers = Fcons (build_marker (current_buffer,
+						    iend, iend),
+				      build_marker (current_buffer,
+						    output_end, output_end));
+	      XMARKER (XCDR (output_markers))->insertion_type = true;
+	    }
+
+	  avail_in = min (avail_in, (ptrdiff_t) sizeof in);
+	  memcpy (in, BYTE_POS_ADDR (pos_byte), avail_in);
+	  stream.next_in = in;
+	  stream.avail_in = avail_in;
+	  stream.next_out = out;
+	  stream.avail_out = avail_out;
+	  args.stream = &stream;
+	  thread_call_without_lock (call_inflate, &args);
+	  if (MODIFF != modiff)
+	    {
+	      /* Delete the output wherever it is now.  */
+	      ptrdiff_t output_start = marker_position (XCAR (output_markers));
+	      unwind_data.start = output_start;
+	      unwind_data.nbytes
+		= marker_position (XCDR (output_markers)) - output_start;
+	      error ("Buffer modified by another thread during decompression");
+	    }
+	  /* Other threads can move the gap without modifying the
+	     buffer.  */
+	  move_gap_both (output_end, output_end);
+	  inflate_status = args.status;
+	  decompressed = avail_out - stream.avail_out;
+	  if (GAP_SIZE < decompressed)
+	    make_gap (decompressed - GAP_SIZE);
+	  memcpy (GPT_ADDR, out, decompressed);
+	}
+      else
+	{
+	  if (GAP_SIZE < avail_out)
+	    make_gap (avail_out - GAP_SIZE);
+	  stream.next_in = BYTE_POS_ADDR (pos_byte);
+	  stream.avail_in = avail_in;
+	  stream.next_out = GPT_ADDR;
+	  stream.avail_out = avail_out;
+	  inflate_status = inflate (&stream, Z_NO_FLUSH);
+	  decompressed = avail_out - stream.avail_out;
+	}
       pos_byte += avail_in - stream.avail_in;
-      decompressed = avail_out - stream.avail_out;
       insert_from_gap (decompressed, decompressed, 0);
       unwind_data.nbytes += decompressed;
       QUIT;
     }
   while (inflate_status == Z_OK);
 
+  if (CONSP (output_markers))
+    {
+      Fset_marker (XCAR (output_markers), Qnil, Qnil);
+      Fset_marker (XCDR (output_markers), Qnil, Qnil);
+    }
+
   if (inflate_status != Z_STREAM_END)
     return unbind_to (count, Qnil);
 
@@ -201,6 +290,398 @@ This function can be called only in unibyte buffers.  */)
   return unbind_to (count, Qt);
 }
 
+
+/***********************************************************************
+			     Zlib streams
+ ***********************************************************************/
+
+/* zlib-decompress-region needs all of the compressed data in a
+   buffer, and the buffer holds both it and the decompressed data
+   until it is done.  A zlib stream is instead fed its input a piece
+   at a time, as it is read from a process or a file, and inserts its
+   output into a buffer as it goes, so that only the output need be
+   in memory as a whole.  */
+
+struct Lisp_Zlib_Stream
+{
+  struct vectorlike_header header;
+
+  /* The buffer that output is inserted into.  */
+  Lisp_Object buffer;
+
+  /* The zlib state.  */
+  z_stream stream;
+
+  /* True if the stream compresses its input, false if it
+     decompresses it.  */
+  bool_bf compress : 1;
+
+  /* True if data after the end of some gzip data is another gzip
+     member to decompress, as for the gzip program.  */
+  bool_bf members : 1;
+
+  /* True while decompressing a member other than the first.  */
+  bool_bf later_member : 1;
+
+  /* True if the end of the compressed data has been reached.  */
+  bool_bf at_end : 1;
+
+  /* True if the zlib state has been freed.  */
+  bool_bf closed : 1;
+};
+
+/* The number of bytes of input and output handled at a time.  */
+enum { ZLIB_CHUNK_SIZE = 16 * 1024 };
+
+static struct Lisp_Zlib_Stream *
+XZLIB_STREAM (Lisp_Object a)
+{
+  eassert (ZLIB_STREAMP (a));
+  return XUNTAG (a, Lisp_Vectorlike);
+}
+
+static void
+close_zlib_stream (struct Lisp_Zlib_Stream *s)
+{
+  if (!s->closed)
+    {
+      if (s->compress)
+	deflateEnd (&s->stream);
+      else
+	inflateEnd (&s->stream);
+      s->closed = true;
+    }
+}
+
+/* Free the zlib state of a stream that is garbage.  */
+
+void
+finalize_zlib_stream (struct Lisp_Vector *v)
+{
+  close_zlib_stream ((struct Lisp_Zlib_Stream *) v);
+}
+
+static void
+check_zlib_available (void)
+{
+#ifdef WINDOWSNT
+  if (!zlib_initialized)
+    zlib_initialized = init_zlib_functions ();
+  if (!zlib_initialized)
+    error ("zlib library not found");
+#endif
+}
+
+/* Return the windowBits argument that tells zlib to use FORMAT.  */
+
+static int
+format_window_bits (Lisp_Object format, bool compress)
+{
+  if (NILP (format))
+    /* The magic number 32 means "autodetect both the gzip and zlib
+       formats", when decompressing.  */
+    return compress ? MAX_WBITS + 16 : MAX_WBITS + 32;
+  else if (EQ (format, Qgzip))
+    return MAX_WBITS + 16;
+  else if (EQ (format, Qzlib))
+    return MAX_WBITS;
+  else if (EQ (format, Qdeflate))
+    return -MAX_WBITS;
+  else
+    signal_error ("Invalid compression format", format);
+}
+
+static struct Lisp_Zlib_Stream *
+allocate_zlib_stream (Lisp_Object buffer, bool compress)
+{
+  struct Lisp_Zlib_Stream *s
+    = ALLOCATE_ZEROED_PSEUDOVECTOR (struct Lisp_Zlib_Stream, buffer,
+				    PVEC_ZLIB_STREAM);
+
+  s->buffer = Fget_buffer (buffer);
+  if (NILP (s->buffer))
+    nsberror (buffer);
+  s->compress = compress;
+  s->closed = true;
+  return s;
+}
+
+DEFUN ("zlib-make-decompressor", Fzlib_make_decompressor,
+       Szlib_make_decompressor, 1, 2, 0,
+       doc: /* Return a stream that decompresses data into BUFFER.
+Feed the compressed data to the stream with `zlib-stream-feed', and
+call `zlib-stream-finish' when it has all been fed.
+
+FORMAT is the format of the compressed data: `gzip', `zlib', or
+`deflate' for raw deflate data without a header.  If FORMAT is nil or
+omitted, the data can be in either gzip or zlib format.  As with the
+gzip program, gzip data can consist of several members, which are
+decompressed in turn, and anything after the last member is ignored.  */)
+  (Lisp_Object buffer, Lisp_Object format)
+{
+  Lisp_Object stream;
+  int window_bits = format_window_bits (format, false);
+  struct Lisp_Zlib_Stream *s;
+
+  check_zlib_available ();
+  s = allocate_zlib_stream (buffer, false);
+  if (inflateInit2 (&s->stream, window_bits) != Z_OK)
+    error ("Cannot initialize zlib decompression");
+  s->closed = false;
+  s->members = window_bits > MAX_WBITS;
+  XSETPSEUDOVECTOR (stream, s, PVEC_ZLIB_STREAM);
+  return stream;
+}
+
+DEFUN ("zlib-make-compressor", Fzlib_make_compressor,
+       Szlib_make_compressor, 1, 3, 0,
+       doc: /* Return a stream that compresses data into BUFFER.
+Feed the data to compress to the stream with `zlib-stream-feed', and
+call `zlib-stream-finish' when it has all been fed, to insert the rest
+of the compressed data.
+
+FORMAT is the format of the compressed data: `gzip', which is the
+default, `zlib', or `deflate' for raw deflate data without a header.
+LEVEL is the compression level, from 0 for no compression to 9 for the
+best compression.  If LEVEL is nil or omitted, use the default level
+of zlib, which is a compromise between speed and compression.  */)
+  (Lisp_Object buffer, Lisp_Object format, Lisp_Object level)
+{
+  Lisp_Object stream;
+  int window_bits = format_window_bits (format, true);
+  int compression_level = Z_DEFAULT_COMPRESSION;
+  struct Lisp_Zlib_Stream *s;
+
+  if (!NILP (level))
+    {
+      CHECK_RANGED_INTEGER (level, 0, 9);
+      compression_level = XINT (level);
+    }
+
+  check_zlib_available ();
+  s = allocate_zlib_stream (buffer, true);
+  if (deflateInit2 (&s->stream, compression_level, Z_DEFLATED, window_bits,
+		    8, Z_DEFAULT_STRATEGY)
+      != Z_OK)
+    error ("Cannot initialize zlib compression");
+  s->closed = false;
+  XSETPSEUDOVECTOR (stream, s, PVEC_ZLIB_STREAM);
+  return stream;
+}
+
+DEFUN ("zlib-stream-p", Fzlib_stream_p, Szlib_stream_p, 1, 1, 0,
+       doc: /* Return t if OBJECT is a zlib stream.  */)
+  (Lisp_Object object)
+{
+  return ZLIB_STREAMP (object) ? Qt : Qnil;
+}
+
+/* Copy to IN up to SIZE bytes of DATA, a unibyte string or buffer,
+   from byte POS on, and return the number of bytes copied.  POS
+   counts from the start of the accessible portion of a buffer.  The
+   input is copied because Lisp code run when output is inserted
+   could relocate or change it.  */
+
+static ptrdiff_t
+fetch_zlib_input (Lisp_Object data, ptrdiff_t pos, unsigned char *in,
+		  ptrdiff_t size)
+{
+  if (NILP (data))
+    return 0;
+  else if (STRINGP (data))
+    {
+      ptrdiff_t nbytes = clip_to_bounds (0, SBYTES (data) - pos, size);
+
+      memcpy (in, SDATA (data) + pos, nbytes);
+      return nbytes;
+    }
+  else
+    {
+      struct buffer *b = XBUFFER (data);
+      ptrdiff_t from, to, nbytes;
+
+      if (!BUFFER_LIVE_P (b))
+	error ("Input buffer has been killed");
+      from = BUF_BEGV_BYTE (b) + pos;
+      to = clip_to_bounds (from, from + size, BUF_ZV_BYTE (b));
+      for (nbytes = 0; from + nbytes < to; )
+	{
+	  ptrdiff_t p = from + nbytes;
+	  ptrdiff_t lim = (p < BUF_GPT_BYTE (b)
+			   ? min (BUF_GPT_BYTE (b), to) : to);
+
+	  memcpy (in + nbytes, BUF_BYTE_ADDRESS (b, p), lim - p);
+	  nbytes += lim - p;
+	}
+      return nbytes;
+    }
+}
+
+/* Feed DATA, a unibyte string or buffer, or nil for no data, to the
+   zlib stream S, and insert the output at point in the current
+   buffer.  If FINISH, this is the end of the data to compress.  */
+
+static void
+run_zlib_stream (struct Lisp_Zlib_Stream *s, Lisp_Object data, bool finish)
+{
+  z_stream *stream = &s->stream;
+  unsigned char in[ZLIB_CHUNK_SIZE];
+  /* In a multibyte buffer, output is converted to multibyte in place,
+     which can take twice the room.  */
+  unsigned char out[2 * ZLIB_CHUNK_SIZE];
+  ptrdiff_t pos = 0;
+
+  while (true)
+    {
+      ptrdiff_t avail_in = fetch_zlib_input (data, pos, in, sizeof in);
+      ptrdiff_t nbytes;
+      int status;
+
+      if (s->at_end)
+	{
+	  if (avail_in == 0 || !s->members)
+	    break;
+	  inflateReset (stream);
+	  s->at_end = false;
+	  s->later_member = true;
+	}
+
+      stream->next_in = in;
+      stream->avail_in = avail_in;
+      stream->next_out = out;
+      stream->avail_out = ZLIB_CHUNK_SIZE;
+      if (s->compress)
+	status = deflate (stream, finish ? Z_FINISH : Z_NO_FLUSH);
+      else
+	status = inflate (stream, Z_NO_FLUSH);
+      pos += avail_in - stream->avail_in;
+      nbytes = ZLIB_CHUNK_SIZE - stream->avail_out;
+
+      if (status == Z_STREAM_END)
+	s->at_end = true;
+      else if (status == Z_DATA_ERROR && s->later_member
+	       && stream->total_out == 0)
+	{
+	  /* Like gzip, ignore trailing garbage, such as the zeros that
+	     pad a tape archive.  */
+	  s->at_end = true;
+	  s->members = false;
+	}
+      else if (status != Z_OK && status != Z_BUF_ERROR)
+	{
+	  close_zlib_stream (s);
+	  if (status == Z_MEM_ERROR)
+	    memory_full (SIZE_MAX);
+	  if (s->compress)
+	    error ("zlib compression failed");
+	  xsignal1 (Qzlib_data_error,
+		    build_string ("Invalid compressed data"));
+	}
+
+      if (nbytes > 0)
+	{
+	  if (current_buffer != XBUFFER (s->buffer))
+	    error ("Output buffer has been killed");
+	  if (!NILP (BVAR (current_buffer, enable_multibyte_characters)))
+	    nbytes = str_to_multibyte (out, sizeof out, nbytes);
+	  insert ((char *) out, nbytes);
+	}
+      QUIT;
+
+      /* Stop when all the input has been used and there is no more
+	 output to insert.  */
+      if (s->compress && finish
+	  ? status == Z_STREAM_END
+	  : (stream->avail_in == 0 && stream->avail_out != 0
+	     && avail_in < sizeof in))
+	break;
+    }
+}
+
+/* Make the output buffer of S current, recording how to restore the
+   buffer that is current now.  */
+
+static void
+set_zlib_output_buffer (struct Lisp_Zlib_Stream *s)
+{
+  if (!BUFFER_LIVE_P (XBUFFER (s->buffer)))
+    error ("Output buffer has been killed");
+  record_unwind_current_buffer ();
+  set_buffer_internal (XBUFFER (s->buffer));
+}
+
+DEFUN ("zlib-stream-feed", Fzlib_stream_feed, Szlib_stream_feed, 2, 2, 0,
+       doc: /* Feed DATA to the zlib stream STREAM.
+DATA is a unibyte string, or a unibyte buffer whose accessible portion
+is fed.  A multibyte string must hold only ASCII and raw bytes.
+
+The output of STREAM is inserted at point in its buffer, as by
+`insert', leaving point after it.  If the buffer is multibyte, each
+byte of output is inserted as an ASCII or raw-byte character, to be
+decoded later if need be.
+
+For a decompressor, return t if the end of the compressed data has
+been reached, and nil if more data is expected; signal an error if the
+data is not valid.  For a compressor, return nil.  */)
+  (Lisp_Object stream, Lisp_Object data)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  struct Lisp_Zlib_Stream *s;
+
+  CHECK_TYPE (ZLIB_STREAMP (stream), Qzlib_stream_p, stream);
+  s = XZLIB_STREAM (stream);
+  if (STRINGP (data))
+    {
+      if (STRING_MULTIBYTE (data))
+	data = Fstring_to_unibyte (data);
+    }
+  else
+    {
+      CHECK_BUFFER (data);
+      if (!NILP (BVAR (XBUFFER (data), enable_multibyte_characters)))
+	error ("Input buffer must be unibyte");
+      if (EQ (data, s->buffer))
+	error ("Input buffer is the output buffer");
+    }
+  if (s->closed)
+    error ("Zlib stream has been finished");
+
+  set_zlib_output_buffer (s);
+  run_zlib_stream (s, data, false);
+  return unbind_to (count, s->compress || !s->at_end ? Qnil : Qt);
+}
+
+DEFUN ("zlib-stream-finish", Fzlib_stream_finish, Szlib_stream_finish,
+       1, 1, 0,
+       doc: /* Finish the zlib stream STREAM and free its memory.
+For a compressor, insert the rest of the compressed data into its
+buffer.  For a decompressor, signal an error if the end of the
+compressed data has not been reached.  STREAM cannot be fed afterwards.
+Finishing a stream again does nothing.  */)
+  (Lisp_Object stream)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  struct Lisp_Zlib_Stream *s;
+
+  CHECK_TYPE (ZLIB_STREAMP (stream), Qzlib_stream_p, stream);
+  s = XZLIB_STREAM (stream);
+  if (s->closed)
+    return Qnil;
+  if (s->compress)
+    {
+      set_zlib_output_buffer (s);
+      run_zlib_stream (s, Qnil, true);
+    }
+  else if (!s->at_end)
+    {
+      close_zlib_stream (s);
+      xsignal1 (Qzlib_data_error,
+		build_string ("Compressed data is truncated"));
+    }
+  close_zlib_stream (s);
+  return unbind_to (count, Qnil);
+}
+
 
 /***********************************************************************
 			    Initialization
@@ -208,8 +689,24 @@ This function can be called only in unibyte buffers.  */)
 void
 syms_of_decompress (void)
 {
+  DEFSYM (Qgzip, "gzip");
+  DEFSYM (Qzlib, "zlib");
+  DEFSYM (Qdeflate, "deflate");
+  DEFSYM (Qzlib_stream_p, "zlib-stream-p");
+
+  DEFSYM (Qzlib_data_error, "zlib-data-error");
+  Fput (Qzlib_data_error, Qerror_conditions,
+	listn (CONSTYPE_PURE, 2, Qzlib_data_error, Qerror));
+  Fput (Qzlib_data_error, Qerror_message,
+	build_pure_c_string ("zlib data error"));
+
   defsubr (&Szlib_decompress_region);
   defsubr (&Szlib_available_p);
+  defsubr (&Szlib_make_decompressor);
+  defsubr (&Szlib_make_compressor);
+  defsubr (&Szlib_stream_p);
+  defsubr (&Szlib_stream_feed);
+  defsubr (&Szlib_stream_finish);
 }
 
 #endif /* HAVE_ZLIB */
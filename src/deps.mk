@@ -38,7 +38,7 @@ atimer.o: atimer.c atimer.h syssignal.h systime.h lisp.h blockinput.h \
  globals.h ../lib/unistd.h msdos.h $(config_h)
 bidi.o: bidi.c buffer.h character.h dispextern.h msdos.h lisp.h \
    globals.h $(config_h)
-buffer.o: buffer.c buffer.h region-cache.h commands.h window.h \
+buffer.o: buffer.c buffer.h region-cache.h line-index.h commands.h window.h \
    $(INTERVALS_H) blockinput.h atimer.h systime.h character.h ../lib/unistd.h \
    indent.h keyboard.h coding.h keymap.h frame.h lisp.h globals.h $(config_h)
 callint.o: callint.c window.h commands.h buffer.h keymap.h globals.h msdos.h \
@@ -95,7 +95,7 @@ emacs.o: emacs.c commands.h systty.h syssignal.h blockinput.h process.h \
    frame.h coding.h gnutls.h msdos.h dosfns.h unexec.h
 fileio.o: fileio.c window.h buffer.h systime.h $(INTERVALS_H) character.h \
    coding.h msdos.h blockinput.h atimer.h lisp.h $(config_h) frame.h \
-   commands.h globals.h ../lib/unistd.h
+   commands.h globals.h ../lib/unistd.h line-index.h
 filelock.o: filelock.c buffer.h character.h coding.h systime.h composite.h \
    ../lib/unistd.h lisp.h globals.h $(config_h)
 font.o: font.c dispextern.h frame.h window.h ccl.h character.h charset.h \
@@ -128,7 +128,9 @@ indent.o: indent.c frame.h window.h indent.h buffer.h lisp.h $(config_h) \
    keyboard.h systime.h coding.h $(INTERVALS_H) globals.h
 inotify.o: inotify.c lisp.h coding.h process.h keyboard.h frame.h termhooks.h
 insdel.o: insdel.c window.h buffer.h $(INTERVALS_H) blockinput.h character.h \
-   atimer.h systime.h region-cache.h lisp.h globals.h $(config_h)
+   atimer.h systime.h region-cache.h line-index.h lisp.h globals.h \
+   $(config_h)
+json.o: json.c buffer.h character.h lisp.h globals.h $(config_h)
 keyboard.o: keyboard.c termchar.h termhooks.h termopts.h buffer.h character.h \
    commands.h frame.h window.h macros.h disptab.h keyboard.h syssignal.h \
    systime.h syntax.h $(INTERVALS_H) blockinput.h atimer.h composite.h \
@@ -138,6 +140,8 @@ keymap.o: keymap.c buffer.h commands.h keyboard.h termhooks.h blockinput.h \
    atimer.h systime.h puresize.h character.h charset.h $(INTERVALS_H) \
    keymap.h window.h coding.h frame.h lisp.h globals.h $(config_h)
 lastfile.o: lastfile.c $(config_h)
+line-index.o: line-index.c buffer.h character.h count-newlines.h \
+   line-index.h lisp.h globals.h $(config_h)
 macros.o: macros.c window.h buffer.h commands.h macros.h keyboard.h msdos.h \
    dispextern.h lisp.h globals.h $(config_h) systime.h coding.h composite.h
 gmalloc.o: gmalloc.c $(config_h)
@@ -177,8 +181,9 @@ scroll.o: scroll.c termchar.h dispextern.h frame.h msdos.h keyboard.h \
    termhooks.h lisp.h globals.h $(config_h) systime.h coding.h composite.h \
    window.h
 search.o: search.c regex.h commands.h buffer.h region-cache.h syntax.h \
-   blockinput.h atimer.h systime.h category.h character.h charset.h \
-   $(INTERVALS_H) lisp.h globals.h $(config_h)
+   line-index.h count-newlines.h blockinput.h atimer.h systime.h category.h \
+   character.h charset.h $(INTERVALS_H) lisp.h globals.h $(config_h)
+sort.o: sort.c lisp.h globals.h $(config_h)
 sound.o: sound.c dispextern.h syssignal.h lisp.h globals.h $(config_h) \
    atimer.h systime.h ../lib/unistd.h msdos.h
 syntax.o: syntax.c syntax.h buffer.h commands.h category.h character.h \
@@ -222,7 +227,7 @@ xdisp.o: xdisp.c macros.h commands.h process.h indent.h buffer.h \
    charset.h lisp.h $(config_h) keyboard.h $(INTERVALS_H) region-cache.h \
    xterm.h w32term.h nsterm.h nsgui.h msdos.h composite.h fontset.h ccl.h \
    blockinput.h atimer.h systime.h keymap.h font.h globals.h termopts.h \
-   ../lib/unistd.h gnutls.h gtkutil.h
+   ../lib/unistd.h gnutls.h gtkutil.h line-index.h
 xfaces.o: xfaces.c frame.h xterm.h buffer.h blockinput.h \
    window.h character.h charset.h msdos.h dosfns.h composite.h atimer.h	\
    systime.h keyboard.h fontset.h w32term.h nsterm.h coding.h ccl.h \
@@ -299,6 +304,7 @@ composite.o: composite.c composite.h buffer.h character.h coding.h font.h \
    lisp.h globals.h $(config_h)
 intervals.o: intervals.c buffer.h $(INTERVALS_H) keyboard.h puresize.h \
    keymap.h lisp.h globals.h $(config_h) systime.h coding.h
+itree.o: itree.c itree.h lisp.h globals.h $(config_h)
 textprop.o: textprop.c buffer.h window.h $(INTERVALS_H) \
    lisp.h globals.h $(config_h)
 
@@ -312,7 +312,7 @@ directory_files_internal (Lisp_Object directory, Lisp_Object full,
 
   if (NILP (nosort))
     list = Fsort (Fnreverse (list),
-		  attrs ? Qfile_attributes_lessp : Qstring_lessp);
+		  attrs ? Qfile_attributes_lessp : Qstring_lessp, Qnil);
 
   (void) directory_volatile;
   return list;
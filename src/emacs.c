@@ -1523,6 +1523,8 @@ Using an Emacs configured with --with-x-toolkit=lucid does not have this problem
       syms_of_xml ();
 #endif
 
+      syms_of_json ();
+
 #ifdef HAVE_ZLIB
       syms_of_decompress ();
 #endif
@@ -1992,6 +1994,9 @@ all of which are called before Emacs is actually killed.  */
 
   shut_down_emacs (0, (STRINGP (arg) && !feof (stdin)) ? arg : Qnil);
 
+  /* Let the threads that help the GC mark objects exit first.  */
+  stop_mark_helpers (0);
+
 #ifdef HAVE_NS
   ns_release_autorelease_pool (ns_pool);
 #endif
@@ -2733,6 +2733,18 @@ usage: (funcall FUNCTION &rest ARGUMENTS)  */)
 
   if (SUBRP (fun))
     val = funcall_subr (XSUBR (fun), numargs, args + 1);
+  else if (COMPILEDP (fun)
+	   && (ASIZE (fun) & PSEUDOVECTOR_SIZE_MASK) > COMPILED_STACK_DEPTH
+	   && INTEGERP (AREF (fun, COMPILED_ARGLIST))
+	   && STRINGP (AREF (fun, COMPILED_BYTECODE)))
+    /* Run lexically bound byte-code directly; this is what
+       funcall_lambda would do, and most calls from byte-code end up
+       here.  */
+    val = exec_byte_code (AREF (fun, COMPILED_BYTECODE),
+			  AREF (fun, COMPILED_CONSTANTS),
+			  AREF (fun, COMPILED_STACK_DEPTH),
+			  AREF (fun, COMPILED_ARGLIST),
+			  numargs, args + 1);
   else if (COMPILEDP (fun))
     val = funcall_lambda (fun, numargs, args + 1);
   else
@@ -44,6 +44,12 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
 #include <sys/acl.h>
 #endif
 
+#if defined HAVE_MMAP && !defined WINDOWSNT && !defined MSDOS
+#include <signal.h>
+#include <sys/mman.h>
+#define MAP_FILES
+#endif
+
 #include <c-ctype.h>
 
 #include "lisp.h"
@@ -54,6 +60,7 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "window.h"
 #include "blockinput.h"
 #include "region-cache.h"
+#include "line-index.h"
 #include "frame.h"
 
 #ifdef HAVE_LINUX_FS_H
@@ -3338,6 +3345,186 @@ otherwise, if FILE2 does not exist, the answer is t.  */)
 /* Some buffer offsets are stored in 'int' variables.  */
 verify (READ_BUF_SIZE <= INT_MAX);
 
+/* Regular files are read straight into the gap this many bytes at a
+   time.  */
+#define LARGE_READ_SIZE (16 << 20)
+
+/* When replacing buffer text with the contents of a regular file of
+   at least MAP_FILE_MIN bytes, map the file into memory and compare it
+   with the buffer MAP_CHUNK_SIZE bytes at a time.  */
+#define MAP_FILE_MIN (1 << 20)
+#define MAP_CHUNK_SIZE (1 << 20)
+verify (MAP_CHUNK_SIZE <= INT_MAX);
+
+/* Return the number of bytes at the start of the N bytes at P that
+   match the text of the current buffer from byte position POS on,
+   looking no further than LIM.  */
+
+static ptrdiff_t
+match_buffer_forward (unsigned char const *p, ptrdiff_t n,
+		      ptrdiff_t pos, ptrdiff_t lim)
+{
+  ptrdiff_t matched = 0;
+
+  n = min (n, lim - pos);
+  while (matched < n)
+    {
+      /* The text is contiguous up to the gap.  */
+      ptrdiff_t seg = (pos + matched < GPT_BYTE
+		       ? min (GPT_BYTE - (pos + matched), n - matched)
+		       : n - matched);
+      unsigned char const *b = BYTE_POS_ADDR (pos + matched);
+      unsigned char const *q = p + matched;
+      ptrdiff_t i = 0;
+
+      while (seg - i >= 256 && memcmp (b + i, q + i, 256) == 0)
+	i += 256;
+      while (i < seg && b[i] == q[i])
+	i++;
+      matched += i;
+      if (i < seg)
+	break;
+    }
+  return matched;
+}
+
+/* Return the number of bytes at the end of the N bytes at P that match
+   the text of the current buffer before byte position POS, looking
+   back no further than LIM.  */
+
+static ptrdiff_t
+match_buffer_backward (unsigned char const *p, ptrdiff_t n,
+		       ptrdiff_t pos, ptrdiff_t lim)
+{
+  unsigned char const *p_end = p + n;
+  ptrdiff_t matched = 0;
+
+  n = min (n, pos - lim);
+  while (matched < n)
+    {
+      /* The text is contiguous back to the gap.  */
+      ptrdiff_t end = pos - matched;
+      ptrdiff_t seg = (end > GPT_BYTE
+		       ? min (end - GPT_BYTE, n - matched)
+		       : n - matched);
+      unsigned char const *b = BYTE_POS_ADDR (end - 1) + 1;
+      unsigned char const *q = p_end - matched;
+      ptrdiff_t i = 0;
+
+      while (seg - i >= 256 && memcmp (b - i - 256, q - i - 256, 256) == 0)
+	i += 256;
+      while (i < seg && b[-i - 1] == q[-i - 1])
+	i++;
+      matched += i;
+      if (i < seg)
+	break;
+    }
+  return matched;
+}
+
+/* Return true if decoding with CODING the N bytes at P, which are part
+   of the text between BEG and END of the file mapped at FILE_DATA,
+   would leave them unchanged.  */
+
+static bool
+decoding_preserves_file_data_p (struct coding_system *coding,
+				unsigned char const *file_data,
+				off_t beg, off_t end,
+				unsigned char const *p, ptrdiff_t n)
+{
+  unsigned char const *text_beg = file_data + beg;
+  unsigned char const *text_end = file_data + end;
+  unsigned char const *q = p + n;
+  int i;
+
+  /* Extend the bytes to character boundaries.  */
+  for (i = 0; i < MAX_MULTIBYTE_LENGTH && p > text_beg && !CHAR_HEAD_P (*p);
+       i++)
+    p--;
+  for (i = 0; i < MAX_MULTIBYTE_LENGTH && q < text_end && !CHAR_HEAD_P (*q);
+       i++)
+    q++;
+  return decoding_preserves_bytes_p (coding, p, q - p);
+}
+
+#ifdef MAP_FILES
+
+struct file_map
+{
+  void *addr;
+  size_t size;
+};
+
+/* The mapping that Finsert_file_contents is comparing with the
+   buffer, where to return if reading it raises SIGBUS, and the action
+   for SIGBUS to restore afterwards.  Reading a mapping past the end of
+   the file raises SIGBUS, which happens when the file shrinks while it
+   is mapped, as a log file that is rotated does.  */
+static struct file_map *guarded_map;
+static sigjmp_buf map_fault_jmp;
+static struct sigaction map_fault_old_action;
+
+static void
+handle_map_fault (int sig, siginfo_t *siginfo, void *arg)
+{
+  char *addr = siginfo ? siginfo->si_addr : NULL;
+  struct file_map *map = guarded_map;
+
+  if (map && map->addr && (char *) map->addr <= addr
+      && addr < (char *) map->addr + map->size)
+    siglongjmp (map_fault_jmp, 1);
+
+  /* Some other bus error.  Let the usual handler deal with it when
+     the access is retried.  */
+  sigaction (SIGBUS, &map_fault_old_action, NULL);
+}
+
+static void
+guard_file_map (struct file_map *map)
+{
+  struct sigaction action;
+
+  sigfillset (&action.sa_mask);
+  action.sa_sigaction = handle_map_fault;
+  action.sa_flags = SA_SIGINFO;
+  guarded_map = map;
+  sigaction (SIGBUS, &action, &map_fault_old_action);
+}
+
+static void
+unmap_file (void *arg)
+{
+  struct file_map *map = arg;
+
+  if (map->addr)
+    {
+      if (guarded_map == map)
+	{
+	  sigaction (SIGBUS, &map_fault_old_action, NULL);
+	  guarded_map = NULL;
+	}
+      munmap (map->addr, map->size);
+      map->addr = NULL;
+    }
+}
+
+#endif
+
+/* Add the time since START and NBYTES to the statistics about reading
+   files.  */
+
+static void
+count_file_read (struct timespec start, off_t nbytes)
+{
+  if (FLOATP (Vfile_read_time))
+    {
+      struct timespec since_start = timespec_sub (current_timespec (), start);
+      Vfile_read_time = make_float (XFLOAT_DATA (Vfile_read_time)
+				    + timespectod (since_start));
+    }
+  file_read_bytes += nbytes;
+}
+
 /* This function is called after Lisp functions to decide a coding
    system are called, or when they cause an error.  Before they are
    called, the current buffer is set unibyte and it contains only a
@@ -3557,6 +3744,11 @@ by calling `format-decode', which see.  */)
   Lisp_Object old_Vdeactivate_mark = Vdeactivate_mark;
   bool we_locked_file = false;
   ptrdiff_t fd_index;
+#ifdef MAP_FILES
+  struct file_map map = { NULL, 0 };
+#endif
+  unsigned char *file_data = NULL;
+  struct timespec read_start;
   Lisp_Object window_markers = Qnil;
   /* same_at_start and same_at_end count bytes, because file access counts
      bytes and BEG and END count bytes.  */
@@ -3768,8 +3960,7 @@ by calling `format-decode', which see.  */)
 		  bset_read_only (buf, Qnil);
 		  bset_filename (buf, Qnil);
 		  bset_undo_list (buf, Qt);
-		  eassert (buf->overlays_before == NULL);
-		  eassert (buf->overlays_after == NULL);
+		  eassert (itree_empty_p (&buf->overlays));
 
 		  set_buffer_internal (buf);
 		  Ferase_buffer ();
@@ -3831,19 +4022,67 @@ by calling `format-decode', which see.  */)
      If the code conversion is "automatic" then we try using this
      method and hope for the best.
      But if we discover the need for conversion, we give up on this method
-     and let the following if-statement handle the replace job.  */
+     and let the following if-statement handle the replace job.
+
+     A large file is compared with the buffer where it lies in the page
+     cache, rather than copied to READ_BUF; if it needs decoding, but
+     decoding it would not change it, as is usual for UTF-8 text, this
+     method is used as well.  */
+#ifdef MAP_FILES
+  if (!NILP (replace) && BEGV < ZV
+      && ! not_regular && end_offset - beg_offset >= MAP_FILE_MIN
+      && end_offset <= st.st_size
+      && end_offset <= min (PTRDIFF_MAX, SIZE_MAX))
+    {
+      void *addr = mmap (NULL, end_offset, PROT_READ, MAP_SHARED, fd, 0);
+      if (addr != MAP_FAILED)
+	{
+	  Lisp_Object mapped_coding_system = coding_system;
+
+	  map.addr = addr;
+	  map.size = end_offset;
+	  record_unwind_protect_ptr (unmap_file, &map);
+	  if (sigsetjmp (map_fault_jmp, 1) == 0)
+	    {
+	      guard_file_map (&map);
+	      file_data = addr;
+	    }
+	  else
+	    {
+	      /* The file shrank while we compared it with the buffer.
+		 Start again, reading it instead.  */
+	      immediate_quit = false;
+	      unmap_file (&map);
+	      file_data = NULL;
+	      same_at_start = BEGV_BYTE;
+	      same_at_end = ZV_BYTE;
+	      coding_system = mapped_coding_system;
+	      setup_coding_system (coding_system, &coding);
+	    }
+	}
+    }
+#endif
   if (!NILP (replace)
       && BEGV < ZV
       && (NILP (coding_system)
-	  || ! CODING_REQUIRE_DECODING (&coding)))
+	  || ! CODING_REQUIRE_DECODING (&coding)
+	  || file_data))
     {
       ptrdiff_t overlap;
       /* There is still a possibility we will find the need to do code
 	 conversion.  If that happens, set this variable to
 	 give up on handling REPLACE in the optimized way.  */
       bool giveup_match_end = false;
+      /* Whether text that needs decoding can be compared as is, if
+	 decoding leaves it unchanged.  */
+      bool compare_undecoded
+	= (file_data
+	   && ! NILP (BVAR (current_buffer, enable_multibyte_characters))
+	   && ! CODING_REQUIRE_DETECTION (&coding));
+
+      read_start = current_timespec ();
 
-      if (beg_offset != 0)
+      if (beg_offset != 0 && !file_data)
 	{
 	  if (lseek (fd, beg_offset, SEEK_SET) < 0)
 	    report_file_error ("Setting file position", orig_filename);
@@ -3856,8 +4095,19 @@ by calling `format-decode', which see.  */)
       while (1)
 	{
 	  int nread, bufpos;
+	  unsigned char *chunk;
 
-	  nread = emacs_read (fd, read_buf, sizeof read_buf);
+	  if (file_data)
+	    {
+	      off_t pos = beg_offset + (same_at_start - BEGV_BYTE);
+	      nread = min (end_offset - pos, MAP_CHUNK_SIZE);
+	      chunk = file_data + pos;
+	    }
+	  else
+	    {
+	      nread = emacs_read (fd, read_buf, sizeof read_buf);
+	      chunk = (unsigned char *) read_buf;
+	    }
 	  if (nread < 0)
 	    report_file_error ("Read error", orig_filename);
 	  else if (nread == 0)
@@ -3865,13 +4115,16 @@ by calling `format-decode', which see.  */)
 
 	  if (CODING_REQUIRE_DETECTION (&coding))
 	    {
-	      coding_system = detect_coding_system ((unsigned char *) read_buf,
-						    nread, nread, 1, 0,
+	      coding_system = detect_coding_system (chunk, nread, nread, 1, 0,
 						    coding_system);
 	      setup_coding_system (coding_system, &coding);
 	    }
 
-	  if (CODING_REQUIRE_DECODING (&coding))
+	  if (CODING_REQUIRE_DECODING (&coding)
+	      && ! (compare_undecoded
+		    && decoding_preserves_file_data_p (&coding, file_data,
+						       beg_offset, end_offset,
+						       chunk, nread)))
 	    /* We found that the file should be decoded somehow.
                Let's give up here.  */
 	    {
@@ -3879,10 +4132,8 @@ by calling `format-decode', which see.  */)
 	      break;
 	    }
 
-	  bufpos = 0;
-	  while (bufpos < nread && same_at_start < ZV_BYTE
-		 && FETCH_BYTE (same_at_start) == read_buf[bufpos])
-	    same_at_start++, bufpos++;
+	  bufpos = match_buffer_forward (chunk, nread, same_at_start, ZV_BYTE);
+	  same_at_start += bufpos;
 	  /* If we found a discrepancy, stop the scan.
 	     Otherwise loop around and scan the next bufferful.  */
 	  if (bufpos != nread)
@@ -3893,6 +4144,10 @@ by calling `format-decode', which see.  */)
 	 there's no need to replace anything.  */
       if (same_at_start - BEGV_BYTE == end_offset - beg_offset)
 	{
+#ifdef MAP_FILES
+	  unmap_file (&map);
+#endif
+	  count_file_read (read_start, end_offset - beg_offset);
 	  emacs_close (fd);
 	  clear_unwind_protect (fd_index);
 
@@ -3907,8 +4162,9 @@ by calling `format-decode', which see.  */)
 	 already found that decoding is necessary, don't waste time.  */
       while (!giveup_match_end)
 	{
-	  int total_read, nread, bufpos, trial;
+	  int total_read, nread, bufpos, trial, matched;
 	  off_t curpos;
+	  unsigned char *chunk;
 
 	  /* At what file position are we now scanning?  */
 	  curpos = end_offset - (ZV_BYTE - same_at_end);
@@ -3916,30 +4172,51 @@ by calling `format-decode', which see.  */)
 	  if (curpos == 0)
 	    break;
 	  /* How much can we scan in the next step?  */
-	  trial = min (curpos, sizeof read_buf);
-	  if (lseek (fd, curpos - trial, SEEK_SET) < 0)
-	    report_file_error ("Setting file position", orig_filename);
-
-	  total_read = nread = 0;
-	  while (total_read < trial)
+	  if (file_data)
 	    {
-	      nread = emacs_read (fd, read_buf + total_read, trial - total_read);
-	      if (nread < 0)
-		report_file_error ("Read error", orig_filename);
-	      else if (nread == 0)
-		break;
-	      total_read += nread;
+	      trial = min (curpos, MAP_CHUNK_SIZE);
+	      chunk = file_data + curpos - trial;
+	      total_read = nread = trial;
 	    }
+	  else
+	    {
+	      trial = min (curpos, sizeof read_buf);
+	      if (lseek (fd, curpos - trial, SEEK_SET) < 0)
+		report_file_error ("Setting file position", orig_filename);
 
-	  /* Scan this bufferful from the end, comparing with
-	     the Emacs buffer.  */
-	  bufpos = total_read;
+	      total_read = nread = 0;
+	      while (total_read < trial)
+		{
+		  nread = emacs_read (fd, read_buf + total_read,
+				      trial - total_read);
+		  if (nread < 0)
+		    report_file_error ("Read error", orig_filename);
+		  else if (nread == 0)
+		    break;
+		  total_read += nread;
+		}
+	      chunk = (unsigned char *) read_buf;
+	    }
 
-	  /* Compare with same_at_start to avoid counting some buffer text
-	     as matching both at the file's beginning and at the end.  */
-	  while (bufpos > 0 && same_at_end > same_at_start
-		 && FETCH_BYTE (same_at_end - 1) == read_buf[bufpos - 1])
-	    same_at_end--, bufpos--;
+	  /* Scan this bufferful from the end, comparing with
+	     the Emacs buffer.  Compare with same_at_start to avoid
+	     counting some buffer text as matching both at the file's
+	     beginning and at the end.  */
+	  matched = match_buffer_backward (chunk, total_read,
+					   same_at_end, same_at_start);
+	  if (matched > 0 && CODING_REQUIRE_DECODING (&coding)
+	      && ! (compare_undecoded
+		    && decoding_preserves_file_data_p (&coding, file_data,
+						       beg_offset, end_offset,
+						       (chunk + total_read
+							- matched),
+						       matched)))
+	    {
+	      giveup_match_end = true;
+	      break;
+	    }
+	  same_at_end -= matched;
+	  bufpos = total_read - matched;
 
 	  /* If we found a discrepancy, stop the scan.
 	     Otherwise loop around and scan the preceding bufferful.  */
@@ -3959,6 +4236,8 @@ by calling `format-decode', which see.  */)
 	    break;
 	}
       immediate_quit = 0;
+      count_file_read (read_start,
+		       (same_at_start - BEGV_BYTE) + (ZV_BYTE - same_at_end));
 
       if (! giveup_match_end)
 	{
@@ -4015,6 +4294,9 @@ by calling `format-decode', which see.  */)
 	  replace_handled = true;
 	}
     }
+#ifdef MAP_FILES
+  unmap_file (&map);
+#endif
 
   /* If requested, replace the accessible part of the buffer
      with the file contents.  Avoid replacing text at the
@@ -4034,6 +4316,7 @@ by calling `format-decode', which see.  */)
       unsigned char *decoded;
       ptrdiff_t temp;
       ptrdiff_t this = 0;
+      off_t file_bytes = 0;
       ptrdiff_t this_count = SPECPDL_INDEX ();
       bool multibyte
 	= ! NILP (BVAR (current_buffer, enable_multibyte_characters));
@@ -4044,6 +4327,7 @@ by calling `format-decode', which see.  */)
       /* First read the whole file, performing code conversion into
 	 CONVERSION_BUFFER.  */
 
+      read_start = current_timespec ();
       if (lseek (fd, beg_offset, SEEK_SET) < 0)
 	report_file_error ("Setting file position", orig_filename);
 
@@ -4064,6 +4348,7 @@ by calling `format-decode', which see.  */)
 
 	  if (this <= 0)
 	    break;
+	  file_bytes += this;
 
 	  BUF_TEMP_SET_PT (XBUFFER (conversion_buffer),
 			   BUF_Z (XBUFFER (conversion_buffer)));
@@ -4097,10 +4382,10 @@ by calling `format-decode', which see.  */)
       /* Compare the beginning of the converted string with the buffer
 	 text.  */
 
-      bufpos = 0;
-      while (bufpos < inserted && same_at_start < same_at_end
-	     && FETCH_BYTE (same_at_start) == decoded[bufpos])
-	same_at_start++, bufpos++;
+      bufpos = match_buffer_forward (decoded, inserted,
+				     same_at_start, same_at_end);
+      same_at_start += bufpos;
+      count_file_read (read_start, file_bytes);
 
       /* If the file matches the head of buffer completely,
 	 there's no need to replace anything.  */
@@ -4128,14 +4413,12 @@ by calling `format-decode', which see.  */)
 	  same_at_start--;
 
       /* Scan this bufferful from the end, comparing with
-	 the Emacs buffer.  */
-      bufpos = inserted;
-
-      /* Compare with same_at_start to avoid counting some buffer text
-	 as matching both at the file's beginning and at the end.  */
-      while (bufpos > 0 && same_at_end > same_at_start
-	     && FETCH_BYTE (same_at_end - 1) == decoded[bufpos - 1])
-	same_at_end--, bufpos--;
+	 the Emacs buffer.  Compare with same_at_start to avoid
+	 counting some buffer text as matching both at the file's
+	 beginning and at the end.  */
+      bufpos = inserted - match_buffer_backward (decoded, inserted,
+						 same_at_end, same_at_start);
+      same_at_end -= inserted - bufpos;
 
       /* Extend the end of non-matching text area to the next
 	 multibyte character boundary.  */
@@ -4234,13 +4517,18 @@ by calling `format-decode', which see.  */)
 
   /* Here, we don't do code conversion in the loop.  It is done by
      decode_coding_gap after all data are read into the buffer.  */
+  read_start = current_timespec ();
   {
     ptrdiff_t gap_size = GAP_SIZE;
+    /* Read a regular file in large pieces, unless other threads
+       are to run meanwhile; see below.  */
+    ptrdiff_t read_size = (not_regular || other_threads_p ()
+			   ? READ_BUF_SIZE : LARGE_READ_SIZE);
 
     while (how_much < total)
       {
 	/* `try' is reserved in some compilers (Microsoft C).  */
-	ptrdiff_t trytry = min (total - how_much, READ_BUF_SIZE);
+	ptrdiff_t trytry = min (total - how_much, read_size);
 	ptrdiff_t this;
 
 	if (not_regular)
@@ -4277,10 +4565,32 @@ by calling `format-decode', which see.  */)
 	       here doesn't do any harm.  */
 	    immediate_quit = 1;
 	    QUIT;
-	    this = emacs_read (fd,
-			       ((char *) BEG_ADDR + PT_BYTE - BEG_BYTE
-				+ inserted),
-			       trytry);
+	    if (other_threads_p ())
+	      {
+		/* Let other threads run during the read.  As they
+		   could change the buffer meanwhile, read into READ_BUF
+		   and copy that to the gap afterwards, unless the text
+		   read so far did not survive.  */
+		EMACS_INT modiff = MODIFF;
+		ptrdiff_t gpt = GPT;
+		bool inhibit_shrinking = current_buffer->text->inhibit_shrinking;
+
+		current_buffer->text->inhibit_shrinking = true;
+		this = emacs_read_without_lock (fd, read_buf,
+					       min (trytry, sizeof read_buf));
+		current_buffer->text->inhibit_shrinking = inhibit_shrinking;
+		if (MODIFF != modiff || GPT != gpt
+		    || GAP_SIZE - inserted != gap_size)
+		  error ("Buffer modified by another thread while reading %s",
+			 SDATA (orig_filename));
+		if (this > 0)
+		  memcpy (GPT_ADDR + inserted, read_buf, this);
+	      }
+	    else
+	      this = emacs_read (fd,
+				 ((char *) BEG_ADDR + PT_BYTE - BEG_BYTE
+				  + inserted),
+				 trytry);
 	    immediate_quit = 0;
 	  }
 
@@ -4302,6 +4612,7 @@ by calling `format-decode', which see.  */)
 	inserted += this;
       }
   }
+  count_file_read (read_start, inserted);
 
   /* Now we have either read all the file data into the gap,
      or stop reading on I/O error or quit.  If nothing was
@@ -4637,6 +4948,7 @@ by calling `format-decode', which see.  */)
     invalidate_region_cache (current_buffer,
                              current_buffer->newline_cache,
                              PT - BEG, Z - PT - inserted);
+  line_index_invalidate (current_buffer, PT - BEG, Z - PT - inserted);
 
   if (read_quit)
     quit ();
@@ -5898,6 +6210,7 @@ init_fileio (void)
   umask (realmask);
 
   valid_timestamp_file_system = 0;
+  Vfile_read_time = make_float (0.0);
 
   /* fsync can be a significant performance hit.  Often it doesn't
      suffice to make the file-save operation survive a crash.  For
@@ -6162,6 +6475,17 @@ Setting this to nil may avoid data loss if the system loses power or
 the operating system crashes.  By default, it is non-nil in batch mode.  */);
   write_region_inhibit_fsync = 0; /* See also `init_fileio' above.  */
 
+  DEFVAR_LISP ("file-read-time", Vfile_read_time,
+	       doc: /* Accumulated time `insert-file-contents' spent reading files.
+The time is in seconds as a floating point value.  When replacing
+buffer text, this includes the time spent comparing it with the
+contents of the file.  */);
+
+  DEFVAR_INT ("file-read-bytes", file_read_bytes,
+	      doc: /* Number of bytes `insert-file-contents' has read from files.
+This includes the bytes compared with buffer text when replacing it.  */);
+  file_read_bytes = 0;
+
   DEFVAR_BOOL ("delete-by-moving-to-trash", delete_by_moving_to_trash,
                doc: /* Specifies whether to use the system's trash can.
 When non-nil, certain file deletion commands use the function
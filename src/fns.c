@@ -26,6 +26,7 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
 #include <intprops.h>
 #include <vla.h>
 #include <errno.h>
+#include <count-trailing-zeros.h>
 
 #include "lisp.h"
 #include "character.h"
@@ -35,8 +36,6 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "intervals.h"
 #include "window.h"
 
-static void sort_vector_copy (Lisp_Object, ptrdiff_t,
-			      Lisp_Object *restrict, Lisp_Object *restrict);
 static bool internal_equal (Lisp_Object, Lisp_Object, int, bool, Lisp_Object);
 
 DEFUN ("identity", Fidentity, Sidentity, 1, 1, 0,
@@ -1895,149 +1894,104 @@ See also the function `nreverse', which is used more often.  */)
   return new;
 }
 
-/* Sort LIST using PREDICATE, preserving original order of elements
-   considered as equal.  */
+/* Sort LIST using PREDICATE, comparing the results of calling KEY on
+   the elements unless KEY is nil, and preserving original order of
+   elements considered as equal.  The elements stay in the same cons
+   cells, which are linked again in their new order.  */
 
 static Lisp_Object
-sort_list (Lisp_Object list, Lisp_Object predicate)
+sort_list (Lisp_Object list, Lisp_Object predicate, Lisp_Object key)
 {
-  Lisp_Object front, back;
-  Lisp_Object len, tem;
-  EMACS_INT length;
+  ptrdiff_t length = XFASTINT (Flength (list));
+  ptrdiff_t i;
+  Lisp_Object tail, *keys, *conses;
+  USE_SAFE_ALLOCA;
 
-  front = list;
-  len = Flength (list);
-  length = XINT (len);
   if (length < 2)
     return list;
 
-  XSETINT (len, (length / 2) - 1);
-  tem = Fnthcdr (len, list);
-  back = Fcdr (tem);
-  Fsetcdr (tem, Qnil);
-
-  front = Fsort (front, predicate);
-  back = Fsort (back, predicate);
-  return merge (front, back, predicate);
-}
-
-/* Using PRED to compare, return whether A and B are in order.
-   Compare stably when A appeared before B in the input.  */
-static bool
-inorder (Lisp_Object pred, Lisp_Object a, Lisp_Object b)
-{
-  return NILP (call2 (pred, b, a));
-}
-
-/* Using PRED to compare, merge from ALEN-length A and BLEN-length B
-   into DEST.  Argument arrays must be nonempty and must not overlap,
-   except that B might be the last part of DEST.  */
-static void
-merge_vectors (Lisp_Object pred,
-	       ptrdiff_t alen, Lisp_Object const a[restrict VLA_ELEMS (alen)],
-	       ptrdiff_t blen, Lisp_Object const b[VLA_ELEMS (blen)],
-	       Lisp_Object dest[VLA_ELEMS (alen + blen)])
-{
-  eassume (0 < alen && 0 < blen);
-  Lisp_Object const *alim = a + alen;
-  Lisp_Object const *blim = b + blen;
-
-  while (true)
+  SAFE_ALLOCA_LISP (keys, 2 * length);
+  conses = keys + length;
+  for (i = 0, tail = list; i < length; i++, tail = XCDR (tail))
     {
-      if (inorder (pred, a[0], b[0]))
-	{
-	  *dest++ = *a++;
-	  if (a == alim)
-	    {
-	      if (dest != b)
-		memcpy (dest, b, (blim - b) * sizeof *dest);
-	      return;
-	    }
-	}
-      else
-	{
-	  *dest++ = *b++;
-	  if (b == blim)
-	    {
-	      memcpy (dest, a, (alim - a) * sizeof *dest);
-	      return;
-	    }
-	}
+      conses[i] = tail;
+      keys[i] = XCAR (tail);
     }
-}
+  if (!NILP (key))
+    for (i = 0; i < length; i++)
+      keys[i] = call1 (key, keys[i]);
 
-/* Using PRED to compare, sort LEN-length VEC in place, using TMP for
-   temporary storage.  LEN must be at least 2.  */
-static void
-sort_vector_inplace (Lisp_Object pred, ptrdiff_t len,
-		     Lisp_Object vec[restrict VLA_ELEMS (len)],
-		     Lisp_Object tmp[restrict VLA_ELEMS (len >> 1)])
-{
-  eassume (2 <= len);
-  ptrdiff_t halflen = len >> 1;
-  sort_vector_copy (pred, halflen, vec, tmp);
-  if (1 < len - halflen)
-    sort_vector_inplace (pred, len - halflen, vec + halflen, vec);
-  merge_vectors (pred, halflen, tmp, len - halflen, vec + halflen, vec);
-}
+  tim_sort (predicate, keys, conses, length);
 
-/* Using PRED to compare, sort from LEN-length SRC into DST.
-   Len must be positive.  */
-static void
-sort_vector_copy (Lisp_Object pred, ptrdiff_t len,
-		  Lisp_Object src[restrict VLA_ELEMS (len)],
-		  Lisp_Object dest[restrict VLA_ELEMS (len)])
-{
-  eassume (0 < len);
-  ptrdiff_t halflen = len >> 1;
-  if (halflen < 1)
-    dest[0] = src[0];
-  else
-    {
-      if (1 < halflen)
-	sort_vector_inplace (pred, halflen, src, dest);
-      if (1 < len - halflen)
-	sort_vector_inplace (pred, len - halflen, src + halflen, dest);
-      merge_vectors (pred, halflen, src, len - halflen, src + halflen, dest);
-    }
+  for (i = 0; i < length - 1; i++)
+    XSETCDR (conses[i], conses[i + 1]);
+  XSETCDR (conses[length - 1], Qnil);
+  list = conses[0];
+  SAFE_FREE ();
+  return list;
 }
 
-/* Sort VECTOR in place using PREDICATE, preserving original order of
-   elements considered as equal.  */
+/* Sort VECTOR in place using PREDICATE, comparing the results of
+   calling KEY on the elements unless KEY is nil, and preserving
+   original order of elements considered as equal.  */
 
 static void
-sort_vector (Lisp_Object vector, Lisp_Object predicate)
+sort_vector (Lisp_Object vector, Lisp_Object predicate, Lisp_Object key)
 {
   ptrdiff_t len = ASIZE (vector);
+  Lisp_Object *keys;
+  USE_SAFE_ALLOCA;
+
   if (len < 2)
     return;
-  ptrdiff_t halflen = len >> 1;
-  Lisp_Object *tmp;
-  USE_SAFE_ALLOCA;
-  SAFE_ALLOCA_LISP (tmp, halflen);
-  for (ptrdiff_t i = 0; i < halflen; i++)
-    tmp[i] = make_number (0);
-  sort_vector_inplace (predicate, len, XVECTOR (vector)->contents, tmp);
+  if (NILP (key))
+    {
+      tim_sort (predicate, XVECTOR (vector)->contents, NULL, len);
+      return;
+    }
+
+  SAFE_ALLOCA_LISP (keys, len);
+  for (ptrdiff_t i = 0; i < len; i++)
+    keys[i] = AREF (vector, i);
+  for (ptrdiff_t i = 0; i < len; i++)
+    keys[i] = call1 (key, keys[i]);
+  tim_sort (predicate, keys, XVECTOR (vector)->contents, len);
   SAFE_FREE ();
 }
 
-DEFUN ("sort", Fsort, Ssort, 2, 2, 0,
+DEFUN ("sort", Fsort, Ssort, 2, 3, 0,
        doc: /* Sort SEQ, stably, comparing elements using PREDICATE.
 Returns the sorted sequence.  SEQ should be a list or vector.  SEQ is
 modified by side effects.  PREDICATE is called with two elements of
 SEQ, and should return non-nil if the first element should sort before
-the second.  */)
-  (Lisp_Object seq, Lisp_Object predicate)
+the second.
+
+If KEY is non-nil, it is called once on each element of SEQ, and
+PREDICATE is called with the values it returned instead of the
+elements themselves.
+
+Sorting takes fewer comparisons when SEQ is already partly in order.
+If PREDICATE is `<', `>' or `string<', elements are compared without
+calling it.  */)
+  (Lisp_Object seq, Lisp_Object predicate, Lisp_Object key)
 {
   if (CONSP (seq))
-    seq = sort_list (seq, predicate);
+    seq = sort_list (seq, predicate, key);
   else if (VECTORP (seq))
-    sort_vector (seq, predicate);
+    sort_vector (seq, predicate, key);
   else if (!NILP (seq))
     wrong_type_argument (Qsequencep, seq);
   return seq;
 }
 
+/* Using PRED to compare, return whether A and B are in order.
+   Compare stably when A appeared before B in the input.  */
+static bool
+inorder (Lisp_Object pred, Lisp_Object a, Lisp_Object b)
+{
+  return NILP (call2 (pred, b, a));
+}
+
 Lisp_Object
 merge (Lisp_Object org_l1, Lisp_Object org_l2, Lisp_Object pred)
 {
@@ -2326,10 +2280,9 @@ internal_equal (Lisp_Object o1, Lisp_Object o2, int depth, bool props,
 	return 0;
       if (OVERLAYP (o1))
 	{
-	  if (!internal_equal (OVERLAY_START (o1), OVERLAY_START (o2),
-			       depth + 1, props, ht)
-	      || !internal_equal (OVERLAY_END (o1), OVERLAY_END (o2),
-				  depth + 1, props, ht))
+	  if (OVERLAY_BUFFER (o1) != OVERLAY_BUFFER (o2)
+	      || OVERLAY_START (o1) != OVERLAY_START (o2)
+	      || OVERLAY_END (o1) != OVERLAY_END (o2))
 	    return 0;
 	  o1 = XOVERLAY (o1)->plist;
 	  o2 = XOVERLAY (o2)->plist;
@@ -3568,36 +3521,6 @@ set_hash_key_and_value (struct Lisp_Hash_Table *h, Lisp_Object key_and_value)
 {
   h->key_and_value = key_and_value;
 }
-static void
-set_hash_next (struct Lisp_Hash_Table *h, Lisp_Object next)
-{
-  h->next = next;
-}
-static void
-set_hash_next_slot (struct Lisp_Hash_Table *h, ptrdiff_t idx, Lisp_Object val)
-{
-  gc_aset (h->next, idx, val);
-}
-static void
-set_hash_hash (struct Lisp_Hash_Table *h, Lisp_Object hash)
-{
-  h->hash = hash;
-}
-static void
-set_hash_hash_slot (struct Lisp_Hash_Table *h, ptrdiff_t idx, Lisp_Object val)
-{
-  gc_aset (h->hash, idx, val);
-}
-static void
-set_hash_index (struct Lisp_Hash_Table *h, Lisp_Object index)
-{
-  h->index = index;
-}
-static void
-set_hash_index_slot (struct Lisp_Hash_Table *h, ptrdiff_t idx, Lisp_Object val)
-{
-  gc_aset (h->index, idx, val);
-}
 
 /* If OBJ is a Lisp hash table, return a pointer to its struct
    Lisp_Hash_Table.  Otherwise, signal an error.  */
@@ -3784,6 +3707,290 @@ allocate_hash_table (void)
 #define INDEX_SIZE_BOUND \
   ((ptrdiff_t) min (MOST_POSITIVE_FIXNUM, PTRDIFF_MAX / word_size))
 
+/* The index of a hash table maps hash codes to entry numbers.  It is
+   open-addressed, so that a lookup usually looks at a single place in
+   memory instead of following a chain of entries.  Its slots come in
+   groups of HASH_GROUP_SIZE; the tags of a group fit in a word and
+   are compared with the tag of the hash code looked for all at once.
+   The hash code is scrambled to choose the first group to look in
+   and the tag; another group is tried only if a group is full, so
+   that a lookup stops at the first group with an empty slot.
+   Removing an entry marks its slot as deleted, unless its group has
+   an empty slot anyway, and the index is rebuilt when too few slots
+   are empty.
+
+   The entries themselves stay in KEY_AND_VALUE in the order they were
+   added, so that their numbers do not change when the index grows.  */
+
+enum { HASH_GROUP_SIZE = sizeof (unsigned long) };
+
+/* Tags of unused slots.  The tags of used slots are less than 0x80.  */
+enum { HASH_TAG_EMPTY = 0x80, HASH_TAG_DELETED = 0xfe };
+
+/* A group of slots of an index.  Keeping the tags next to the entry
+   numbers means that a lookup usually needs a single cache line or
+   two of the index.  */
+struct hash_index_group
+{
+  unsigned char tags[HASH_GROUP_SIZE];
+  ptrdiff_t entry[HASH_GROUP_SIZE];
+};
+
+/* Return the tags of group G of the index of H.  */
+
+static unsigned long
+hash_group (struct Lisp_Hash_Table *h, ptrdiff_t g)
+{
+  unsigned long w;
+  memcpy (&w, h->index[g].tags, sizeof w);
+  return w;
+}
+
+/* Return the tag of SLOT of the index of H.  */
+
+static unsigned char *
+hash_slot_tag (struct Lisp_Hash_Table *h, ptrdiff_t slot)
+{
+  return &h->index[slot / HASH_GROUP_SIZE].tags[slot % HASH_GROUP_SIZE];
+}
+
+/* Return the number of the entry in SLOT of the index of H.  */
+
+static ptrdiff_t *
+hash_slot_entry (struct Lisp_Hash_Table *h, ptrdiff_t slot)
+{
+  return &h->index[slot / HASH_GROUP_SIZE].entry[slot % HASH_GROUP_SIZE];
+}
+
+/* Mark all the slots of the index of H as empty.  */
+
+static void
+hash_clear_index (struct Lisp_Hash_Table *h)
+{
+  ptrdiff_t g;
+
+  for (g = 0; g < h->index_size / HASH_GROUP_SIZE; g++)
+    memset (h->index[g].tags, HASH_TAG_EMPTY, HASH_GROUP_SIZE);
+  h->index_deleted = 0;
+}
+
+/* Return the tags W with the high bit of each byte that is equal to
+   TAG set, and all other bits clear.  */
+
+static unsigned long
+hash_group_match (unsigned long w, int tag)
+{
+  unsigned long const ones = ULONG_MAX / UCHAR_MAX;
+  unsigned long const lows = ones * 0x7f;
+  unsigned long x = w ^ (ones * tag);
+  return ~(((x & lows) + lows) | x | lows);
+}
+
+/* Return the tags W with the high bit of each unused slot set.  */
+
+static unsigned long
+hash_group_unused (unsigned long w)
+{
+  return w & (ULONG_MAX / UCHAR_MAX * 0x80);
+}
+
+/* Return the bit for the byte at position B in a group.  */
+
+static unsigned long
+hash_group_bit (int b)
+{
+#ifdef WORDS_BIGENDIAN
+  return 0x80ul << (HASH_GROUP_SIZE - 1 - b) * CHAR_BIT;
+#else
+  return 0x80ul << b * CHAR_BIT;
+#endif
+}
+
+/* Return the position in its group of the first byte whose bit is set
+   in MATCH, which is nonzero.  */
+
+static int
+hash_group_first (unsigned long match)
+{
+#ifdef WORDS_BIGENDIAN
+  int b;
+  for (b = 0; ! (match & hash_group_bit (b)); b++)
+    continue;
+  return b;
+#else
+  return count_trailing_zeros_l (match) / CHAR_BIT;
+#endif
+}
+
+/* A large odd constant that fits in EMACS_UINT: 2**EMACS_INT_WIDTH
+   divided by the golden ratio.  */
+#define HASH_SCRAMBLE \
+  ((EMACS_UINT) (0x9e3779b97f4a7c15ull >> (64 - EMACS_INT_WIDTH)))
+
+/* Return the first group of the index of H to look in for hash code
+   HASH, and store the tag for HASH in *TAG.  Both come from the high
+   bits of HASH times HASH_SCRAMBLE, which depend on all the bits of
+   HASH; hash codes of objects of the same type often differ only in a
+   few bits.  The tag is the top 7 bits, and the group the bits below
+   them, so that the tags in a group do not all have the same high
+   bits.  */
+
+static ptrdiff_t
+hash_group_start (struct Lisp_Hash_Table *h, EMACS_UINT hash, int *tag)
+{
+  EMACS_UINT m = hash * HASH_SCRAMBLE;
+  ptrdiff_t groups = h->index_size / HASH_GROUP_SIZE;
+  *tag = m >> (EMACS_INT_WIDTH - 7);
+  if (groups == 1)
+    return 0;
+  return (m << 7) >> (EMACS_INT_WIDTH - count_trailing_zeros_ll (groups));
+}
+
+/* Return the group to look in after group G of H, when STEP groups
+   have been looked in before.  This visits every group in turn.  */
+
+static ptrdiff_t
+hash_group_next (struct Lisp_Hash_Table *h, ptrdiff_t g, ptrdiff_t step)
+{
+  return (g + step) & (h->index_size / HASH_GROUP_SIZE - 1);
+}
+
+/* Return the number of slots of an index for SIZE entries, where
+   REHASH_THRESHOLD is the threshold of the hash table.  Leave at
+   least one slot in four unused when the table is full, so that even
+   a full table can have many entries removed and added again before
+   its index needs to be rebuilt to get rid of deleted slots.  Return
+   -1 if the index would be too large.  */
+
+static ptrdiff_t
+hash_index_size (EMACS_INT size, double rehash_threshold)
+{
+  double index_float = size / rehash_threshold;
+  EMACS_INT groups;
+
+  if (! (index_float < INDEX_SIZE_BOUND / 2
+	 && size < INDEX_SIZE_BOUND / 4))
+    return -1;
+  for (groups = 1;
+       groups * HASH_GROUP_SIZE < max (index_float, size + size / 3 + 1);
+       groups *= 2)
+    continue;
+  return groups * HASH_GROUP_SIZE;
+}
+
+/* Give H an index with INDEX_SIZE slots, all empty.  */
+
+static void
+allocate_hash_index (struct Lisp_Hash_Table *h, ptrdiff_t index_size)
+{
+  h->index = xnmalloc (index_size / HASH_GROUP_SIZE, sizeof *h->index);
+  h->index_size = index_size;
+  hash_clear_index (h);
+}
+
+/* Record in the index of H that entry I is in use.  */
+
+static void
+hash_index_insert (struct Lisp_Hash_Table *h, ptrdiff_t i)
+{
+  int tag;
+  ptrdiff_t g = hash_group_start (h, h->hash[i], &tag);
+
+  for (ptrdiff_t step = 1; ; g = hash_group_next (h, g, step++))
+    {
+      unsigned long unused = hash_group_unused (hash_group (h, g));
+      if (unused)
+	{
+	  ptrdiff_t slot = g * HASH_GROUP_SIZE + hash_group_first (unused);
+	  if (*hash_slot_tag (h, slot) == HASH_TAG_DELETED)
+	    h->index_deleted--;
+	  *hash_slot_tag (h, slot) = tag;
+	  *hash_slot_entry (h, slot) = i;
+	  return;
+	}
+    }
+}
+
+/* Mark SLOT of the index of H as unused.  */
+
+static void
+hash_index_remove (struct Lisp_Hash_Table *h, ptrdiff_t slot)
+{
+  /* If the group has an empty slot, no lookup goes past it, so
+     this slot can be empty too.  */
+  if (hash_group_match (hash_group (h, slot / HASH_GROUP_SIZE),
+			HASH_TAG_EMPTY))
+    *hash_slot_tag (h, slot) = HASH_TAG_EMPTY;
+  else
+    {
+      *hash_slot_tag (h, slot) = HASH_TAG_DELETED;
+      h->index_deleted++;
+    }
+}
+
+/* Build the index of H again from its entries.  */
+
+static void
+hash_rebuild_index (struct Lisp_Hash_Table *h)
+{
+  ptrdiff_t i, size = HASH_TABLE_SIZE (h);
+
+  hash_clear_index (h);
+  for (i = 0; i < size; i++)
+    if (! (h->hash[i] & HASH_FREE_BIT))
+      hash_index_insert (h, i);
+}
+
+/* Return the slot of the index of H that holds entry I, which is in
+   use.  */
+
+static ptrdiff_t
+hash_index_slot (struct Lisp_Hash_Table *h, ptrdiff_t i)
+{
+  int tag;
+  ptrdiff_t g = hash_group_start (h, h->hash[i], &tag);
+
+  for (ptrdiff_t step = 1; ; g = hash_group_next (h, g, step++))
+    {
+      unsigned long match = hash_group_match (hash_group (h, g), tag);
+      for (; match; match &= ~hash_group_bit (hash_group_first (match)))
+	{
+	  ptrdiff_t slot = g * HASH_GROUP_SIZE + hash_group_first (match);
+	  if (*hash_slot_entry (h, slot) == i)
+	    return slot;
+	}
+      eassert (! hash_group_match (hash_group (h, g), HASH_TAG_EMPTY));
+    }
+}
+
+/* Make entries FROM to TO - 1 of H free, chained in that order in
+   front of the entries already free.  */
+
+static void
+hash_free_entries (struct Lisp_Hash_Table *h, ptrdiff_t from, ptrdiff_t to)
+{
+  ptrdiff_t i;
+
+  for (i = to - 1; from <= i; i--)
+    {
+      h->hash[i] = HASH_FREE_BIT | (h->next_free + 1);
+      h->next_free = i;
+    }
+}
+
+/* Remove entry I of H, which is in use and no longer in its index.
+   Put it at the front of the free list.  */
+
+static void
+hash_remove_entry (struct Lisp_Hash_Table *h, ptrdiff_t i)
+{
+  set_hash_key_slot (h, i, Qnil);
+  set_hash_value_slot (h, i, Qnil);
+  hash_free_entries (h, i, i + 1);
+  h->count--;
+  eassert (h->count >= 0);
+}
+
 /* Create and initialize a new hash table.
 
    TEST specifies the test the hash table will use to compare keys.
@@ -3813,9 +4020,8 @@ make_hash_table (struct hash_table_test test,
 {
   struct Lisp_Hash_Table *h;
   Lisp_Object table;
-  EMACS_INT index_size, sz;
-  ptrdiff_t i;
-  double index_float;
+  EMACS_INT sz;
+  ptrdiff_t index_size;
 
   /* Preconditions.  */
   eassert (SYMBOLP (test.name));
@@ -3830,15 +4036,14 @@ make_hash_table (struct hash_table_test test,
     size = make_number (1);
 
   sz = XFASTINT (size);
-  index_float = sz / XFLOAT_DATA (rehash_threshold);
-  index_size = (index_float < INDEX_SIZE_BOUND + 1
-		? next_almost_prime (index_float)
-		: INDEX_SIZE_BOUND + 1);
-  if (INDEX_SIZE_BOUND < max (index_size, 2 * sz))
+  index_size = hash_index_size (sz, XFLOAT_DATA (rehash_threshold));
+  if (index_size < 0)
     error ("Hash table too large");
 
   /* Allocate a table and initialize it.  */
   h = allocate_hash_table ();
+  h->hash = NULL;
+  h->index = NULL;
 
   /* Initialize hash table slots.  */
   h->test = test;
@@ -3847,14 +4052,12 @@ make_hash_table (struct hash_table_test test,
   h->rehash_size = rehash_size;
   h->count = 0;
   h->key_and_value = Fmake_vector (make_number (2 * sz), Qnil);
-  h->hash = Fmake_vector (size, Qnil);
-  h->next = Fmake_vector (size, Qnil);
-  h->index = Fmake_vector (make_number (index_size), Qnil);
+  h->hash = xnmalloc (sz, sizeof *h->hash);
+  allocate_hash_index (h, index_size);
 
   /* Set up the free list.  */
-  for (i = 0; i < sz - 1; ++i)
-    set_hash_next_slot (h, i, make_number (i + 1));
-  h->next_free = make_number (0);
+  h->next_free = -1;
+  hash_free_entries (h, 0, sz);
 
   XSET_HASH_TABLE (table, h);
   eassert (HASH_TABLE_P (table));
@@ -3873,6 +4076,32 @@ make_hash_table (struct hash_table_test test,
 }
 
 
+/* Give hash table H2, a copy of H1 made with memcpy, its own copies
+   of the hash codes and index of H1.  */
+
+void
+copy_hash_table_arrays (struct Lisp_Hash_Table *h2,
+			struct Lisp_Hash_Table *h1)
+{
+  h2->hash = NULL;
+  h2->index = NULL;
+  h2->hash = xnmalloc (HASH_TABLE_SIZE (h1), sizeof *h2->hash);
+  memcpy (h2->hash, h1->hash, HASH_TABLE_SIZE (h1) * sizeof *h2->hash);
+  h2->index = xnmalloc (h1->index_size / HASH_GROUP_SIZE,
+			sizeof *h2->index);
+  memcpy (h2->index, h1->index,
+	  h1->index_size / HASH_GROUP_SIZE * sizeof *h2->index);
+}
+
+/* Free the hash codes and index of H, which is being reclaimed.  */
+
+void
+free_hash_table_arrays (struct Lisp_Hash_Table *h)
+{
+  xfree (h->hash);
+  xfree (h->index);
+}
+
 /* Return a copy of hash table H1.  Keys and values are not copied,
    only the table itself is.  */
 
@@ -3884,10 +4113,8 @@ copy_hash_table (struct Lisp_Hash_Table *h1)
 
   h2 = allocate_hash_table ();
   *h2 = *h1;
+  copy_hash_table_arrays (h2, h1);
   h2->key_and_value = Fcopy_sequence (h1->key_and_value);
-  h2->hash = Fcopy_sequence (h1->hash);
-  h2->next = Fcopy_sequence (h1->next);
-  h2->index = Fcopy_sequence (h1->index);
   XSET_HASH_TABLE (table, h2);
 
   /* Maybe add this hash table to the list of all weak hash tables.  */
@@ -3907,12 +4134,13 @@ copy_hash_table (struct Lisp_Hash_Table *h1)
 static void
 maybe_resize_hash_table (struct Lisp_Hash_Table *h)
 {
-  if (NILP (h->next_free))
+  if (h->next_free < 0)
     {
       ptrdiff_t old_size = HASH_TABLE_SIZE (h);
-      EMACS_INT new_size, index_size, nsize;
-      ptrdiff_t i;
-      double index_float;
+      EMACS_INT new_size;
+      ptrdiff_t index_size;
+      EMACS_UINT *hash;
+      Lisp_Object key_and_value;
 
       if (INTEGERP (h->rehash_size))
 	new_size = old_size + XFASTINT (h->rehash_size);
@@ -3928,12 +4156,9 @@ maybe_resize_hash_table (struct Lisp_Hash_Table *h)
 	  else
 	    new_size = INDEX_SIZE_BOUND + 1;
 	}
-      index_float = new_size / XFLOAT_DATA (h->rehash_threshold);
-      index_size = (index_float < INDEX_SIZE_BOUND + 1
-		    ? next_almost_prime (index_float)
-		    : INDEX_SIZE_BOUND + 1);
-      nsize = max (index_size, 2 * new_size);
-      if (INDEX_SIZE_BOUND < nsize)
+      index_size = hash_index_size (new_size,
+				    XFLOAT_DATA (h->rehash_threshold));
+      if (index_size < 0)
 	error ("Hash table too large to resize");
 
 #ifdef ENABLE_CHECKING
@@ -3942,45 +4167,58 @@ maybe_resize_hash_table (struct Lisp_Hash_Table *h)
 	message ("Growing hash table to: %"pI"d", new_size);
 #endif
 
-      set_hash_key_and_value (h, larger_vector (h->key_and_value,
-						2 * (new_size - old_size), -1));
-      set_hash_next (h, larger_vector (h->next, new_size - old_size, -1));
-      set_hash_hash (h, larger_vector (h->hash, new_size - old_size, -1));
-      set_hash_index (h, Fmake_vector (make_number (index_size), Qnil));
+      hash = xnmalloc (new_size, sizeof *hash);
+      key_and_value = Fmake_vector (make_number (2 * new_size), Qnil);
+      memcpy (hash, h->hash, old_size * sizeof *hash);
+      memcpy (XVECTOR (key_and_value)->contents,
+	      XVECTOR (h->key_and_value)->contents,
+	      2 * old_size * word_size);
+      xfree (h->hash);
+      h->hash = hash;
+      set_hash_key_and_value (h, key_and_value);
+
+      /* The free list is empty.  Add the new entries so that they are
+         used in order.  This makes some operations like maphash
+         faster.  */
+      hash_free_entries (h, old_size, new_size);
+
+      xfree (h->index);
+      allocate_hash_index (h, index_size);
+      hash_rebuild_index (h);
+    }
+}
 
-      /* Update the free list.  Do it so that new entries are added at
-         the end of the free list.  This makes some operations like
-         maphash faster.  */
-      for (i = old_size; i < new_size - 1; ++i)
-	set_hash_next_slot (h, i, make_number (i + 1));
 
-      if (!NILP (h->next_free))
-	{
-	  Lisp_Object last, next;
+/* Return the slot of the index of H that holds the entry matching
+   KEY, whose hash code is HASH, or -1 if there is none.  */
 
-	  last = h->next_free;
-	  while (next = HASH_NEXT (h, XFASTINT (last)),
-		 !NILP (next))
-	    last = next;
+static ptrdiff_t
+hash_lookup_slot (struct Lisp_Hash_Table *h, Lisp_Object key, EMACS_UINT hash)
+{
+  int tag;
+  ptrdiff_t g = hash_group_start (h, hash, &tag);
+
+  for (ptrdiff_t step = 1; ; g = hash_group_next (h, g, step++))
+    {
+      unsigned long w = hash_group (h, g);
+      unsigned long match = hash_group_match (w, tag);
 
-	  set_hash_next_slot (h, XFASTINT (last), make_number (old_size));
+      for (; match; match &= ~hash_group_bit (hash_group_first (match)))
+	{
+	  ptrdiff_t slot = g * HASH_GROUP_SIZE + hash_group_first (match);
+	  ptrdiff_t i = *hash_slot_entry (h, slot);
+	  if (EQ (key, HASH_KEY (h, i))
+	      || (h->test.cmpfn
+		  && hash == h->hash[i]
+		  && h->test.cmpfn (&h->test, key, HASH_KEY (h, i))))
+	    return slot;
 	}
-      else
-	XSETFASTINT (h->next_free, old_size);
 
-      /* Rehash.  */
-      for (i = 0; i < old_size; ++i)
-	if (!NILP (HASH_HASH (h, i)))
-	  {
-	    EMACS_UINT hash_code = XUINT (HASH_HASH (h, i));
-	    ptrdiff_t start_of_bucket = hash_code % ASIZE (h->index);
-	    set_hash_next_slot (h, i, HASH_INDEX (h, start_of_bucket));
-	    set_hash_index_slot (h, start_of_bucket, make_number (i));
-	  }
+      if (hash_group_match (w, HASH_TAG_EMPTY))
+	return -1;
     }
 }
 
-
 /* Lookup KEY in hash table H.  If HASH is non-null, return in *HASH
    the hash code of KEY.  Value is the index of the entry in H
    matching KEY, or -1 if not found.  */
@@ -3989,29 +4227,15 @@ ptrdiff_t
 hash_lookup (struct Lisp_Hash_Table *h, Lisp_Object key, EMACS_UINT *hash)
 {
   EMACS_UINT hash_code;
-  ptrdiff_t start_of_bucket;
-  Lisp_Object idx;
+  ptrdiff_t slot;
 
   hash_code = h->test.hashfn (&h->test, key);
   eassert ((hash_code & ~INTMASK) == 0);
   if (hash)
     *hash = hash_code;
 
-  start_of_bucket = hash_code % ASIZE (h->index);
-  idx = HASH_INDEX (h, start_of_bucket);
-
-  while (!NILP (idx))
-    {
-      ptrdiff_t i = XFASTINT (idx);
-      if (EQ (key, HASH_KEY (h, i))
-	  || (h->test.cmpfn
-	      && hash_code == XUINT (HASH_HASH (h, i))
-	      && h->test.cmpfn (&h->test, key, HASH_KEY (h, i))))
-	break;
-      idx = HASH_NEXT (h, i);
-    }
-
-  return NILP (idx) ? -1 : XFASTINT (idx);
+  slot = hash_lookup_slot (h, key, hash_code);
+  return slot < 0 ? -1 : *hash_slot_entry (h, slot);
 }
 
 
@@ -4023,27 +4247,31 @@ ptrdiff_t
 hash_put (struct Lisp_Hash_Table *h, Lisp_Object key, Lisp_Object value,
 	  EMACS_UINT hash)
 {
-  ptrdiff_t start_of_bucket, i;
+  ptrdiff_t i;
 
   eassert ((hash & ~INTMASK) == 0);
 
   /* Increment count after resizing because resizing may fail.  */
   maybe_resize_hash_table (h);
+
+  /* If the index has too few empty slots left, get rid of the deleted
+     ones.  This does not allocate memory, which the profiler relies
+     on.  */
+  if (h->index_size - h->index_size / 8 <= h->count + h->index_deleted)
+    hash_rebuild_index (h);
   h->count++;
 
   /* Store key/value in the key_and_value vector.  */
-  i = XFASTINT (h->next_free);
-  h->next_free = HASH_NEXT (h, i);
+  i = h->next_free;
+  h->next_free = (h->hash[i] & ~HASH_FREE_BIT) - 1;
   set_hash_key_slot (h, i, key);
   set_hash_value_slot (h, i, value);
 
   /* Remember its hash code.  */
-  set_hash_hash_slot (h, i, make_number (hash));
+  h->hash[i] = hash;
 
-  /* Add new entry to its collision chain.  */
-  start_of_bucket = hash % ASIZE (h->index);
-  set_hash_next_slot (h, i, HASH_INDEX (h, start_of_bucket));
-  set_hash_index_slot (h, start_of_bucket, make_number (i));
+  /* Add new entry to the index.  */
+  hash_index_insert (h, i);
   return i;
 }
 
@@ -4054,46 +4282,17 @@ void
 hash_remove_from_table (struct Lisp_Hash_Table *h, Lisp_Object key)
 {
   EMACS_UINT hash_code;
-  ptrdiff_t start_of_bucket;
-  Lisp_Object idx, prev;
+  ptrdiff_t slot;
 
   hash_code = h->test.hashfn (&h->test, key);
   eassert ((hash_code & ~INTMASK) == 0);
-  start_of_bucket = hash_code % ASIZE (h->index);
-  idx = HASH_INDEX (h, start_of_bucket);
-  prev = Qnil;
+  slot = hash_lookup_slot (h, key, hash_code);
 
-  while (!NILP (idx))
+  if (0 <= slot)
     {
-      ptrdiff_t i = XFASTINT (idx);
-
-      if (EQ (key, HASH_KEY (h, i))
-	  || (h->test.cmpfn
-	      && hash_code == XUINT (HASH_HASH (h, i))
-	      && h->test.cmpfn (&h->test, key, HASH_KEY (h, i))))
-	{
-	  /* Take entry out of collision chain.  */
-	  if (NILP (prev))
-	    set_hash_index_slot (h, start_of_bucket, HASH_NEXT (h, i));
-	  else
-	    set_hash_next_slot (h, XFASTINT (prev), HASH_NEXT (h, i));
-
-	  /* Clear slots in key_and_value and add the slots to
-	     the free list.  */
-	  set_hash_key_slot (h, i, Qnil);
-	  set_hash_value_slot (h, i, Qnil);
-	  set_hash_hash_slot (h, i, Qnil);
-	  set_hash_next_slot (h, i, h->next_free);
-	  h->next_free = make_number (i);
-	  h->count--;
-	  eassert (h->count >= 0);
-	  break;
-	}
-      else
-	{
-	  prev = idx;
-	  idx = HASH_NEXT (h, i);
-	}
+      ptrdiff_t i = *hash_slot_entry (h, slot);
+      hash_index_remove (h, slot);
+      hash_remove_entry (h, i);
     }
 }
 
@@ -4109,16 +4308,13 @@ hash_clear (struct Lisp_Hash_Table *h)
 
       for (i = 0; i < size; ++i)
 	{
-	  set_hash_next_slot (h, i, i < size - 1 ? make_number (i + 1) : Qnil);
 	  set_hash_key_slot (h, i, Qnil);
 	  set_hash_value_slot (h, i, Qnil);
-	  set_hash_hash_slot (h, i, Qnil);
 	}
 
-      for (i = 0; i < ASIZE (h->index); ++i)
-	ASET (h->index, i, Qnil);
-
-      h->next_free = make_number (0);
+      h->next_free = -1;
+      hash_free_entries (h, 0, size);
+      hash_clear_index (h);
       h->count = 0;
     }
 }
@@ -4137,78 +4333,53 @@ hash_clear (struct Lisp_Hash_Table *h)
 static bool
 sweep_weak_table (struct Lisp_Hash_Table *h, bool remove_entries_p)
 {
-  ptrdiff_t n = gc_asize (h->index);
+  ptrdiff_t n = gc_asize (h->key_and_value) / 2;
   bool marked = false;
 
-  for (ptrdiff_t bucket = 0; bucket < n; ++bucket)
+  for (ptrdiff_t i = 0; i < n; ++i)
     {
-      Lisp_Object idx, next, prev;
-
-      /* Follow collision chain, removing entries that
-	 don't survive this garbage collection.  */
-      prev = Qnil;
-      for (idx = HASH_INDEX (h, bucket); !NILP (idx); idx = next)
-	{
-	  ptrdiff_t i = XFASTINT (idx);
-	  bool key_known_to_survive_p = survives_gc_p (HASH_KEY (h, i));
-	  bool value_known_to_survive_p = survives_gc_p (HASH_VALUE (h, i));
-	  bool remove_p;
-
-	  if (EQ (h->weak, Qkey))
-	    remove_p = !key_known_to_survive_p;
-	  else if (EQ (h->weak, Qvalue))
-	    remove_p = !value_known_to_survive_p;
-	  else if (EQ (h->weak, Qkey_or_value))
-	    remove_p = !(key_known_to_survive_p || value_known_to_survive_p);
-	  else if (EQ (h->weak, Qkey_and_value))
-	    remove_p = !(key_known_to_survive_p && value_known_to_survive_p);
-	  else
-	    emacs_abort ();
+      if (h->hash[i] & HASH_FREE_BIT)
+	continue;
 
-	  next = HASH_NEXT (h, i);
+      bool key_known_to_survive_p = survives_gc_p (HASH_KEY (h, i));
+      bool value_known_to_survive_p = survives_gc_p (HASH_VALUE (h, i));
+      bool remove_p;
+
+      if (EQ (h->weak, Qkey))
+	remove_p = !key_known_to_survive_p;
+      else if (EQ (h->weak, Qvalue))
+	remove_p = !value_known_to_survive_p;
+      else if (EQ (h->weak, Qkey_or_value))
+	remove_p = !(key_known_to_survive_p || value_known_to_survive_p);
+      else if (EQ (h->weak, Qkey_and_value))
+	remove_p = !(key_known_to_survive_p && value_known_to_survive_p);
+      else
+	emacs_abort ();
 
-	  if (remove_entries_p)
+      if (remove_entries_p)
+	{
+	  if (remove_p)
 	    {
-	      if (remove_p)
-		{
-		  /* Take out of collision chain.  */
-		  if (NILP (prev))
-		    set_hash_index_slot (h, bucket, next);
-		  else
-		    set_hash_next_slot (h, XFASTINT (prev), next);
-
-		  /* Add to free list.  */
-		  set_hash_next_slot (h, i, h->next_free);
-		  h->next_free = idx;
-
-		  /* Clear key, value, and hash.  */
-		  set_hash_key_slot (h, i, Qnil);
-		  set_hash_value_slot (h, i, Qnil);
-		  set_hash_hash_slot (h, i, Qnil);
-
-		  h->count--;
-		}
-	      else
-		{
-		  prev = idx;
-		}
+	      /* Take out of the index, and add to free list.  */
+	      hash_index_remove (h, hash_index_slot (h, i));
+	      hash_remove_entry (h, i);
 	    }
-	  else
+	}
+      else
+	{
+	  if (!remove_p)
 	    {
-	      if (!remove_p)
+	      /* Make sure key and value survive.  */
+	      if (!key_known_to_survive_p)
+		{
+		  mark_object (HASH_KEY (h, i));
+		  marked = 1;
+		}
+
+	      if (!value_known_to_survive_p)
 		{
-		  /* Make sure key and value survive.  */
-		  if (!key_known_to_survive_p)
-		    {
-		      mark_object (HASH_KEY (h, i));
-		      marked = 1;
-		    }
-
-		  if (!value_known_to_survive_p)
-		    {
-		      mark_object (HASH_VALUE (h, i));
-		      marked = 1;
-		    }
+		  mark_object (HASH_VALUE (h, i));
+		  marked = 1;
 		}
 	    }
 	}
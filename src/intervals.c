@@ -55,6 +55,11 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
 static Lisp_Object merge_properties_sticky (Lisp_Object, Lisp_Object);
 static INTERVAL merge_interval_right (INTERVAL);
 static INTERVAL reproduce_tree (INTERVAL, INTERVAL);
+
+/* Incremented whenever intervals are split, merged or deleted, or
+   their lengths change, which invalidates the interval cached by
+   find_interval in each buffer.  */
+static EMACS_INT interval_tree_modiff;
 
 /* Utility functions for intervals.  */
 
@@ -547,6 +552,8 @@ split_interval_right (INTERVAL interval, ptrdiff_t offset)
   ptrdiff_t position = interval->position;
   ptrdiff_t new_length = LENGTH (interval) - offset;
 
+  interval_tree_modiff++;
+
   new->position = position + offset;
   set_interval_parent (new, interval);
 
@@ -590,6 +597,8 @@ split_interval_left (INTERVAL interval, ptrdiff_t offset)
   INTERVAL new = make_interval ();
   ptrdiff_t new_length = offset;
 
+  interval_tree_modiff++;
+
   new->position = interval->position;
   interval->position = interval->position + offset;
   set_interval_parent (new, interval);
@@ -639,6 +648,51 @@ interval_start_pos (INTERVAL source)
   return 0;
 }
 
+/* Return the interval of the buffer text TEXT containing POSITION,
+   if it is the interval find_interval found last in TEXT or one next
+   to it; otherwise return NULL.  Text properties are mostly looked up
+   at positions close to the previous lookup, such as by redisplay as
+   it moves through the text, so this usually saves descending the
+   tree from its root.  */
+
+static INTERVAL
+find_cached_interval (struct buffer_text *text, ptrdiff_t position)
+{
+  INTERVAL i = text->cached_interval;
+  ptrdiff_t start = text->cached_interval_pos;
+
+  if (! (i && text->cached_interval_modiff == interval_tree_modiff))
+    return NULL;
+
+  i->position = start;
+  if (position >= start + LENGTH (i))
+    {
+      INTERVAL next = next_interval (i);
+      if (next)
+	{
+	  i = next;
+	  start = i->position;
+	  if (position >= start + LENGTH (i))
+	    return NULL;
+	}
+      else if (position > start + LENGTH (i))
+	return NULL;
+    }
+  else if (position < start)
+    {
+      i = previous_interval (i);
+      if (! i)
+	return NULL;
+      start = i->position;
+      if (position < start)
+	return NULL;
+    }
+
+  text->cached_interval = i;
+  text->cached_interval_pos = start;
+  return i;
+}
+
 /* Find the interval containing text position POSITION in the text
    represented by the interval tree TREE.  POSITION is a buffer
    position (starting from 1) or a string index (starting from 0).
@@ -655,6 +709,8 @@ find_interval (register INTERVAL tree, register ptrdiff_t position)
   /* The distance from the left edge of the subtree at TREE
                     to POSITION.  */
   register ptrdiff_t relative_position;
+  /* The text of the buffer whose tree TREE is, if any.  */
+  struct buffer_text *text = NULL;
 
   if (!tree)
     return NULL;
@@ -665,7 +721,17 @@ find_interval (register INTERVAL tree, register ptrdiff_t position)
       Lisp_Object parent;
       GET_INTERVAL_OBJECT (parent, tree);
       if (BUFFERP (parent))
-	relative_position -= BUF_BEG (XBUFFER (parent));
+	{
+	  relative_position -= BUF_BEG (XBUFFER (parent));
+	  if (tree == buffer_intervals (XBUFFER (parent)))
+	    {
+	      INTERVAL i;
+	      text = XBUFFER (parent)->text;
+	      i = find_cached_interval (text, position);
+	      if (i)
+		return i;
+	    }
+	}
     }
 
   eassert (relative_position <= TOTAL_LENGTH (tree));
@@ -693,6 +759,12 @@ find_interval (register INTERVAL tree, register ptrdiff_t position)
 	    = (position - relative_position /* left edge of *tree.  */
 	       + LEFT_TOTAL_LENGTH (tree)); /* left edge of this interval.  */
 
+	  if (text)
+	    {
+	      text->cached_interval = tree;
+	      text->cached_interval_pos = tree->position;
+	      text->cached_interval_modiff = interval_tree_modiff;
+	    }
 	  return tree;
 	}
     }
@@ -1235,6 +1307,8 @@ delete_interval (register INTERVAL i)
 
   eassert (amt == 0);		/* Only used on zero-length intervals now.  */
 
+  interval_tree_modiff++;
+
   if (ROOT_INTERVAL_P (i))
     {
       Lisp_Object owner;
@@ -1403,6 +1477,7 @@ offset_intervals (struct buffer *buffer, ptrdiff_t start, ptrdiff_t length)
 				    start, length);
   else
     adjust_intervals_for_deletion (buffer, start, -length);
+  interval_tree_modiff++;
 }
 
 /* Merge interval I with its lexicographic successor. The resulting
@@ -1420,6 +1495,8 @@ merge_interval_right (register INTERVAL i)
   register ptrdiff_t absorb = LENGTH (i);
   register INTERVAL successor;
 
+  interval_tree_modiff++;
+
   /* Find the succeeding interval.  */
   if (! NULL_RIGHT_CHILD (i))      /* It's below us.  Add absorb
 				      as we descend.  */
@@ -1476,6 +1553,8 @@ merge_interval_left (register INTERVAL i)
   register ptrdiff_t absorb = LENGTH (i);
   register INTERVAL predecessor;
 
+  interval_tree_modiff++;
+
   /* Find the preceding interval.  */
   if (! NULL_LEFT_CHILD (i))	/* It's below us. Go down,
 				   adding ABSORB as we go.  */
@@ -1872,8 +1951,8 @@ adjust_for_invis_intang (ptrdiff_t pos, ptrdiff_t test_offs, ptrdiff_t adj,
 	     == (test_offs == 0 ? 1 : -1))
 	  /* Invisible property is from an overlay.  */
 	  : (test_offs == 0
-	     ? XMARKER (OVERLAY_START (invis_overlay))->insertion_type == 0
-	     : XMARKER (OVERLAY_END (invis_overlay))->insertion_type == 1)))
+	     ? !XOVERLAY (invis_overlay)->interval->front_advance
+	     : XOVERLAY (invis_overlay)->interval->rear_advance)))
     pos += adj;
 
   return pos;
@@ -2471,4 +2550,5 @@ set_intervals_multibyte (bool multi_flag)
 
   if (i)
     set_intervals_multibyte_1 (i, multi_flag, BEG, BEG_BYTE, Z, Z_BYTE);
+  interval_tree_modiff++;
 }
@@ -0,0 +1,724 @@
+/* Interval trees for overlays.
+
+Copyright (C) 2017 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include "lisp.h"
+#include "itree.h"
+
+/* See itree.h for an overview.  The red-black tree code follows the
+   usual textbook presentation (Cormen et al., chapters 13 and 14);
+   the only twists are the maintenance of LIMIT, and that any node
+   whose children are about to move must first hand its OFFSET down to
+   them, see itree_inherit_offset.  */
+
+/* Move the pending shift of NODE, whose own positions must be up to
+   date, into its children.  */
+
+static void
+itree_inherit_offset (struct itree_node *node)
+{
+  ptrdiff_t offset = node->offset;
+
+  if (offset)
+    {
+      struct itree_node *child;
+
+      if ((child = node->left))
+	{
+	  child->begin += offset;
+	  child->end += offset;
+	  child->limit += offset;
+	  child->offset += offset;
+	}
+      if ((child = node->right))
+	{
+	  child->begin += offset;
+	  child->end += offset;
+	  child->limit += offset;
+	  child->offset += offset;
+	}
+      node->offset = 0;
+    }
+}
+
+/* Shift NODE and everything below it by DELTA.  */
+
+static void
+itree_shift_subtree (struct itree_node *node, ptrdiff_t delta)
+{
+  node->begin += delta;
+  node->end += delta;
+  node->limit += delta;
+  node->offset += delta;
+}
+
+/* Recompute the LIMIT of NODE from its END and its children.  */
+
+static void
+itree_update_limit (struct itree_node *node)
+{
+  ptrdiff_t limit = node->end;
+
+  if (node->left)
+    limit = max (limit, node->left->limit + node->offset);
+  if (node->right)
+    limit = max (limit, node->right->limit + node->offset);
+  node->limit = limit;
+}
+
+/* Recompute the LIMIT of NODE and all of its ancestors.  */
+
+static void
+itree_propagate_limit (struct itree_node *node)
+{
+  for (; node; node = node->parent)
+    itree_update_limit (node);
+}
+
+/* Apply the offsets of all ancestors of NODE, and of NODE itself, so
+   that NODE and its children hold their real positions.  */
+
+static void
+itree_validate (struct itree_node *node)
+{
+  if (node->parent)
+    itree_validate (node->parent);
+  itree_inherit_offset (node);
+}
+
+/* Replace the subtree at DEST by the one at SOURCE, which may be
+   NULL.  */
+
+static void
+itree_replace_child (struct itree_tree *tree, struct itree_node *dest,
+		     struct itree_node *source)
+{
+  if (!dest->parent)
+    tree->root = source;
+  else if (dest == dest->parent->left)
+    dest->parent->left = source;
+  else
+    dest->parent->right = source;
+  if (source)
+    source->parent = dest->parent;
+}
+
+static void
+itree_rotate_left (struct itree_tree *tree, struct itree_node *node)
+{
+  struct itree_node *right = node->right;
+
+  itree_inherit_offset (node);
+  itree_inherit_offset (right);
+
+  node->right = right->left;
+  if (right->left)
+    right->left->parent = node;
+  itree_replace_child (tree, node, right);
+  right->left = node;
+  node->parent = right;
+
+  itree_update_limit (node);
+  itree_update_limit (right);
+}
+
+static void
+itree_rotate_right (struct itree_tree *tree, struct itree_node *node)
+{
+  struct itree_node *left = node->left;
+
+  itree_inherit_offset (node);
+  itree_inherit_offset (left);
+
+  node->left = left->right;
+  if (left->right)
+    left->right->parent = node;
+  itree_replace_child (tree, node, left);
+  left->right = node;
+  node->parent = left;
+
+  itree_update_limit (node);
+  itree_update_limit (left);
+}
+
+/* Restore the red-black properties after NODE was inserted.  */
+
+static void
+itree_insert_fix (struct itree_tree *tree, struct itree_node *node)
+{
+  while (node->parent && node->parent->red)
+    {
+      struct itree_node *parent = node->parent;
+      struct itree_node *grandparent = parent->parent;
+
+      if (parent == grandparent->left)
+	{
+	  struct itree_node *uncle = grandparent->right;
+
+	  if (uncle && uncle->red)
+	    {
+	      parent->red = false;
+	      uncle->red = false;
+	      grandparent->red = true;
+	      node = grandparent;
+	    }
+	  else
+	    {
+	      if (node == parent->right)
+		{
+		  node = parent;
+		  itree_rotate_left (tree, node);
+		  parent = node->parent;
+		}
+	      parent->red = false;
+	      grandparent->red = true;
+	      itree_rotate_right (tree, grandparent);
+	    }
+	}
+      else
+	{
+	  struct itree_node *uncle = grandparent->left;
+
+	  if (uncle && uncle->red)
+	    {
+	      parent->red = false;
+	      uncle->red = false;
+	      grandparent->red = true;
+	      node = grandparent;
+	    }
+	  else
+	    {
+	      if (node == parent->left)
+		{
+		  node = parent;
+		  itree_rotate_right (tree, node);
+		  parent = node->parent;
+		}
+	      parent->red = false;
+	      grandparent->red = true;
+	      itree_rotate_left (tree, grandparent);
+	    }
+	}
+    }
+  tree->root->red = false;
+}
+
+/* Restore the red-black properties after a black node was removed
+   from above NODE, a child of PARENT.  NODE may be NULL.  */
+
+static void
+itree_remove_fix (struct itree_tree *tree, struct itree_node *node,
+		  struct itree_node *parent)
+{
+  while (parent && (!node || !node->red))
+    {
+      if (node == parent->left)
+	{
+	  struct itree_node *other = parent->right;
+
+	  if (other->red)
+	    {
+	      other->red = false;
+	      parent->red = true;
+	      itree_rotate_left (tree, parent);
+	      other = parent->right;
+	    }
+	  if ((!other->left || !other->left->red)
+	      && (!other->right || !other->right->red))
+	    {
+	      other->red = true;
+	      node = parent;
+	      parent = node->parent;
+	    }
+	  else
+	    {
+	      if (!other->right || !other->right->red)
+		{
+		  other->left->red = false;
+		  other->red = true;
+		  itree_rotate_right (tree, other);
+		  other = parent->right;
+		}
+	      other->red = parent->red;
+	      parent->red = false;
+	      other->right->red = false;
+	      itree_rotate_left (tree, parent);
+	      node = tree->root;
+	      parent = NULL;
+	    }
+	}
+      else
+	{
+	  struct itree_node *other = parent->left;
+
+	  if (other->red)
+	    {
+	      other->red = false;
+	      parent->red = true;
+	      itree_rotate_right (tree, parent);
+	      other = parent->left;
+	    }
+	  if ((!other->left || !other->left->red)
+	      && (!other->right || !other->right->red))
+	    {
+	      other->red = true;
+	      node = parent;
+	      parent = node->parent;
+	    }
+	  else
+	    {
+	      if (!other->left || !other->left->red)
+		{
+		  other->right->red = false;
+		  other->red = true;
+		  itree_rotate_left (tree, other);
+		  other = parent->left;
+		}
+	      other->red = parent->red;
+	      parent->red = false;
+	      other->left->red = false;
+	      itree_rotate_right (tree, parent);
+	      node = tree->root;
+	      parent = NULL;
+	    }
+	}
+    }
+  if (node)
+    node->red = false;
+}
+
+/* Prepare NODE, which is not yet part of any tree, to hold the
+   overlay DATA.  */
+
+void
+itree_node_init (struct itree_node *node, bool front_advance,
+		 bool rear_advance, Lisp_Object data)
+{
+  node->parent = node->left = node->right = NULL;
+  node->begin = node->end = node->limit = -1;
+  node->offset = 0;
+  node->data = data;
+  node->red = false;
+  node->front_advance = front_advance;
+  node->rear_advance = rear_advance;
+}
+
+/* Return the pending shift of NODE, the sum of the offsets of its
+   ancestors.  */
+
+static ptrdiff_t
+itree_pending_offset (struct itree_node *node)
+{
+  ptrdiff_t offset = 0;
+
+  while ((node = node->parent))
+    offset += node->offset;
+  return offset;
+}
+
+/* Return the start position of NODE, which must be in a tree.  */
+
+ptrdiff_t
+itree_node_begin (struct itree_node *node)
+{
+  return node->begin + itree_pending_offset (node);
+}
+
+/* Return the end position of NODE, which must be in a tree.  */
+
+ptrdiff_t
+itree_node_end (struct itree_node *node)
+{
+  return node->end + itree_pending_offset (node);
+}
+
+/* Insert NODE into TREE, covering BEGIN..END.  */
+
+void
+itree_insert (struct itree_tree *tree, struct itree_node *node,
+	      ptrdiff_t begin, ptrdiff_t end)
+{
+  struct itree_node *parent = NULL;
+  struct itree_node *child = tree->root;
+
+  eassert (begin <= end);
+
+  /* Find the insertion point, updating the limits on the way down.  */
+  while (child)
+    {
+      itree_inherit_offset (child);
+      parent = child;
+      if (child->limit < end)
+	child->limit = end;
+      child = begin < child->begin ? child->left : child->right;
+    }
+
+  node->parent = parent;
+  node->left = node->right = NULL;
+  node->begin = begin;
+  node->end = end;
+  node->limit = end;
+  node->offset = 0;
+  node->red = true;
+
+  if (!parent)
+    tree->root = node;
+  else if (begin < parent->begin)
+    parent->left = node;
+  else
+    parent->right = node;
+
+  tree->size++;
+  itree_insert_fix (tree, node);
+}
+
+/* Remove NODE from TREE.  Afterwards, NODE's BEGIN and END still hold
+   the positions it had in the tree.  */
+
+void
+itree_remove (struct itree_tree *tree, struct itree_node *node)
+{
+  struct itree_node *child, *child_parent;
+  bool removed_black;
+
+  eassert (tree->size > 0);
+  itree_validate (node);
+
+  if (!node->left || !node->right)
+    {
+      child = node->left ? node->left : node->right;
+      child_parent = node->parent;
+      removed_black = !node->red;
+      itree_replace_child (tree, node, child);
+    }
+  else
+    {
+      /* Splice NODE's successor, which has no left child, into NODE's
+	 place.  */
+      struct itree_node *min = node->right;
+
+      itree_inherit_offset (min);
+      while (min->left)
+	{
+	  min = min->left;
+	  itree_inherit_offset (min);
+	}
+
+      child = min->right;
+      removed_black = !min->red;
+      if (min->parent == node)
+	child_parent = min;
+      else
+	{
+	  child_parent = min->parent;
+	  itree_replace_child (tree, min, child);
+	  min->right = node->right;
+	  min->right->parent = min;
+	}
+      itree_replace_child (tree, node, min);
+      min->left = node->left;
+      min->left->parent = min;
+      min->red = node->red;
+    }
+
+  itree_propagate_limit (child_parent);
+  if (removed_black)
+    itree_remove_fix (tree, child, child_parent);
+
+  node->parent = node->left = node->right = NULL;
+  node->limit = node->end;
+  tree->size--;
+}
+
+/* Return the start position NODE, which holds its real positions and
+   covers POS, should have after inserting LENGTH characters at POS;
+   see itree_insert_gap.  */
+
+static ptrdiff_t
+itree_gap_begin (struct itree_node *node, ptrdiff_t pos, ptrdiff_t length,
+		 bool before_markers)
+{
+  ptrdiff_t begin = node->begin, end = node->end;
+
+  if (begin == pos && (before_markers || node->front_advance))
+    begin += length;
+  if (end > pos || before_markers || node->rear_advance)
+    end += length;
+  /* An empty node whose start advances but whose end doesn't stays
+     empty, like an overlay whose markers got crossed.  */
+  return min (begin, end);
+}
+
+/* Shift the positions at or after POS in the subtree at NODE for the
+   insertion of LENGTH characters at POS.  NODE's own positions must be
+   up to date.  Only visits the subtrees holding a node that ends at or
+   after POS; those that start after it are shifted as a whole.  */
+
+static void
+itree_insert_gap_1 (struct itree_node *node, ptrdiff_t pos,
+		    ptrdiff_t length, bool before_markers)
+{
+  itree_inherit_offset (node);
+  if (node->begin > pos)
+    {
+      node->begin += length;
+      node->end += length;
+      if (node->right)
+	itree_shift_subtree (node->right, length);
+    }
+  else
+    {
+      if (node->end >= pos)
+	{
+	  node->begin = itree_gap_begin (node, pos, length, before_markers);
+	  if (node->end > pos || before_markers || node->rear_advance)
+	    node->end += length;
+	}
+      if (node->right && node->right->limit >= pos)
+	itree_insert_gap_1 (node->right, pos, length, before_markers);
+    }
+  if (node->left && node->left->limit >= pos)
+    itree_insert_gap_1 (node->left, pos, length, before_markers);
+  itree_update_limit (node);
+}
+
+/* Update TREE for the insertion of LENGTH characters at POS.  Nodes
+   that start or end exactly at POS are moved if they advance at that
+   end, or if BEFORE_MARKERS, as for insert-before-markers.  */
+
+void
+itree_insert_gap (struct itree_tree *tree, ptrdiff_t pos, ptrdiff_t length,
+		  bool before_markers)
+{
+  struct itree_iterator it;
+  struct itree_node *node, **moved = NULL;
+  ptrdiff_t nmoved = 0, i;
+  USE_SAFE_ALLOCA;
+
+  if (!tree->root || length <= 0)
+    return;
+
+  /* The positions of all other nodes are updated in place, which keeps
+     them in order.  But the nodes that start at POS and advance there
+     pass those that start at POS and don't, so take them out of the
+     tree first.  With BEFORE_MARKERS, all of them advance together.  */
+  if (!before_markers)
+    {
+      ITREE_FOREACH (node, it, tree, pos, pos)
+	if (node->begin == pos
+	    && itree_gap_begin (node, pos, length, false) != pos)
+	  nmoved++;
+      if (nmoved)
+	{
+	  SAFE_NALLOCA (moved, 1, nmoved);
+	  i = 0;
+	  ITREE_FOREACH (node, it, tree, pos, pos)
+	    if (node->begin == pos
+		&& itree_gap_begin (node, pos, length, false) != pos)
+	      moved[i++] = node;
+	  for (i = 0; i < nmoved; i++)
+	    itree_remove (tree, moved[i]);
+	}
+    }
+
+  if (tree->root)
+    itree_insert_gap_1 (tree->root, pos, length, before_markers);
+
+  /* Since a node is only moved when its start advances, its end
+     advances too.  */
+  for (i = 0; i < nmoved; i++)
+    itree_insert (tree, moved[i], pos + length, moved[i]->end + length);
+  SAFE_FREE ();
+}
+
+/* Update the positions in the subtree at NODE for the deletion of the
+   LENGTH characters after POS, which end at TO.  NODE's own positions
+   must be up to date.  This maps positions monotonically, so the order
+   of the nodes is preserved.  */
+
+static void
+itree_delete_gap_1 (struct itree_node *node, ptrdiff_t pos, ptrdiff_t to,
+		    ptrdiff_t length)
+{
+  itree_inherit_offset (node);
+  if (node->begin >= to)
+    {
+      node->begin -= length;
+      node->end -= length;
+      if (node->right)
+	itree_shift_subtree (node->right, -length);
+    }
+  else
+    {
+      if (node->end > pos)
+	{
+	  node->begin = min (node->begin, pos);
+	  node->end = node->end >= to ? node->end - length : pos;
+	}
+      if (node->right && node->right->limit > pos)
+	itree_delete_gap_1 (node->right, pos, to, length);
+    }
+  if (node->left && node->left->limit > pos)
+    itree_delete_gap_1 (node->left, pos, to, length);
+  itree_update_limit (node);
+}
+
+/* Update TREE for the deletion of the LENGTH characters after POS.  */
+
+void
+itree_delete_gap (struct itree_tree *tree, ptrdiff_t pos, ptrdiff_t length)
+{
+  if (!tree->root || length <= 0)
+    return;
+
+  itree_delete_gap_1 (tree->root, pos, pos + length, length);
+}
+
+static void
+itree_transform_1 (struct itree_node *node, ptrdiff_t (*fn) (ptrdiff_t))
+{
+  itree_inherit_offset (node);
+  if (node->left)
+    itree_transform_1 (node->left, fn);
+  if (node->right)
+    itree_transform_1 (node->right, fn);
+  node->begin = fn (node->begin);
+  node->end = fn (node->end);
+  itree_update_limit (node);
+}
+
+/* Replace every position P in TREE by FN (P).  FN must be monotonic,
+   so that the order of the nodes is preserved.  */
+
+void
+itree_transform (struct itree_tree *tree, ptrdiff_t (*fn) (ptrdiff_t))
+{
+  if (tree->root)
+    itree_transform_1 (tree->root, fn);
+}
+
+/* Return the smallest start position greater than POS of any node in
+   TREE, or PTRDIFF_MAX if there is none.  */
+
+ptrdiff_t
+itree_next_begin (struct itree_tree *tree, ptrdiff_t pos)
+{
+  struct itree_node *node = tree->root;
+  ptrdiff_t next = PTRDIFF_MAX;
+
+  while (node)
+    {
+      itree_inherit_offset (node);
+      if (node->begin > pos)
+	{
+	  next = node->begin;
+	  node = node->left;
+	}
+      else
+	node = node->right;
+    }
+  return next;
+}
+
+/* Return the largest start position less than POS of any node in
+   TREE, or PTRDIFF_MIN if there is none.  */
+
+ptrdiff_t
+itree_prev_begin (struct itree_tree *tree, ptrdiff_t pos)
+{
+  struct itree_node *node = tree->root;
+  ptrdiff_t prev = PTRDIFF_MIN;
+
+  while (node)
+    {
+      itree_inherit_offset (node);
+      if (node->begin < pos)
+	{
+	  prev = node->begin;
+	  node = node->right;
+	}
+      else
+	node = node->left;
+    }
+  return prev;
+}
+
+/* Return the first node, in order, of the subtree at NODE that may
+   overlap the range of IT.  NODE's own positions must be up to date.  */
+
+static struct itree_node *
+itree_iterator_first (struct itree_iterator *it, struct itree_node *node)
+{
+  for (;;)
+    {
+      itree_inherit_offset (node);
+      if (node->left && node->left->limit >= it->begin)
+	node = node->left;
+      else
+	return node;
+    }
+}
+
+/* Start a walk with IT over the nodes of TREE overlapping
+   BEGIN..END.  */
+
+void
+itree_iterator_start (struct itree_iterator *it, struct itree_tree *tree,
+		      ptrdiff_t begin, ptrdiff_t end)
+{
+  it->begin = begin;
+  it->end = end;
+  it->node = (tree->root && tree->root->limit >= begin
+	      ? itree_iterator_first (it, tree->root)
+	      : NULL);
+}
+
+/* Return the next node of the walk IT, or NULL at the end.  */
+
+struct itree_node *
+itree_iterator_next (struct itree_iterator *it)
+{
+  struct itree_node *node = it->node;
+
+  while (node && node->begin <= it->end)
+    {
+      struct itree_node *current = node;
+
+      /* Find the next candidate, skipping subtrees which end too
+	 early.  */
+      if (node->right && node->right->limit >= it->begin)
+	node = itree_iterator_first (it, node->right);
+      else
+	{
+	  while (node->parent && node == node->parent->right)
+	    node = node->parent;
+	  node = node->parent;
+	}
+
+      if (current->end >= it->begin)
+	{
+	  it->node = node;
+	  return current;
+	}
+    }
+
+  it->node = NULL;
+  return NULL;
+}
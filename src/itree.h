@@ -0,0 +1,131 @@
+/* Interval trees for overlays.
+
+Copyright (C) 2017 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef EMACS_ITREE_H
+#define EMACS_ITREE_H
+
+#include "lisp.h"
+
+INLINE_HEADER_BEGIN
+
+/* The overlays of a buffer are kept in an augmented red-black tree
+   ordered by start position.  Every node also records the largest
+   end position found in its subtree (LIMIT), which lets a search for
+   the intervals overlapping some range skip whole subtrees, so that
+   finding K overlapping intervals out of N costs O(K log N) instead
+   of O(N).
+
+   Text insertions and deletions shift the positions of all the
+   intervals after the change.  Rather than visiting every one of
+   them, the shift is recorded in the OFFSET of the root of each
+   affected subtree and only pushed down to the children when a node
+   is actually visited.  Consequently, the BEGIN, END and LIMIT
+   stored in a node are only accurate once the offsets of all its
+   ancestors have been applied; use itree_node_begin and
+   itree_node_end to read them from outside of itree.c.  */
+
+struct itree_node
+{
+  struct itree_node *parent;
+  struct itree_node *left;
+  struct itree_node *right;
+
+  /* The interval, see above.  Both ends are inclusive, since an empty
+     overlay still occupies its position.  */
+  ptrdiff_t begin;
+  ptrdiff_t end;
+
+  /* The largest END of any node in this subtree.  */
+  ptrdiff_t limit;
+
+  /* Shift not yet applied to the children of this node.  */
+  ptrdiff_t offset;
+
+  /* The overlay this node belongs to.  */
+  Lisp_Object data;
+
+  bool_bf red : 1;
+
+  /* Whether the corresponding end of the interval advances when text
+     is inserted right at it, like a marker of insertion type t.  */
+  bool_bf front_advance : 1;
+  bool_bf rear_advance : 1;
+};
+
+struct itree_tree
+{
+  struct itree_node *root;
+
+  /* Number of nodes in the tree.  */
+  ptrdiff_t size;
+};
+
+/* State of an in-order walk over the nodes of a tree overlapping the
+   closed range BEGIN..END.  The BEGIN and END of each node returned by
+   the walk are up to date.  The tree must not be modified while a walk
+   is in progress, but several walks may be active at the same time.  */
+
+struct itree_iterator
+{
+  struct itree_node *node;
+  ptrdiff_t begin;
+  ptrdiff_t end;
+};
+
+extern void itree_node_init (struct itree_node *, bool, bool, Lisp_Object);
+extern ptrdiff_t itree_node_begin (struct itree_node *);
+extern ptrdiff_t itree_node_end (struct itree_node *);
+extern void itree_insert (struct itree_tree *, struct itree_node *,
+			  ptrdiff_t, ptrdiff_t);
+extern void itree_remove (struct itree_tree *, struct itree_node *);
+extern void itree_insert_gap (struct itree_tree *, ptrdiff_t, ptrdiff_t,
+			      bool);
+extern void itree_delete_gap (struct itree_tree *, ptrdiff_t, ptrdiff_t);
+extern void itree_transform (struct itree_tree *, ptrdiff_t (*) (ptrdiff_t));
+extern ptrdiff_t itree_next_begin (struct itree_tree *, ptrdiff_t);
+extern ptrdiff_t itree_prev_begin (struct itree_tree *, ptrdiff_t);
+extern void itree_iterator_start (struct itree_iterator *,
+				  struct itree_tree *, ptrdiff_t, ptrdiff_t);
+extern struct itree_node *itree_iterator_next (struct itree_iterator *);
+
+/* Initialize TREE to be empty.  */
+
+INLINE void
+itree_init (struct itree_tree *tree)
+{
+  tree->root = NULL;
+  tree->size = 0;
+}
+
+INLINE bool
+itree_empty_p (struct itree_tree *tree)
+{
+  return !tree->root;
+}
+
+/* Iterate NODE over all nodes of TREE that overlap BEGIN..END, in
+   order of increasing start position, using the iterator IT.  */
+
+#define ITREE_FOREACH(node, it, tree, begin, end)			\
+  for (itree_iterator_start (&(it), tree, begin, end);			\
+       ((node) = itree_iterator_next (&(it))) != NULL; )
+
+INLINE_HEADER_END
+
+#endif /* EMACS_ITREE_H */
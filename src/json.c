@@ -0,0 +1,1191 @@
+/* JSON parsing and serialization.
+
+Copyright (C) 2017 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#include <config.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <c-ctype.h>
+#include <ftoastr.h>
+
+#include "lisp.h"
+#include "buffer.h"
+#include "character.h"
+
+/* Objects and arrays nested deeper than this are rejected, both when
+   parsing and when serializing.  This bounds the C stack used by the
+   recursive descent, and catches circular vectors and hash tables.  */
+enum { JSON_MAX_DEPTH = 2048 };
+
+enum json_object_type
+  {
+    json_object_hashtable,
+    json_object_alist,
+    json_object_plist
+  };
+
+enum json_array_type
+  {
+    json_array_array,
+    json_array_list
+  };
+
+/* How Lisp objects correspond to JSON values, as specified by the
+   keyword arguments of the functions below.  */
+
+struct json_configuration
+{
+  enum json_object_type object_type;
+  enum json_array_type array_type;
+  Lisp_Object null_object;
+  Lisp_Object false_object;
+};
+
+/* Parse the keyword arguments ARGS of length NARGS into CONF.  Accept
+   :object-type and :array-type only if PARSE_OBJECT_TYPES.  If a
+   keyword occurs more than once, the first occurrence wins.  */
+
+static void
+json_parse_args (ptrdiff_t nargs, Lisp_Object *args,
+		 struct json_configuration *conf, bool parse_object_types)
+{
+  if (nargs % 2 != 0)
+    wrong_type_argument (Qplistp, Flist (nargs, args));
+
+  for (ptrdiff_t i = nargs; i > 0; i -= 2)
+    {
+      Lisp_Object key = args[i - 2];
+      Lisp_Object value = args[i - 1];
+      if (parse_object_types && EQ (key, QCobject_type))
+	{
+	  if (EQ (value, Qhash_table))
+	    conf->object_type = json_object_hashtable;
+	  else if (EQ (value, Qalist))
+	    conf->object_type = json_object_alist;
+	  else if (EQ (value, Qplist))
+	    conf->object_type = json_object_plist;
+	  else
+	    signal_error ("Invalid JSON object type", value);
+	}
+      else if (parse_object_types && EQ (key, QCarray_type))
+	{
+	  if (EQ (value, Qarray))
+	    conf->array_type = json_array_array;
+	  else if (EQ (value, Qlist))
+	    conf->array_type = json_array_list;
+	  else
+	    signal_error ("Invalid JSON array type", value);
+	}
+      else if (EQ (key, QCnull_object))
+	conf->null_object = value;
+      else if (EQ (key, QCfalse_object))
+	conf->false_object = value;
+      else
+	signal_error ("Invalid JSON keyword argument", key);
+    }
+}
+
+/* Return the length of the well-formed UTF-8 sequence of a scalar
+   value that starts at P and has at most N bytes, or 0 if there is no
+   such sequence there.  Overlong forms, surrogates, code points beyond
+   U+10FFFF and the internal representation of raw bytes are all
+   rejected.  */
+
+static int
+json_utf8_length (const unsigned char *p, ptrdiff_t n)
+{
+  int c = p[0];
+  int len;
+  unsigned char lo = 0x80, hi = 0xBF;
+
+  if (c < 0x80)
+    return 1;
+  else if (c < 0xC2)
+    return 0;
+  else if (c < 0xE0)
+    len = 2;
+  else if (c < 0xF0)
+    {
+      len = 3;
+      if (c == 0xE0)
+	lo = 0xA0;
+      else if (c == 0xED)
+	hi = 0x9F;
+    }
+  else if (c < 0xF5)
+    {
+      len = 4;
+      if (c == 0xF0)
+	lo = 0x90;
+      else if (c == 0xF4)
+	hi = 0x8F;
+    }
+  else
+    return 0;
+
+  if (n < len || p[1] < lo || hi < p[1])
+    return 0;
+  for (int i = 2; i < len; i++)
+    if ((p[i] & 0xC0) != 0x80)
+      return 0;
+  return len;
+}
+
+
+/* Parsing.  */
+
+/* State of the parser.  The text being parsed is split into up to two
+   segments, like the arguments of re_search_2: the bytes at offsets
+   [0, SIZE1) are at TEXT1, and those at offsets [SIZE1, SIZE1 + SIZE2)
+   are at TEXT2.  This lets a buffer be parsed without moving its gap.  */
+
+struct json_parser
+{
+  const unsigned char *text1, *text2;
+  ptrdiff_t size1, size2;
+
+  /* Offset of the next byte to read.  */
+  ptrdiff_t pos;
+
+  /* The string being parsed, or nil if parsing the current buffer
+     starting at byte position START_BYTE.  */
+  Lisp_Object string;
+  ptrdiff_t start_byte;
+
+  int depth;
+  struct json_configuration conf;
+
+  /* Scratch space for the contents of strings and numbers.  */
+  unsigned char *buf;
+  ptrdiff_t buf_size;
+};
+
+/* Recompute the text segments of P.  No Lisp code runs while parsing,
+   but allocating objects might still relocate buffer text, so do this
+   before reading each token.  */
+
+static void
+json_refresh (struct json_parser *p)
+{
+  if (STRINGP (p->string))
+    {
+      p->text1 = SDATA (p->string);
+      p->size1 = SBYTES (p->string);
+      p->text2 = NULL;
+      p->size2 = 0;
+    }
+  else
+    {
+      ptrdiff_t start = p->start_byte;
+      p->text1 = BYTE_POS_ADDR (start);
+      if (start < GPT_BYTE && GPT_BYTE < ZV_BYTE)
+	{
+	  p->size1 = GPT_BYTE - start;
+	  p->text2 = GAP_END_ADDR;
+	  p->size2 = ZV_BYTE - GPT_BYTE;
+	}
+      else
+	{
+	  p->size1 = ZV_BYTE - start;
+	  p->text2 = NULL;
+	  p->size2 = 0;
+	}
+    }
+}
+
+/* Return the byte at offset POS of the text of P, or -1 if POS is at
+   the end of the text.  */
+
+static int
+json_byte_at (struct json_parser *p, ptrdiff_t pos)
+{
+  if (pos < p->size1)
+    return p->text1[pos];
+  pos -= p->size1;
+  if (pos < p->size2)
+    return p->text2[pos];
+  return -1;
+}
+
+static int
+json_peek (struct json_parser *p)
+{
+  return json_byte_at (p, p->pos);
+}
+
+static void
+json_parser_cleanup (void *arg)
+{
+  struct json_parser *p = arg;
+  xfree (p->buf);
+}
+
+/* Make sure there is room for N more bytes after the first USED bytes
+   of the scratch space of P.  */
+
+static void
+json_reserve (struct json_parser *p, ptrdiff_t used, ptrdiff_t n)
+{
+  if (p->buf_size - used < n)
+    {
+      p->buf = xpalloc (p->buf, &p->buf_size, n - (p->buf_size - used),
+			-1, 1);
+      json_refresh (p);
+    }
+}
+
+/* Signal an error of type ERROR described by MSG, at the current
+   position of P.  The error data also contain the character position
+   where the error was detected: an index into the string, or a buffer
+   position.  */
+
+static _Noreturn void
+json_error (struct json_parser *p, Lisp_Object error, const char *msg)
+{
+  ptrdiff_t position
+    = (STRINGP (p->string)
+       ? string_byte_to_char (p->string, min (p->pos, SBYTES (p->string)))
+       : BYTE_TO_CHAR (min (p->start_byte + p->pos, ZV_BYTE)));
+  xsignal2 (error, build_string (msg), make_number (position));
+}
+
+/* Signal a parse error at the current position, or an end-of-file
+   error if there is no more input.  */
+
+static _Noreturn void
+json_unexpected (struct json_parser *p, const char *msg)
+{
+  if (json_peek (p) < 0)
+    json_error (p, Qjson_end_of_file, "Unexpected end of input");
+  json_error (p, Qjson_parse_error, msg);
+}
+
+static void
+json_skip_whitespace (struct json_parser *p)
+{
+  int c;
+
+  json_refresh (p);
+  while ((c = json_peek (p)) == ' ' || c == '\t' || c == '\n' || c == '\r')
+    p->pos++;
+}
+
+/* Consume the literal LIT, whose first byte has already been seen.  */
+
+static void
+json_parse_literal (struct json_parser *p, const char *lit)
+{
+  for (; *lit; lit++)
+    {
+      if (json_peek (p) != (unsigned char) *lit)
+	json_unexpected (p, "Invalid literal");
+      p->pos++;
+    }
+}
+
+/* Return the value of the four hexadecimal digits of a \u escape.  */
+
+static int
+json_parse_hex4 (struct json_parser *p)
+{
+  int value = 0;
+
+  for (int i = 0; i < 4; i++)
+    {
+      int c = json_peek (p);
+      int digit = ('0' <= c && c <= '9' ? c - '0'
+		   : 'a' <= c && c <= 'f' ? c - 'a' + 10
+		   : 'A' <= c && c <= 'F' ? c - 'A' + 10
+		   : -1);
+      if (digit < 0)
+	json_unexpected (p, "Invalid \\u escape");
+      value = (value << 4) | digit;
+      p->pos++;
+    }
+  return value;
+}
+
+/* Parse a JSON string, whose opening quote is at the current position.
+   Store its contents in the scratch space of P starting at offset
+   USED, and return their length in bytes.  Store the number of
+   characters in *NCHARS.  */
+
+static ptrdiff_t
+json_parse_string_contents (struct json_parser *p, ptrdiff_t used,
+			    ptrdiff_t *nchars)
+{
+  ptrdiff_t start = used;
+  ptrdiff_t chars = 0;
+
+  p->pos++;
+  for (;;)
+    {
+      int c = json_peek (p);
+
+      json_reserve (p, used, MAX_MULTIBYTE_LENGTH);
+      if (c == '"')
+	{
+	  p->pos++;
+	  break;
+	}
+      else if (c == '\\')
+	{
+	  p->pos++;
+	  c = json_peek (p);
+	  p->pos++;
+	  switch (c)
+	    {
+	    case '"': case '\\': case '/': break;
+	    case 'b': c = '\b'; break;
+	    case 'f': c = '\f'; break;
+	    case 'n': c = '\n'; break;
+	    case 'r': c = '\r'; break;
+	    case 't': c = '\t'; break;
+	    case 'u':
+	      c = json_parse_hex4 (p);
+	      if (0xDC00 <= c && c <= 0xDFFF)
+		json_error (p, Qjson_parse_error, "Unpaired surrogate");
+	      if (0xD800 <= c && c <= 0xDBFF)
+		{
+		  if (json_peek (p) != '\\')
+		    json_unexpected (p, "Unpaired surrogate");
+		  p->pos++;
+		  if (json_peek (p) != 'u')
+		    json_unexpected (p, "Unpaired surrogate");
+		  p->pos++;
+		  int lo = json_parse_hex4 (p);
+		  if (! (0xDC00 <= lo && lo <= 0xDFFF))
+		    json_error (p, Qjson_parse_error, "Unpaired surrogate");
+		  c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+		}
+	      break;
+	    default:
+	      p->pos--;
+	      json_unexpected (p, "Invalid escape sequence");
+	    }
+	  used += CHAR_STRING (c, p->buf + used);
+	}
+      else if (c < 0x20)
+	json_unexpected (p, "Control character in string");
+      else if (c < 0x80)
+	{
+	  p->buf[used++] = c;
+	  p->pos++;
+	}
+      else
+	{
+	  unsigned char seq[4];
+	  int n;
+
+	  for (n = 0; n < 4 && 0 <= json_byte_at (p, p->pos + n); n++)
+	    seq[n] = json_byte_at (p, p->pos + n);
+	  int len = json_utf8_length (seq, n);
+	  if (len == 0)
+	    {
+	      /* A sequence cut short by the end of the input might still
+		 be completed by more input.  */
+	      int need = (c < 0xC2 ? 0 : c < 0xE0 ? 2 : c < 0xF0 ? 3
+			  : c < 0xF5 ? 4 : 0);
+	      bool prefix = n < need;
+	      for (int i = 1; prefix && i < n; i++)
+		prefix = (seq[i] & 0xC0) == 0x80;
+	      if (prefix)
+		{
+		  p->pos += n;
+		  json_unexpected (p, "Invalid UTF-8");
+		}
+	      json_error (p, Qjson_parse_error, "Invalid UTF-8");
+	    }
+	  memcpy (p->buf + used, seq, len);
+	  used += len;
+	  p->pos += len;
+	}
+      chars++;
+    }
+
+  *nchars = chars;
+  return used - start;
+}
+
+/* Parse a JSON number at the current position.  */
+
+static Lisp_Object
+json_parse_number (struct json_parser *p)
+{
+  ptrdiff_t start = p->pos;
+  bool is_float = false;
+
+  if (json_peek (p) == '-')
+    p->pos++;
+  if (json_peek (p) == '0')
+    p->pos++;
+  else if (c_isdigit (json_peek (p)))
+    while (c_isdigit (json_peek (p)))
+      p->pos++;
+  else
+    json_unexpected (p, "Invalid number");
+
+  if (json_peek (p) == '.')
+    {
+      is_float = true;
+      p->pos++;
+      if (!c_isdigit (json_peek (p)))
+	json_unexpected (p, "Invalid number");
+      while (c_isdigit (json_peek (p)))
+	p->pos++;
+    }
+
+  if (json_peek (p) == 'e' || json_peek (p) == 'E')
+    {
+      is_float = true;
+      p->pos++;
+      if (json_peek (p) == '+' || json_peek (p) == '-')
+	p->pos++;
+      if (!c_isdigit (json_peek (p)))
+	json_unexpected (p, "Invalid number");
+      while (c_isdigit (json_peek (p)))
+	p->pos++;
+    }
+
+  ptrdiff_t len = p->pos - start;
+  json_reserve (p, 0, len + 1);
+  for (ptrdiff_t i = 0; i < len; i++)
+    p->buf[i] = json_byte_at (p, start + i);
+  p->buf[len] = '\0';
+
+  if (!is_float)
+    {
+      /* Integers that do not fit in a fixnum become floats.  */
+      bool negative = p->buf[0] == '-';
+      EMACS_INT value = 0;
+      ptrdiff_t i;
+      for (i = negative; i < len; i++)
+	{
+	  int digit = p->buf[i] - '0';
+	  if ((MOST_POSITIVE_FIXNUM - digit) / 10 < value)
+	    break;
+	  value = 10 * value + digit;
+	}
+      if (i == len)
+	return make_number (negative ? -value : value);
+    }
+
+  return make_float (strtod ((char *) p->buf, NULL));
+}
+
+static Lisp_Object json_parse_value (struct json_parser *);
+
+static void
+json_enter (struct json_parser *p)
+{
+  if (JSON_MAX_DEPTH <= p->depth)
+    json_error (p, Qjson_object_too_deep, "Nesting too deep");
+  p->depth++;
+  p->pos++;
+}
+
+/* Parse a JSON array, whose opening bracket is at the current
+   position.  */
+
+static Lisp_Object
+json_parse_array (struct json_parser *p)
+{
+  Lisp_Object elts = Qnil;
+  ptrdiff_t n = 0;
+
+  json_enter (p);
+  json_skip_whitespace (p);
+  if (json_peek (p) == ']')
+    p->pos++;
+  else
+    for (;;)
+      {
+	elts = Fcons (json_parse_value (p), elts);
+	n++;
+	json_skip_whitespace (p);
+	int c = json_peek (p);
+	p->pos++;
+	if (c == ']')
+	  break;
+	if (c != ',')
+	  {
+	    p->pos--;
+	    json_unexpected (p, "Expected `,' or `]'");
+	  }
+	QUIT;
+      }
+  p->depth--;
+
+  if (p->conf.array_type == json_array_list)
+    return Fnreverse (elts);
+
+  Lisp_Object result = make_uninit_vector (n);
+  for (ptrdiff_t i = n - 1; 0 <= i; i--, elts = XCDR (elts))
+    ASET (result, i, XCAR (elts));
+  return result;
+}
+
+/* Parse the key of a JSON object member, and return it as a Lisp
+   object suitable for the configured object type.  */
+
+static Lisp_Object
+json_parse_key (struct json_parser *p)
+{
+  ptrdiff_t nchars, nbytes;
+
+  if (json_peek (p) != '"')
+    json_unexpected (p, "Expected string key");
+
+  switch (p->conf.object_type)
+    {
+    case json_object_hashtable:
+      nbytes = json_parse_string_contents (p, 0, &nchars);
+      return make_string_from_bytes ((char *) p->buf, nchars, nbytes);
+
+    case json_object_plist:
+      /* Keys become keywords.  */
+      json_reserve (p, 0, 1);
+      p->buf[0] = ':';
+      nbytes = json_parse_string_contents (p, 1, &nchars) + 1;
+      nchars++;
+      break;
+
+    default:
+      nbytes = json_parse_string_contents (p, 0, &nchars);
+      break;
+    }
+
+  Lisp_Object obarray = check_obarray (Vobarray);
+  Lisp_Object tem = oblookup (obarray, (char *) p->buf, nchars, nbytes);
+  if (SYMBOLP (tem))
+    return tem;
+  return intern_driver (make_string_from_bytes ((char *) p->buf,
+						nchars, nbytes),
+			obarray, tem);
+}
+
+/* Parse a JSON object, whose opening brace is at the current
+   position.  */
+
+static Lisp_Object
+json_parse_object (struct json_parser *p)
+{
+  Lisp_Object result = Qnil;
+  struct Lisp_Hash_Table *h = NULL;
+
+  if (p->conf.object_type == json_object_hashtable)
+    {
+      result = make_hash_table (hashtest_equal,
+				make_number (DEFAULT_HASH_SIZE),
+				make_float (DEFAULT_REHASH_SIZE),
+				make_float (DEFAULT_REHASH_THRESHOLD),
+				Qnil);
+      h = XHASH_TABLE (result);
+    }
+
+  json_enter (p);
+  json_skip_whitespace (p);
+  if (json_peek (p) == '}')
+    p->pos++;
+  else
+    for (;;)
+      {
+	json_skip_whitespace (p);
+	Lisp_Object key = json_parse_key (p);
+	json_skip_whitespace (p);
+	if (json_peek (p) != ':')
+	  json_unexpected (p, "Expected `:'");
+	p->pos++;
+	Lisp_Object value = json_parse_value (p);
+
+	switch (p->conf.object_type)
+	  {
+	  case json_object_hashtable:
+	    {
+	      /* If a key occurs more than once, the last value wins.  */
+	      EMACS_UINT hash;
+	      ptrdiff_t i = hash_lookup (h, key, &hash);
+	      if (0 <= i)
+		set_hash_value_slot (h, i, value);
+	      else
+		hash_put (h, key, value, hash);
+	    }
+	    break;
+	  case json_object_alist:
+	    result = Fcons (Fcons (key, value), result);
+	    break;
+	  case json_object_plist:
+	    result = Fcons (value, Fcons (key, result));
+	    break;
+	  }
+
+	json_skip_whitespace (p);
+	int c = json_peek (p);
+	p->pos++;
+	if (c == '}')
+	  break;
+	if (c != ',')
+	  {
+	    p->pos--;
+	    json_unexpected (p, "Expected `,' or `}'");
+	  }
+	QUIT;
+      }
+  p->depth--;
+
+  return h ? result : Fnreverse (result);
+}
+
+/* Parse the JSON value that starts at the current position, possibly
+   after some whitespace.  */
+
+static Lisp_Object
+json_parse_value (struct json_parser *p)
+{
+  json_skip_whitespace (p);
+
+  int c = json_peek (p);
+  switch (c)
+    {
+    case '{':
+      return json_parse_object (p);
+    case '[':
+      return json_parse_array (p);
+    case '"':
+      {
+	ptrdiff_t nchars;
+	ptrdiff_t nbytes = json_parse_string_contents (p, 0, &nchars);
+	return make_string_from_bytes ((char *) p->buf, nchars, nbytes);
+      }
+    case 't':
+      json_parse_literal (p, "true");
+      return Qt;
+    case 'f':
+      json_parse_literal (p, "false");
+      return p->conf.false_object;
+    case 'n':
+      json_parse_literal (p, "null");
+      return p->conf.null_object;
+    default:
+      if (c == '-' || c_isdigit (c))
+	return json_parse_number (p);
+      json_unexpected (p, "Unexpected character");
+    }
+}
+
+static void
+json_parser_init (struct json_parser *p, Lisp_Object string,
+		  ptrdiff_t start_byte, ptrdiff_t nargs, Lisp_Object *args)
+{
+  p->string = string;
+  p->start_byte = start_byte;
+  p->pos = 0;
+  p->depth = 0;
+  p->buf = NULL;
+  p->buf_size = 0;
+  p->conf = (struct json_configuration) {json_object_hashtable,
+					 json_array_array, QCnull, QCfalse};
+  json_parse_args (nargs, args, &p->conf, true);
+  json_refresh (p);
+}
+
+DEFUN ("json-parse-string", Fjson_parse_string, Sjson_parse_string,
+       1, MANY, 0,
+       doc: /* Parse the JSON STRING into a Lisp object.
+This is essentially the reverse operation of `json-serialize', which
+see.  The returned object will be the JSON null value, the JSON false
+value, t, a number, a string, a vector, a list, a hash table, an alist,
+or a plist.  Its elements will be further objects of these types.
+Integers too large to be fixnums are returned as floats.  If there are
+duplicate keys in an object, all but the last one are ignored for hash
+tables; alists and plists keep all of them, in the order they appear.
+If STRING doesn't contain a valid JSON value, this function signals an
+error of type `json-parse-error'.
+
+The arguments ARGS are a list of keyword/argument pairs:
+
+The keyword argument `:object-type' specifies which Lisp type is used
+to represent objects; it can be `hash-table', `alist' or `plist'.  It
+defaults to `hash-table'.
+
+The keyword argument `:array-type' specifies which Lisp type is used
+to represent arrays; it can be `array' (the default) or `list'.
+
+The keyword argument `:null-object' specifies which object to use
+to represent a JSON null value.  It defaults to `:null'.
+
+The keyword argument `:false-object' specifies which object to use to
+represent a JSON false value.  It defaults to `:false'.
+usage: (json-parse-string STRING &rest ARGS) */)
+  (ptrdiff_t nargs, Lisp_Object *args)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  struct json_parser p;
+  Lisp_Object string = args[0];
+
+  CHECK_STRING (string);
+  json_parser_init (&p, string, 0, nargs - 1, args + 1);
+  record_unwind_protect_ptr (json_parser_cleanup, &p);
+
+  Lisp_Object value = json_parse_value (&p);
+  json_skip_whitespace (&p);
+  if (json_peek (&p) >= 0)
+    json_error (&p, Qjson_trailing_content, "Trailing content");
+
+  return unbind_to (count, value);
+}
+
+DEFUN ("json-parse-buffer", Fjson_parse_buffer, Sjson_parse_buffer,
+       0, MANY, 0,
+       doc: /* Read a JSON value from the current buffer, starting at point.
+Move point after the end of the value if parsing was successful.
+On error, don't move point.
+
+The text is parsed in place, without copying it into a string first.
+In particular, if the accessible portion of the buffer ends before the
+value is complete, this signals `json-end-of-file' and leaves point
+alone; so a process filter can insert JSON output into a buffer as it
+arrives, and call this function to consume each complete value.
+
+The returned object and the keyword/argument pairs ARGS are as
+described for `json-parse-string'.
+usage: (json-parse-buffer &rest ARGS) */)
+  (ptrdiff_t nargs, Lisp_Object *args)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  struct json_parser p;
+
+  json_parser_init (&p, Qnil, PT_BYTE, nargs, args);
+  record_unwind_protect_ptr (json_parser_cleanup, &p);
+
+  Lisp_Object value = json_parse_value (&p);
+  ptrdiff_t byte = PT_BYTE + p.pos;
+  SET_PT_BOTH (BYTE_TO_CHAR (byte), byte);
+
+  return unbind_to (count, value);
+}
+
+
+/* Serialization.  */
+
+struct json_writer
+{
+  /* The output, and the space allocated for it.  */
+  char *buf;
+  ptrdiff_t used, size;
+
+  int depth;
+  struct json_configuration conf;
+};
+
+static void
+json_writer_cleanup (void *arg)
+{
+  struct json_writer *w = arg;
+  xfree (w->buf);
+}
+
+static void
+json_out (struct json_writer *w, const char *s, ptrdiff_t len)
+{
+  if (w->size - w->used < len)
+    w->buf = xpalloc (w->buf, &w->size, len - (w->size - w->used), -1, 1);
+  memcpy (w->buf + w->used, s, len);
+  w->used += len;
+}
+
+static void
+json_out_byte (struct json_writer *w, char c)
+{
+  json_out (w, &c, 1);
+}
+
+/* Write the Lisp string STRING as a JSON string.  */
+
+static void
+json_out_string (struct json_writer *w, Lisp_Object string)
+{
+  const unsigned char *s = SDATA (string);
+  ptrdiff_t n = SBYTES (string);
+  ptrdiff_t i = 0;
+
+  json_out_byte (w, '"');
+  while (i < n)
+    {
+      /* Copy runs of bytes that need no escaping in one go.  */
+      ptrdiff_t run = i;
+      while (i < n && s[i] >= 0x20 && s[i] < 0x80 && s[i] != '"'
+	     && s[i] != '\\')
+	i++;
+      json_out (w, (const char *) s + run, i - run);
+      if (i == n)
+	break;
+
+      unsigned char c = s[i];
+      if (c >= 0x80)
+	{
+	  int len = json_utf8_length (s + i, n - i);
+	  if (len == 0)
+	    wrong_type_argument (Qutf_8_string_p, string);
+	  json_out (w, (const char *) s + i, len);
+	  i += len;
+	  continue;
+	}
+
+      char esc[sizeof "\\u001f"];
+      switch (c)
+	{
+	case '"': strcpy (esc, "\\\""); break;
+	case '\\': strcpy (esc, "\\\\"); break;
+	case '\b': strcpy (esc, "\\b"); break;
+	case '\f': strcpy (esc, "\\f"); break;
+	case '\n': strcpy (esc, "\\n"); break;
+	case '\r': strcpy (esc, "\\r"); break;
+	case '\t': strcpy (esc, "\\t"); break;
+	default: sprintf (esc, "\\u%04x", c); break;
+	}
+      json_out (w, esc, strlen (esc));
+      i++;
+    }
+  json_out_byte (w, '"');
+}
+
+static void json_out_value (struct json_writer *, Lisp_Object);
+
+static void
+json_enter_nested (struct json_writer *w)
+{
+  if (JSON_MAX_DEPTH <= w->depth)
+    xsignal0 (Qjson_object_too_deep);
+  w->depth++;
+}
+
+/* Write the member KEY: VALUE of an object.  FIRST says whether it is
+   the first member.  */
+
+static void
+json_out_member (struct json_writer *w, bool first, Lisp_Object key,
+		 Lisp_Object value)
+{
+  if (!first)
+    json_out_byte (w, ',');
+  json_out_string (w, key);
+  json_out_byte (w, ':');
+  json_out_value (w, value);
+}
+
+/* Write the alist or plist OBJ as a JSON object.  Members whose key
+   already occurred earlier in the list are skipped.  */
+
+static void
+json_out_list (struct json_writer *w, Lisp_Object obj)
+{
+  bool is_alist = CONSP (XCAR (obj));
+  Lisp_Object seen = Qnil;
+  struct Lisp_Hash_Table *seen_table = NULL;
+  ptrdiff_t nseen = 0;
+  Lisp_Object tail, tortoise;
+  bool n, first = true;
+
+  json_out_byte (w, '{');
+  FOR_EACH_TAIL (tail, obj, tortoise, n)
+    {
+      Lisp_Object key, value;
+      if (is_alist)
+	{
+	  Lisp_Object pair = XCAR (tail);
+	  CHECK_CONS (pair);
+	  key = XCAR (pair);
+	  value = XCDR (pair);
+	}
+      else
+	{
+	  key = XCAR (tail);
+	  tail = XCDR (tail);
+	  CHECK_CONS (tail);
+	  value = XCAR (tail);
+	}
+      CHECK_SYMBOL (key);
+
+      /* Look for duplicates in a list while the object is small, and
+	 switch to a hash table when it gets larger.  */
+      if (seen_table)
+	{
+	  EMACS_UINT hash;
+	  if (0 <= hash_lookup (seen_table, key, &hash))
+	    continue;
+	  hash_put (seen_table, key, Qt, hash);
+	}
+      else
+	{
+	  if (!NILP (Fmemq (key, seen)))
+	    continue;
+	  seen = Fcons (key, seen);
+	  if (++nseen == 16)
+	    {
+	      Lisp_Object table
+		= make_hash_table (hashtest_eq, make_number (DEFAULT_HASH_SIZE),
+				   make_float (DEFAULT_REHASH_SIZE),
+				   make_float (DEFAULT_REHASH_THRESHOLD),
+				   Qnil);
+	      seen_table = XHASH_TABLE (table);
+	      for (; CONSP (seen); seen = XCDR (seen))
+		{
+		  EMACS_UINT hash;
+		  hash_lookup (seen_table, XCAR (seen), &hash);
+		  hash_put (seen_table, XCAR (seen), Qt, hash);
+		}
+	    }
+	}
+
+      Lisp_Object name = SYMBOL_NAME (key);
+      if (!is_alist && SREF (name, 0) == ':')
+	name = Fsubstring (name, make_number (1), Qnil);
+      json_out_member (w, first, name, value);
+      first = false;
+    }
+  if (!NILP (tail))
+    wrong_type_argument (Qlistp, obj);
+  json_out_byte (w, '}');
+}
+
+static void
+json_out_value (struct json_writer *w, Lisp_Object obj)
+{
+  if (EQ (obj, w->conf.null_object))
+    json_out (w, "null", 4);
+  else if (EQ (obj, w->conf.false_object))
+    json_out (w, "false", 5);
+  else if (EQ (obj, Qt))
+    json_out (w, "true", 4);
+  else if (INTEGERP (obj))
+    {
+      char buf[INT_BUFSIZE_BOUND (EMACS_INT)];
+      json_out (w, buf, sprintf (buf, "%"pI"d", XINT (obj)));
+    }
+  else if (FLOATP (obj))
+    {
+      double d = XFLOAT_DATA (obj);
+      char buf[DBL_BUFSIZE_BOUND + 2];
+      if (! isfinite (d))
+	wrong_type_argument (Qjson_value_p, obj);
+      int len = dtoastr (buf, sizeof buf - 2, 0, 0, d);
+      /* Keep the value a float when it is read back.  */
+      if (! strpbrk (buf, ".e"))
+	{
+	  strcpy (buf + len, ".0");
+	  len += 2;
+	}
+      json_out (w, buf, len);
+    }
+  else if (STRINGP (obj))
+    json_out_string (w, obj);
+  else if (VECTORP (obj))
+    {
+      json_enter_nested (w);
+      json_out_byte (w, '[');
+      for (ptrdiff_t i = 0; i < ASIZE (obj); i++)
+	{
+	  if (i > 0)
+	    json_out_byte (w, ',');
+	  json_out_value (w, AREF (obj, i));
+	}
+      json_out_byte (w, ']');
+      w->depth--;
+    }
+  else if (HASH_TABLE_P (obj))
+    {
+      struct Lisp_Hash_Table *h = XHASH_TABLE (obj);
+      bool first = true;
+
+      json_enter_nested (w);
+      json_out_byte (w, '{');
+      for (ptrdiff_t i = 0; i < HASH_TABLE_SIZE (h); i++)
+	if (!NILP (HASH_HASH (h, i)))
+	  {
+	    Lisp_Object key = HASH_KEY (h, i);
+	    CHECK_STRING (key);
+	    json_out_member (w, first, key, HASH_VALUE (h, i));
+	    first = false;
+	  }
+      json_out_byte (w, '}');
+      w->depth--;
+    }
+  else if (NILP (obj))
+    json_out (w, "{}", 2);
+  else if (CONSP (obj))
+    {
+      json_enter_nested (w);
+      json_out_list (w, obj);
+      w->depth--;
+    }
+  else
+    wrong_type_argument (Qjson_value_p, obj);
+}
+
+/* Serialize OBJECT according to the keyword arguments ARGS of length
+   NARGS into W, which is freed when unwinding the current binding
+   level.  */
+
+static void
+json_serialize (struct json_writer *w, Lisp_Object object,
+		ptrdiff_t nargs, Lisp_Object *args)
+{
+  w->buf = NULL;
+  w->used = w->size = 0;
+  w->depth = 0;
+  w->conf = (struct json_configuration) {json_object_hashtable,
+					 json_array_array, QCnull, QCfalse};
+  json_parse_args (nargs, args, &w->conf, false);
+  record_unwind_protect_ptr (json_writer_cleanup, w);
+  json_out_value (w, object);
+}
+
+DEFUN ("json-serialize", Fjson_serialize, Sjson_serialize, 1, MANY,
+       NULL,
+       doc: /* Return the JSON representation of OBJECT as a string.
+
+OBJECT must be t, a number, string, vector, hash table, alist, plist,
+or the Lisp equivalents to the JSON null and false values, and its
+elements must recursively consist of the same kinds of values.  t is
+written as the JSON true value.  Vectors are written as JSON arrays,
+whereas hash tables, alists and plists are written as JSON objects;
+nil is the empty object.  Floats must be finite, and are always
+written with a decimal point or an exponent.  Strings are written as
+UTF-8, escaping control characters, and must contain only Unicode
+characters.
+
+Hash table keys must be strings, and are written in the order they
+have in the table.  Alist and plist keys must be symbols, whose names
+are written without the leading colon of plist keys; if a key occurs
+more than once in the same list, only its first member is written.
+Objects and arrays nested too deeply, as circular vectors are, signal
+`json-object-too-deep'.
+
+The Lisp equivalents to the JSON null and false values are
+configurable in the arguments ARGS, a list of keyword/argument pairs:
+
+The keyword argument `:null-object' specifies which object to use
+to represent a JSON null value.  It defaults to `:null'.
+
+The keyword argument `:false-object' specifies which object to use to
+represent a JSON false value.  It defaults to `:false'.
+
+If you specify the same value for `:null-object' and `:false-object',
+a potentially ambiguous situation, the JSON output will not contain
+any JSON false values.
+usage: (json-serialize OBJECT &rest ARGS)  */)
+     (ptrdiff_t nargs, Lisp_Object *args)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  struct json_writer w;
+
+  json_serialize (&w, args[0], nargs - 1, args + 1);
+  Lisp_Object result
+    = make_string_from_bytes (w.buf,
+			      multibyte_chars_in_text ((unsigned char *) w.buf,
+						       w.used),
+			      w.used);
+  return unbind_to (count, result);
+}
+
+DEFUN ("json-insert", Fjson_insert, Sjson_insert, 1, MANY,
+       NULL,
+       doc: /* Insert the JSON representation of OBJECT before point.
+This is the same as (insert (json-serialize OBJECT)), but faster, as
+no string is made.  See the function `json-serialize' for allowed
+values of OBJECT.
+usage: (json-insert OBJECT &rest ARGS)  */)
+     (ptrdiff_t nargs, Lisp_Object *args)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  struct json_writer w;
+
+  json_serialize (&w, args[0], nargs - 1, args + 1);
+  if (!NILP (BVAR (current_buffer, enable_multibyte_characters)))
+    insert (w.buf, w.used);
+  else
+    {
+      Lisp_Object string
+	= make_string_from_bytes (w.buf,
+				  multibyte_chars_in_text ((unsigned char *)
+							   w.buf, w.used),
+				  w.used);
+      Finsert (1, &string);
+    }
+
+  return unbind_to (count, Qnil);
+}
+
+
+/* Simplified version of 'define-error' that works with pure
+   objects.  */
+
+static void
+define_error (Lisp_Object name, const char *message, Lisp_Object parent)
+{
+  eassert (SYMBOLP (name));
+  eassert (SYMBOLP (parent));
+  Lisp_Object parent_conditions = Fget (parent, Qerror_conditions);
+  eassert (CONSP (parent_conditions));
+  eassert (!NILP (Fmemq (parent, parent_conditions)));
+  eassert (NILP (Fmemq (name, parent_conditions)));
+  Fput (name, Qerror_conditions, pure_cons (name, parent_conditions));
+  Fput (name, Qerror_message, build_pure_c_string (message));
+}
+
+void
+syms_of_json (void)
+{
+  DEFSYM (QCnull, ":null");
+  DEFSYM (QCfalse, ":false");
+
+  DEFSYM (Qutf_8_string_p, "utf-8-string-p");
+  DEFSYM (Qjson_value_p, "json-value-p");
+  DEFSYM (Qplistp, "plistp");
+
+  DEFSYM (Qjson_error, "json-error");
+  DEFSYM (Qjson_parse_error, "json-parse-error");
+  DEFSYM (Qjson_end_of_file, "json-end-of-file");
+  DEFSYM (Qjson_trailing_content, "json-trailing-content");
+  DEFSYM (Qjson_object_too_deep, "json-object-too-deep");
+  define_error (Qjson_error, "generic json error", Qerror);
+  define_error (Qjson_parse_error, "could not parse JSON stream",
+		Qjson_error);
+  define_error (Qjson_end_of_file, "end of JSON stream", Qjson_parse_error);
+  define_error (Qjson_trailing_content, "trailing content after JSON stream",
+		Qjson_parse_error);
+  define_error (Qjson_object_too_deep,
+		"object cyclic or Lisp evaluation too deep", Qjson_error);
+
+  DEFSYM (QCobject_type, ":object-type");
+  DEFSYM (QCarray_type, ":array-type");
+  DEFSYM (QCnull_object, ":null-object");
+  DEFSYM (QCfalse_object, ":false-object");
+  DEFSYM (Qalist, "alist");
+  DEFSYM (Qplist, "plist");
+  DEFSYM (Qarray, "array");
+
+  defsubr (&Sjson_serialize);
+  defsubr (&Sjson_insert);
+  defsubr (&Sjson_parse_string);
+  defsubr (&Sjson_parse_buffer);
+}
@@ -1672,8 +1672,8 @@ adjust_point_for_property (ptrdiff_t last_pt, bool modified)
 	  && display_prop_intangible_p (val, overlay, PT, PT_BYTE)
 	  && (!OVERLAYP (overlay)
 	      ? get_property_and_range (PT, Qdisplay, &val, &beg, &end, Qnil)
-	      : (beg = OVERLAY_POSITION (OVERLAY_START (overlay)),
-		 end = OVERLAY_POSITION (OVERLAY_END (overlay))))
+	      : (beg = OVERLAY_START (overlay),
+		 end = OVERLAY_END (overlay)))
 	  && (beg < PT /* && end > PT   <- It's always the case.  */
 	      || (beg <= PT && STRINGP (val) && SCHARS (val) == 0)))
 	{
@@ -4312,27 +4312,74 @@ timer_resume_idle (void)
    ...).  Each element has the form (FUN . ARGS).  */
 Lisp_Object pending_funcalls;
 
-/* Return true if TIMER is a valid timer, placing its value into *RESULT.  */
+/* Return true if TIMER is a timer with a valid time, placing the time
+   into *RESULT.  */
 static bool
-decode_timer (Lisp_Object timer, struct timespec *result)
+decode_timer_time (Lisp_Object timer, struct lisp_time *result)
 {
   Lisp_Object *vec;
 
   if (! (VECTORP (timer) && ASIZE (timer) == 9))
-    return 0;
+    return false;
   vec = XVECTOR (timer)->contents;
-  if (! NILP (vec[0]))
-    return 0;
   if (! INTEGERP (vec[2]))
     return false;
+  return decode_time_components (vec[1], vec[2], vec[3], vec[8], result, 0) > 0;
+}
 
+/* Return true if TIMER is a valid timer that has not been triggered,
+   placing its value into *RESULT.  */
+static bool
+decode_timer (Lisp_Object timer, struct timespec *result)
+{
   struct lisp_time t;
-  if (decode_time_components (vec[1], vec[2], vec[3], vec[8], &t, 0) <= 0)
+
+  if (! (decode_timer_time (timer, &t) && NILP (AREF (timer, 0))))
     return false;
   *result = lisp_to_timespec (t);
   return timespec_valid_p (*result);
 }
 
+/* Return a list of the timers at the start of TIMERS, a list sorted by
+   time, that are valid, have not been triggered, and are ripe at NOW.
+   Stop at the first one that is not ripe yet.  */
+static Lisp_Object
+ripe_timers (Lisp_Object timers, struct timespec now)
+{
+  Lisp_Object ripe = Qnil;
+
+  for (; CONSP (timers); timers = XCDR (timers))
+    {
+      struct timespec timer_time;
+
+      if (decode_timer (XCAR (timers), &timer_time))
+	{
+	  if (timespec_cmp (timer_time, now) > 0)
+	    break;
+	  ripe = Fcons (XCAR (timers), ripe);
+	}
+    }
+  return Fnreverse (ripe);
+}
+
+/* Return the time from NOW until the first valid timer in TIMERS that
+   has not been triggered is ripe, zero if it is ripe already, or an
+   invalid time if there is no such timer.  TIMERS is sorted by time.  */
+static struct timespec
+time_until_timer (Lisp_Object timers, struct timespec now)
+{
+  for (; CONSP (timers); timers = XCDR (timers))
+    {
+      struct timespec timer_time;
+
+      if (decode_timer (XCAR (timers), &timer_time))
+	return (timespec_cmp (timer_time, now) <= 0
+		? make_timespec (0, 0)
+		: timespec_sub (timer_time, now));
+    }
+  return invalid_timespec ();
+}
+
 
 /* Check whether a timer has fired.  To prevent larger problems we simply
    disregard elements that are not proper timers.  Do not make a circular
@@ -4503,7 +4550,8 @@ timer_check_2 (Lisp_Object timers, Lisp_Object idle_timers)
 struct timespec
 timer_check (void)
 {
-  struct timespec nexttime;
+  struct timespec nexttime, idle_nexttime;
+  struct timespec now = current_timespec ();
   Lisp_Object timers, idle_timers;
 
   Lisp_Object tem = Vinhibit_quit;
@@ -4511,13 +4559,16 @@ timer_check (void)
 
   /* We use copies of the timers' lists to allow a timer to add itself
      again, without locking up Emacs if the newly added timer is
-     already ripe when added.  */
+     already ripe when added.  Only the timers that are ripe are
+     copied, so that checking timers does not take time proportional
+     to the number of timers that are not.  */
 
   /* Always consider the ordinary timers.  */
-  timers = Fcopy_sequence (Vtimer_list);
+  timers = ripe_timers (Vtimer_list, now);
   /* Consider the idle timers only if Emacs is idle.  */
   if (timespec_valid_p (timer_idleness_start_time))
-    idle_timers = Fcopy_sequence (Vtimer_idle_list);
+    idle_timers = ripe_timers (Vtimer_idle_list,
+			       timespec_sub (now, timer_idleness_start_time));
   else
     idle_timers = Qnil;
 
@@ -4529,9 +4580,54 @@ timer_check (void)
     }
   while (nexttime.tv_sec == 0 && nexttime.tv_nsec == 0);
 
+  /* The timers have run, and may have added or rescheduled timers,
+     some of which can be ripe by now; if so, return zero, so that the
+     caller checks timers again soon.  */
+  now = current_timespec ();
+  nexttime = time_until_timer (Vtimer_list, now);
+  if (timespec_valid_p (timer_idleness_start_time))
+    {
+      idle_nexttime
+	= time_until_timer (Vtimer_idle_list,
+			    timespec_sub (now, timer_idleness_start_time));
+      if (timespec_valid_p (idle_nexttime)
+	  && (! timespec_valid_p (nexttime)
+	      || timespec_cmp (idle_nexttime, nexttime) < 0))
+	nexttime = idle_nexttime;
+    }
+
   return nexttime;
 }
 
+DEFUN ("timer--last-before", Ftimer__last_before, Stimer__last_before,
+       2, 2, 0,
+       doc: /* Return the last cons of TIMERS whose timer is due before TIMER.
+TIMERS is a list of timers sorted by time, such as `timer-list'.
+Return nil if none of them is due before TIMER.  This is where
+`timer-activate' inserts TIMER.  */)
+  (Lisp_Object timer, Lisp_Object timers)
+{
+  struct lisp_time t, u;
+  Lisp_Object last = Qnil;
+
+  if (! decode_timer_time (timer, &t))
+    error ("Invalid or uninitialized timer");
+
+  for (; CONSP (timers); timers = XCDR (timers))
+    {
+      if (! (decode_timer_time (XCAR (timers), &u)
+	     && (u.hi < t.hi
+		 || (u.hi == t.hi
+		     && (u.lo < t.lo
+			 || (u.lo == t.lo
+			     && (u.us < t.us
+				 || (u.us == t.us && u.ps < t.ps))))))))
+	break;
+      last = timers;
+    }
+  return last;
+}
+
 DEFUN ("current-idle-time", Fcurrent_idle_time, Scurrent_idle_time, 0, 0, 0,
        doc: /* Return the current length of Emacs idleness, or nil.
 The value when Emacs is idle is a list of four integers (HIGH LOW USEC PSEC)
@@ -11248,6 +11344,7 @@ syms_of_keyboard (void)
   staticpro (&help_form_saved_window_configs);
 
   defsubr (&Scurrent_idle_time);
+  defsubr (&Stimer__last_before);
   defsubr (&Sevent_symbol_parse_modifiers);
   defsubr (&Sevent_convert_list);
   defsubr (&Sread_key_sequence);
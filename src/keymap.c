@@ -3589,7 +3589,7 @@ Return list of symbols found.  */)
   apropos_predicate = predicate;
   apropos_accumulate = Qnil;
   map_obarray (Vobarray, apropos_accum, regexp);
-  tem = Fsort (apropos_accumulate, Qstring_lessp);
+  tem = Fsort (apropos_accumulate, Qstring_lessp, Qnil);
   apropos_accumulate = Qnil;
   apropos_predicate = Qnil;
   return tem;
@@ -0,0 +1,409 @@
+/* Indexing the lines of a buffer.
+
+Copyright (C) 2017 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
+
+
+#include <config.h>
+
+#include "lisp.h"
+#include "buffer.h"
+#include "character.h"
+#include "count-newlines.h"
+#include "line-index.h"
+
+
+/* Data structures.  */
+
+/* The number of bytes a chunk is given when the text is counted.
+   Chunks that grow past twice this size are merged with their
+   neighbors and counted again.  */
+enum { LINE_INDEX_CHUNK = 16 * 1024 };
+
+/* Smaller buffers are not indexed, and shorter scans do not use the
+   index: scanning the text directly is fast enough for them.  */
+enum
+  {
+    LINE_INDEX_MIN_SIZE = 256 * 1024,
+    LINE_INDEX_MIN_SCAN = 64 * 1024,
+    LINE_INDEX_MIN_COUNT = 256
+  };
+
+/* The size of some text.  */
+struct line_counts
+{
+  ptrdiff_t bytes, chars, lines;
+};
+
+/* Which of the counts to search by.  */
+enum line_count_kind { BY_BYTES, BY_CHARS, BY_LINES };
+
+struct line_index
+{
+  /* The number of chunks, a power of two.  */
+  ptrdiff_t size;
+
+  /* The counts of each chunk.  Some chunks can be empty.  */
+  struct line_counts *chunk;
+
+  /* A Fenwick tree over CHUNK: TREE[I], for I between 1 and SIZE,
+     holds the sum of the counts of chunks I - (I & -I) to I - 1.  */
+  struct line_counts *tree;
+
+  /* The counts of the whole text, when it was last indexed.  */
+  struct line_counts total;
+
+  /* If the text has changed since it was last indexed, the number of
+     chars unchanged at its beginning and at its end; otherwise -1.  */
+  ptrdiff_t beg_unchanged, end_unchanged;
+};
+
+static ptrdiff_t
+count_of (struct line_counts const *c, enum line_count_kind kind)
+{
+  return kind == BY_BYTES ? c->bytes : kind == BY_CHARS ? c->chars : c->lines;
+}
+
+static void
+add_counts (struct line_counts *c, struct line_counts const *d)
+{
+  c->bytes += d->bytes;
+  c->chars += d->chars;
+  c->lines += d->lines;
+}
+
+static void
+subtract_counts (struct line_counts *c, struct line_counts const *d)
+{
+  c->bytes -= d->bytes;
+  c->chars -= d->chars;
+  c->lines -= d->lines;
+}
+
+
+/* Counting text.  */
+
+/* Count the text of the current buffer between byte positions FROM
+   and TO, which must be character boundaries, into *C.  */
+static void
+count_text (ptrdiff_t from, ptrdiff_t to, struct line_counts *c)
+{
+  bool multibyte = !NILP (BVAR (current_buffer, enable_multibyte_characters));
+
+  c->bytes = c->chars = to - from;
+  c->lines = 0;
+  while (from < to)
+    {
+      ptrdiff_t lim = from < GPT_BYTE ? min (to, GPT_BYTE) : to;
+      unsigned char *p = BYTE_POS_ADDR (from);
+      unsigned char *plim = p + (lim - from);
+
+      c->lines += count_newlines (p, lim - from);
+      if (multibyte)
+	for (; p < plim; p++)
+	  c->chars -= !CHAR_HEAD_P (*p);
+      from = lim;
+    }
+}
+
+/* Return the byte position after the Nth newline at or after byte
+   position FROM in the current buffer.  There must be that many.  */
+static ptrdiff_t
+skip_newlines (ptrdiff_t from, ptrdiff_t n)
+{
+  while (true)
+    {
+      ptrdiff_t lim = from < GPT_BYTE ? GPT_BYTE : Z_BYTE;
+      unsigned char *base = BYTE_POS_ADDR (from);
+      unsigned char *plim = base + (lim - from);
+      unsigned char *p = base;
+
+      eassert (from < Z_BYTE);
+      while ((p = memchr (p, '\n', plim - p)))
+	{
+	  p++;
+	  if (--n == 0)
+	    return from + (p - base);
+	}
+      from = lim;
+    }
+}
+
+
+/* The Fenwick tree.  */
+
+/* Add D to the counts of chunk I of LI.  */
+static void
+tree_add (struct line_index *li, ptrdiff_t i, struct line_counts const *d)
+{
+  for (i++; i <= li->size; i += i & -i)
+    add_counts (&li->tree[i], d);
+}
+
+/* Return the number of leading chunks of LI whose KIND counts add up
+   to at most TARGET, and store the sum of their counts in *BEFORE.
+   If TARGET is less than the total, the chunk that follows them is
+   the one that holds the TARGETth unit of KIND, counting from 0.  */
+static ptrdiff_t
+tree_search (struct line_index *li, enum line_count_kind kind,
+	     ptrdiff_t target, struct line_counts *before)
+{
+  struct line_counts sum = { 0, 0, 0 };
+  ptrdiff_t i = 0, step;
+
+  for (step = li->size; step; step >>= 1)
+    if (i + step <= li->size)
+      {
+	struct line_counts *t = &li->tree[i + step];
+
+	if (count_of (&sum, kind) + count_of (t, kind) <= target)
+	  {
+	    i += step;
+	    add_counts (&sum, t);
+	  }
+      }
+  *before = sum;
+  return i;
+}
+
+/* Count the current buffer's text between byte positions FROM and TO
+   again, spreading it evenly over chunks FIRST to LAST - 1 of LI.  */
+static void
+recount_chunks (struct line_index *li, ptrdiff_t first, ptrdiff_t last,
+		ptrdiff_t from, ptrdiff_t to)
+{
+  bool multibyte = !NILP (BVAR (current_buffer, enable_multibyte_characters));
+  ptrdiff_t i;
+
+  for (i = first; i < last; i++)
+    {
+      ptrdiff_t end = i == last - 1 ? to : from + (to - from) / (last - i);
+      struct line_counts c, d;
+
+      if (multibyte)
+	while (end < to && !CHAR_HEAD_P (FETCH_BYTE (end)))
+	  end++;
+      count_text (from, end, &c);
+      d = c;
+      subtract_counts (&d, &li->chunk[i]);
+      li->chunk[i] = c;
+      tree_add (li, i, &d);
+      add_counts (&li->total, &d);
+      from = end;
+    }
+}
+
+/* Index the whole text of the current buffer in LI.  */
+static void
+build_line_index (struct line_index *li)
+{
+  ptrdiff_t bytes = Z_BYTE - BEG_BYTE;
+  ptrdiff_t size = 16;
+
+  while (size * LINE_INDEX_CHUNK < bytes)
+    size *= 2;
+  if (size != li->size)
+    {
+      xfree (li->chunk);
+      xfree (li->tree);
+      li->chunk = xnmalloc (size, sizeof *li->chunk);
+      li->tree = xnmalloc (size + 1, sizeof *li->tree);
+      li->size = size;
+    }
+  memset (li->chunk, 0, size * sizeof *li->chunk);
+  memset (li->tree, 0, (size + 1) * sizeof *li->tree);
+  memset (&li->total, 0, sizeof li->total);
+  recount_chunks (li, 0, size, BEG_BYTE, Z_BYTE);
+  li->beg_unchanged = li->end_unchanged = -1;
+}
+
+/* Bring LI up to date with the text of the current buffer, counting
+   again the chunks that overlap the text changed since it was last
+   indexed.  */
+static void
+update_line_index (struct line_index *li)
+{
+  ptrdiff_t bytes = Z_BYTE - BEG_BYTE, chars = Z - BEG;
+  ptrdiff_t head = li->beg_unchanged, tail = li->end_unchanged;
+  ptrdiff_t first, last, from, to, n;
+  struct line_counts before, before_last;
+
+  if (head < 0)
+    {
+      /* Be safe if the text changed without our being told.  */
+      if (li->total.bytes != bytes || li->total.chars != chars)
+	build_line_index (li);
+      return;
+    }
+  if (head + tail > min (li->total.chars, chars))
+    {
+      build_line_index (li);
+      return;
+    }
+
+  /* Find the chunks that held the changed text.  An insertion at the
+     boundary of two chunks goes to the second one.  */
+  first = tree_search (li, BY_CHARS, head, &before);
+  if (first == li->size)
+    {
+      first--;
+      before = li->total;
+      subtract_counts (&before, &li->chunk[first]);
+    }
+  if (head < li->total.chars - tail)
+    last = tree_search (li, BY_CHARS, li->total.chars - tail - 1,
+			&before_last);
+  else
+    last = first, before_last = before;
+  from = before.bytes;
+  to = bytes - (li->total.bytes - before_last.bytes - li->chunk[last].bytes);
+
+  /* Take in neighbors until the chunks are not too big.  */
+  for (n = last + 1 - first;
+       n < li->size && to - from > 2 * LINE_INDEX_CHUNK * n; n++)
+    {
+      if (last + 1 < li->size)
+	to += li->chunk[++last].bytes;
+      else
+	from -= li->chunk[--first].bytes;
+    }
+
+  if (to - from > 2 * LINE_INDEX_CHUNK * n
+      || (li->size > 16 && bytes < li->size * (LINE_INDEX_CHUNK / 8)))
+    build_line_index (li);
+  else
+    {
+      recount_chunks (li, first, last + 1, BEG_BYTE + from, BEG_BYTE + to);
+      li->beg_unchanged = li->end_unchanged = -1;
+    }
+  eassert (li->total.bytes == bytes && li->total.chars == chars);
+}
+
+/* Store into *C the counts of the current buffer's text before byte
+   position BYTEPOS.  */
+static void
+counts_before (struct line_index *li, ptrdiff_t bytepos,
+	       struct line_counts *c)
+{
+  if (tree_search (li, BY_BYTES, bytepos - BEG_BYTE, c) < li->size)
+    {
+      struct line_counts part;
+
+      count_text (BEG_BYTE + c->bytes, bytepos, &part);
+      add_counts (c, &part);
+    }
+}
+
+/* Store into *C the counts of the current buffer's text up to and
+   including its Nth newline, which must exist.  */
+static void
+counts_through_newline (struct line_index *li, ptrdiff_t n,
+			struct line_counts *c)
+{
+  struct line_counts part;
+  ptrdiff_t chunk_start, end;
+
+  tree_search (li, BY_LINES, n - 1, c);
+  chunk_start = BEG_BYTE + c->bytes;
+  end = skip_newlines (chunk_start, n - c->lines);
+  count_text (chunk_start, end, &part);
+  add_counts (c, &part);
+}
+
+
+/* Interface.  */
+
+void
+free_line_index (struct line_index *li)
+{
+  xfree (li->chunk);
+  xfree (li->tree);
+  xfree (li);
+}
+
+void
+line_index_invalidate (struct buffer *buf, ptrdiff_t head, ptrdiff_t tail)
+{
+  struct line_index *li;
+
+  if (buf->base_buffer)
+    buf = buf->base_buffer;
+  li = buf->line_index;
+  if (!li)
+    return;
+
+  if (li->beg_unchanged < 0 || head < li->beg_unchanged)
+    li->beg_unchanged = head;
+  if (li->end_unchanged < 0 || tail < li->end_unchanged)
+    li->end_unchanged = tail;
+}
+
+bool
+line_index_scan (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end_byte,
+		 ptrdiff_t count, ptrdiff_t *shortage,
+		 ptrdiff_t *charpos, ptrdiff_t *bytepos)
+{
+  struct buffer *buf = (current_buffer->base_buffer
+			? current_buffer->base_buffer : current_buffer);
+  struct line_index *li = buf->line_index;
+  struct line_counts at_start, at_end, found;
+  ptrdiff_t n;
+
+  if (-LINE_INDEX_MIN_COUNT < count && count < LINE_INDEX_MIN_COUNT)
+    return false;
+  if (start_byte == -1)
+    start_byte = CHAR_TO_BYTE (start);
+  if (eabs (end_byte - start_byte) < LINE_INDEX_MIN_SCAN)
+    return false;
+
+  if (li)
+    update_line_index (li);
+  else
+    {
+      if (Z_BYTE - BEG_BYTE < LINE_INDEX_MIN_SIZE)
+	return false;
+      li = buf->line_index = xzalloc (sizeof *li);
+      build_line_index (li);
+    }
+
+  counts_before (li, start_byte, &at_start);
+
+  /* Which newline of the buffer is the one we look for?  Scanning
+     backwards, we stop after it too.  */
+  n = at_start.lines + count + (count < 0);
+  if (0 < n && n <= li->total.lines)
+    {
+      counts_through_newline (li, n, &found);
+      if (count > 0
+	  ? BEG_BYTE + found.bytes <= end_byte
+	  : BEG_BYTE + found.bytes > end_byte)
+	{
+	  if (shortage)
+	    *shortage = 0;
+	  *charpos = BEG + found.chars;
+	  *bytepos = BEG_BYTE + found.bytes;
+	  return true;
+	}
+    }
+
+  counts_before (li, end_byte, &at_end);
+  if (shortage)
+    *shortage = eabs (count) - eabs (at_end.lines - at_start.lines);
+  *charpos = BEG + at_end.chars;
+  *bytepos = end_byte;
+  return true;
+}
@@ -0,0 +1,63 @@
+/* Header file: Indexing the lines of a buffer.
+
+Copyright (C) 2017 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
+
+#ifndef EMACS_LINE_INDEX_H
+#define EMACS_LINE_INDEX_H
+
+/* The newline cache lets find_newline skip text known to hold no
+   newlines, but moving over a million lines still means looking at a
+   million newlines.  The line index instead divides the text of a big
+   buffer into chunks of a few kilobytes, and keeps the number of
+   bytes, characters and newlines in each chunk in a Fenwick tree, so
+   that the number of newlines before a position, and the position of
+   the Nth newline, can be found in logarithmic time plus a scan of a
+   single chunk.
+
+   Like the newline cache, the index is enabled by cache-long-scans,
+   is created the first time a long scan is made in a big enough
+   buffer, and is told about changes to the text by
+   invalidate_buffer_caches; the chunks that overlap a changed region
+   are counted again when the index is next used.  */
+
+struct buffer;
+struct line_index;
+
+/* Free a line index.  */
+extern void free_line_index (struct line_index *);
+
+/* Indicate that a section of BUF has changed.  HEAD and TAIL are the
+   number of chars unchanged at the beginning and at the end of the
+   buffer, as for invalidate_region_cache.  */
+extern void line_index_invalidate (struct buffer *BUF,
+                                   ptrdiff_t HEAD, ptrdiff_t TAIL);
+
+/* Search the current buffer for COUNT newlines between START_BYTE and
+   END_BYTE, like find_newline, using the line index.  START_BYTE can
+   be -1, in which case it is computed from START, the corresponding
+   character position.  Return false if the scan is too short or the
+   buffer too small to be worth indexing; otherwise store the
+   character and byte positions find_newline would return in *CHARPOS
+   and *BYTEPOS, the number of newlines left unfound in *SHORTAGE if
+   SHORTAGE is not NULL, and return true.  */
+extern bool line_index_scan (ptrdiff_t START, ptrdiff_t START_BYTE,
+                             ptrdiff_t END_BYTE, ptrdiff_t COUNT,
+                             ptrdiff_t *SHORTAGE,
+                             ptrdiff_t *CHARPOS, ptrdiff_t *BYTEPOS);
+
+#endif /* EMACS_LINE_INDEX_H */
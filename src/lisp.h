@@ -593,6 +593,7 @@ INLINE bool TERMINALP (Lisp_Object);
 INLINE bool THREADP (Lisp_Object);
 INLINE bool MUTEXP (Lisp_Object);
 INLINE bool CONDVARP (Lisp_Object);
+INLINE bool ZLIB_STREAMP (Lisp_Object);
 INLINE struct Lisp_Save_Value *XSAVE_VALUE (Lisp_Object);
 INLINE struct Lisp_Finalizer *XFINALIZER (Lisp_Object);
 INLINE struct Lisp_Symbol *(XSYMBOL) (Lisp_Object);
@@ -843,6 +844,7 @@ enum pvec_type
   PVEC_THREAD,
   PVEC_MUTEX,
   PVEC_CONDVAR,
+  PVEC_ZLIB_STREAM,
 
   /* These should be last, check internal_equal to see why.  */
   PVEC_COMPILED,
@@ -1966,23 +1968,6 @@ struct Lisp_Hash_Table
      ratio, a float.  */
   Lisp_Object rehash_threshold;
 
-  /* Vector of hash codes.  If hash[I] is nil, this means that the
-     I-th entry is unused.  */
-  Lisp_Object hash;
-
-  /* Vector used to chain entries.  If entry I is free, next[I] is the
-     entry number of the next free item.  If entry I is non-free,
-     next[I] is the index of the next entry in the collision chain.  */
-  Lisp_Object next;
-
-  /* Index of first free entry in free list.  */
-  Lisp_Object next_free;
-
-  /* Bucket vector.  A non-nil entry is the index of the first item in
-     a collision chain.  This vector's size can be larger than the
-     hash table size to reduce collisions.  */
-  Lisp_Object index;
-
   /* Only the fields above are traced normally by the GC.  The ones below
      `count' are special and are either ignored by the GC or traced in
      a special way (e.g. because of weakness).  */
@@ -1990,6 +1975,25 @@ struct Lisp_Hash_Table
   /* Number of key/value entries in the table.  */
   ptrdiff_t count;
 
+  /* Index of first free entry in free list, or -1 if there is none.  */
+  ptrdiff_t next_free;
+
+  /* Hash codes of the entries.  If HASH_FREE_BIT is set in hash[I],
+     the I-th entry is unused, and the other bits are one more than
+     the entry number of the next free entry, or 0 if there is none.  */
+  EMACS_UINT *hash;
+
+  /* The index, which is open-addressed and allocated with xmalloc.
+     It has INDEX_SIZE slots, in groups of a word's worth.  The tag of
+     a slot in use holds seven bits computed from the hash code of the
+     entry whose number is in the slot; the tag of an unused slot tells
+     whether it is empty or was deleted.  */
+  struct hash_index_group *index;
+  ptrdiff_t index_size;
+
+  /* Number of deleted slots in the index.  */
+  ptrdiff_t index_deleted;
+
   /* Vector of keys and values.  The key of item I is found at index
      2 * I, the value is found at index 2 * I + 1.
      This is gc_marked specially if the table is weak.  */
@@ -2034,34 +2038,24 @@ HASH_VALUE (struct Lisp_Hash_Table *h, ptrdiff_t idx)
   return AREF (h->key_and_value, 2 * idx + 1);
 }
 
-/* Value is the index of the next entry following the one at IDX
-   in hash table H.  */
-INLINE Lisp_Object
-HASH_NEXT (struct Lisp_Hash_Table *h, ptrdiff_t idx)
-{
-  return AREF (h->next, idx);
-}
+/* The bit that marks unused entries in the hash codes of a hash
+   table.  Hash codes fit in a Lisp integer, so they never have it.  */
+#define HASH_FREE_BIT ((EMACS_UINT) 1 << (EMACS_INT_WIDTH - 1))
 
-/* Value is the hash code computed for entry IDX in hash table H.  */
+/* Value is the hash code computed for entry IDX in hash table H, or
+   nil if entry IDX is unused.  */
 INLINE Lisp_Object
 HASH_HASH (struct Lisp_Hash_Table *h, ptrdiff_t idx)
 {
-  return AREF (h->hash, idx);
-}
-
-/* Value is the index of the element in hash table H that is the
-   start of the collision list at index IDX in the index vector of H.  */
-INLINE Lisp_Object
-HASH_INDEX (struct Lisp_Hash_Table *h, ptrdiff_t idx)
-{
-  return AREF (h->index, idx);
+  EMACS_UINT hash = h->hash[idx];
+  return hash & HASH_FREE_BIT ? Qnil : make_number (hash);
 }
 
 /* Value is the size of hash table H.  */
 INLINE ptrdiff_t
 HASH_TABLE_SIZE (struct Lisp_Hash_Table *h)
 {
-  return ASIZE (h->next);
+  return ASIZE (h->key_and_value) / 2;
 }
 
 /* Default size for hash tables if not specified.  */
@@ -2150,22 +2144,17 @@ struct Lisp_Marker
 struct Lisp_Overlay
 /* An overlay's real data content is:
    - plist
-   - buffer (really there are two buffer pointers, one per marker,
-     and both points to the same buffer)
-   - insertion type of both ends (per-marker fields)
-   - start & start byte (of start marker)
-   - end & end byte (of end marker)
-   - next (singly linked list of overlays)
-   - next fields of start and end markers (singly linked list of markers).
-   I.e. 9words plus 2 bits, 3words of which are for external linked lists.
-*/
+   - buffer
+   - the node of the buffer's overlay tree that holds the start and end
+     positions, and the insertion types of both ends.
+   The node is allocated along with the overlay and kept until the
+   overlay is freed, even while the overlay is not in any buffer.  */
   {
     ENUM_BF (Lisp_Misc_Type) type : 16;	/* = Lisp_Misc_Overlay */
     bool_bf gcmarkbit : 1;
     unsigned spacer : 15;
-    struct Lisp_Overlay *next;
-    Lisp_Object start;
-    Lisp_Object end;
+    struct buffer *buffer;
+    struct itree_node *interval;
     Lisp_Object plist;
   };
 
@@ -2834,6 +2823,12 @@ CONDVARP (Lisp_Object a)
   return PSEUDOVECTORP (a, PVEC_CONDVAR);
 }
 
+INLINE bool
+ZLIB_STREAMP (Lisp_Object a)
+{
+  return PSEUDOVECTORP (a, PVEC_ZLIB_STREAM);
+}
+
 /* Test for image (image . spec)  */
 INLINE bool
 IMAGEP (Lisp_Object x)
@@ -3537,6 +3532,9 @@ EMACS_UINT sxhash (Lisp_Object, int);
 Lisp_Object make_hash_table (struct hash_table_test, Lisp_Object, Lisp_Object,
                              Lisp_Object, Lisp_Object);
 ptrdiff_t hash_lookup (struct Lisp_Hash_Table *, Lisp_Object, EMACS_UINT *);
+extern void copy_hash_table_arrays (struct Lisp_Hash_Table *,
+				    struct Lisp_Hash_Table *);
+extern void free_hash_table_arrays (struct Lisp_Hash_Table *);
 ptrdiff_t hash_put (struct Lisp_Hash_Table *, Lisp_Object, Lisp_Object,
 		    EMACS_UINT);
 void hash_remove_from_table (struct Lisp_Hash_Table *, Lisp_Object);
@@ -3690,6 +3688,8 @@ extern void refill_memory_reserve (void);
 extern void alloc_unexec_pre (void);
 extern void alloc_unexec_post (void);
 extern void mark_stack (char *, char *);
+extern void stop_mark_helpers (int);
+extern void forget_mark_helpers (void);
 extern void flush_stack_call_func (void (*func) (void *arg), void *arg);
 extern const char *pending_malloc_warning;
 extern Lisp_Object zero_vector;
@@ -3840,7 +3840,7 @@ extern Lisp_Object make_save_funcptr_ptr_obj (void (*) (void), void *,
 					      Lisp_Object);
 extern Lisp_Object make_save_memory (Lisp_Object *, ptrdiff_t);
 extern void free_save_value (Lisp_Object);
-extern Lisp_Object build_overlay (Lisp_Object, Lisp_Object, Lisp_Object);
+extern Lisp_Object build_overlay (bool, bool, Lisp_Object);
 extern void free_marker (Lisp_Object);
 extern void free_cons (struct Lisp_Cons *);
 extern void init_alloc_once (void);
@@ -4063,9 +4063,9 @@ extern void syms_of_editfns (void);
 /* Defined in buffer.c.  */
 extern bool mouse_face_overlay_overlaps (Lisp_Object);
 extern _Noreturn void nsberror (Lisp_Object);
-extern void adjust_overlays_for_insert (ptrdiff_t, ptrdiff_t);
+extern void adjust_overlays_for_insert (ptrdiff_t, ptrdiff_t, bool);
 extern void adjust_overlays_for_delete (ptrdiff_t, ptrdiff_t);
-extern void fix_start_end_in_overlays (ptrdiff_t, ptrdiff_t);
+extern void transpose_overlays (ptrdiff_t, ptrdiff_t, ptrdiff_t, ptrdiff_t);
 extern void report_overlay_modification (Lisp_Object, Lisp_Object, bool,
                                          Lisp_Object, Lisp_Object, Lisp_Object);
 extern bool overlay_touches_p (ptrdiff_t);
@@ -4113,6 +4113,7 @@ extern Lisp_Object make_temp_name (Lisp_Object, bool);
 
 /* Defined in search.c.  */
 extern void shrink_regexp_cache (void);
+extern void mark_regexp_cache (void);
 extern void restore_search_regs (void);
 extern void update_search_regs (ptrdiff_t oldstart,
                                 ptrdiff_t oldend, ptrdiff_t newend);
@@ -4389,6 +4390,7 @@ extern int emacs_open (const char *, int, int);
 extern int emacs_pipe (int[2]);
 extern int emacs_close (int);
 extern ptrdiff_t emacs_read (int, void *, ptrdiff_t);
+extern ptrdiff_t emacs_read_without_lock (int, void *, ptrdiff_t);
 extern ptrdiff_t emacs_write (int, void const *, ptrdiff_t);
 extern ptrdiff_t emacs_write_sig (int, void const *, ptrdiff_t);
 extern void emacs_perror (char const *);
@@ -4403,6 +4405,9 @@ extern int str_collate (Lisp_Object, Lisp_Object, Lisp_Object, Lisp_Object);
 /* Defined in sound.c.  */
 extern void syms_of_sound (void);
 
+/* Defined in sort.c.  */
+extern void tim_sort (Lisp_Object, Lisp_Object *, Lisp_Object *, ptrdiff_t);
+
 /* Defined in category.c.  */
 extern void init_category_once (void);
 extern Lisp_Object char_category_set (int);
@@ -4488,8 +4493,12 @@ extern void syms_of_xml (void);
 extern void xml_cleanup_parser (void);
 #endif
 
+/* Defined in json.c.  */
+extern void syms_of_json (void);
+
 #ifdef HAVE_ZLIB
 /* Defined in decompress.c.  */
+extern void finalize_zlib_stream (struct Lisp_Vector *);
 extern void syms_of_decompress (void);
 #endif
 
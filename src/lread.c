@@ -127,6 +127,7 @@ static int read_emacs_mule_char (int, int (*) (int, Lisp_Object),
 static void readevalloop (Lisp_Object, FILE *, Lisp_Object, bool,
                           Lisp_Object, Lisp_Object,
                           Lisp_Object, Lisp_Object);
+static bool load_elc_image (int, Lisp_Object);
 
 /* Functions that read one byte from the current source READCHARFUN
    or unreads one byte.  If the integer argument C is -1, it returns
@@ -1330,7 +1331,10 @@ Return t if the file exists and loads successfully.  */)
   if (lisp_file_lexically_bound_p (Qget_file_char))
     Fset (Qlexical_binding, Qt);
 
-  if (! version || version >= 22)
+  if (compiled && version >= 22
+      && load_elc_image (fileno (stream), hist_file_name))
+    ;
+  else if (! version || version >= 22)
     readevalloop (Qget_file_char, stream, hist_file_name,
 		  0, Qnil, Qnil, Qnil, Qnil);
   else
@@ -1946,6 +1950,979 @@ readevalloop (Lisp_Object readcharfun,
   unbind_to (count, Qnil);
 }
 
+/* Binary images of compiled files.
+
+   To spare `load' the work of parsing the text of a compiled file,
+   the byte compiler appends to the file an image of the objects that
+   reading it yields, made by Flread__write_elc_image.  The image
+   follows "#@00", which makes the reader skip to the end of the file,
+   so the text before it is unchanged: the file can still be loaded
+   by reading it, and the positions of lazily loaded doc strings and
+   functions in it stay valid.
+
+   An image starts with ELC_IMAGE_MAGIC and a format version, then
+   gives the number of symbols, of shared objects and of top-level
+   forms, the names of the symbols, and the forms.  Numbers are
+   written 7 bits a byte, least significant first, with the high bit
+   set in all bytes but the last.  Each object starts with a byte
+   that is one of enum elc_image_tag.  The file ends with the offset
+   of the image and a checksum of everything before "#@00" and of
+   everything from it up to the end of the image, 8 bytes each least
+   significant first, then ELC_IMAGE_MAGIC again.  The checksum makes
+   `load' parse the text of a file that was edited after it was
+   compiled, rather than use an image that no longer matches it.  */
+
+#define ELC_IMAGE_MAGIC "\037ELCIMG\n"
+enum { ELC_IMAGE_MAGIC_SIZE = sizeof ELC_IMAGE_MAGIC - 1 };
+enum { ELC_IMAGE_VERSION = 2 };
+enum { ELC_IMAGE_TRAILER_SIZE = 16 + ELC_IMAGE_MAGIC_SIZE };
+
+enum elc_image_tag
+  {
+    ELC_FIXNUM,		/* The number times two, or minus one minus
+			   that if it is negative.  */
+    ELC_FLOAT,		/* The 8 bytes of the double, least significant
+			   first.  */
+    ELC_SYMBOL,		/* The index of the symbol in the table.  */
+    ELC_UNINTERNED,	/* The name, as a string without properties.  */
+    ELC_STRING,		/* Flags, byte and char counts, the bytes, then
+			   if it has text properties, their number and
+			   the start, end and plist of each.  */
+    ELC_LIST,		/* N, then the cars of N conses, then the cdr
+			   of the last.  */
+    ELC_VECTOR,		/* N, then the N elements.  */
+    ELC_BYTE_CODE,	/* Likewise.  */
+    ELC_CHAR_TABLE,	/* Likewise.  */
+    ELC_SUB_CHAR_TABLE,	/* Depth and minimum char, then the elements.  */
+    ELC_BOOL_VECTOR,	/* The number of bits, then the bytes.  */
+    ELC_HASH_TABLE,	/* Size, test, weakness, rehash size and
+			   threshold, N, then N keys and values.  */
+    ELC_LOAD_FILE_NAME,	/* What #$ reads as.  */
+    ELC_DEFINE,		/* An index, then an object that is referred
+			   to more than once.  */
+    ELC_REF		/* The index of an object given by ELC_DEFINE.  */
+  };
+
+/* Flags of ELC_STRING.  */
+enum { ELC_STRING_MULTIBYTE = 1, ELC_STRING_INTERVALS = 2 };
+
+verify (sizeof (double) == sizeof (uint64_t));
+
+/* Bytes of an image being written.  */
+
+struct elc_image_buffer
+{
+  unsigned char *data;
+  ptrdiff_t len, size;
+};
+
+struct elc_image_writer
+{
+  /* The header, the symbol table and the forms, written separately
+     because the header and symbol table are known only once the
+     forms are written.  */
+  struct elc_image_buffer header, symbols, forms;
+
+  /* Map objects to the number of references to them, and once they
+     are written, the shared ones to minus one minus their index.  */
+  Lisp_Object refs;
+
+  /* Map symbols to their index in the table.  */
+  Lisp_Object symbol_index;
+
+  /* The number of symbols and of shared objects written.  */
+  ptrdiff_t nsymbols, nshared;
+
+  /* What #$ reads as while the file is read.  */
+  Lisp_Object load_file_name;
+
+  /* False if an object cannot be written.  */
+  bool ok;
+};
+
+static void
+elc_image_put (struct elc_image_buffer *b, void const *data, ptrdiff_t n)
+{
+  if (b->size - b->len < n)
+    b->data = xpalloc (b->data, &b->size, n - (b->size - b->len), -1, 1);
+  memcpy (b->data + b->len, data, n);
+  b->len += n;
+}
+
+static void
+elc_image_put_byte (struct elc_image_buffer *b, int c)
+{
+  unsigned char byte = c;
+  elc_image_put (b, &byte, 1);
+}
+
+static void
+elc_image_put_uint (struct elc_image_buffer *b, EMACS_UINT n)
+{
+  for (; 0x7f < n; n >>= 7)
+    elc_image_put_byte (b, (n & 0x7f) | 0x80);
+  elc_image_put_byte (b, n);
+}
+
+/* Write the characters of STRING to B, without its properties.  */
+
+static void
+elc_image_put_string (struct elc_image_buffer *b, Lisp_Object string,
+		      int flags)
+{
+  elc_image_put_byte (b, flags | (STRING_MULTIBYTE (string)
+				  ? ELC_STRING_MULTIBYTE : 0));
+  elc_image_put_uint (b, SBYTES (string));
+  elc_image_put_uint (b, SCHARS (string));
+  elc_image_put (b, SDATA (string), SBYTES (string));
+}
+
+static void
+free_elc_image_writer (void *arg)
+{
+  struct elc_image_writer *w = arg;
+  xfree (w->header.data);
+  xfree (w->symbols.data);
+  xfree (w->forms.data);
+}
+
+/* Return true if OBJ may be referred to more than once in what is
+   read, so that the image must say whether it is.  */
+
+static bool
+elc_image_shareable_p (struct elc_image_writer *w, Lisp_Object obj)
+{
+  return ! (INTEGERP (obj) || EQ (obj, w->load_file_name)
+	    || (SYMBOLP (obj)
+		&& XSYMBOL (obj)->interned != SYMBOL_UNINTERNED));
+}
+
+static void
+collect_string_interval (INTERVAL interval, Lisp_Object list)
+{
+  if (!NILP (interval->plist))
+    XSETCAR (list, Fcons (list3 (make_number (interval->position),
+				 make_number (interval->position
+					      + LENGTH (interval)),
+				 interval->plist),
+			  XCAR (list)));
+}
+
+/* Return a list of the start, end and plist of the intervals of
+   STRING that have properties.  */
+
+static Lisp_Object
+string_interval_list (Lisp_Object string)
+{
+  Lisp_Object list = Fcons (Qnil, Qnil);
+  traverse_intervals (string_intervals (string), 0,
+		      collect_string_interval, list);
+  return Fnreverse (XCAR (list));
+}
+
+/* Count the references to OBJ and the objects in it.  */
+
+static void
+elc_image_count (struct elc_image_writer *w, Lisp_Object obj)
+{
+  struct Lisp_Hash_Table *h = XHASH_TABLE (w->refs);
+
+  for (; elc_image_shareable_p (w, obj); obj = XCDR (obj))
+    {
+      EMACS_UINT hash;
+      ptrdiff_t i = hash_lookup (h, obj, &hash);
+
+      if (0 <= i)
+	{
+	  set_hash_value_slot (h, i, make_number (XINT (HASH_VALUE (h, i))
+						   + 1));
+	  return;
+	}
+      hash_put (h, obj, make_number (1), hash);
+
+      if (STRINGP (obj))
+	{
+	  Lisp_Object tail;
+	  for (tail = string_interval_list (obj); CONSP (tail);
+	       tail = XCDR (tail))
+	    elc_image_count (w, XCAR (XCDR (XCDR (XCAR (tail)))));
+	  return;
+	}
+      else if (HASH_TABLE_P (obj))
+	{
+	  struct Lisp_Hash_Table *table = XHASH_TABLE (obj);
+	  elc_image_count (w, table->test.name);
+	  elc_image_count (w, table->weak);
+	  elc_image_count (w, table->rehash_size);
+	  elc_image_count (w, table->rehash_threshold);
+	  for (i = 0; i < HASH_TABLE_SIZE (table); i++)
+	    if (!NILP (HASH_HASH (table, i)))
+	      {
+		elc_image_count (w, HASH_KEY (table, i));
+		elc_image_count (w, HASH_VALUE (table, i));
+	      }
+	  return;
+	}
+      else if (VECTORP (obj) || COMPILEDP (obj) || CHAR_TABLE_P (obj))
+	{
+	  ptrdiff_t size = ASIZE (obj);
+	  if (size & PSEUDOVECTOR_FLAG)
+	    size &= PSEUDOVECTOR_SIZE_MASK;
+	  for (i = 0; i < size; i++)
+	    elc_image_count (w, AREF (obj, i));
+	  return;
+	}
+      else if (SUB_CHAR_TABLE_P (obj))
+	{
+	  struct Lisp_Sub_Char_Table *tbl = XSUB_CHAR_TABLE (obj);
+	  for (i = 0; i < chartab_size[tbl->depth]; i++)
+	    elc_image_count (w, tbl->contents[i]);
+	  return;
+	}
+      else if (BOOL_VECTOR_P (obj) || FLOATP (obj) || SYMBOLP (obj))
+	return;
+      else if (!CONSP (obj))
+	{
+	  /* Markers, buffers and the like cannot be read.  */
+	  w->ok = false;
+	  return;
+	}
+
+      elc_image_count (w, XCAR (obj));
+    }
+}
+
+/* Return the index in the table of the shared objects of OBJ, or -1
+   if OBJ is not shared.  If it is shared but not written yet, give it
+   an index and write ELC_DEFINE and the index; after that, return
+   minus one minus its index.  */
+
+static ptrdiff_t
+elc_image_share (struct elc_image_writer *w, Lisp_Object obj)
+{
+  struct Lisp_Hash_Table *h = XHASH_TABLE (w->refs);
+  ptrdiff_t i = hash_lookup (h, obj, NULL);
+  EMACS_INT n = XINT (HASH_VALUE (h, i));
+
+  if (n < 0)
+    return -1 - n;
+  if (n == 1)
+    return -1;
+  set_hash_value_slot (h, i, make_number (-1 - w->nshared));
+  elc_image_put_byte (&w->forms, ELC_DEFINE);
+  elc_image_put_uint (&w->forms, w->nshared);
+  return -1 - w->nshared++;
+}
+
+static void
+elc_image_write (struct elc_image_writer *w, Lisp_Object obj)
+{
+  struct elc_image_buffer *b = &w->forms;
+  ptrdiff_t i, size;
+
+  if (EQ (obj, w->load_file_name))
+    {
+      elc_image_put_byte (b, ELC_LOAD_FILE_NAME);
+      return;
+    }
+  if (INTEGERP (obj))
+    {
+      EMACS_INT n = XINT (obj);
+      elc_image_put_byte (b, ELC_FIXNUM);
+      elc_image_put_uint (b, n < 0 ? -1 - 2 * (EMACS_UINT) n : 2 * n);
+      return;
+    }
+  if (!elc_image_shareable_p (w, obj))
+    {
+      EMACS_UINT hash;
+      struct Lisp_Hash_Table *h = XHASH_TABLE (w->symbol_index);
+
+      i = hash_lookup (h, obj, &hash);
+      if (i < 0)
+	{
+	  i = hash_put (h, obj, make_number (w->nsymbols++), hash);
+	  elc_image_put_string (&w->symbols, SYMBOL_NAME (obj), 0);
+	}
+      elc_image_put_byte (b, ELC_SYMBOL);
+      elc_image_put_uint (b, XINT (HASH_VALUE (h, i)));
+      return;
+    }
+
+  i = elc_image_share (w, obj);
+  if (0 <= i)
+    {
+      elc_image_put_byte (b, ELC_REF);
+      elc_image_put_uint (b, i);
+      return;
+    }
+
+  if (CONSP (obj))
+    {
+      Lisp_Object tail;
+
+      /* Write the conses up to the first one that is shared, which
+	 must be written as the cdr of the one before it.  */
+      for (size = 1, tail = XCDR (obj);
+	   CONSP (tail) && XINT (Fgethash (tail, w->refs, Qnil)) == 1;
+	   tail = XCDR (tail))
+	size++;
+      elc_image_put_byte (b, ELC_LIST);
+      elc_image_put_uint (b, size);
+      for (; size; size--, obj = XCDR (obj))
+	elc_image_write (w, XCAR (obj));
+      elc_image_write (w, tail);
+    }
+  else if (FLOATP (obj))
+    {
+      double d = XFLOAT_DATA (obj);
+      uint64_t bits;
+      memcpy (&bits, &d, sizeof bits);
+      elc_image_put_byte (b, ELC_FLOAT);
+      for (i = 0; i < 8; i++, bits >>= 8)
+	elc_image_put_byte (b, bits & 0xff);
+    }
+  else if (SYMBOLP (obj))
+    {
+      elc_image_put_byte (b, ELC_UNINTERNED);
+      elc_image_put_string (b, SYMBOL_NAME (obj), 0);
+    }
+  else if (STRINGP (obj))
+    {
+      Lisp_Object intervals = string_interval_list (obj);
+      elc_image_put_byte (b, ELC_STRING);
+      elc_image_put_string (b, obj,
+			    NILP (intervals) ? 0 : ELC_STRING_INTERVALS);
+      if (!NILP (intervals))
+	{
+	  elc_image_put_uint (b, XFASTINT (Flength (intervals)));
+	  for (; CONSP (intervals); intervals = XCDR (intervals))
+	    {
+	      Lisp_Object interval = XCAR (intervals);
+	      elc_image_put_uint (b, XFASTINT (XCAR (interval)));
+	      elc_image_put_uint (b, XFASTINT (XCAR (XCDR (interval))));
+	      elc_image_write (w, XCAR (XCDR (XCDR (interval))));
+	    }
+	}
+    }
+  else if (HASH_TABLE_P (obj))
+    {
+      struct Lisp_Hash_Table *h = XHASH_TABLE (obj);
+      elc_image_put_byte (b, ELC_HASH_TABLE);
+      elc_image_write (w, make_number (HASH_TABLE_SIZE (h)));
+      elc_image_write (w, h->test.name);
+      elc_image_write (w, h->weak);
+      elc_image_write (w, h->rehash_size);
+      elc_image_write (w, h->rehash_threshold);
+      elc_image_put_uint (b, h->count);
+      for (i = 0; i < HASH_TABLE_SIZE (h); i++)
+	if (!NILP (HASH_HASH (h, i)))
+	  {
+	    elc_image_write (w, HASH_KEY (h, i));
+	    elc_image_write (w, HASH_VALUE (h, i));
+	  }
+    }
+  else if (BOOL_VECTOR_P (obj))
+    {
+      elc_image_put_byte (b, ELC_BOOL_VECTOR);
+      elc_image_put_uint (b, bool_vector_size (obj));
+      elc_image_put (b, bool_vector_uchar_data (obj),
+		     bool_vector_bytes (bool_vector_size (obj)));
+    }
+  else if (SUB_CHAR_TABLE_P (obj))
+    {
+      struct Lisp_Sub_Char_Table *tbl = XSUB_CHAR_TABLE (obj);
+      elc_image_put_byte (b, ELC_SUB_CHAR_TABLE);
+      elc_image_put_uint (b, tbl->depth);
+      elc_image_put_uint (b, tbl->min_char);
+      for (i = 0; i < chartab_size[tbl->depth]; i++)
+	elc_image_write (w, tbl->contents[i]);
+    }
+  else
+    {
+      eassert (VECTORP (obj) || COMPILEDP (obj) || CHAR_TABLE_P (obj));
+      size = ASIZE (obj);
+      if (size & PSEUDOVECTOR_FLAG)
+	size &= PSEUDOVECTOR_SIZE_MASK;
+      elc_image_put_byte (b, (VECTORP (obj) ? ELC_VECTOR
+			      : COMPILEDP (obj) ? ELC_BYTE_CODE
+			      : ELC_CHAR_TABLE));
+      elc_image_put_uint (b, size);
+      for (i = 0; i < size; i++)
+	elc_image_write (w, AREF (obj, i));
+    }
+}
+
+/* Return the checksum, starting from H, of the N bytes at P.  This
+   reads them 8 at a time, least significant first, so that it is the
+   same on every host, and is meant only to notice changes.  */
+
+static uint64_t
+elc_image_checksum (uint64_t h, unsigned char const *p, ptrdiff_t n)
+{
+  while (0 < n)
+    {
+      int len = min (n, 8);
+      uint64_t w = 0;
+      for (int i = len - 1; 0 <= i; i--)
+	w = (w << 8) | p[i];
+      h = (((h << 5) | (h >> 59)) ^ w) * 0x9e3779b97f4a7c15u;
+      p += len;
+      n -= len;
+    }
+  return h;
+}
+
+/* Return the offset of the image in the compiled file open as FD, or
+   0 if it has none.  If CHECKSUM is non-null and there is an image,
+   store the checksum of the file in *CHECKSUM.  Leave the file offset
+   of FD unchanged.  */
+
+static off_t
+elc_image_offset (int fd, uint64_t *checksum)
+{
+  struct stat st;
+  unsigned char buf[ELC_IMAGE_TRAILER_SIZE];
+  off_t pos = lseek (fd, 0, SEEK_CUR), offset = 0;
+
+  if (pos < 0 || fstat (fd, &st) != 0
+      || st.st_size < ELC_IMAGE_TRAILER_SIZE + 4
+      || lseek (fd, st.st_size - ELC_IMAGE_TRAILER_SIZE, SEEK_SET) < 0
+      || emacs_read (fd, buf, sizeof buf) != sizeof buf
+      || memcmp (buf + 16, ELC_IMAGE_MAGIC, ELC_IMAGE_MAGIC_SIZE) != 0)
+    ;
+  else
+    {
+      char marker[4];
+      for (int i = 7; 0 <= i; i--)
+	offset = (offset << 8) | buf[i];
+      if (! (4 <= offset && offset < st.st_size - ELC_IMAGE_TRAILER_SIZE
+	     && lseek (fd, offset - 4, SEEK_SET) >= 0
+	     && emacs_read (fd, marker, 4) == 4
+	     && memcmp (marker, "#@00", 4) == 0))
+	offset = 0;
+      else if (checksum)
+	{
+	  *checksum = 0;
+	  for (int i = 15; 8 <= i; i--)
+	    *checksum = (*checksum << 8) | buf[i];
+	}
+    }
+
+  lseek (fd, pos, SEEK_SET);
+  return offset;
+}
+
+/* Return a list of the top-level forms in the compiled file open as
+   STREAM, as `load' would read them.  */
+
+static Lisp_Object
+read_elc_forms (FILE *stream)
+{
+  Lisp_Object readcharfun = Qget_file_char, forms = Qnil;
+  int c;
+
+  instream = stream;
+  while ((c = READCHAR) >= 0)
+    {
+      if (c == ';')
+	while ((c = READCHAR) != '\n' && c != -1)
+	  continue;
+      else if (! (c == ' ' || c == '\t' || c == '\n' || c == '\f'
+		  || c == '\r' || c == NO_BREAK_SPACE))
+	{
+	  UNREAD (c);
+	  read_objects = Qnil;
+	  forms = Fcons (read_internal_start (readcharfun, Qnil, Qnil), forms);
+	}
+    }
+  return Fnreverse (forms);
+}
+
+DEFUN ("lread--write-elc-image", Flread__write_elc_image,
+       Slread__write_elc_image, 1, 1, 0,
+       doc: /* Append to the compiled Lisp file FILE an image of its forms.
+`load' then makes the objects of FILE from the image, instead of by
+parsing its text.  Return non-nil if the image was written, and nil if
+FILE holds objects that cannot be put in an image, or is remote.  */)
+  (Lisp_Object file)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  Lisp_Object encoded, forms, tail;
+  struct elc_image_writer w;
+  unsigned char trailer[ELC_IMAGE_TRAILER_SIZE];
+  unsigned char *text;
+  uint64_t checksum;
+  FILE *stream;
+  off_t offset;
+  int fd;
+
+  CHECK_STRING (file);
+  file = Fexpand_file_name (file, Qnil);
+  if (!NILP (Ffind_file_name_handler (file, Qnil)))
+    return Qnil;
+  encoded = ENCODE_FILE (file);
+
+  fd = emacs_open (SSDATA (encoded), O_RDONLY, 0);
+  if (fd < 0)
+    report_file_error ("Opening input file", file);
+  stream = fdopen (fd, "r" FOPEN_BINARY);
+  if (!stream)
+    {
+      emacs_close (fd);
+      report_file_error ("Opening stdio stream", file);
+    }
+  record_unwind_protect_ptr (fclose_unwind, stream);
+  if (elc_image_offset (fd, NULL))
+    error ("File `%s' already has an image", SDATA (file));
+
+  w.load_file_name = Fmake_symbol (build_string ("load-file-name"));
+  specbind (Qload_file_name, w.load_file_name);
+  specbind (Qload_force_doc_strings, Qnil);
+  forms = read_elc_forms (stream);
+
+  w.refs = CALLN (Fmake_hash_table, QCtest, Qeq);
+  w.symbol_index = CALLN (Fmake_hash_table, QCtest, Qeq);
+  w.nsymbols = w.nshared = 0;
+  w.ok = true;
+  for (tail = forms; CONSP (tail) && w.ok; tail = XCDR (tail))
+    elc_image_count (&w, XCAR (tail));
+  if (!w.ok)
+    return unbind_to (count, Qnil);
+
+  memset (&w.header, 0, sizeof w.header);
+  memset (&w.symbols, 0, sizeof w.symbols);
+  memset (&w.forms, 0, sizeof w.forms);
+  record_unwind_protect_ptr (free_elc_image_writer, &w);
+  for (tail = forms; CONSP (tail); tail = XCDR (tail))
+    elc_image_write (&w, XCAR (tail));
+
+  elc_image_put (&w.header, "#@00", 4);
+  elc_image_put (&w.header, ELC_IMAGE_MAGIC, ELC_IMAGE_MAGIC_SIZE);
+  elc_image_put_byte (&w.header, ELC_IMAGE_VERSION);
+  elc_image_put_uint (&w.header, w.nsymbols);
+  elc_image_put_uint (&w.header, w.nshared);
+  elc_image_put_uint (&w.header, XFASTINT (Flength (forms)));
+  elc_image_put (&w.header, w.symbols.data, w.symbols.len);
+  elc_image_put (&w.header, w.forms.data, w.forms.len);
+
+  fd = emacs_open (SSDATA (encoded), O_WRONLY | O_APPEND, 0);
+  if (fd < 0)
+    report_file_error ("Opening output file", file);
+  record_unwind_protect_int (close_file_unwind, fd);
+  offset = lseek (fd, 0, SEEK_END);
+  if (offset < 0 || PTRDIFF_MAX < offset)
+    report_file_error ("Writing image", file);
+  text = xmalloc (offset);
+  record_unwind_protect_ptr (xfree, text);
+  if (lseek (fileno (stream), 0, SEEK_SET) < 0
+      || emacs_read (fileno (stream), text, offset) != offset)
+    report_file_error ("Read error", file);
+  checksum = elc_image_checksum (elc_image_checksum (0, text, offset),
+				 w.header.data, w.header.len);
+
+  offset += 4;
+  for (int i = 0; i < 8; i++)
+    {
+      trailer[i] = (offset >> (8 * i)) & 0xff;
+      trailer[8 + i] = (checksum >> (8 * i)) & 0xff;
+    }
+  memcpy (trailer + 16, ELC_IMAGE_MAGIC, ELC_IMAGE_MAGIC_SIZE);
+  if (emacs_write (fd, w.header.data, w.header.len) != w.header.len
+      || emacs_write (fd, trailer, sizeof trailer) != sizeof trailer)
+    report_file_error ("Writing image", file);
+  return unbind_to (count, Qt);
+}
+
+/* An image being read.  */
+
+struct elc_image_reader
+{
+  unsigned char const *p, *end;
+
+  /* The symbols, each a string until a form refers to it, and the
+     shared objects.  */
+  Lisp_Object symbols, shared;
+
+  /* The number of top-level forms.  */
+  ptrdiff_t nforms;
+
+  /* False if the image turned out to be invalid.  */
+  bool ok;
+};
+
+static Lisp_Object
+elc_image_invalid (struct elc_image_reader *r)
+{
+  r->ok = false;
+  r->p = r->end;
+  return Qnil;
+}
+
+static EMACS_UINT
+elc_image_get_uint (struct elc_image_reader *r)
+{
+  EMACS_UINT n = 0;
+
+  for (int shift = 0; r->p < r->end; shift += 7)
+    {
+      EMACS_UINT bits = *r->p & 0x7f;
+      if (EMACS_INT_WIDTH <= shift || (bits << shift) >> shift != bits)
+	break;
+      n |= bits << shift;
+      if (! (*r->p++ & 0x80))
+	return n;
+    }
+  elc_image_invalid (r);
+  return 0;
+}
+
+/* Return a count of objects of at least MIN_BYTES bytes each in the
+   image, checking that there is room for them.  */
+
+static ptrdiff_t
+elc_image_get_count (struct elc_image_reader *r, ptrdiff_t min_bytes)
+{
+  EMACS_UINT n = elc_image_get_uint (r);
+  if ((r->end - r->p) / min_bytes < n)
+    {
+      elc_image_invalid (r);
+      return 0;
+    }
+  return n;
+}
+
+static Lisp_Object
+elc_image_get_string (struct elc_image_reader *r, int *flags)
+{
+  ptrdiff_t nbytes, nchars;
+  Lisp_Object string;
+
+  if (r->p == r->end)
+    return elc_image_invalid (r);
+  *flags = *r->p++;
+  nbytes = elc_image_get_count (r, 1);
+  nchars = elc_image_get_uint (r);
+  if (! (*flags & ELC_STRING_MULTIBYTE ? nchars <= nbytes : nchars == nbytes))
+    return elc_image_invalid (r);
+  string = make_specified_string ((char const *) r->p, nchars, nbytes,
+				  *flags & ELC_STRING_MULTIBYTE);
+  r->p += nbytes;
+  return string;
+}
+
+/* Record OBJ as the shared object of index ID, if ID is nonnegative.  */
+
+static void
+elc_image_define (struct elc_image_reader *r, ptrdiff_t id, Lisp_Object obj)
+{
+  if (0 <= id)
+    ASET (r->shared, id, obj);
+}
+
+/* Read an object from the image, and if ID is nonnegative, record it
+   as the shared object of index ID as soon as it exists, so that the
+   objects in it can refer to it.  */
+
+static Lisp_Object
+elc_image_read (struct elc_image_reader *r, ptrdiff_t id)
+{
+  Lisp_Object obj = Qnil;
+  ptrdiff_t i, n;
+  int flags;
+
+  if (r->p == r->end)
+    return elc_image_invalid (r);
+
+  switch (*r->p++)
+    {
+    case ELC_FIXNUM:
+      {
+	EMACS_UINT u = elc_image_get_uint (r);
+	EMACS_INT v = u & 1 ? -1 - (EMACS_INT) (u >> 1) : u >> 1;
+	if (FIXNUM_OVERFLOW_P (v))
+	  return elc_image_invalid (r);
+	obj = make_number (v);
+	break;
+      }
+
+    case ELC_FLOAT:
+      {
+	uint64_t bits = 0;
+	double d;
+	if (r->end - r->p < 8)
+	  return elc_image_invalid (r);
+	for (i = 7; 0 <= i; i--)
+	  bits = (bits << 8) | r->p[i];
+	r->p += 8;
+	memcpy (&d, &bits, sizeof d);
+	obj = make_float (d);
+	break;
+      }
+
+    case ELC_SYMBOL:
+      i = elc_image_get_uint (r);
+      if (ASIZE (r->symbols) <= i)
+	return elc_image_invalid (r);
+      /* Intern the symbol when a form first refers to it, as reading
+	 the form would.  */
+      obj = AREF (r->symbols, i);
+      if (STRINGP (obj))
+	{
+	  obj = Fintern (obj, Qnil);
+	  ASET (r->symbols, i, obj);
+	}
+      return obj;
+
+    case ELC_UNINTERNED:
+      obj = elc_image_get_string (r, &flags);
+      if (!r->ok)
+	return Qnil;
+      obj = Fmake_symbol (obj);
+      break;
+
+    case ELC_STRING:
+      obj = elc_image_get_string (r, &flags);
+      if (!r->ok)
+	return Qnil;
+      elc_image_define (r, id, obj);
+      if (flags & ELC_STRING_INTERVALS)
+	for (n = elc_image_get_count (r, 3); 0 < n && r->ok; n--)
+	  {
+	    EMACS_UINT start = elc_image_get_uint (r);
+	    EMACS_UINT end = elc_image_get_uint (r);
+	    Lisp_Object plist = elc_image_read (r, -1);
+	    if (! (start < end && end <= SCHARS (obj)))
+	      return elc_image_invalid (r);
+	    Fset_text_properties (make_number (start), make_number (end),
+				  plist, obj);
+	  }
+      return obj;
+
+    case ELC_LIST:
+      {
+	Lisp_Object tail, last = Qnil;
+	n = elc_image_get_count (r, 2);
+	if (n == 0)
+	  return elc_image_invalid (r);
+	obj = Fmake_list (make_number (n), Qnil);
+	elc_image_define (r, id, obj);
+	for (tail = obj; CONSP (tail); last = tail, tail = XCDR (tail))
+	  XSETCAR (tail, elc_image_read (r, -1));
+	XSETCDR (last, elc_image_read (r, -1));
+	return obj;
+      }
+
+    case ELC_VECTOR:
+    case ELC_BYTE_CODE:
+    case ELC_CHAR_TABLE:
+      {
+	int tag = r->p[-1];
+	n = elc_image_get_count (r, 1);
+	if (tag == ELC_BYTE_CODE ? n == 0
+	    : tag == ELC_CHAR_TABLE ? n < CHAR_TABLE_STANDARD_SLOTS
+	    : false)
+	  return elc_image_invalid (r);
+	obj = Fmake_vector (make_number (n), Qnil);
+	elc_image_define (r, id, obj);
+	for (i = 0; i < n; i++)
+	  ASET (obj, i, elc_image_read (r, -1));
+	if (tag == ELC_BYTE_CODE)
+	  make_byte_code (XVECTOR (obj));
+	else if (tag == ELC_CHAR_TABLE)
+	  XSETPVECTYPE (XVECTOR (obj), PVEC_CHAR_TABLE);
+	return obj;
+      }
+
+    case ELC_SUB_CHAR_TABLE:
+      {
+	EMACS_UINT depth = elc_image_get_uint (r);
+	EMACS_UINT min_char = elc_image_get_uint (r);
+	if (! (1 <= depth && depth <= 3 && min_char <= MAX_CHAR)
+	    || (r->end - r->p) < chartab_size[depth])
+	  return elc_image_invalid (r);
+	obj = make_uninit_sub_char_table (depth, min_char);
+	for (i = 0; i < chartab_size[depth]; i++)
+	  XSUB_CHAR_TABLE (obj)->contents[i] = Qnil;
+	elc_image_define (r, id, obj);
+	for (i = 0; i < chartab_size[depth]; i++)
+	  XSUB_CHAR_TABLE (obj)->contents[i] = elc_image_read (r, -1);
+	return obj;
+      }
+
+    case ELC_BOOL_VECTOR:
+      {
+	EMACS_UINT nbits = elc_image_get_uint (r);
+	if (PTRDIFF_MAX / 2 < nbits
+	    || r->end - r->p < bool_vector_bytes (nbits))
+	  return elc_image_invalid (r);
+	obj = make_uninit_bool_vector (nbits);
+	memcpy (bool_vector_uchar_data (obj), r->p, bool_vector_bytes (nbits));
+	r->p += bool_vector_bytes (nbits);
+	break;
+      }
+
+    case ELC_HASH_TABLE:
+      {
+	/* Make the table as the reader does for #s(hash-table ...).  */
+	Lisp_Object params[10];
+	int nparams = 0;
+	Lisp_Object keywords[] = { QCsize, QCtest, QCweakness,
+				   QCrehash_size, QCrehash_threshold };
+	for (i = 0; i < ARRAYELTS (keywords); i++)
+	  {
+	    Lisp_Object value = elc_image_read (r, -1);
+	    if (!NILP (value))
+	      {
+		params[nparams++] = keywords[i];
+		params[nparams++] = value;
+	      }
+	  }
+	n = elc_image_get_count (r, 2);
+	if (!r->ok)
+	  return Qnil;
+	obj = Fmake_hash_table (nparams, params);
+	elc_image_define (r, id, obj);
+	for (; 0 < n && r->ok; n--)
+	  {
+	    Lisp_Object key = elc_image_read (r, -1);
+	    Fputhash (key, elc_image_read (r, -1), obj);
+	  }
+	return obj;
+      }
+
+    case ELC_LOAD_FILE_NAME:
+      return Vload_file_name;
+
+    case ELC_DEFINE:
+      i = elc_image_get_uint (r);
+      if (ASIZE (r->shared) <= i || !NILP (AREF (r->shared, i)))
+	return elc_image_invalid (r);
+      return elc_image_read (r, i);
+
+    case ELC_REF:
+      i = elc_image_get_uint (r);
+      if (ASIZE (r->shared) <= i || NILP (AREF (r->shared, i)))
+	return elc_image_invalid (r);
+      return AREF (r->shared, i);
+
+    default:
+      return elc_image_invalid (r);
+    }
+
+  elc_image_define (r, id, obj);
+  return obj;
+}
+
+/* Start reading with R the image of N bytes at DATA, up to its first
+   form.  Return false if it is not a valid image.  */
+
+static bool
+elc_image_start (struct elc_image_reader *r, unsigned char const *data,
+		 ptrdiff_t n)
+{
+  ptrdiff_t i;
+  int flags;
+
+  if (n < ELC_IMAGE_MAGIC_SIZE + 1
+      || memcmp (data, ELC_IMAGE_MAGIC, ELC_IMAGE_MAGIC_SIZE) != 0
+      || data[ELC_IMAGE_MAGIC_SIZE] != ELC_IMAGE_VERSION)
+    return false;
+  r->p = data + ELC_IMAGE_MAGIC_SIZE + 1;
+  r->end = data + n;
+  r->ok = true;
+
+  r->symbols = Fmake_vector (make_number (elc_image_get_count (r, 2)), Qnil);
+  r->shared = Fmake_vector (make_number (elc_image_get_count (r, 1)), Qnil);
+  r->nforms = elc_image_get_count (r, 1);
+  for (i = 0; i < ASIZE (r->symbols) && r->ok; i++)
+    ASET (r->symbols, i, elc_image_get_string (r, &flags));
+  return r->ok;
+}
+
+/* Evaluate the forms of the compiled file open as FD, named SOURCENAME
+   in `load-history', from its image, as readevalloop would evaluate
+   them after reading them: each form is made from the image just
+   before it is evaluated.  Return false without evaluating anything
+   if the file has no image, if the image does not match the rest of
+   the file, or if the variables that affect reading call for parsing
+   the text.  */
+
+static bool
+load_elc_image (int fd, Lisp_Object sourcename)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+  off_t offset, pos, end;
+  unsigned char *data;
+  uint64_t checksum;
+  struct elc_image_reader r;
+  Lisp_Object lex_bound;
+  ptrdiff_t i;
+  bool ok;
+
+  if (!load_elc_images || load_force_doc_strings || !NILP (Vpurify_flag)
+      || ! (NILP (Vload_read_function) || EQ (Vload_read_function, Qread))
+      || !NILP (Vread_with_symbol_positions))
+    return false;
+  offset = elc_image_offset (fd, &checksum);
+  if (!offset)
+    return false;
+
+  /* Read the whole file, to check that its text is what the image was
+     made from.  */
+  pos = lseek (fd, 0, SEEK_CUR);
+  end = lseek (fd, 0, SEEK_END) - ELC_IMAGE_TRAILER_SIZE;
+  if (pos < 0 || end < offset || PTRDIFF_MAX < end)
+    return false;
+  data = xmalloc (end);
+  record_unwind_protect_ptr (xfree, data);
+  ok = (lseek (fd, 0, SEEK_SET) == 0
+	&& emacs_read (fd, data, end) == end
+	&& (elc_image_checksum (elc_image_checksum (0, data, offset - 4),
+				data + offset - 4, end - offset + 4)
+	    == checksum)
+	&& elc_image_start (&r, data + offset, end - offset));
+  lseek (fd, pos, SEEK_SET);
+  if (!ok)
+    {
+      unbind_to (count, Qnil);
+      return false;
+    }
+
+  /* Drop what lisp_file_lexically_bound_p may have unread.  */
+  unread_char = -1;
+
+  specbind (Qstandard_input, Qget_file_char);
+  specbind (Qcurrent_load_list, Qnil);
+  lex_bound = find_symbol_value (Qlexical_binding);
+  specbind (Qinternal_interpreter_environment,
+	    (NILP (lex_bound) || EQ (lex_bound, Qunbound)
+	     ? Qnil : list1 (Qt)));
+  if (!NILP (sourcename) && !NILP (Ffile_name_absolute_p (sourcename))
+      && !NILP (Ffboundp (Qfile_truename)))
+    sourcename = call1 (Qfile_truename, sourcename);
+  LOADHIST_ATTACH (sourcename);
+
+  for (i = 0; i < r.nforms; i++)
+    {
+      Lisp_Object form;
+
+      QUIT;
+      form = elc_image_read (&r, -1);
+      /* The checksum matched, so the image can only be invalid if it
+	 was made wrong; the forms before this one were evaluated
+	 already, so it is too late to parse the text instead.  */
+      if (!r.ok)
+	error ("Invalid image in compiled file `%s'", SDATA (sourcename));
+      eval_sub (form);
+    }
+  if (r.p != r.end)
+    error ("Invalid image in compiled file `%s'", SDATA (sourcename));
+
+  build_load_history (sourcename, true);
+  unbind_to (count, Qnil);
+  return true;
+}
+
 DEFUN ("eval-buffer", Feval_buffer, Seval_buffer, 0, 5, "",
        doc: /* Execute the accessible portion of current buffer as Lisp code.
 You can use \\[narrow-to-region] to limit the part of buffer to be evaluated.
@@ -3818,6 +4795,201 @@ static Lisp_Object initial_obarray;
 
 static size_t oblookup_last_bucket_number;
 
+/* Symbols in the initial obarray are looked up through an index, so
+   that the chains of symbols in its buckets, which get long when
+   hundreds of thousands of symbols are interned, need not be walked.
+   The obarray itself is still a vector whose buckets chain all its
+   symbols, for the sake of mapatoms and of Lisp code that looks at
+   it.
+
+   The index is an open-addressed hash table of the symbols, which
+   grows as symbols are interned.  When it gets too full, a larger
+   one is allocated, and the symbols of the old one are moved to it
+   a few slots at a time each time a symbol is interned, so that no
+   single call to `intern' takes long; until that is done, symbols are
+   looked for in both.  */
+
+struct obarray_slot
+{
+  /* The hash code of the name of the symbol, as given by hash_string.  */
+  EMACS_UINT hash;
+
+  /* The symbol, or NULL if the slot is empty, or &obarray_deleted if
+     the symbol in the slot was uninterned.  */
+  struct Lisp_Symbol *symbol;
+};
+
+struct obarray_index
+{
+  /* The slots, SIZE of them, a power of two, 2 to the BITS.  */
+  struct obarray_slot *slots;
+  ptrdiff_t size;
+  int bits;
+
+  /* The number of symbols in the slots, and of slots marked as
+     deleted.  */
+  ptrdiff_t count;
+  ptrdiff_t deleted;
+};
+
+/* The index of the initial obarray, and the index it replaces while
+   its symbols are moved.  */
+static struct obarray_index obarray_index, obarray_old_index;
+
+/* The number of slots of obarray_old_index whose symbols were moved.  */
+static ptrdiff_t obarray_rehash_pos;
+
+/* What marks deleted slots.  */
+static struct Lisp_Symbol obarray_deleted;
+
+/* Return the slot of IX to look in first for hash code HASH.  */
+
+static ptrdiff_t
+obarray_index_start (struct obarray_index *ix, EMACS_UINT hash)
+{
+  return (hash * (EMACS_UINT) 0x9e3779b97f4a7c15) >> (EMACS_INT_WIDTH
+						      - ix->bits);
+}
+
+/* Return the symbol in IX whose name, which hashes to HASH, is the
+   string of SIZE characters (SIZE_BYTE bytes) at PTR, or NULL.  */
+
+static struct Lisp_Symbol *
+obarray_index_lookup (struct obarray_index *ix, EMACS_UINT hash,
+		      const char *ptr, ptrdiff_t size, ptrdiff_t size_byte)
+{
+  ptrdiff_t i;
+
+  if (!ix->slots)
+    return NULL;
+  for (i = obarray_index_start (ix, hash); ix->slots[i].symbol;
+       i = (i + 1) & (ix->size - 1))
+    {
+      struct Lisp_Symbol *sym = ix->slots[i].symbol;
+      if (ix->slots[i].hash == hash && sym != &obarray_deleted
+	  && SBYTES (sym->name) == size_byte
+	  && SCHARS (sym->name) == size
+	  && !memcmp (SDATA (sym->name), ptr, size_byte))
+	return sym;
+    }
+  return NULL;
+}
+
+/* Add SYM, whose name hashes to HASH, to IX, which has room for it.  */
+
+static void
+obarray_index_insert (struct obarray_index *ix, struct Lisp_Symbol *sym,
+		      EMACS_UINT hash)
+{
+  ptrdiff_t i;
+
+  for (i = obarray_index_start (ix, hash);
+       ix->slots[i].symbol && ix->slots[i].symbol != &obarray_deleted;
+       i = (i + 1) & (ix->size - 1))
+    continue;
+  if (ix->slots[i].symbol)
+    ix->deleted--;
+  ix->slots[i].hash = hash;
+  ix->slots[i].symbol = sym;
+  ix->count++;
+}
+
+/* Remove SYM, whose name hashes to HASH, from IX.  Return true if it
+   was there.  */
+
+static bool
+obarray_index_remove (struct obarray_index *ix, struct Lisp_Symbol *sym,
+		      EMACS_UINT hash)
+{
+  ptrdiff_t i;
+
+  if (!ix->slots)
+    return false;
+  for (i = obarray_index_start (ix, hash); ix->slots[i].symbol;
+       i = (i + 1) & (ix->size - 1))
+    if (ix->slots[i].symbol == sym)
+      {
+	ix->slots[i].symbol = &obarray_deleted;
+	ix->count--;
+	ix->deleted++;
+	return true;
+      }
+  return false;
+}
+
+/* Return true if IX is too full to add a symbol to it.  */
+
+static bool
+obarray_index_full_p (struct obarray_index *ix)
+{
+  return 3 * ix->size < 4 * (ix->count + ix->deleted + 1);
+}
+
+/* Move the symbols in up to N slots of the old index of the initial
+   obarray to the new one, and free the old one if it is empty.  */
+
+static void
+obarray_rehash_some (ptrdiff_t n)
+{
+  struct obarray_index *old = &obarray_old_index;
+
+  if (!old->slots)
+    return;
+  for (; 0 < n && obarray_rehash_pos < old->size; n--, obarray_rehash_pos++)
+    {
+      struct obarray_slot *slot = &old->slots[obarray_rehash_pos];
+      if (slot->symbol && slot->symbol != &obarray_deleted)
+	{
+	  obarray_index_insert (&obarray_index, slot->symbol, slot->hash);
+	  slot->symbol = &obarray_deleted;
+	  old->count--;
+	}
+    }
+  if (obarray_rehash_pos == old->size)
+    {
+      xfree (old->slots);
+      memset (old, 0, sizeof *old);
+    }
+}
+
+/* Add SYM, just interned in the initial obarray, to its index.  */
+
+static void
+obarray_index_add (struct Lisp_Symbol *sym)
+{
+  EMACS_UINT hash = hash_string (SSDATA (sym->name), SBYTES (sym->name));
+
+  obarray_rehash_some (16);
+  if (obarray_index_full_p (&obarray_index))
+    {
+      struct obarray_index *ix = &obarray_index;
+      ptrdiff_t count, room;
+
+      /* The symbols of the old index have all been moved by now, as
+	 the current index was made big enough for that below; this
+	 only frees the old index.  */
+      obarray_rehash_some (PTRDIFF_MAX);
+
+      /* Give the new index room for at least twice as many symbols as
+	 there are now, so that it is half full or less.  Each intern
+	 moves the symbols of 16 slots of the old index, and adds at
+	 most one symbol or deleted slot to the new one; leave room for
+	 these too, so that the new index cannot fill up before the old
+	 one is emptied, however few of its symbols are left.  */
+      obarray_old_index = *ix;
+      obarray_rehash_pos = 0;
+      count = ix->count;
+      room = 2 * (count + 1) + ix->size / 8;
+      memset (ix, 0, sizeof *ix);
+      for (ix->bits = 4; (ptrdiff_t) 1 << ix->bits < room; ix->bits++)
+	continue;
+      ix->size = (ptrdiff_t) 1 << ix->bits;
+      ix->slots = xzalloc (ix->size * sizeof *ix->slots);
+      obarray_rehash_some (16);
+    }
+  obarray_index_insert (&obarray_index, sym, hash);
+}
+
 /* Get an error if OBARRAY is not an obarray.
    If it is one, return it.  */
 
@@ -3858,6 +5030,8 @@ intern_sym (Lisp_Object sym, Lisp_Object obarray, Lisp_Object index)
   ptr = aref_addr (obarray, XINT (index));
   set_symbol_next (sym, SYMBOLP (*ptr) ? XSYMBOL (*ptr) : NULL);
   *ptr = sym;
+  if (EQ (obarray, initial_obarray))
+    obarray_index_add (XSYMBOL (sym));
   return sym;
 }
 
@@ -4006,6 +5180,13 @@ usage: (unintern NAME OBARRAY)  */)
 
   XSYMBOL (tem)->interned = SYMBOL_UNINTERNED;
 
+  if (EQ (obarray, initial_obarray))
+    {
+      EMACS_UINT full_hash = hash_string (SSDATA (string), SBYTES (string));
+      if (!obarray_index_remove (&obarray_index, XSYMBOL (tem), full_hash))
+	obarray_index_remove (&obarray_old_index, XSYMBOL (tem), full_hash);
+    }
+
   hash = oblookup_last_bucket_number;
 
   if (EQ (AREF (obarray, hash), tem))
@@ -4057,6 +5238,23 @@ oblookup (Lisp_Object obarray, register const char *ptr, ptrdiff_t size, ptrdiff
   obarray = check_obarray (obarray);
   /* This is sometimes needed in the middle of GC.  */
   obsize = gc_asize (obarray);
+  if (EQ (obarray, initial_obarray))
+    {
+      EMACS_UINT full_hash = hash_string (ptr, size_byte);
+      struct Lisp_Symbol *sym
+	= obarray_index_lookup (&obarray_index, full_hash,
+				ptr, size, size_byte);
+      if (!sym)
+	sym = obarray_index_lookup (&obarray_old_index, full_hash,
+				    ptr, size, size_byte);
+      hash = full_hash % obsize;
+      oblookup_last_bucket_number = hash;
+      if (sym)
+	XSETSYMBOL (tem, sym);
+      else
+	XSETINT (tem, hash);
+      return tem;
+    }
   hash = hash_string (ptr, size_byte) % obsize;
   bucket = AREF (obarray, hash);
   oblookup_last_bucket_number = hash;
@@ -4116,6 +5314,84 @@ OBARRAY defaults to the value of `obarray'.  */)
   return Qnil;
 }
 
+/* Return the greatest number of slots looked at to find a symbol in
+   IX.  */
+
+static ptrdiff_t
+obarray_index_longest_probe (struct obarray_index *ix)
+{
+  ptrdiff_t i, longest = 0;
+
+  for (i = 0; i < ix->size; i++)
+    {
+      struct Lisp_Symbol *sym = ix->slots[i].symbol;
+      if (sym && sym != &obarray_deleted)
+	{
+	  ptrdiff_t start = obarray_index_start (ix, ix->slots[i].hash);
+	  longest = max (longest, ((i - start) & (ix->size - 1)) + 1);
+	}
+    }
+  return longest;
+}
+
+DEFUN ("obarray-statistics", Fobarray_statistics, Sobarray_statistics,
+       0, 1, 0,
+       doc: /* Return statistics about OBARRAY, as an alist.
+OBARRAY defaults to the value of `obarray'.  The alist has these
+elements:
+
+ (symbols . N) where N is the number of symbols in OBARRAY;
+ (buckets . N) where N is the length of OBARRAY;
+ (longest-chain . N) where N is the number of symbols in the
+  fullest bucket of OBARRAY.
+
+For the obarray Emacs starts with, where symbols are looked up through
+an index rather than by walking the chains of the buckets, the alist
+also has these elements:
+
+ (index-size . N) where N is the number of slots in the index;
+ (longest-probe . N) where N is the greatest number of slots looked
+  at to find a symbol in it;
+ (rehashing . FLAG) where FLAG is non-nil if the index is being
+  grown, and the symbols of the previous, smaller one are still being
+  moved to it.  */)
+  (Lisp_Object obarray)
+{
+  ptrdiff_t i, symbols = 0, longest_chain = 0;
+  Lisp_Object result;
+
+  if (NILP (obarray)) obarray = Vobarray;
+  obarray = check_obarray (obarray);
+
+  for (i = 0; i < ASIZE (obarray); i++)
+    {
+      Lisp_Object tail = AREF (obarray, i);
+      ptrdiff_t chain = 0;
+      if (SYMBOLP (tail))
+	for (chain = 1; XSYMBOL (tail)->next; chain++)
+	  XSETSYMBOL (tail, XSYMBOL (tail)->next);
+      symbols += chain;
+      longest_chain = max (longest_chain, chain);
+    }
+
+  result = Qnil;
+  if (EQ (obarray, initial_obarray))
+    {
+      ptrdiff_t longest_probe
+	= max (obarray_index_longest_probe (&obarray_index),
+	       obarray_index_longest_probe (&obarray_old_index));
+      result = list3 (Fcons (Qindex_size, make_number (obarray_index.size)),
+		      Fcons (Qlongest_probe, make_number (longest_probe)),
+		      Fcons (Qrehashing,
+			     obarray_old_index.slots ? Qt : Qnil));
+    }
+  return Fcons (Fcons (Qsymbols, make_number (symbols)),
+		Fcons (Fcons (Qbuckets, make_number (ASIZE (obarray))),
+		       Fcons (Fcons (Qlongest_chain,
+				     make_number (longest_chain)),
+			      result)));
+}
+
 #define OBARRAY_SIZE 1511
 
 void
@@ -4551,6 +5827,8 @@ syms_of_lread (void)
   defsubr (&Sread_event);
   defsubr (&Sget_file_char);
   defsubr (&Smapatoms);
+  defsubr (&Sobarray_statistics);
+  defsubr (&Slread__write_elc_image);
   defsubr (&Slocate_file_internal);
 
   DEFVAR_LISP ("obarray", Vobarray,
@@ -4731,6 +6009,13 @@ and NOERROR and NOMESSAGE are the corresponding arguments passed to
 This is useful when the file being loaded is a temporary copy.  */);
   load_force_doc_strings = 0;
 
+  DEFVAR_BOOL ("load-elc-images", load_elc_images,
+	       doc: /* Non-nil means `load' uses the images in compiled files.
+The byte compiler appends to each compiled file an image of the
+objects in it, which `load' can make without parsing the text of the
+file.  If this is nil, `load' always parses the text.  */);
+  load_elc_images = true;
+
   DEFVAR_BOOL ("load-convert-to-unibyte", load_convert_to_unibyte,
 	       doc: /* Non-nil means `read' converts strings to unibyte whenever possible.
 This is normally bound by `load' and `eval-buffer' to control `read',
@@ -4850,4 +6135,11 @@ that are loaded before your customizations are read!  */);
   DEFSYM (Qrehash_threshold, "rehash-threshold");
 
   DEFSYM (Qchar_from_name, "char-from-name");
+
+  /* Keys in the value of `obarray-statistics'.  */
+  DEFSYM (Qbuckets, "buckets");
+  DEFSYM (Qlongest_chain, "longest-chain");
+  DEFSYM (Qindex_size, "index-size");
+  DEFSYM (Qlongest_probe, "longest-probe");
+  DEFSYM (Qrehashing, "rehashing");
 }
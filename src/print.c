@@ -557,8 +557,7 @@ temp_output_buffer_setup (const char *bufname)
   bset_read_only (current_buffer, Qnil);
   bset_filename (current_buffer, Qnil);
   bset_undo_list (current_buffer, Qt);
-  eassert (current_buffer->overlays_before == NULL);
-  eassert (current_buffer->overlays_after == NULL);
+  eassert (itree_empty_p (&current_buffer->overlays));
   bset_enable_multibyte_characters
     (current_buffer, BVAR (&buffer_defaults, enable_multibyte_characters));
   specbind (Qinhibit_read_only, Qt);
@@ -1782,7 +1781,7 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 	      print_c_string (SSDATA (SYMBOL_NAME (h->test)), printcharfun);
 	      printchar (' ', printcharfun);
 	      print_c_string (SSDATA (SYMBOL_NAME (h->weak)), printcharfun);
-	      len = sprintf (buf, " %"pD"d/%"pD"d", h->count, ASIZE (h->next));
+	      len = sprintf (buf, " %"pD"d/%"pD"d", h->count, HASH_TABLE_SIZE (h));
 	      strout (buf, len, len, printcharfun);
 	    }
 	  len = sprintf (buf, " %p>", ptr);
@@ -1791,7 +1790,7 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 	  /* Implement a readable output, e.g.:
 	    #s(hash-table size 2 test equal data (k1 v1 k2 v2)) */
 	  /* Always print the size.  */
-	  len = sprintf (buf, "#s(hash-table size %"pD"d", ASIZE (h->next));
+	  len = sprintf (buf, "#s(hash-table size %"pD"d", HASH_TABLE_SIZE (h));
 	  strout (buf, len, len, printcharfun);
 
 	  if (!NILP (h->test.name))
@@ -1947,6 +1946,12 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 	    }
 	  printchar ('>', printcharfun);
 	}
+      else if (ZLIB_STREAMP (obj))
+	{
+	  int len = sprintf (buf, "#<zlib-stream %p>",
+			     XUNTAG (obj, Lisp_Vectorlike));
+	  strout (buf, len, len, printcharfun);
+	}
       else
 	{
 	  ptrdiff_t size = ASIZE (obj);
@@ -2028,16 +2033,14 @@ print_object (Lisp_Object obj, Lisp_Object printcharfun, bool escapeflag)
 
 	case Lisp_Misc_Overlay:
 	  print_c_string ("#<overlay ", printcharfun);
-	  if (! XMARKER (OVERLAY_START (obj))->buffer)
+	  if (! OVERLAY_BUFFER (obj))
 	    print_c_string ("in no buffer", printcharfun);
 	  else
 	    {
 	      int len = sprintf (buf, "from %"pD"d to %"pD"d in ",
-				 marker_position (OVERLAY_START (obj)),
-				 marker_position (OVERLAY_END   (obj)));
+				 OVERLAY_START (obj), OVERLAY_END (obj));
 	      strout (buf, len, len, printcharfun);
-	      print_string (BVAR (XMARKER (OVERLAY_START (obj))->buffer, name),
-			    printcharfun);
+	      print_string (BVAR (OVERLAY_BUFFER (obj), name), printcharfun);
 	    }
 	  printchar ('>', printcharfun);
           break;
@@ -93,6 +93,12 @@ static struct rlimit nofile_limit;
 #include <pty.h>
 #endif
 
+#if defined GNU_LINUX && !defined HAVE_NS && !defined HAVE_GLIB
+# define USE_EPOLL
+# include <sys/epoll.h>
+# include <count-trailing-zeros.h>
+#endif
+
 #include <c-ctype.h>
 #include <flexmember.h>
 #include <sig2str.h>
@@ -240,6 +246,9 @@ static EMACS_INT update_tick;
 #define READ_OUTPUT_DELAY_MAX       (READ_OUTPUT_DELAY_INCREMENT * 5)
 #define READ_OUTPUT_DELAY_MAX_MAX   (READ_OUTPUT_DELAY_INCREMENT * 7)
 
+/* The smallest number of bytes read from a process at a time.  */
+enum { READ_OUTPUT_SIZE_MIN = 4096 };
+
 /* Number of processes which have a non-zero read_output_delay,
    and therefore might be delayed for adaptive read buffering.  */
 
@@ -259,6 +268,7 @@ static int status_notify (struct Lisp_Process *, struct Lisp_Process *);
 static int read_process_output (Lisp_Object, int);
 static void create_pty (Lisp_Object);
 static void exec_sentinel (Lisp_Object, Lisp_Object);
+static void stop_waiting_to_write (struct Lisp_Process *);
 
 /* Number of bits set in connect_wait_mask.  */
 static int num_pending_connects;
@@ -436,6 +446,43 @@ static struct fd_callback_data
   struct thread_state *waiting_thread;
 } fd_callback_info[FD_SETSIZE];
 
+#ifdef USE_EPOLL
+
+/* With pselect, the kernel looks at every descriptor up to the
+   highest one waited for, each time Emacs waits, which adds up when
+   there are hundreds of processes and connections.  So on GNU/Linux,
+   wait with epoll instead.  The descriptors waited for stay
+   registered with an epoll instance from one wait to the next, only
+   changes to the masks are passed to the kernel, and the kernel
+   reports just the descriptors that are ready.  */
+
+/* The epoll instance, or -1 if there is none yet, or -2 if epoll
+   cannot be used.  */
+static int epoll_fd = -1;
+
+/* The descriptors registered with epoll_fd for reading and for
+   writing.  */
+static fd_set epoll_read_fds, epoll_write_fds;
+
+/* Descriptors added or deleted since they were last registered.  A
+   descriptor can be closed and then reused for something else
+   meanwhile, so their registration must be made afresh.  */
+static fd_set epoll_changed_fds;
+
+/* Descriptors that epoll cannot wait for, such as regular files.
+   Like pselect, treat them as always ready.  */
+static fd_set epoll_unpollable_fds;
+
+static void
+epoll_note_change (int fd)
+{
+  FD_SET (fd, &epoll_changed_fds);
+}
+
+#else
+# define epoll_note_change(fd) ((void) 0)
+#endif
+
 
 /* Add a file descriptor FD to be monitored for when read is possible.
    When read is possible, call FUNC with argument DATA.  */
@@ -459,6 +506,7 @@ add_non_keyboard_read_fd (int fd)
   fd_callback_info[fd].flags |= FOR_READ;
   if (fd > max_desc)
     max_desc = fd;
+  epoll_note_change (fd);
 }
 
 static void
@@ -495,6 +543,7 @@ add_write_fd (int fd, fd_callback func, void *data)
   fd_callback_info[fd].flags |= FOR_WRITE;
   if (fd > max_desc)
     max_desc = fd;
+  epoll_note_change (fd);
 }
 
 static void
@@ -507,6 +556,7 @@ add_non_blocking_write_fd (int fd)
   if (fd > max_desc)
     max_desc = fd;
   ++num_pending_connects;
+  epoll_note_change (fd);
 }
 
 static void
@@ -535,6 +585,7 @@ delete_write_fd (int fd)
 	emacs_abort ();
     }
   fd_callback_info[fd].flags &= ~(FOR_WRITE | NON_BLOCKING_CONNECT_FD);
+  epoll_note_change (fd);
   if (fd_callback_info[fd].flags == 0)
     {
       fd_callback_info[fd].func = 0;
@@ -635,6 +686,215 @@ compute_write_mask (fd_set *mask)
     }
 }
 
+#ifdef USE_EPOLL
+
+/* The words of an fd_set, which on GNU/Linux is an array of bits in
+   unsigned longs, descriptor D being bit D % ULONG_WIDTH of word
+   D / ULONG_WIDTH.  */
+enum { FD_SET_WORDS = sizeof (fd_set) / sizeof (unsigned long) };
+
+static unsigned long
+fd_set_word (fd_set const *set, int i)
+{
+  unsigned long w = 0;
+  if (set)
+    memcpy (&w, (char const *) set + i * sizeof w, sizeof w);
+  return w;
+}
+
+/* Register FD with epoll_fd for reading if READ, and for writing if
+   WRITE.  Return 0 on success, -1 with errno set on failure.  */
+
+static int
+epoll_register (int fd, bool read, bool write)
+{
+  bool registered = (FD_ISSET (fd, &epoll_read_fds)
+		     || FD_ISSET (fd, &epoll_write_fds));
+  struct epoll_event event;
+
+  if (registered && FD_ISSET (fd, &epoll_changed_fds))
+    {
+      /* FD may be another file now; forget about the old one.  */
+      epoll_ctl (epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+      registered = false;
+    }
+  FD_CLR (fd, &epoll_changed_fds);
+  FD_CLR (fd, &epoll_read_fds);
+  FD_CLR (fd, &epoll_write_fds);
+  FD_CLR (fd, &epoll_unpollable_fds);
+
+  if (! (read || write))
+    return (registered
+	    ? (epoll_ctl (epoll_fd, EPOLL_CTL_DEL, fd, NULL) != 0
+	       && errno != EBADF && errno != ENOENT ? -1 : 0)
+	    : 0);
+
+  memclear (&event, sizeof event);
+  event.events = (read ? EPOLLIN : 0) | (write ? EPOLLOUT : 0);
+  event.data.fd = fd;
+  if (epoll_ctl (epoll_fd, registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+		 fd, &event)
+      != 0)
+    {
+      if (registered && errno == ENOENT)
+	/* FD was closed, which unregistered it, and then reused.  */
+	registered = false;
+      else if (errno == EPERM)
+	{
+	  FD_SET (fd, &epoll_unpollable_fds);
+	  return 0;
+	}
+      if (registered
+	  || epoll_ctl (epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+	return -1;
+    }
+  if (read)
+    FD_SET (fd, &epoll_read_fds);
+  if (write)
+    FD_SET (fd, &epoll_write_fds);
+  return 0;
+}
+
+/* A replacement for pselect that waits with epoll, as explained
+   above.  Only descriptors whose registration differs from what RFDS
+   and WFDS ask for cost a system call, and the ones that are ready
+   are set in RFDS and WFDS from the list that epoll returns.  Use
+   pselect if there are other threads, which could wait for other
+   descriptors at the same time, or if exceptional conditions are
+   waited for.  */
+
+static int
+epoll_pselect (int nfds, fd_set *rfds, fd_set *wfds, fd_set *efds,
+	       struct timespec const *timeout, sigset_t const *sigmask)
+{
+  struct epoll_event events[64];
+  unsigned long unpollable[FD_SET_WORDS];
+  unsigned long saved_r[FD_SET_WORDS], saved_w[FD_SET_WORDS];
+  bool any_unpollable = false;
+  int i, n, ready = 0, msecs = -1;
+
+  if (epoll_fd == -1)
+    {
+      epoll_fd = epoll_create1 (EPOLL_CLOEXEC);
+      if (epoll_fd < 0)
+	epoll_fd = -2;
+    }
+  if (epoll_fd < 0 || efds || other_threads_p ())
+    return pselect (nfds, rfds, wfds, efds, timeout, sigmask);
+
+  /* Bring the registrations up to date, looking bit by bit only at
+     the words where something differs.  */
+  for (i = 0; i < FD_SET_WORDS; i++)
+    {
+      unsigned long r = fd_set_word (rfds, i), w = fd_set_word (wfds, i);
+      unsigned long diff = ((r ^ fd_set_word (&epoll_read_fds, i))
+			    | (w ^ fd_set_word (&epoll_write_fds, i))
+			    | fd_set_word (&epoll_changed_fds, i));
+      int bit;
+
+      for (bit = 0; diff; bit++, diff >>= 1)
+	if (diff & 1)
+	  {
+	    int fd = i * ULONG_WIDTH + bit;
+	    if (epoll_register (fd, (r >> bit) & 1, (w >> bit) & 1) != 0)
+	      return -1;
+	  }
+
+      saved_r[i] = r;
+      saved_w[i] = w;
+      unpollable[i] = (r | w) & fd_set_word (&epoll_unpollable_fds, i);
+      any_unpollable |= unpollable[i] != 0;
+    }
+
+  if (any_unpollable)
+    msecs = 0;
+  else if (timeout)
+    {
+      /* Round up, so as not to wake up before the timeout.  */
+      intmax_t ms = (timeout->tv_sec * (intmax_t) 1000
+		     + (timeout->tv_nsec + 999999) / 1000000);
+      msecs = min (ms, INT_MAX);
+    }
+
+  n = epoll_pwait (epoll_fd, events, ARRAYELTS (events), msecs, sigmask);
+  if (n < 0)
+    return -1;
+
+  if (rfds)
+    FD_ZERO (rfds);
+  if (wfds)
+    FD_ZERO (wfds);
+  for (i = 0; i < n; i++)
+    {
+      int fd = events[i].data.fd;
+      /* Like pselect, report errors and hangups as readiness.  */
+      if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)
+	  && FD_ISSET (fd, &epoll_read_fds))
+	{
+	  FD_SET (fd, rfds);
+	  ready++;
+	}
+      if (events[i].events & (EPOLLOUT | EPOLLHUP | EPOLLERR)
+	  && FD_ISSET (fd, &epoll_write_fds))
+	{
+	  FD_SET (fd, wfds);
+	  ready++;
+	}
+    }
+  if (any_unpollable)
+    for (i = 0; i < FD_SET_WORDS; i++)
+      {
+	unsigned long u = unpollable[i];
+	int bit;
+	for (bit = 0; u; bit++, u >>= 1)
+	  if (u & 1)
+	    {
+	      /* pselect would report the descriptor as ready for
+		 whatever was asked.  */
+	      int fd = i * ULONG_WIDTH + bit;
+	      if (rfds && (saved_r[i] >> bit) & 1 && ! FD_ISSET (fd, rfds))
+		{
+		  FD_SET (fd, rfds);
+		  ready++;
+		}
+	      if (wfds && (saved_w[i] >> bit) & 1 && ! FD_ISSET (fd, wfds))
+		{
+		  FD_SET (fd, wfds);
+		  ready++;
+		}
+	    }
+      }
+  return ready;
+}
+
+#endif /* USE_EPOLL */
+
+/* Return the first descriptor from FD on that is set in RFDS or WFDS,
+   or NFDS if there is none below NFDS.  */
+
+static int
+next_ready_fd (fd_set const *rfds, fd_set const *wfds, int fd, int nfds)
+{
+#ifdef USE_EPOLL
+  /* Skip whole words of descriptors that are not ready, so that
+     finding the few that are costs little even with many open.  */
+  while (fd < nfds)
+    {
+      int i = fd / ULONG_WIDTH;
+      unsigned long w = ((fd_set_word (rfds, i) | fd_set_word (wfds, i))
+			 >> (fd % ULONG_WIDTH));
+      if (w)
+	return min (fd + count_trailing_zeros_l (w), nfds);
+      fd = (i + 1) * ULONG_WIDTH;
+    }
+  return nfds;
+#else
+  while (fd < nfds && ! FD_ISSET (fd, rfds) && ! FD_ISSET (fd, wfds))
+    fd++;
+  return fd;
+#endif
+}
+
 static void
 clear_waiting_thread_info (void)
 {
@@ -1483,6 +1743,36 @@ DEFUN ("process-plist", Fprocess_plist, Sprocess_plist,
   return XPROCESS (process)->plist;
 }
 
+DEFUN ("process-output-statistics", Fprocess_output_statistics,
+       Sprocess_output_statistics, 1, 1, 0,
+       doc: /* Return statistics of the output read from PROCESS.
+The value is a property list with these properties:
+
+  :read-size     The number of bytes Emacs reads from PROCESS at a
+                 time now.  This grows while PROCESS produces output
+                 faster than Emacs reads it, up to
+                 `read-process-output-max'.
+  :bytes         The number of bytes of output read so far.
+  :reads         The number of times output was read.
+  :filter-calls  The number of times the filter of PROCESS was called.
+
+The number of bytes read per filter call shows how well output is
+batched; dividing the bytes read between two calls by the time
+elapsed gives the throughput.  */)
+  (Lisp_Object process)
+{
+  struct Lisp_Process *p;
+
+  CHECK_PROCESS (process);
+  p = XPROCESS (process);
+  return listn (CONSTYPE_HEAP, 8,
+		QCread_size,
+		make_number (max (p->read_output_size, READ_OUTPUT_SIZE_MIN)),
+		QCbytes, make_fixnum_or_float (p->output_bytes),
+		QCreads, make_fixnum_or_float (p->output_reads),
+		QCfilter_calls, make_fixnum_or_float (p->output_filter_calls));
+}
+
 DEFUN ("set-process-plist", Fset_process_plist, Sset_process_plist,
        2, 2, 0,
        doc: /* Replace the plist of PROCESS with PLIST.  Return PLIST.  */)
@@ -4511,6 +4801,8 @@ deactivate_process (Lisp_Object proc)
       p->read_output_skip = 0;
     }
 
+  stop_waiting_to_write (p);
+
   /* Beware SIGCHLD hereabouts.  */
 
   for (i = 0; i < PROCESS_OPEN_FDS; i++)
@@ -5347,6 +5639,8 @@ wait_reading_process_output (intmax_t time_limit, int nsecs, int read_kbd,
 				ns_select
 #elif defined (HAVE_GLIB)
 				xg_select
+#elif defined USE_EPOLL
+				epoll_pselect
 #else
 				pselect
 #endif
@@ -5537,7 +5831,10 @@ wait_reading_process_output (intmax_t time_limit, int nsecs, int read_kbd,
       if (no_avail || nfds == 0)
 	continue;
 
-      for (channel = 0; channel <= max_desc; ++channel)
+      for (channel = next_ready_fd (&Available, &Writeok, 0, max_desc + 1);
+	   channel <= max_desc;
+	   channel = next_ready_fd (&Available, &Writeok, channel + 1,
+				    max_desc + 1))
         {
           struct fd_callback_data *d = &fd_callback_info[channel];
           if (d->func
@@ -5548,7 +5845,10 @@ wait_reading_process_output (intmax_t time_limit, int nsecs, int read_kbd,
             d->func (channel, d->data);
 	}
 
-      for (channel = 0; channel <= max_desc; channel++)
+      for (channel = next_ready_fd (&Available, &Writeok, 0, max_desc + 1);
+	   channel <= max_desc;
+	   channel = next_ready_fd (&Available, &Writeok, channel + 1,
+				    max_desc + 1))
 	{
 	  if (FD_ISSET (channel, &Available)
 	      && ((fd_callback_info[channel].flags & (KEYBOARD_FD | PROCESS_FD))
@@ -5773,11 +6073,45 @@ read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
 				    ssize_t nbytes,
 				    struct coding_system *coding);
 
+/* After reading some output from CHANNEL, read more into the SIZE
+   bytes at BUF, for as long as the output keeps coming in large
+   pieces, so that it is decoded and passed to the filter in one go.
+   Return the number of bytes read.  As a read from a pipe returns no
+   more than the pipe holds, this is what lets a process that produces
+   output quickly be read in large chunks.  */
+
+static ptrdiff_t
+read_more_process_output (int channel, char *buf, ptrdiff_t size)
+{
+  ptrdiff_t total = 0;
+
+#ifndef WINDOWSNT
+  /* Reading a blocking descriptor could wait for the process.  */
+  int flags = fcntl (channel, F_GETFL);
+  if (flags < 0 || ! (flags & O_NONBLOCK))
+    return 0;
+
+  while (total < size)
+    {
+      ptrdiff_t nbytes = emacs_read (channel, buf + total, size - total);
+      if (nbytes <= 0)
+	break;
+      total += nbytes;
+      if (nbytes < READ_OUTPUT_SIZE_MIN / 2)
+	break;
+    }
+#endif
+
+  return total;
+}
+
 /* Read pending output from the process channel,
    starting with our buffered-ahead character if we have one.
    Yield number of decoded characters read.
 
-   This function reads at most 4096 characters.
+   This function reads at most the read size of the process, which
+   is at least READ_OUTPUT_SIZE_MIN bytes, and grows up to
+   `read-process-output-max' bytes while the output keeps coming.
    If you want to read all available subprocess output,
    you must call it repeatedly until it returns zero.
 
@@ -5791,10 +6125,17 @@ read_process_output (Lisp_Object proc, int channel)
   struct Lisp_Process *p = XPROCESS (proc);
   struct coding_system *coding = proc_decode_coding_system[channel];
   int carryover = p->decoding_carryover;
-  enum { readmax = 4096 };
+  ptrdiff_t max_size = clip_to_bounds (READ_OUTPUT_SIZE_MIN,
+				       read_process_output_max,
+				       INT_MAX / 2);
+  ptrdiff_t readmax = clip_to_bounds (READ_OUTPUT_SIZE_MIN,
+				      p->read_output_size, max_size);
   ptrdiff_t count = SPECPDL_INDEX ();
   Lisp_Object odeactivate;
-  char chars[sizeof coding->carryover + readmax];
+  char *chars;
+  USE_SAFE_ALLOCA;
+
+  chars = SAFE_ALLOCA (sizeof coding->carryover + readmax);
 
   if (carryover)
     /* See the comment above.  */
@@ -5837,7 +6178,7 @@ read_process_output (Lisp_Object proc, int channel)
 		  delay += READ_OUTPUT_DELAY_INCREMENT * 2;
 		}
 	    }
-	  else if (delay > 0 && nbytes == readmax - buffered)
+	  else if (delay > 0 && nbytes >= READ_OUTPUT_SIZE_MIN - buffered)
 	    {
 	      delay -= READ_OUTPUT_DELAY_INCREMENT;
 	      if (delay == 0)
@@ -5850,6 +6191,22 @@ read_process_output (Lisp_Object proc, int channel)
 	      process_output_skip = 1;
 	    }
 	}
+      /* A pty returns somewhat less than 4096 bytes at a time.  */
+      if (nbytes >= READ_OUTPUT_SIZE_MIN / 2
+#ifdef HAVE_GNUTLS
+	  && ! (p->gnutls_p && p->gnutls_state)
+#endif
+	  )
+	nbytes += read_more_process_output (channel,
+					    chars + carryover + buffered + nbytes,
+					    readmax - buffered - nbytes);
+
+      /* Read more at a time while the output fills what is read, and
+	 less once it does not.  */
+      if (nbytes == readmax - buffered)
+	p->read_output_size = min (2 * readmax, max_size);
+      else if (nbytes < readmax / 4)
+	p->read_output_size = max (readmax / 2, READ_OUTPUT_SIZE_MIN);
       nbytes += buffered;
       nbytes += buffered && nbytes <= 0;
     }
@@ -5861,9 +6218,17 @@ read_process_output (Lisp_Object proc, int channel)
   if (nbytes <= 0)
     {
       if (nbytes < 0 || coding->mode & CODING_MODE_LAST_BLOCK)
-	return nbytes;
+	{
+	  SAFE_FREE ();
+	  return nbytes;
+	}
       coding->mode |= CODING_MODE_LAST_BLOCK;
     }
+  else
+    {
+      p->output_bytes += nbytes;
+      p->output_reads++;
+    }
 
   /* Now set NBYTES how many bytes we must decode.  */
   nbytes += carryover;
@@ -5879,6 +6244,7 @@ read_process_output (Lisp_Object proc, int channel)
   /* Handling the process output should not deactivate the mark.  */
   Vdeactivate_mark = odeactivate;
 
+  SAFE_FREE ();
   unbind_to (count, Qnil);
   return nbytes;
 }
@@ -5960,13 +6326,16 @@ read_and_dispose_of_process_output (struct Lisp_Process *p, char *chars,
       p->decoding_carryover = coding->carryover_bytes;
     }
   if (SBYTES (text) > 0)
-    /* FIXME: It's wrong to wrap or not based on debug-on-error, and
-       sometimes it's simply wrong to wrap (e.g. when called from
-       accept-process-output).  */
-    internal_condition_case_1 (read_process_output_call,
-			       list3 (outstream, make_lisp_proc (p), text),
-			       !NILP (Vdebug_on_error) ? Qnil : Qerror,
-			       read_process_output_error_handler);
+    {
+      p->output_filter_calls++;
+      /* FIXME: It's wrong to wrap or not based on debug-on-error, and
+	 sometimes it's simply wrong to wrap (e.g. when called from
+	 accept-process-output).  */
+      internal_condition_case_1 (read_process_output_call,
+				 list3 (outstream, make_lisp_proc (p), text),
+				 !NILP (Vdebug_on_error) ? Qnil : Qerror,
+				 read_process_output_error_handler);
+    }
 
   /* If we saved the match data nonrecursively, restore it now.  */
   restore_search_regs ();
@@ -6097,11 +6466,17 @@ Otherwise it discards the output.  */)
    handled by the write_queue element of struct process.  It is a list
    with each entry having the form
 
-   (string . (offset . length))
+   (string offset length . callback)
 
    where STRING is a lisp string, OFFSET is the offset into the
-   string's byte sequence from which we should begin to send, and
-   LENGTH is the number of bytes left to send.  */
+   string's byte sequence from which we should begin to send, LENGTH
+   is the number of bytes left to send, and CALLBACK is nil or a
+   function to call with the process once they have been sent.
+
+   send_process_nowait leaves in the queue what the process cannot
+   take at once, and has the output descriptor waited for like any
+   other by wait_reading_process_output, which calls
+   process_write_ready to send more of it whenever it can.  */
 
 /* Create a new entry in write_queue.
    INPUT_OBJ should be a buffer, string Qt, or Qnil.
@@ -6110,7 +6485,8 @@ Otherwise it discards the output.  */)
 
 static void
 write_queue_push (struct Lisp_Process *p, Lisp_Object input_obj,
-                  const char *buf, ptrdiff_t len, bool front)
+                  const char *buf, ptrdiff_t len, bool front,
+		  Lisp_Object callback)
 {
   ptrdiff_t offset;
   Lisp_Object entry, obj;
@@ -6126,7 +6502,9 @@ write_queue_push (struct Lisp_Process *p, Lisp_Object input_obj,
       obj = make_unibyte_string (buf, len);
     }
 
-  entry = Fcons (obj, Fcons (make_number (offset), make_number (len)));
+  entry = Fcons (obj, Fcons (make_number (offset),
+			     Fcons (make_number (len), callback)));
+  p->write_queue_bytes += len;
 
   if (front)
     pset_write_queue (p, Fcons (entry, p->write_queue));
@@ -6135,12 +6513,12 @@ write_queue_push (struct Lisp_Process *p, Lisp_Object input_obj,
 }
 
 /* Remove the first element in the write_queue of process P, put its
-   contents in OBJ, BUF and LEN, and return true.  If the
+   contents in OBJ, BUF, LEN and CALLBACK, and return true.  If the
    write_queue is empty, return false.  */
 
 static bool
 write_queue_pop (struct Lisp_Process *p, Lisp_Object *obj,
-		 const char **buf, ptrdiff_t *len)
+		 const char **buf, ptrdiff_t *len, Lisp_Object *callback)
 {
   Lisp_Object entry, offset_length;
   ptrdiff_t offset;
@@ -6154,29 +6532,78 @@ write_queue_pop (struct Lisp_Process *p, Lisp_Object *obj,
   *obj = XCAR (entry);
   offset_length = XCDR (entry);
 
-  *len = XINT (XCDR (offset_length));
   offset = XINT (XCAR (offset_length));
+  *len = XINT (XCAR (XCDR (offset_length)));
+  *callback = XCDR (XCDR (offset_length));
   *buf = SSDATA (*obj) + offset;
+  p->write_queue_bytes -= *len;
 
   return 1;
 }
 
-/* Send some data to process PROC.
-   BUF is the beginning of the data; LEN is the number of characters.
-   OBJECT is the Lisp object that the data comes from.  If OBJECT is
-   nil or t, it means that the data comes from C string.
+static Lisp_Object
+write_callback_error_handler (Lisp_Object error_val)
+{
+  cmd_error_internal (error_val, "error in process write callback: ");
+  Vinhibit_quit = Qt;
+  update_echo_area ();
+  Fsleep_for (make_number (2), Qnil);
+  return Qt;
+}
 
-   If OBJECT is not nil, the data is encoded by PROC's coding-system
-   for encoding before it is sent.
+/* Call CALLBACK, unless it is nil, with PROC as argument, now that
+   the data it came with has been sent.  */
 
-   This function can evaluate Lisp code and can garbage collect.  */
+static void
+run_write_callback (Lisp_Object proc, Lisp_Object callback)
+{
+  ptrdiff_t count = SPECPDL_INDEX ();
+
+  if (NILP (callback))
+    return;
+
+  record_unwind_current_buffer ();
+  record_unwind_save_match_data ();
+  specbind (Qinhibit_quit, Qt);
+  internal_condition_case_1 (read_process_output_call,
+			     list2 (callback, proc),
+			     !NILP (Vdebug_on_error) ? Qnil : Qerror,
+			     write_callback_error_handler);
+  unbind_to (count, Qnil);
+}
+
+/* Stop waiting for the output descriptor of P to be writable.  */
 
 static void
-send_process (Lisp_Object proc, const char *buf, ptrdiff_t len,
-	      Lisp_Object object)
+stop_waiting_to_write (struct Lisp_Process *p)
+{
+  int fd = p->outfd;
+
+  if (!p->write_fd_registered)
+    return;
+
+  p->write_fd_registered = false;
+  delete_write_fd (fd);
+  /* A pty or socket is also read from; don't call
+     process_write_ready when it is readable.  */
+  fd_callback_info[fd].func = 0;
+  fd_callback_info[fd].data = 0;
+}
+
+static void send_process (Lisp_Object, const char *, ptrdiff_t, Lisp_Object);
+static void process_write_ready (int, void *);
+
+/* Check that data can be sent to process PROC.  Then, if the LEN
+   bytes at *BUF, which come from *OBJECT as explained for
+   send_process, need encoding, encode them by PROC's coding system
+   for encoding, and update *BUF, *LEN and *OBJECT to describe the
+   result.  */
+
+static void
+encode_process_input (Lisp_Object proc, const char **buf, ptrdiff_t *len,
+		      Lisp_Object *object)
 {
   struct Lisp_Process *p = XPROCESS (proc);
-  ssize_t rv;
   struct coding_system *coding;
 
   if (NETCONN_P (proc))
@@ -6195,10 +6622,10 @@ send_process (Lisp_Object proc, const char *buf, ptrdiff_t len,
   coding = proc_encode_coding_system[p->outfd];
   Vlast_coding_system_used = CODING_ID_NAME (coding->id);
 
-  if ((STRINGP (object) && STRING_MULTIBYTE (object))
-      || (BUFFERP (object)
-	  && !NILP (BVAR (XBUFFER (object), enable_multibyte_characters)))
-      || EQ (object, Qt))
+  if ((STRINGP (*object) && STRING_MULTIBYTE (*object))
+      || (BUFFERP (*object)
+	  && !NILP (BVAR (XBUFFER (*object), enable_multibyte_characters)))
+      || EQ (*object, Qt))
     {
       pset_encode_coding_system
 	(p, complement_process_encoding_system (p->encode_coding_system));
@@ -6243,53 +6670,130 @@ send_process (Lisp_Object proc, const char *buf, ptrdiff_t len,
   if (CODING_REQUIRE_ENCODING (coding))
     {
       coding->dst_object = Qt;
-      if (BUFFERP (object))
+      if (BUFFERP (*object))
 	{
 	  ptrdiff_t from_byte, from, to;
 	  ptrdiff_t save_pt, save_pt_byte;
 	  struct buffer *cur = current_buffer;
 
-	  set_buffer_internal (XBUFFER (object));
+	  set_buffer_internal (XBUFFER (*object));
 	  save_pt = PT, save_pt_byte = PT_BYTE;
 
-	  from_byte = PTR_BYTE_POS ((unsigned char *) buf);
+	  from_byte = PTR_BYTE_POS ((unsigned char *) *buf);
 	  from = BYTE_TO_CHAR (from_byte);
-	  to = BYTE_TO_CHAR (from_byte + len);
+	  to = BYTE_TO_CHAR (from_byte + *len);
 	  TEMP_SET_PT_BOTH (from, from_byte);
-	  encode_coding_object (coding, object, from, from_byte,
-				to, from_byte + len, Qt);
+	  encode_coding_object (coding, *object, from, from_byte,
+				to, from_byte + *len, Qt);
 	  TEMP_SET_PT_BOTH (save_pt, save_pt_byte);
 	  set_buffer_internal (cur);
 	}
-      else if (STRINGP (object))
+      else if (STRINGP (*object))
 	{
-	  encode_coding_object (coding, object, 0, 0, SCHARS (object),
-				SBYTES (object), Qt);
+	  encode_coding_object (coding, *object, 0, 0, SCHARS (*object),
+				SBYTES (*object), Qt);
 	}
       else
 	{
-	  coding->dst_object = make_unibyte_string (buf, len);
-	  coding->produced = len;
+	  coding->dst_object = make_unibyte_string (*buf, *len);
+	  coding->produced = *len;
 	}
 
-      len = coding->produced;
-      object = coding->dst_object;
-      buf = SSDATA (object);
+      *len = coding->produced;
+      *object = coding->dst_object;
+      *buf = SSDATA (*object);
+    }
+}
+
+/* Write as much as possible of the LEN bytes at BUF to the process P,
+   without waiting.  Return the number of bytes written, or -1 with
+   errno set if none could be.  */
+
+static ptrdiff_t
+process_write (struct Lisp_Process *p, const char *buf, ptrdiff_t len)
+{
+  ptrdiff_t written;
+  int outfd = p->outfd;
+
+#ifdef DATAGRAM_SOCKETS
+  if (DATAGRAM_CHAN_P (outfd))
+    return sendto (outfd, buf, len, 0, datagram_address[outfd].sa,
+		   datagram_address[outfd].len);
+#endif
+
+#ifdef HAVE_GNUTLS
+  if (p->gnutls_p && p->gnutls_state)
+    written = emacs_gnutls_write (p, buf, len);
+  else
+#endif
+    written = emacs_write_sig (outfd, buf, len);
+  if (p->read_output_delay > 0
+      && p->adaptive_read_buffering == 1)
+    {
+      p->read_output_delay = 0;
+      process_output_delay_count--;
+      p->read_output_skip = 0;
+    }
+  return written ? written : -1;
+}
+
+/* Signal an error for a write to process PROC that failed with
+   errno.  */
+
+static _Noreturn void
+process_write_error (Lisp_Object proc)
+{
+  struct Lisp_Process *p = XPROCESS (proc);
+
+#ifdef DATAGRAM_SOCKETS
+  if (DATAGRAM_CHAN_P (p->outfd) && errno == EMSGSIZE)
+    report_file_error ("Sending datagram", proc);
+#endif
+  if (errno == EPIPE)
+    {
+      p->raw_status_new = 0;
+      pset_status (p, list2 (Qexit, make_number (256)));
+      p->tick = ++process_tick;
+      deactivate_process (proc);
+      error ("process %s no longer connected to pipe; closed it",
+	     SDATA (p->name));
     }
+  /* This is a real error.  */
+  report_file_error ("Writing to process", proc);
+}
+
+/* Send some data to process PROC.
+   BUF is the beginning of the data; LEN is the number of characters.
+   OBJECT is the Lisp object that the data comes from.  If OBJECT is
+   nil or t, it means that the data comes from C string.
+
+   If OBJECT is not nil, the data is encoded by PROC's coding-system
+   for encoding before it is sent.
+
+   This function can evaluate Lisp code and can garbage collect.  */
+
+static void
+send_process (Lisp_Object proc, const char *buf, ptrdiff_t len,
+	      Lisp_Object object)
+{
+  struct Lisp_Process *p = XPROCESS (proc);
+
+  encode_process_input (proc, &buf, &len, &object);
 
   /* If there is already data in the write_queue, put the new data
      in the back of queue.  Otherwise, ignore it.  */
   if (!NILP (p->write_queue))
-    write_queue_push (p, object, buf, len, 0);
+    write_queue_push (p, object, buf, len, 0, Qnil);
 
   do   /* while !NILP (p->write_queue) */
     {
       ptrdiff_t cur_len = -1;
       const char *cur_buf;
-      Lisp_Object cur_object;
+      Lisp_Object cur_object, cur_callback = Qnil;
 
       /* If write_queue is empty, ignore it.  */
-      if (!write_queue_pop (p, &cur_object, &cur_buf, &cur_len))
+      if (!write_queue_pop (p, &cur_object, &cur_buf, &cur_len,
+			    &cur_callback))
 	{
 	  cur_len = len;
 	  cur_buf = buf;
@@ -6299,99 +6803,157 @@ send_process (Lisp_Object proc, const char *buf, ptrdiff_t len,
       while (cur_len > 0)
 	{
 	  /* Send this batch, using one or more write calls.  */
-	  ptrdiff_t written = 0;
-	  int outfd = p->outfd;
-#ifdef DATAGRAM_SOCKETS
-	  if (DATAGRAM_CHAN_P (outfd))
-	    {
-	      rv = sendto (outfd, cur_buf, cur_len,
-			   0, datagram_address[outfd].sa,
-			   datagram_address[outfd].len);
-	      if (rv >= 0)
-		written = rv;
-	      else if (errno == EMSGSIZE)
-		report_file_error ("Sending datagram", proc);
-	    }
-	  else
-#endif
-	    {
-#ifdef HAVE_GNUTLS
-	      if (p->gnutls_p && p->gnutls_state)
-		written = emacs_gnutls_write (p, cur_buf, cur_len);
-	      else
-#endif
-		written = emacs_write_sig (outfd, cur_buf, cur_len);
-	      rv = (written ? 0 : -1);
-	      if (p->read_output_delay > 0
-		  && p->adaptive_read_buffering == 1)
-		{
-		  p->read_output_delay = 0;
-		  process_output_delay_count--;
-		  p->read_output_skip = 0;
-		}
-	    }
+	  ptrdiff_t written = process_write (p, cur_buf, cur_len);
 
-	  if (rv < 0)
+	  if (written < 0)
 	    {
-	      if (would_block (errno))
-		/* Buffer is full.  Wait, accepting input;
-		   that may allow the program
-		   to finish doing output and read more.  */
-		{
-#ifdef BROKEN_PTY_READ_AFTER_EAGAIN
-		  /* A gross hack to work around a bug in FreeBSD.
-		     In the following sequence, read(2) returns
-		     bogus data:
-
-		     write(2)	 1022 bytes
-		     write(2)   954 bytes, get EAGAIN
-		     read(2)   1024 bytes in process_read_output
-		     read(2)     11 bytes in process_read_output
-
-		     That is, read(2) returns more bytes than have
-		     ever been written successfully.  The 1033 bytes
-		     read are the 1022 bytes written successfully
-		     after processing (for example with CRs added if
-		     the terminal is set up that way which it is
-		     here).  The same bytes will be seen again in a
-		     later read(2), without the CRs.  */
-
-		  if (errno == EAGAIN)
-		    {
-		      int flags = FWRITE;
-		      ioctl (p->outfd, TIOCFLUSH, &flags);
-		    }
-#endif /* BROKEN_PTY_READ_AFTER_EAGAIN */
+	      if (! would_block (errno))
+		process_write_error (proc);
 
-		  /* Put what we should have written in wait_queue.  */
-		  write_queue_push (p, cur_object, cur_buf, cur_len, 1);
-		  wait_reading_process_output (0, 20 * 1000 * 1000,
-					       0, 0, Qnil, NULL, 0);
-		  /* Reread queue, to see what is left.  */
-		  break;
-		}
-	      else if (errno == EPIPE)
+	      /* Buffer is full.  Wait, accepting input;
+		 that may allow the program
+		 to finish doing output and read more.  */
+#ifdef BROKEN_PTY_READ_AFTER_EAGAIN
+	      /* A gross hack to work around a bug in FreeBSD.
+		 In the following sequence, read(2) returns
+		 bogus data:
+
+		 write(2)	 1022 bytes
+		 write(2)   954 bytes, get EAGAIN
+		 read(2)   1024 bytes in process_read_output
+		 read(2)     11 bytes in process_read_output
+
+		 That is, read(2) returns more bytes than have
+		 ever been written successfully.  The 1033 bytes
+		 read are the 1022 bytes written successfully
+		 after processing (for example with CRs added if
+		 the terminal is set up that way which it is
+		 here).  The same bytes will be seen again in a
+		 later read(2), without the CRs.  */
+
+	      if (errno == EAGAIN)
 		{
-		  p->raw_status_new = 0;
-		  pset_status (p, list2 (Qexit, make_number (256)));
-		  p->tick = ++process_tick;
-		  deactivate_process (proc);
-		  error ("process %s no longer connected to pipe; closed it",
-			 SDATA (p->name));
+		  int flags = FWRITE;
+		  ioctl (p->outfd, TIOCFLUSH, &flags);
 		}
-	      else
-		/* This is a real error.  */
-		report_file_error ("Writing to process", proc);
+#endif /* BROKEN_PTY_READ_AFTER_EAGAIN */
+
+	      /* Put what we should have written in wait_queue.  */
+	      write_queue_push (p, cur_object, cur_buf, cur_len, 1,
+				cur_callback);
+	      wait_reading_process_output (0, 20 * 1000 * 1000,
+					   0, 0, Qnil, NULL, 0);
+	      /* Reread queue, to see what is left.  */
+	      break;
 	    }
 	  cur_buf += written;
 	  cur_len -= written;
 	}
+
+      if (cur_len == 0)
+	run_write_callback (proc, cur_callback);
     }
   while (!NILP (p->write_queue));
+
+  stop_waiting_to_write (p);
+}
+
+/* Like send_process, but don't wait for PROC to read the data.  What
+   it cannot take now is kept in its write_queue, and sent by
+   process_write_ready while Emacs waits for other things.  Call
+   CALLBACK, unless it is nil, with PROC once all of the data has been
+   sent.  Writing directly from the buffer or string the data comes
+   from, this copies only the part that has to wait.  */
+
+static void
+send_process_nowait (Lisp_Object proc, const char *buf, ptrdiff_t len,
+		     Lisp_Object object, Lisp_Object callback)
+{
+  struct Lisp_Process *p = XPROCESS (proc);
+
+  encode_process_input (proc, &buf, &len, &object);
+
+  if (NILP (p->write_queue))
+    while (len > 0)
+      {
+	ptrdiff_t written = process_write (p, buf, len);
+
+	if (written < 0)
+	  {
+	    if (! would_block (errno))
+	      process_write_error (proc);
+	    break;
+	  }
+	buf += written;
+	len -= written;
+      }
+
+  if (len == 0 && NILP (p->write_queue))
+    run_write_callback (proc, callback);
+  else
+    {
+      write_queue_push (p, object, buf, len, 0, callback);
+      if (!p->write_fd_registered)
+	{
+	  add_write_fd (p->outfd, process_write_ready, p);
+	  p->write_fd_registered = true;
+	}
+    }
+}
+
+/* Send more of what is queued for the process whose struct is DATA,
+   now that its output descriptor FD can be written.  */
+
+static void
+process_write_ready (int fd, void *data)
+{
+  struct Lisp_Process *p = data;
+  Lisp_Object proc;
+
+  XSETPROCESS (proc, p);
+
+  while (p->outfd == fd && !NILP (p->write_queue))
+    {
+      Lisp_Object obj, callback;
+      const char *buf;
+      ptrdiff_t len, written;
+
+      write_queue_pop (p, &obj, &buf, &len, &callback);
+      for (; len > 0; buf += written, len -= written)
+	{
+	  written = process_write (p, buf, len);
+	  if (written < 0)
+	    break;
+	}
+
+      if (len > 0)
+	{
+	  if (would_block (errno))
+	    {
+	      write_queue_push (p, obj, buf, len, 1, callback);
+	      return;
+	    }
+
+	  /* Nobody is there to be told about the error; treat the
+	     process like one whose pipe broke, and drop the rest.  */
+	  pset_write_queue (p, Qnil);
+	  p->write_queue_bytes = 0;
+	  p->raw_status_new = 0;
+	  pset_status (p, list2 (Qexit, make_number (256)));
+	  p->tick = ++process_tick;
+	  deactivate_process (proc);
+	  return;
+	}
+
+      run_write_callback (proc, callback);
+    }
+
+  if (NILP (p->write_queue))
+    stop_waiting_to_write (p);
 }
 
 DEFUN ("process-send-region", Fprocess_send_region, Sprocess_send_region,
-       3, 3, 0,
+       3, 4, 0,
        doc: /* Send current contents of region as input to PROCESS.
 PROCESS may be a process, a buffer, the name of a process or buffer, or
 nil, indicating the current buffer's process.
@@ -6400,9 +6962,16 @@ If the region is more than 500 characters long,
 it is sent in several bunches.  This may happen even for shorter regions.
 Output from processes can arrive in between bunches.
 
+If optional argument NOWAIT is non-nil, don't wait for PROCESS to read
+the text: send what it can take now, and the rest while Emacs waits
+for other things, such as keyboard input or output from processes.
+If NOWAIT is a function, call it with PROCESS as argument once all of
+the text has been sent, which can be before this function returns.
+
 If PROCESS is a non-blocking network process that hasn't been fully
 set up yet, this function will block until socket setup has completed.  */)
-  (Lisp_Object process, Lisp_Object start, Lisp_Object end)
+  (Lisp_Object process, Lisp_Object start, Lisp_Object end,
+   Lisp_Object nowait)
 {
   Lisp_Object proc = get_process (process);
   ptrdiff_t start_byte, end_byte;
@@ -6418,14 +6987,19 @@ set up yet, this function will block until socket setup has completed.  */)
   if (NETCONN_P (proc))
     wait_while_connecting (proc);
 
-  send_process (proc, (char *) BYTE_POS_ADDR (start_byte),
-		end_byte - start_byte, Fcurrent_buffer ());
+  if (NILP (nowait))
+    send_process (proc, (char *) BYTE_POS_ADDR (start_byte),
+		  end_byte - start_byte, Fcurrent_buffer ());
+  else
+    send_process_nowait (proc, (char *) BYTE_POS_ADDR (start_byte),
+			 end_byte - start_byte, Fcurrent_buffer (),
+			 FUNCTIONP (nowait) ? nowait : Qnil);
 
   return Qnil;
 }
 
 DEFUN ("process-send-string", Fprocess_send_string, Sprocess_send_string,
-       2, 2, 0,
+       2, 3, 0,
        doc: /* Send PROCESS the contents of STRING as input.
 PROCESS may be a process, a buffer, the name of a process or buffer, or
 nil, indicating the current buffer's process.
@@ -6433,17 +7007,39 @@ If STRING is more than 500 characters long,
 it is sent in several bunches.  This may happen even for shorter strings.
 Output from processes can arrive in between bunches.
 
+If optional argument NOWAIT is non-nil, don't wait for PROCESS to read
+STRING, as in `process-send-region'.
+
 If PROCESS is a non-blocking network process that hasn't been fully
 set up yet, this function will block until socket setup has completed.  */)
-  (Lisp_Object process, Lisp_Object string)
+  (Lisp_Object process, Lisp_Object string, Lisp_Object nowait)
 {
   CHECK_STRING (string);
   Lisp_Object proc = get_process (process);
-  send_process (proc, SSDATA (string),
-		SBYTES (string), string);
+  if (NILP (nowait))
+    send_process (proc, SSDATA (string), SBYTES (string), string);
+  else
+    send_process_nowait (proc, SSDATA (string), SBYTES (string), string,
+			 FUNCTIONP (nowait) ? nowait : Qnil);
   return Qnil;
 }
-
+
+DEFUN ("process-send-queue-size", Fprocess_send_queue_size,
+       Sprocess_send_queue_size, 0, 1, 0,
+       doc: /* Return the number of bytes waiting to be sent to PROCESS.
+These are bytes of text passed to `process-send-string' or
+`process-send-region' that PROCESS has not been able to read yet.
+PROCESS may be a process, a buffer, the name of a process or buffer, or
+nil, indicating the current buffer's process.
+
+A program producing a lot of input for a process can use this to wait
+while much of it is still to be sent, instead of queuing it all.  */)
+  (Lisp_Object process)
+{
+  return make_fixnum_or_float (XPROCESS (get_process (process))
+			       ->write_queue_bytes);
+}
+
 /* Return the foreground process group for the tty/pty that
    the process P uses.  */
 static pid_t
@@ -6829,6 +7425,87 @@ SIGCODE may be an integer, or a symbol whose name is a signal name.  */)
   return make_number (kill (pid, signo));
 }
 
+#ifndef WINDOWSNT
+
+DEFUN ("process--fork", Fprocess__fork, Sprocess__fork, 0, 0, 0,
+       doc: /* Make a copy of this Emacs as a child process.
+Return 0 in the copy, and in this Emacs a process object for the copy,
+which has no input or output, but like other processes has a status
+and a sentinel, and can be waited for with `accept-process-output'.
+This works only in batch mode, when there are no live subprocesses
+other than copies and no other threads.  The copy starts with
+everything this Emacs has loaded, except for the other copies, and
+should exit by calling `kill-emacs'.  */)
+  (void)
+{
+  Lisp_Object tail, proc;
+  struct Lisp_Process *p;
+  sigset_t oldset;
+  pid_t pid;
+
+  if (!noninteractive)
+    error ("Emacs can be forked only in batch mode");
+  if (other_threads_p ())
+    error ("Emacs cannot be forked while other threads are running");
+  FOR_EACH_PROCESS (tail, proc)
+    {
+      p = XPROCESS (proc);
+      if (0 <= p->infd || 0 <= p->outfd)
+	error ("Emacs cannot be forked while it has live subprocesses");
+    }
+
+  /* Do not let the copy write out what this Emacs has buffered.  */
+  fflush (stdout);
+  fflush (stderr);
+
+  /* Keep the SIGCHLD handler from missing the copy, if it exits before
+     its process is made.  */
+  block_child_signal (&oldset);
+  pid = fork ();
+  if (pid < 0)
+    {
+      int fork_errno = errno;
+      unblock_child_signal (&oldset);
+      report_file_errno ("Forking Emacs", Qnil, fork_errno);
+    }
+
+  if (pid == 0)
+    {
+      /* The other copies are not children of this one, so the SIGCHLD
+	 handler must not wait for them.  */
+      FOR_EACH_PROCESS (tail, proc)
+	if (XPROCESS (proc)->alive)
+	  remove_process (proc);
+      unblock_child_signal (&oldset);
+
+#ifdef USE_EPOLL
+      /* The copy shares the epoll instance of this Emacs; let it make
+	 one of its own when it first waits.  */
+      if (0 <= epoll_fd)
+	emacs_close (epoll_fd);
+      epoll_fd = -1;
+      FD_ZERO (&epoll_read_fds);
+      FD_ZERO (&epoll_write_fds);
+      FD_ZERO (&epoll_unpollable_fds);
+#endif
+
+      /* Nor does it have the threads that help the GC mark.  */
+      forget_mark_helpers ();
+
+      return make_number (0);
+    }
+
+  proc = make_process (build_string ("emacs"));
+  p = XPROCESS (proc);
+  pset_childp (p, Qt);
+  p->pid = pid;
+  p->alive = 1;
+  unblock_child_signal (&oldset);
+  return proc;
+}
+
+#endif /* not WINDOWSNT */
+
 DEFUN ("process-send-eof", Fprocess_send_eof, Sprocess_send_eof, 0, 1, 0,
        doc: /* Make PROCESS see end-of-file in its input.
 EOF comes after any text already sent to it.
@@ -6864,6 +7541,10 @@ process has been transmitted to the serial port.  */)
   if (! EQ (XPROCESS (proc)->status, Qrun))
     error ("Process %s not running", SDATA (XPROCESS (proc)->name));
 
+  /* Send what is still queued first.  */
+  if (!NILP (XPROCESS (proc)->write_queue))
+    send_process (proc, "", 0, Qnil);
+
   if (coding && CODING_REQUIRE_FLUSHING (coding))
     {
       coding->mode |= CODING_MODE_LAST_BLOCK;
@@ -7666,6 +8347,7 @@ add_keyboard_wait_descriptor (int desc)
   fd_callback_info[desc].flags |= (FOR_READ | KEYBOARD_FD);
   if (desc > max_desc)
     max_desc = desc;
+  epoll_note_change (desc);
 #endif
 }
 
@@ -7678,6 +8360,7 @@ delete_keyboard_wait_descriptor (int desc)
   eassert (desc >= 0 && desc < FD_SETSIZE);
 
   fd_callback_info[desc].flags &= ~(FOR_READ | KEYBOARD_FD | PROCESS_FD);
+  epoll_note_change (desc);
 
   if (desc == max_desc)
     recompute_max_desc ();
@@ -8070,6 +8753,10 @@ syms_of_process (void)
   DEFSYM (QCcommand, ":command");
   DEFSYM (QCconnection_type, ":connection-type");
   DEFSYM (QCstderr, ":stderr");
+  DEFSYM (QCread_size, ":read-size");
+  DEFSYM (QCbytes, ":bytes");
+  DEFSYM (QCreads, ":reads");
+  DEFSYM (QCfilter_calls, ":filter-calls");
   DEFSYM (Qpty, "pty");
   DEFSYM (Qpipe, "pipe");
 
@@ -8148,6 +8835,15 @@ non-nil value means that the delay is not reset on write.
 The variable takes effect when `start-process' is called.  */);
   Vprocess_adaptive_read_buffering = Qt;
 
+  DEFVAR_INT ("read-process-output-max", read_process_output_max,
+	      doc: /* Maximum number of bytes to read from a subprocess at a time.
+Emacs first reads 4096 bytes at a time from a subprocess, and reads
+twice as many each time the output fills what it read, up to this
+limit, so that a subprocess producing much output has it decoded and
+passed to its filter in large chunks.  It reads less again when the
+output slows down.  See `process-output-statistics'.  */);
+  read_process_output_max = 4 * 1024 * 1024;
+
   defsubr (&Sprocessp);
   defsubr (&Sget_process);
   defsubr (&Sdelete_process);
@@ -8173,6 +8869,7 @@ The variable takes effect when `start-process' is called.  */);
   defsubr (&Sprocess_contact);
   defsubr (&Sprocess_plist);
   defsubr (&Sset_process_plist);
+  defsubr (&Sprocess_output_statistics);
   defsubr (&Sprocess_list);
   defsubr (&Smake_process);
   defsubr (&Smake_pipe_process);
@@ -8190,6 +8887,7 @@ The variable takes effect when `start-process' is called.  */);
   defsubr (&Saccept_process_output);
   defsubr (&Sprocess_send_region);
   defsubr (&Sprocess_send_string);
+  defsubr (&Sprocess_send_queue_size);
   defsubr (&Sinterrupt_process);
   defsubr (&Skill_process);
   defsubr (&Squit_process);
@@ -8198,6 +8896,9 @@ The variable takes effect when `start-process' is called.  */);
   defsubr (&Sprocess_running_child_p);
   defsubr (&Sprocess_send_eof);
   defsubr (&Ssignal_process);
+#ifndef WINDOWSNT
+  defsubr (&Sprocess__fork);
+#endif
   defsubr (&Swaiting_for_user_input_p);
   defsubr (&Sprocess_type);
   defsubr (&Sinternal_default_process_sentinel);
@@ -147,6 +147,16 @@ struct Lisp_Process
        time.  Value is nanoseconds to delay reading output from
        this process.  Range is 0 .. 50 * 1000 * 1000.  */
     int read_output_delay;
+    /* Number of bytes to read from this process at a time.  This
+       grows while the output keeps filling what is read, up to
+       `read-process-output-max', and shrinks again when it does not.
+       Zero means the minimum.  */
+    ptrdiff_t read_output_size;
+    /* Number of bytes of output read from this process, of times
+       output was read, and of calls to its filter.  */
+    intmax_t output_bytes, output_reads, output_filter_calls;
+    /* Number of bytes in `write_queue' that are still to be sent.  */
+    ptrdiff_t write_queue_bytes;
     /* Should we delay reading output from this process.
        Initialized from `Vprocess_adaptive_read_buffering'.
        0 = nil, 1 = t, 2 = other.  */
@@ -173,6 +183,9 @@ struct Lisp_Process
     bool_bf is_non_blocking_client : 1;
     /* Whether this is a server or a client socket. */
     bool_bf is_server : 1;
+    /* Whether `outfd' is being waited for to send the data in
+       `write_queue' without blocking.  */
+    bool_bf write_fd_registered : 1;
     int raw_status;
     /* The length of the socket backlog. */
     int backlog;
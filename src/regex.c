@@ -527,6 +527,13 @@ static regoff_t re_match_2_internal (struct re_pattern_buffer *bufp,
 				     ssize_t pos,
 				     struct re_registers *regs,
 				     ssize_t stop);
+#ifdef emacs
+static void dfa_compile (struct re_pattern_buffer *bufp);
+static int dfa_search (struct re_pattern_buffer *bufp,
+		       re_char *string1, ssize_t size1,
+		       re_char *string2, ssize_t size2,
+		       ssize_t start, ssize_t limit, ssize_t stop);
+#endif
 
 /* These are the command codes that appear in compiled regular
    expressions.  Some opcodes are followed by argument bytes.  A
@@ -2500,6 +2507,9 @@ regex_compile (const_re_char *pattern, size_t size,
   bufp->fastmap_accurate = 0;
   bufp->not_bol = bufp->not_eol = 0;
   bufp->used_syntax = 0;
+#ifdef emacs
+  re_free_dfa (bufp);
+#endif
 
   /* Set `used' to zero, so that if we return an error, the pattern
      printer (for debugging) will think there's no pattern.  We reset it
@@ -3624,6 +3634,10 @@ regex_compile (const_re_char *pattern, size_t size,
   /* We have succeeded; set the length of the buffer.  */
   bufp->used = b - bufp->buffer;
 
+#ifdef emacs
+  dfa_compile (bufp);
+#endif
+
 #ifdef DEBUG
   if (debug > 0)
     {
@@ -4262,6 +4276,15 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, size_t size1,
   /* See whether the pattern is anchored.  */
   anchored_start = (bufp->buffer[0] == begline);
 
+#ifdef emacs
+  /* In a forward search, first check in one pass that a match starts
+     somewhere in the range.  */
+  if (bufp->dfa && range > 0
+      && dfa_search (bufp, string1, size1, string2, size2,
+		     startpos, startpos + range, stop) == 0)
+    return -1;
+#endif
+
 #ifdef emacs
   gl_state.object = re_match_object; /* Used by SYNTAX_TABLE_BYTE_TO_CHAR. */
   {
@@ -4390,6 +4413,14 @@ re_search_2 (struct re_pattern_buffer *bufp, const char *str1, size_t size1,
 	  && !bufp->can_be_null)
 	return -1;
 
+#ifdef emacs
+      /* Don't backtrack where the DFA knows that nothing matches.  */
+      if (bufp->dfa
+	  && dfa_search (bufp, string1, size1, string2, size2,
+			 startpos, startpos, stop) == 0)
+	goto advance;
+#endif
+
       val = re_match_2_internal (bufp, string1, size1, string2, size2,
 				 startpos, regs, stop);
 
@@ -4868,6 +4899,666 @@ mutually_exclusive_p (struct re_pattern_buffer *bufp, const_re_char *p1,
   return 0;
 }
 
+
+#ifdef emacs
+
+/* A lazily built DFA, used by `re_search_2' to rule out the places
+   where no match can start without backtracking.
+
+   The compiled pattern is read as an NFA whose states, called threads
+   here, are the operations that consume a character.  A DFA state is
+   the set of threads alive at some point in the text, and its
+   transitions are only computed when the search first needs them.
+   Those on ASCII characters are remembered in the state; the others
+   are recomputed each time.  The DFA only tells whether there is a
+   match, so the backtracking matcher still has to find it and fill
+   in the registers.  Back references, counted repetitions and the
+   operations that look at the syntax table, the categories or point
+   are not supported; patterns using them don't get a DFA.  */
+
+/* A thread: the offset of an operation in the compiled pattern, times
+   256, plus the number of bytes of an `exactn' already matched.  */
+typedef unsigned int dfa_thread;
+#define DFA_THREAD(offset, count) (((dfa_thread) (offset) << 8) + (count))
+#define DFA_THREAD_OFFSET(thread) ((thread) >> 8)
+#define DFA_THREAD_COUNT(thread) ((thread) & 0xff)
+
+/* Compiled patterns this long or longer don't get a DFA.  */
+#define DFA_MAX_PATTERN (UINT_MAX >> 8)
+
+/* If a DFA needs more states than this, give up on it.  */
+#define DFA_MAX_STATES 256
+
+/* Number of hash chains of the states of a DFA.  */
+#define DFA_BUCKETS 64
+
+/* Flags of a DFA state, describing where in the text it is.  */
+enum
+  {
+    /* At the beginning of the text.  */
+    DFA_AT_BEG = 1,
+    /* Just after a newline.  */
+    DFA_AFTER_NEWLINE = 2,
+    /* A match may still start here, see `dfa_search'.  */
+    DFA_INJECT = 4
+  };
+
+/* Conditions that the anchors test, see `dfa_context'.  */
+enum
+  {
+    DFA_BOL = 1,
+    DFA_EOL = 2,
+    DFA_BOB = 4,
+    DFA_EOB = 8
+  };
+
+struct dfa_state
+{
+  struct dfa_state *hash_next;
+  size_t hash;
+
+  /* The state reached on each ASCII character, or NULL if not known
+     yet.  */
+  struct dfa_state *next[128];
+
+  /* Whether a match ends here, when the next character is not a
+     newline (index 0) or is one (index 1).  */
+  bool accept[2];
+
+  unsigned char flags;
+
+  /* The threads, sorted.  */
+  ptrdiff_t nthreads;
+  dfa_thread threads[FLEXIBLE_ARRAY_MEMBER];
+};
+
+struct re_dfa
+{
+  struct dfa_state *buckets[DFA_BUCKETS];
+  int nstates;
+
+  /* True if there were too many states.  */
+  bool disabled;
+
+  /* Whether the states were built for a multibyte target.  */
+  bool target_multibyte;
+
+  /* Work areas for `dfa_closure' and `dfa_step', with room for one
+     element per byte of the compiled pattern, plus one.  */
+  dfa_thread *closure, *kernel;
+  unsigned int *stack;
+
+  /* MARK[OFFSET] is GENERATION if the operation at OFFSET has been
+     seen by the current `dfa_closure'.  */
+  unsigned int *mark;
+  unsigned int generation;
+};
+
+/* Return true if the compiled pattern in BUFP only uses operations
+   that the DFA supports.  */
+static bool
+dfa_supported_p (struct re_pattern_buffer *bufp)
+{
+  re_char *p = bufp->buffer;
+  re_char *pend = p + bufp->used;
+
+  if (bufp->used >= DFA_MAX_PATTERN)
+    return false;
+
+  while (p < pend)
+    switch (*p)
+      {
+      case exactn:
+      case anychar:
+      case charset:
+      case charset_not:
+	p = skip_one_char (p);
+	break;
+
+      case no_op:
+      case succeed:
+      case begline:
+      case endline:
+      case begbuf:
+      case endbuf:
+	p += 1;
+	break;
+
+      case start_memory:
+      case stop_memory:
+	p += 2;
+	break;
+
+      case jump:
+      case on_failure_jump:
+      case on_failure_keep_string_jump:
+      case on_failure_jump_loop:
+      case on_failure_jump_nastyloop:
+      case on_failure_jump_smart:
+	p += 3;
+	break;
+
+      default:
+	return false;
+      }
+  return true;
+}
+
+/* Set up the DFA of the pattern just compiled in BUFP, if it can have
+   one.  */
+static void
+dfa_compile (struct re_pattern_buffer *bufp)
+{
+  struct re_dfa *dfa;
+  size_t n = bufp->used + 1;
+
+  if (!dfa_supported_p (bufp))
+    return;
+
+  dfa = xzalloc (sizeof *dfa);
+  dfa->closure = xnmalloc (n, sizeof *dfa->closure);
+  dfa->kernel = xnmalloc (n, sizeof *dfa->kernel);
+  dfa->stack = xnmalloc (n, sizeof *dfa->stack);
+  dfa->mark = xzalloc (n * sizeof *dfa->mark);
+  bufp->dfa = dfa;
+}
+
+/* Forget all the states of DFA.  */
+static void
+dfa_flush (struct re_dfa *dfa)
+{
+  int i;
+
+  for (i = 0; i < DFA_BUCKETS; i++)
+    while (dfa->buckets[i])
+      {
+	struct dfa_state *s = dfa->buckets[i];
+	dfa->buckets[i] = s->hash_next;
+	xfree (s);
+      }
+  dfa->nstates = 0;
+}
+
+void
+re_free_dfa (struct re_pattern_buffer *bufp)
+{
+  struct re_dfa *dfa = bufp->dfa;
+
+  if (dfa)
+    {
+      dfa_flush (dfa);
+      xfree (dfa->closure);
+      xfree (dfa->kernel);
+      xfree (dfa->stack);
+      xfree (dfa->mark);
+      xfree (dfa);
+      bufp->dfa = NULL;
+    }
+}
+
+/* Return the conditions that hold for the anchors at a place of the
+   text described by the state flags FLAGS, given whether it is
+   followed by a newline or the end of the text (EOL) and whether it
+   is the end of the text (EOB).  */
+static int
+dfa_context (struct re_pattern_buffer *bufp, int flags, bool eol, bool eob)
+{
+  bool bol = (flags & DFA_AT_BEG
+	      ? !bufp->not_bol
+	      : (flags & DFA_AFTER_NEWLINE) != 0);
+
+  return ((bol ? DFA_BOL : 0)
+	  | (eol ? DFA_EOL : 0)
+	  | (flags & DFA_AT_BEG ? DFA_BOB : 0)
+	  | (eob ? DFA_EOB : 0));
+}
+
+/* Store in BUFP->dfa->closure the threads reachable without consuming
+   any character from the N threads at THREADS, and from the start of
+   the pattern as well if START, when the anchors see CONTEXT.  Store
+   their number in *NCLOSURE.  Return true if the end of the pattern
+   is reachable too, that is, if a match ends here.  */
+static bool
+dfa_closure (struct re_pattern_buffer *bufp, const dfa_thread *threads,
+	     ptrdiff_t n, bool start, int context, ptrdiff_t *nclosure)
+{
+  struct re_dfa *dfa = bufp->dfa;
+  re_char *buffer = bufp->buffer;
+  size_t used = bufp->used;
+  ptrdiff_t i, sp = 0, nout = 0;
+  bool accept = false;
+
+  if (++dfa->generation == 0)
+    {
+      memset (dfa->mark, 0, (used + 1) * sizeof *dfa->mark);
+      dfa->generation = 1;
+    }
+
+#define DFA_PUSH(offset)						\
+  do {									\
+    size_t offset_ = (offset);						\
+    if (dfa->mark[offset_] != dfa->generation)				\
+      {									\
+	dfa->mark[offset_] = dfa->generation;				\
+	dfa->stack[sp++] = offset_;					\
+      }									\
+  } while (0)
+
+  if (start)
+    DFA_PUSH (0);
+  for (i = 0; i < n; i++)
+    if (DFA_THREAD_COUNT (threads[i]))
+      /* In the middle of an `exactn': nothing to expand.  */
+      dfa->closure[nout++] = threads[i];
+    else
+      DFA_PUSH (DFA_THREAD_OFFSET (threads[i]));
+
+  while (sp > 0)
+    {
+      size_t offset = dfa->stack[--sp];
+      re_char *p = buffer + offset;
+      int mcnt;
+
+      if (offset == used)
+	{
+	  accept = true;
+	  continue;
+	}
+
+      switch (*p)
+	{
+	case succeed:
+	  accept = true;
+	  break;
+
+	case exactn:
+	case anychar:
+	case charset:
+	case charset_not:
+	  dfa->closure[nout++] = DFA_THREAD (offset, 0);
+	  break;
+
+	case no_op:
+	  DFA_PUSH (offset + 1);
+	  break;
+
+	case start_memory:
+	case stop_memory:
+	  DFA_PUSH (offset + 2);
+	  break;
+
+	case begline:
+	  if (context & DFA_BOL)
+	    DFA_PUSH (offset + 1);
+	  break;
+
+	case endline:
+	  if (context & DFA_EOL)
+	    DFA_PUSH (offset + 1);
+	  break;
+
+	case begbuf:
+	  if (context & DFA_BOB)
+	    DFA_PUSH (offset + 1);
+	  break;
+
+	case endbuf:
+	  if (context & DFA_EOB)
+	    DFA_PUSH (offset + 1);
+	  break;
+
+	case jump:
+	  {
+	    re_char *dest;
+	    int mcnt2;
+
+	    EXTRACT_NUMBER (mcnt, p + 1);
+	    dest = p + 3 + mcnt;
+	    DFA_PUSH (dest - buffer);
+
+	    /* Once `re_match_2_internal' has turned the
+	       `on_failure_jump_smart' of a simple loop into an
+	       `on_failure_keep_string_jump', the jump at the end of
+	       the loop goes back past it, and leaving the loop relies
+	       on the failure point pushed before the first iteration
+	       keeping the string position.  Make the exit explicit.  */
+	    if (mcnt < 0 && dest - 3 >= buffer
+		&& (re_opcode_t) dest[-3] == on_failure_keep_string_jump)
+	      {
+		EXTRACT_NUMBER (mcnt2, dest - 2);
+		if (dest + mcnt2 == p + 3)
+		  DFA_PUSH (offset + 3);
+	      }
+	  }
+	  break;
+
+	case on_failure_jump:
+	case on_failure_keep_string_jump:
+	case on_failure_jump_loop:
+	case on_failure_jump_nastyloop:
+	case on_failure_jump_smart:
+	  EXTRACT_NUMBER (mcnt, p + 1);
+	  DFA_PUSH (offset + 3);
+	  DFA_PUSH (offset + 3 + mcnt);
+	  break;
+
+	default:
+	  /* Excluded by `dfa_supported_p'.  */
+	  eassume (false);
+	}
+    }
+
+#undef DFA_PUSH
+
+  *nclosure = nout;
+  return accept;
+}
+
+/* If THREAD matches the character at D, store the following thread
+   in *NEXT and return true.  This mirrors `re_match_2_internal'.  */
+static bool
+dfa_match_char (struct re_pattern_buffer *bufp, dfa_thread thread,
+		re_char *d, dfa_thread *next)
+{
+  re_char *p = bufp->buffer + DFA_THREAD_OFFSET (thread);
+  RE_TRANSLATE_TYPE translate = bufp->translate;
+  const boolean multibyte = RE_MULTIBYTE_P (bufp);
+  const boolean target_multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+
+  switch (*p)
+    {
+    case exactn:
+      {
+	int n = p[1], count = DFA_THREAD_COUNT (thread);
+	re_char *q = p + 2 + count;
+	int pat_charlen, pat_ch, buf_ch;
+
+	if (target_multibyte)
+	  {
+	    if (multibyte)
+	      pat_ch = STRING_CHAR_AND_LENGTH (q, pat_charlen);
+	    else
+	      {
+		pat_ch = RE_CHAR_TO_MULTIBYTE (*q);
+		pat_charlen = 1;
+	      }
+	    buf_ch = STRING_CHAR (d);
+	    if (TRANSLATE (buf_ch) != pat_ch)
+	      return false;
+	  }
+	else
+	  {
+	    if (multibyte)
+	      {
+		pat_ch = STRING_CHAR_AND_LENGTH (q, pat_charlen);
+		pat_ch = RE_CHAR_TO_UNIBYTE (pat_ch);
+	      }
+	    else
+	      {
+		pat_ch = *q;
+		pat_charlen = 1;
+	      }
+	    buf_ch = RE_CHAR_TO_MULTIBYTE (*d);
+	    if (! CHAR_BYTE8_P (buf_ch))
+	      {
+		buf_ch = TRANSLATE (buf_ch);
+		buf_ch = RE_CHAR_TO_UNIBYTE (buf_ch);
+		if (buf_ch < 0)
+		  buf_ch = *d;
+	      }
+	    else
+	      buf_ch = *d;
+	    if (buf_ch != pat_ch)
+	      return false;
+	  }
+
+	count += pat_charlen;
+	*next = (count < n
+		 ? thread + pat_charlen
+		 : DFA_THREAD (q + pat_charlen - bufp->buffer, 0));
+	return true;
+      }
+
+    case anychar:
+      {
+	re_wchar_t buf_ch = RE_STRING_CHAR (d, target_multibyte);
+
+	buf_ch = TRANSLATE (buf_ch);
+	if ((!(RE_SYNTAX_EMACS & RE_DOT_NEWLINE) && buf_ch == '\n')
+	    || ((RE_SYNTAX_EMACS & RE_DOT_NOT_NULL) && buf_ch == '\000'))
+	  return false;
+	*next = DFA_THREAD (p + 1 - bufp->buffer, 0);
+	return true;
+      }
+
+    case charset:
+    case charset_not:
+      {
+	unsigned int c, corig;
+	int len;
+	boolean unibyte_char = false;
+
+	corig = c = RE_STRING_CHAR_AND_LENGTH (d, len, target_multibyte);
+	if (target_multibyte)
+	  {
+	    int c1;
+
+	    c = TRANSLATE (c);
+	    c1 = RE_CHAR_TO_UNIBYTE (c);
+	    if (c1 >= 0)
+	      {
+		unibyte_char = true;
+		c = c1;
+	      }
+	  }
+	else
+	  {
+	    int c1 = RE_CHAR_TO_MULTIBYTE (c);
+
+	    if (! CHAR_BYTE8_P (c1))
+	      {
+		c1 = TRANSLATE (c1);
+		c1 = RE_CHAR_TO_UNIBYTE (c1);
+		if (c1 >= 0)
+		  {
+		    unibyte_char = true;
+		    c = c1;
+		  }
+	      }
+	    else
+	      unibyte_char = true;
+	  }
+
+	if (!execute_charset (&p, c, corig, unibyte_char))
+	  return false;
+	*next = DFA_THREAD (p - bufp->buffer, 0);
+	return true;
+      }
+
+    default:
+      eassume (false);
+    }
+}
+
+static int
+dfa_thread_compare (const void *a, const void *b)
+{
+  dfa_thread x = *(const dfa_thread *) a, y = *(const dfa_thread *) b;
+  return (x > y) - (x < y);
+}
+
+/* Return the state of BUFP's DFA with the N threads at THREADS, which
+   this sorts, and the flags FLAGS.  Create it if necessary.  Return
+   NULL if that would make too many states; the DFA is then disabled
+   and all its states are freed.  */
+static struct dfa_state *
+dfa_intern (struct re_pattern_buffer *bufp, dfa_thread *threads,
+	    ptrdiff_t n, int flags)
+{
+  struct re_dfa *dfa = bufp->dfa;
+  struct dfa_state *s, **bucket;
+  size_t hash = flags;
+  ptrdiff_t i, j, nclosure;
+  int eol;
+
+  if (n > 1)
+    {
+      qsort (threads, n, sizeof *threads, dfa_thread_compare);
+      for (i = j = 1; i < n; i++)
+	if (threads[i] != threads[j - 1])
+	  threads[j++] = threads[i];
+      n = j;
+    }
+
+  for (i = 0; i < n; i++)
+    hash = hash * 31 + threads[i];
+
+  bucket = &dfa->buckets[hash % DFA_BUCKETS];
+  for (s = *bucket; s; s = s->hash_next)
+    if (s->hash == hash && s->flags == flags && s->nthreads == n
+	&& !memcmp (s->threads, threads, n * sizeof *threads))
+      return s;
+
+  if (dfa->nstates == DFA_MAX_STATES)
+    {
+      dfa_flush (dfa);
+      dfa->disabled = true;
+      return NULL;
+    }
+
+  s = xmalloc (offsetof (struct dfa_state, threads) + n * sizeof *threads);
+  memset (s->next, 0, sizeof s->next);
+  s->hash = hash;
+  s->flags = flags;
+  s->nthreads = n;
+  memcpy (s->threads, threads, n * sizeof *threads);
+  for (eol = 0; eol < 2; eol++)
+    s->accept[eol] = dfa_closure (bufp, s->threads, n, flags & DFA_INJECT,
+				  dfa_context (bufp, flags, eol, false),
+				  &nclosure);
+  s->hash_next = *bucket;
+  *bucket = s;
+  dfa->nstates++;
+  return s;
+}
+
+/* Return the state that BUFP's DFA reaches from S over the character
+   at D, which is not at the end of the text.  Return NULL if there
+   are too many states.  */
+static struct dfa_state *
+dfa_step (struct re_pattern_buffer *bufp, struct dfa_state *s, re_char *d)
+{
+  struct re_dfa *dfa = bufp->dfa;
+  bool newline = *d == '\n';
+  ptrdiff_t i, n = 0, nclosure;
+
+  dfa_closure (bufp, s->threads, s->nthreads, s->flags & DFA_INJECT,
+	       dfa_context (bufp, s->flags, newline, false), &nclosure);
+  for (i = 0; i < nclosure; i++)
+    if (dfa_match_char (bufp, dfa->closure[i], d, &dfa->kernel[n]))
+      n++;
+  return dfa_intern (bufp, dfa->kernel, n,
+		     ((s->flags & DFA_INJECT)
+		      | (newline ? DFA_AFTER_NEWLINE : 0)));
+}
+
+/* Use the DFA of BUFP to find out whether a match can start anywhere
+   from START to LIMIT, both character boundaries, and end before
+   STOP, in the virtual concatenation of STRING1 and STRING2.  Return
+   1 if so, 0 if not, and -1 if the DFA can't tell.  */
+static int
+dfa_search (struct re_pattern_buffer *bufp, re_char *string1, ssize_t size1,
+	    re_char *string2, ssize_t size2, ssize_t start, ssize_t limit,
+	    ssize_t stop)
+{
+  struct re_dfa *dfa = bufp->dfa;
+  const boolean target_multibyte = RE_TARGET_MULTIBYTE_P (bufp);
+  ssize_t total_size = size1 + size2;
+  ssize_t pos = start;
+  dfa_thread start_thread = DFA_THREAD (0, 0);
+  struct dfa_state *s;
+  int flags;
+  unsigned int count = 0;
+
+  if (dfa->disabled || limit > stop || stop > total_size)
+    return -1;
+
+  if (dfa->target_multibyte != target_multibyte)
+    {
+      dfa_flush (dfa);
+      dfa->target_multibyte = target_multibyte;
+    }
+
+  flags = (start == 0 ? DFA_AT_BEG
+	   : *POS_ADDR_VSTRING (start - 1) == '\n' ? DFA_AFTER_NEWLINE
+	   : 0);
+  /* When searching, a DFA_INJECT state stands for its threads plus the
+     start of the pattern, until LIMIT is passed.  */
+  s = (limit > start
+       ? dfa_intern (bufp, NULL, 0, flags | DFA_INJECT)
+       : dfa_intern (bufp, &start_thread, 1, flags));
+
+  while (s)
+    {
+      re_char *d;
+      struct dfa_state *next;
+
+      if (pos > limit && (s->flags & DFA_INJECT))
+	{
+	  s = dfa_intern (bufp, s->threads, s->nthreads,
+			  s->flags & ~DFA_INJECT);
+	  if (!s)
+	    break;
+	}
+
+      if (s->nthreads == 0 && !(s->flags & DFA_INJECT))
+	return 0;
+
+      if (pos == stop)
+	{
+	  ptrdiff_t nclosure;
+	  bool eob = stop == total_size;
+	  bool eol = eob ? true : *POS_ADDR_VSTRING (stop) == '\n';
+
+	  return dfa_closure (bufp, s->threads, s->nthreads,
+			      s->flags & DFA_INJECT,
+			      dfa_context (bufp, s->flags,
+					   eob ? !bufp->not_eol : eol, eob),
+			      &nclosure);
+	}
+
+      d = POS_ADDR_VSTRING (pos);
+      if (s->accept[*d == '\n'])
+	return 1;
+
+      if (*d < 0x80)
+	{
+	  next = s->next[*d];
+	  if (!next)
+	    {
+	      next = dfa_step (bufp, s, d);
+	      if (!next)
+		break;
+	      s->next[*d] = next;
+	    }
+	  pos++;
+	}
+      else
+	{
+	  next = dfa_step (bufp, s, d);
+	  pos += target_multibyte ? BYTES_BY_CHAR_HEAD (*d) : 1;
+	}
+      s = next;
+
+      if ((++count & 0xffff) == 0)
+	IMMEDIATE_QUIT_CHECK;
+    }
+
+  return -1;
+}
+
+#endif /* emacs */
+
 
 /* Matching routines.  */
 
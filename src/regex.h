@@ -423,6 +423,11 @@ struct re_pattern_buffer
 
   /* Charset of unibyte characters at compiling time. */
   int charset_unibyte;
+
+  /* The lazily built DFA that `re_search_2' uses to skip the places
+     where no match can start, or zero if the pattern is beyond what
+     it supports.  */
+  struct re_dfa *dfa;
 #endif
 
 /* [[[end pattern_buffer]]] */
@@ -528,6 +533,13 @@ extern regoff_t re_match_2 (struct re_pattern_buffer *__buffer,
 			    ssize_t __stop);
 
 
+#ifdef emacs
+/* Free the DFA of the compiled pattern in BUFFER.  This must be called
+   before freeing BUFFER->buffer.  */
+extern void re_free_dfa (struct re_pattern_buffer *__buffer);
+#endif
+
+
 /* Set REGS to hold NUM_REGS registers, storing them in STARTS and
    ENDS.  Subsequent matches using BUFFER and REGS will use this memory
    for recording register information.  STARTS and ENDS must be
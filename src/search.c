@@ -27,19 +27,24 @@ along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
 #include "syntax.h"
 #include "charset.h"
 #include "region-cache.h"
+#include "line-index.h"
+#include "count-newlines.h"
 #include "blockinput.h"
 #include "intervals.h"
 
 #include <sys/types.h>
 #include "regex.h"
 
-#define REGEXP_CACHE_SIZE 20
-
 /* If the regexp is non-nil, then the buffer contains the compiled form
    of that regexp, suitable for searching.  */
 struct regexp_cache
 {
-  struct regexp_cache *next;
+  /* Neighbors in the list of all entries.  */
+  struct regexp_cache *next, *prev;
+  /* Next entry in the same hash chain, and the hash code of this
+     entry's pattern, translate table and POSIX flag.  */
+  struct regexp_cache *hash_next;
+  EMACS_UINT hash;
   Lisp_Object regexp, f_whitespace_regexp;
   /* Syntax table for which the regexp applies.  We need this because
      of character classes.  If this is t, then the compiled pattern is valid
@@ -51,11 +56,19 @@ struct regexp_cache
   bool posix;
 };
 
-/* The instances of that struct.  */
-static struct regexp_cache searchbufs[REGEXP_CACHE_SIZE];
+/* The head and tail of the doubly-linked list of all cache entries,
+   ordered from the most to the least recently used.  Entries whose
+   regexp is nil are unused and kept at the tail.  */
+static struct regexp_cache *searchbuf_head, *searchbuf_tail;
+
+/* Number of entries in that list.  It grows on demand up to
+   regexp_cache_size.  */
+static EMACS_INT searchbuf_count;
 
-/* The head of the linked list; points to the most recently used buffer.  */
-static struct regexp_cache *searchbuf_head;
+/* Hash table of the entries in use, with searchbuf_nbuckets chains.
+   The number of chains is zero or a power of two.  */
+static struct regexp_cache **searchbuf_buckets;
+static ptrdiff_t searchbuf_nbuckets;
 
 
 /* Every call to re_match, etc., must pass &search_regs as the regs
@@ -149,6 +162,132 @@ compile_pattern_1 (struct regexp_cache *cp, Lisp_Object pattern,
   cp->regexp = Fcopy_sequence (pattern);
 }
 
+/* Unlink CP from the list of cache entries.  */
+
+static void
+searchbuf_unlink (struct regexp_cache *cp)
+{
+  if (cp->prev)
+    cp->prev->next = cp->next;
+  else
+    searchbuf_head = cp->next;
+  if (cp->next)
+    cp->next->prev = cp->prev;
+  else
+    searchbuf_tail = cp->prev;
+}
+
+/* Link CP into the list of cache entries, at the front if FRONT,
+   otherwise at the back.  */
+
+static void
+searchbuf_link (struct regexp_cache *cp, bool front)
+{
+  if (front)
+    {
+      cp->prev = NULL;
+      cp->next = searchbuf_head;
+      if (searchbuf_head)
+	searchbuf_head->prev = cp;
+      else
+	searchbuf_tail = cp;
+      searchbuf_head = cp;
+    }
+  else
+    {
+      cp->next = NULL;
+      cp->prev = searchbuf_tail;
+      if (searchbuf_tail)
+	searchbuf_tail->next = cp;
+      else
+	searchbuf_head = cp;
+      searchbuf_tail = cp;
+    }
+}
+
+/* Remove CP from the hash table, if it is in there.  */
+
+static void
+searchbuf_unhash (struct regexp_cache *cp)
+{
+  struct regexp_cache **cpp;
+
+  if (NILP (cp->regexp))
+    return;
+  for (cpp = &searchbuf_buckets[cp->hash & (searchbuf_nbuckets - 1)];
+       *cpp != cp; cpp = &(*cpp)->hash_next)
+    eassert (*cpp);
+  *cpp = cp->hash_next;
+}
+
+/* Add CP, which must be in use, to the hash table.  */
+
+static void
+searchbuf_hash (struct regexp_cache *cp)
+{
+  struct regexp_cache **bucket;
+
+  /* Keep the chains short.  Rehash all entries in use into a larger
+     table if there are more entries than chains.  */
+  if (searchbuf_nbuckets < searchbuf_count)
+    {
+      ptrdiff_t n = max (16, searchbuf_nbuckets);
+      struct regexp_cache *p;
+
+      while (n < searchbuf_count)
+	n *= 2;
+      xfree (searchbuf_buckets);
+      searchbuf_buckets = xzalloc (n * sizeof *searchbuf_buckets);
+      searchbuf_nbuckets = n;
+      for (p = searchbuf_head; p; p = p->next)
+	if (p != cp && !NILP (p->regexp))
+	  {
+	    bucket = &searchbuf_buckets[p->hash & (n - 1)];
+	    p->hash_next = *bucket;
+	    *bucket = p;
+	  }
+    }
+
+  bucket = &searchbuf_buckets[cp->hash & (searchbuf_nbuckets - 1)];
+  cp->hash_next = *bucket;
+  *bucket = cp;
+}
+
+/* Return a new, unused cache entry.  */
+
+static struct regexp_cache *
+searchbuf_new (void)
+{
+  struct regexp_cache *cp = xzalloc (sizeof *cp);
+
+  cp->buf.allocated = 100;
+  cp->buf.buffer = xmalloc (100);
+  cp->buf.fastmap = cp->fastmap;
+  cp->buf.translate = make_number (0);
+  cp->regexp = Qnil;
+  cp->f_whitespace_regexp = Qnil;
+  cp->syntax_table = Qnil;
+  searchbuf_count++;
+  return cp;
+}
+
+/* Free the least recently used entries until there are at most MAX.  */
+
+static void
+searchbuf_trim (EMACS_INT max)
+{
+  while (searchbuf_count > max)
+    {
+      struct regexp_cache *cp = searchbuf_tail;
+      searchbuf_unhash (cp);
+      searchbuf_unlink (cp);
+      re_free_dfa (&cp->buf);
+      xfree (cp->buf.buffer);
+      xfree (cp);
+      searchbuf_count--;
+    }
+}
+
 /* Shrink each compiled regexp buffer in the cache
    to the size actually used right now.
    This is called from garbage collection.  */
@@ -165,6 +304,23 @@ shrink_regexp_cache (void)
     }
 }
 
+/* Mark the Lisp objects referenced by the regexp cache.
+   This is called from garbage collection.  */
+
+void
+mark_regexp_cache (void)
+{
+  struct regexp_cache *cp;
+
+  for (cp = searchbuf_head; cp != 0; cp = cp->next)
+    {
+      mark_object (cp->regexp);
+      mark_object (cp->f_whitespace_regexp);
+      mark_object (cp->syntax_table);
+      mark_object (cp->buf.translate);
+    }
+}
+
 /* Clear the regexp cache w.r.t. a particular syntax table,
    because it was changed.
    There is no danger of memory leak here because re_compile_pattern
@@ -173,14 +329,22 @@ shrink_regexp_cache (void)
 void
 clear_regexp_cache (void)
 {
-  int i;
-
-  for (i = 0; i < REGEXP_CACHE_SIZE; ++i)
-    /* It's tempting to compare with the syntax-table we've actually changed,
-       but it's not sufficient because char-table inheritance means that
-       modifying one syntax-table can change others at the same time.  */
-    if (!EQ (searchbufs[i].syntax_table, Qt))
-      searchbufs[i].regexp = Qnil;
+  struct regexp_cache *cp, *next;
+
+  for (cp = searchbuf_head; cp != 0; cp = next)
+    {
+      next = cp->next;
+      /* It's tempting to compare with the syntax-table we've actually changed,
+	 but it's not sufficient because char-table inheritance means that
+	 modifying one syntax-table can change others at the same time.  */
+      if (!NILP (cp->regexp) && !EQ (cp->syntax_table, Qt))
+	{
+	  searchbuf_unhash (cp);
+	  cp->regexp = Qnil;
+	  searchbuf_unlink (cp);
+	  searchbuf_link (cp, false);
+	}
+    }
 }
 
 /* Compile a regexp if necessary, but first check to see if there's one in
@@ -198,22 +362,28 @@ struct re_pattern_buffer *
 compile_pattern (Lisp_Object pattern, struct re_registers *regp,
 		 Lisp_Object translate, bool posix, bool multibyte)
 {
-  struct regexp_cache *cp, **cpp;
-
-  for (cpp = &searchbuf_head; ; cpp = &cp->next)
-    {
-      cp = *cpp;
-      /* Entries are initialized to nil, and may be set to nil by
-	 compile_pattern_1 if the pattern isn't valid.  Don't apply
-	 string accessors in those cases.  However, compile_pattern_1
-	 is only applied to the cache entry we pick here to reuse.  So
-	 nil should never appear before a non-nil entry.  */
-      if (NILP (cp->regexp))
-	goto compile_it;
-      if (SCHARS (cp->regexp) == SCHARS (pattern)
+  struct regexp_cache *cp = NULL;
+  EMACS_UINT hash;
+
+  if (NILP (translate))
+    translate = make_number (0);
+
+  /* Look the pattern up in the hash table.  The syntax table and the
+     whitespace regexp are not part of the hash code, since they only
+     matter for some patterns; entries differing only in them share a
+     chain.  */
+  hash = hash_string (SSDATA (pattern), SBYTES (pattern));
+  hash = sxhash_combine (hash, XHASH (translate));
+  hash = sxhash_combine (hash, posix);
+  if (searchbuf_nbuckets)
+    for (cp = searchbuf_buckets[hash & (searchbuf_nbuckets - 1)];
+	 cp; cp = cp->hash_next)
+      if (cp->hash == hash
+	  && SCHARS (cp->regexp) == SCHARS (pattern)
+	  && SBYTES (cp->regexp) == SBYTES (pattern)
 	  && STRING_MULTIBYTE (cp->regexp) == STRING_MULTIBYTE (pattern)
-	  && !NILP (Fstring_equal (cp->regexp, pattern))
-	  && EQ (cp->buf.translate, (! NILP (translate) ? translate : make_number (0)))
+	  && !memcmp (SDATA (cp->regexp), SDATA (pattern), SBYTES (pattern))
+	  && EQ (cp->buf.translate, translate)
 	  && cp->posix == posix
 	  && (EQ (cp->syntax_table, Qt)
 	      || EQ (cp->syntax_table, BVAR (current_buffer, syntax_table)))
@@ -221,23 +391,42 @@ compile_pattern (Lisp_Object pattern, struct re_registers *regp,
 	  && cp->buf.charset_unibyte == charset_unibyte)
 	break;
 
-      /* If we're at the end of the cache, compile into the nil cell
-	 we found, or the last (least recently used) cell with a
-	 string value.  */
-      if (cp->next == 0)
+  if (cp)
+    regexp_cache_hits++;
+  else
+    {
+      EMACS_INT size = max (1, regexp_cache_size);
+
+      regexp_cache_misses++;
+      searchbuf_trim (size);
+
+      /* Compile into an unused entry, or a new one if the cache may
+	 still grow, or else the least recently used one.  The entry
+	 stays at the tail of the list, unused, if compilation fails.  */
+      if (searchbuf_count < size
+	  && !(searchbuf_tail && NILP (searchbuf_tail->regexp)))
 	{
-	compile_it:
-	  compile_pattern_1 (cp, pattern, translate, posix);
-	  break;
+	  cp = searchbuf_new ();
+	  searchbuf_link (cp, false);
 	}
+      else
+	{
+	  cp = searchbuf_tail;
+	  searchbuf_unhash (cp);
+	}
+      compile_pattern_1 (cp, pattern, translate, posix);
+      cp->hash = hash;
+      searchbuf_hash (cp);
     }
 
-  /* When we get here, cp (aka *cpp) contains the compiled pattern,
+  /* When we get here, cp contains the compiled pattern,
      either because we found it in the cache or because we just compiled it.
      Move it to the front of the queue to mark it as most recently used.  */
-  *cpp = cp->next;
-  cp->next = searchbuf_head;
-  searchbuf_head = cp;
+  if (cp != searchbuf_head)
+    {
+      searchbuf_unlink (cp);
+      searchbuf_link (cp, true);
+    }
 
   /* Advise the searching functions about the space we have allocated
      for register data.  */
@@ -251,7 +440,7 @@ compile_pattern (Lisp_Object pattern, struct re_registers *regp,
   return &cp->buf;
 }
 
-
+
 static Lisp_Object
 looking_at_1 (Lisp_Object string, bool posix)
 {
@@ -612,6 +801,11 @@ newline_cache_on_off (struct buffer *buf)
 	      free_region_cache (base_buf->newline_cache);
 	      base_buf->newline_cache = 0;
 	    }
+	  if (base_buf->line_index)
+	    {
+	      free_line_index (base_buf->line_index);
+	      base_buf->line_index = 0;
+	    }
 	}
       return NULL;
     }
@@ -629,6 +823,10 @@ newline_cache_on_off (struct buffer *buf)
 }
 
 
+/* Bounds on the size of the chunks that find_newline counts newlines
+   in, when it is to skip many lines.  */
+enum { NEWLINE_CHUNK_MIN = 256, NEWLINE_CHUNK_MAX = 64 * 1024 };
+
 /* Search for COUNT newlines between START/START_BYTE and END/END_BYTE.
 
    If COUNT is positive, search forwards; END must be >= START.
@@ -682,6 +880,20 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
   else
     cache_buffer = current_buffer;
 
+  /* Long scans over many lines are quicker with the line index.  */
+  if (newline_cache)
+    {
+      ptrdiff_t pos, pos_byte;
+
+      if (line_index_scan (start, start_byte, end_byte, count, shortage,
+			   &pos, &pos_byte))
+	{
+	  if (bytepos)
+	    *bytepos = pos_byte;
+	  return pos;
+	}
+    }
+
   if (shortage != 0)
     *shortage = 0;
 
@@ -787,6 +999,42 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
 	  ptrdiff_t base = start_byte - lim_byte;
 	  ptrdiff_t cursor, next;
 
+	  /* When several lines are to be skipped, skip chunks that have
+	     fewer newlines than that by just counting them, instead of
+	     looking for every newline.  */
+	  if (count > 1)
+	    {
+	      ptrdiff_t chunk = NEWLINE_CHUNK_MIN;
+
+	      for (cursor = base; cursor < 0; cursor = next)
+		{
+		  ptrdiff_t n;
+
+		  /* Cache boundaries must be character boundaries.  */
+		  next = cursor + min (chunk, - cursor);
+		  while (next < 0 && !CHAR_HEAD_P (lim_addr[next]))
+		    next++;
+
+		  n = count_newlines (lim_addr + cursor, next - cursor);
+		  if (count <= n)
+		    break;
+		  count -= n;
+
+		  if (newline_cache && n == 0)
+		    {
+		      know_region_cache (cache_buffer, newline_cache,
+					 BYTE_TO_CHAR (lim_byte + cursor),
+					 BYTE_TO_CHAR (lim_byte + next));
+		      /* know_region_cache can relocate buffer text.  */
+		      lim_addr = BYTE_POS_ADDR (ceiling_byte) + 1;
+		    }
+
+		  /* Start small in case the newline is near.  */
+		  chunk = min (2 * chunk, NEWLINE_CHUNK_MAX);
+		}
+	      base = cursor;
+	    }
+
 	  for (cursor = base; cursor < 0; cursor = next)
 	    {
               /* The dumb loop.  */
@@ -897,6 +1145,38 @@ find_newline (ptrdiff_t start, ptrdiff_t start_byte, ptrdiff_t end,
 	  ptrdiff_t base = start_byte - ceiling_byte;
 	  ptrdiff_t cursor, prev;
 
+	  /* Skip chunks with too few newlines, as above.  */
+	  if (count < -1)
+	    {
+	      ptrdiff_t chunk = NEWLINE_CHUNK_MIN;
+
+	      for (cursor = base; 0 < cursor; cursor = prev)
+		{
+		  ptrdiff_t n;
+
+		  prev = cursor - min (chunk, cursor);
+		  while (prev > 0 && !CHAR_HEAD_P (ceiling_addr[prev]))
+		    prev--;
+
+		  n = count_newlines (ceiling_addr + prev, cursor - prev);
+		  if (-count <= n)
+		    break;
+		  count += n;
+
+		  if (newline_cache && n == 0)
+		    {
+		      know_region_cache (cache_buffer, newline_cache,
+					 BYTE_TO_CHAR (ceiling_byte + prev),
+					 BYTE_TO_CHAR (ceiling_byte + cursor));
+		      /* know_region_cache can relocate buffer text.  */
+		      ceiling_addr = BYTE_POS_ADDR (ceiling_byte);
+		    }
+
+		  chunk = min (2 * chunk, NEWLINE_CHUNK_MAX);
+		}
+	      base = cursor;
+	    }
+
 	  for (cursor = base; 0 < cursor; cursor = prev)
             {
 	      unsigned char *nl = memrchr (ceiling_addr, '\n', cursor);
@@ -3393,23 +3673,6 @@ the buffer.  If the buffer doesn't have a cache, the value is nil.  */)
 void
 syms_of_search (void)
 {
-  register int i;
-
-  for (i = 0; i < REGEXP_CACHE_SIZE; ++i)
-    {
-      searchbufs[i].buf.allocated = 100;
-      searchbufs[i].buf.buffer = xmalloc (100);
-      searchbufs[i].buf.fastmap = searchbufs[i].fastmap;
-      searchbufs[i].regexp = Qnil;
-      searchbufs[i].f_whitespace_regexp = Qnil;
-      searchbufs[i].syntax_table = Qnil;
-      staticpro (&searchbufs[i].regexp);
-      staticpro (&searchbufs[i].f_whitespace_regexp);
-      staticpro (&searchbufs[i].syntax_table);
-      searchbufs[i].next = (i == REGEXP_CACHE_SIZE-1 ? 0 : &searchbufs[i+1]);
-    }
-  searchbuf_head = &searchbufs[0];
-
   /* Error condition used for failing searches.  */
   DEFSYM (Qsearch_failed, "search-failed");
 
@@ -3449,6 +3712,25 @@ do not set the match data.  The proper way to use this variable
 is to bind it with `let' around a small expression.  */);
   Vinhibit_changing_match_data = Qnil;
 
+  DEFVAR_INT ("regexp-cache-size", regexp_cache_size,
+	      doc: /* Maximum number of compiled regexps to keep for reuse.
+Searching and matching functions compile their regexp argument, and
+keep the compiled form around in case the same regexp is used again.
+Increase this if the code you run uses many different regexps in
+turn, as Font Lock does with the keywords of some major modes.
+See also `regexp-cache-hits' and `regexp-cache-misses'.  */);
+  regexp_cache_size = 100;
+
+  DEFVAR_INT ("regexp-cache-hits", regexp_cache_hits,
+	      doc: /* Number of times a compiled regexp was found in the cache.
+See `regexp-cache-size'.  */);
+  regexp_cache_hits = 0;
+
+  DEFVAR_INT ("regexp-cache-misses", regexp_cache_misses,
+	      doc: /* Number of times a regexp had to be compiled.
+See `regexp-cache-size'.  */);
+  regexp_cache_misses = 0;
+
   defsubr (&Slooking_at);
   defsubr (&Sposix_looking_at);
   defsubr (&Sstring_match);
@@ -0,0 +1,753 @@
+/* Stable sorting of Lisp objects.
+
+Copyright (C) 2017 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* This is TimSort, as described by Tim Peters in listsort.txt in the
+   Python sources, and as implemented there in listobject.c.
+
+   The sequence is split into runs, stretches that are already sorted
+   or in strictly descending order, the latter being reversed in
+   place.  Runs shorter than a minimum length computed from the length
+   of the sequence are extended with a binary insertion sort.  Runs
+   are pushed on a stack and merged with their neighbors so that the
+   lengths of the runs on the stack grow at least as fast as the
+   Fibonacci numbers, which keeps the merges balanced.  When a merge
+   finds that one run keeps winning, it switches to galloping: it
+   finds how many elements of that run come next by exponential and
+   then binary search, and copies them all at once.
+
+   Sorting text that is already sorted, or nearly so, as completion
+   candidates often are, thus calls the predicate about once per
+   element instead of N log N times.
+
+   The elements are sorted by their keys, in an array of Lisp
+   objects.  If there is a separate array of values, the values are
+   moved along with the keys.  */
+
+#include <config.h>
+
+#include "lisp.h"
+
+/* The maximum number of runs on the stack.  The invariant on the
+   lengths of the runs makes this enough for any array that fits in
+   memory.  */
+enum { MAX_MERGE_PENDING = 85 };
+
+/* The number of times a run must win in a row before a merge starts
+   galloping.  */
+enum { MIN_GALLOP = 7 };
+
+/* Some keys, and the values that go with them if there are any.  */
+struct sort_slice
+{
+  Lisp_Object *keys;
+  Lisp_Object *values;
+};
+
+/* A run, sorted already.  */
+struct sort_run
+{
+  struct sort_slice base;
+  ptrdiff_t len;
+};
+
+struct merge_state
+{
+  /* Return true if A sorts before B.  */
+  bool (*lessp) (struct merge_state *, Lisp_Object, Lisp_Object);
+
+  /* The Lisp predicate, if it has to be called.  */
+  Lisp_Object predicate;
+
+  /* The current number of wins in a row after which a merge starts
+     galloping.  It goes down while galloping pays off.  */
+  ptrdiff_t min_gallop;
+
+  /* Room for the shorter run of a merge, which is no longer than half
+     the elements.  */
+  struct sort_slice temp;
+
+  /* The stack of runs waiting to be merged.  */
+  int n;
+  struct sort_run pending[MAX_MERGE_PENDING];
+};
+
+/* The functions that compare keys.  The ones that stand for a
+   built-in predicate behave exactly like it, but do not go through
+   funcall.  */
+
+static bool
+sort_lessp_call (struct merge_state *ms, Lisp_Object a, Lisp_Object b)
+{
+  return !NILP (call2 (ms->predicate, a, b));
+}
+
+static bool
+sort_lessp_fixnum (struct merge_state *ms, Lisp_Object a, Lisp_Object b)
+{
+  return XINT (a) < XINT (b);
+}
+
+static bool
+sort_lessp_number (struct merge_state *ms, Lisp_Object a, Lisp_Object b)
+{
+  if (INTEGERP (a) && INTEGERP (b))
+    return XINT (a) < XINT (b);
+  return !NILP (arithcompare (a, b, ARITH_LESS));
+}
+
+static bool
+sort_greaterp_number (struct merge_state *ms, Lisp_Object a, Lisp_Object b)
+{
+  if (INTEGERP (a) && INTEGERP (b))
+    return XINT (a) > XINT (b);
+  return !NILP (arithcompare (a, b, ARITH_GRTR));
+}
+
+static bool
+sort_lessp_string (struct merge_state *ms, Lisp_Object a, Lisp_Object b)
+{
+  return !NILP (Fstring_lessp (a, b));
+}
+
+/* Set the function with which MS compares the N KEYS to sort, so
+   that it compares them the way the predicate of MS does.  */
+
+static void
+set_sort_lessp (struct merge_state *ms, Lisp_Object *keys, ptrdiff_t n)
+{
+  Lisp_Object fun = ms->predicate;
+
+  ms->lessp = sort_lessp_call;
+
+  if (SYMBOLP (fun) && !NILP (fun))
+    fun = indirect_function (fun);
+  if (SUBRP (fun))
+    {
+      struct Lisp_Subr *subr = XSUBR (fun);
+
+      if (subr->function.aMANY == Flss)
+	{
+	  ptrdiff_t i;
+	  for (i = 0; i < n && INTEGERP (keys[i]); i++)
+	    continue;
+	  ms->lessp = i == n ? sort_lessp_fixnum : sort_lessp_number;
+	}
+      else if (subr->function.aMANY == Fgtr)
+	ms->lessp = sort_greaterp_number;
+      else if (subr->function.a2 == Fstring_lessp)
+	ms->lessp = sort_lessp_string;
+    }
+}
+
+/* Move the key and value at index FROM of SRC to index TO of DEST.  */
+
+static void
+sort_slice_copy (struct sort_slice dest, ptrdiff_t to,
+		 struct sort_slice src, ptrdiff_t from)
+{
+  dest.keys[to] = src.keys[from];
+  if (dest.values)
+    dest.values[to] = src.values[from];
+}
+
+/* Move N keys and values from SRC to DEST, which may overlap.  */
+
+static void
+sort_slice_move (struct sort_slice dest, struct sort_slice src, ptrdiff_t n)
+{
+  memmove (dest.keys, src.keys, n * sizeof *dest.keys);
+  if (dest.values)
+    memmove (dest.values, src.values, n * sizeof *dest.values);
+}
+
+/* Return the part of S starting at index I.  */
+
+static struct sort_slice
+sort_slice_at (struct sort_slice s, ptrdiff_t i)
+{
+  s.keys += i;
+  if (s.values)
+    s.values += i;
+  return s;
+}
+
+/* Reverse the order of the N elements of S.  */
+
+static void
+sort_slice_reverse (struct sort_slice s, ptrdiff_t n)
+{
+  for (ptrdiff_t i = 0, j = n - 1; i < j; i++, j--)
+    {
+      Lisp_Object tem = s.keys[i];
+      s.keys[i] = s.keys[j];
+      s.keys[j] = tem;
+      if (s.values)
+	{
+	  tem = s.values[i];
+	  s.values[i] = s.values[j];
+	  s.values[j] = tem;
+	}
+    }
+}
+
+/* Sort the N elements of S, the first START of which are sorted
+   already, by inserting each of the others where a binary search
+   says it goes.  */
+
+static void
+binary_sort (struct merge_state *ms, struct sort_slice s, ptrdiff_t n,
+	     ptrdiff_t start)
+{
+  for (; start < n; start++)
+    {
+      Lisp_Object pivot = s.keys[start];
+      ptrdiff_t l = 0, r = start;
+
+      while (l < r)
+	{
+	  ptrdiff_t p = l + ((r - l) >> 1);
+	  if (ms->lessp (ms, pivot, s.keys[p]))
+	    r = p;
+	  else
+	    l = p + 1;
+	}
+
+      memmove (s.keys + l + 1, s.keys + l, (start - l) * sizeof *s.keys);
+      s.keys[l] = pivot;
+      if (s.values)
+	{
+	  Lisp_Object value = s.values[start];
+	  memmove (s.values + l + 1, s.values + l,
+		   (start - l) * sizeof *s.values);
+	  s.values[l] = value;
+	}
+    }
+}
+
+/* Return the length of the run at the start of the N elements of S,
+   which is at least 1, and reverse it if it is descending.  Only
+   strictly descending runs are reversed, so that the sort is
+   stable.  */
+
+static ptrdiff_t
+count_run (struct merge_state *ms, struct sort_slice s, ptrdiff_t n)
+{
+  ptrdiff_t i;
+
+  if (n == 1)
+    return 1;
+  if (ms->lessp (ms, s.keys[1], s.keys[0]))
+    {
+      for (i = 2; i < n && ms->lessp (ms, s.keys[i], s.keys[i - 1]); i++)
+	continue;
+      sort_slice_reverse (s, i);
+    }
+  else
+    for (i = 2; i < n && !ms->lessp (ms, s.keys[i], s.keys[i - 1]); i++)
+      continue;
+  return i;
+}
+
+/* Return where KEY goes among the N sorted keys at A: the index K
+   such that A[K - 1] < KEY <= A[K].  Start looking at index HINT, and
+   go away from it in exponentially growing steps before searching
+   the last step with a binary search, so that this is faster than a
+   binary search when KEY goes close to HINT.  */
+
+static ptrdiff_t
+gallop_left (struct merge_state *ms, Lisp_Object key, Lisp_Object *a,
+	     ptrdiff_t n, ptrdiff_t hint)
+{
+  ptrdiff_t ofs = 1, lastofs = 0, maxofs;
+
+  eassume (0 <= hint && hint < n);
+  if (ms->lessp (ms, a[hint], key))
+    {
+      /* Look to the right, until a[hint + lastofs] < key
+	 <= a[hint + ofs].  */
+      maxofs = n - hint;
+      while (ofs < maxofs && ms->lessp (ms, a[hint + ofs], key))
+	{
+	  lastofs = ofs;
+	  ofs = (ofs << 1) + 1;
+	}
+      ofs = min (ofs, maxofs);
+      lastofs += hint;
+      ofs += hint;
+    }
+  else
+    {
+      /* Look to the left, until a[hint - ofs] < key
+	 <= a[hint - lastofs].  */
+      ptrdiff_t tem;
+      maxofs = hint + 1;
+      while (ofs < maxofs && !ms->lessp (ms, a[hint - ofs], key))
+	{
+	  lastofs = ofs;
+	  ofs = (ofs << 1) + 1;
+	}
+      ofs = min (ofs, maxofs);
+      tem = lastofs;
+      lastofs = hint - ofs;
+      ofs = hint - tem;
+    }
+
+  /* Now a[lastofs] < key <= a[ofs], where a[-1] is minus infinity
+     and a[n] plus infinity.  */
+  lastofs++;
+  while (lastofs < ofs)
+    {
+      ptrdiff_t m = lastofs + ((ofs - lastofs) >> 1);
+      if (ms->lessp (ms, a[m], key))
+	lastofs = m + 1;
+      else
+	ofs = m;
+    }
+  return ofs;
+}
+
+/* Like gallop_left, but return the index K such that A[K - 1] <= KEY
+   < A[K], so that KEY would go after the keys equal to it.  */
+
+static ptrdiff_t
+gallop_right (struct merge_state *ms, Lisp_Object key, Lisp_Object *a,
+	      ptrdiff_t n, ptrdiff_t hint)
+{
+  ptrdiff_t ofs = 1, lastofs = 0, maxofs;
+
+  eassume (0 <= hint && hint < n);
+  if (ms->lessp (ms, key, a[hint]))
+    {
+      /* Look to the left, until a[hint - ofs] <= key
+	 < a[hint - lastofs].  */
+      ptrdiff_t tem;
+      maxofs = hint + 1;
+      while (ofs < maxofs && ms->lessp (ms, key, a[hint - ofs]))
+	{
+	  lastofs = ofs;
+	  ofs = (ofs << 1) + 1;
+	}
+      ofs = min (ofs, maxofs);
+      tem = lastofs;
+      lastofs = hint - ofs;
+      ofs = hint - tem;
+    }
+  else
+    {
+      /* Look to the right, until a[hint + lastofs] <= key
+	 < a[hint + ofs].  */
+      maxofs = n - hint;
+      while (ofs < maxofs && !ms->lessp (ms, key, a[hint + ofs]))
+	{
+	  lastofs = ofs;
+	  ofs = (ofs << 1) + 1;
+	}
+      ofs = min (ofs, maxofs);
+      lastofs += hint;
+      ofs += hint;
+    }
+
+  /* Now a[lastofs] <= key < a[ofs].  */
+  lastofs++;
+  while (lastofs < ofs)
+    {
+      ptrdiff_t m = lastofs + ((ofs - lastofs) >> 1);
+      if (ms->lessp (ms, key, a[m]))
+	ofs = m;
+      else
+	lastofs = m + 1;
+    }
+  return ofs;
+}
+
+/* Merge the NA elements of SSA with the NB elements of SSB that
+   follow them, where 0 < NA <= NB, the first element of SSB goes
+   before the first one of SSA, and the last one of SSA after the last
+   one of SSB.  Copy SSA out of the way and merge from the left.  */
+
+static void
+merge_lo (struct merge_state *ms, struct sort_slice ssa, ptrdiff_t na,
+	  struct sort_slice ssb, ptrdiff_t nb)
+{
+  struct sort_slice dest = ssa;
+  ptrdiff_t min_gallop = ms->min_gallop;
+
+  eassume (0 < na && 0 < nb && ssa.keys + na == ssb.keys);
+  sort_slice_move (ms->temp, ssa, na);
+  ssa = ms->temp;
+
+  sort_slice_copy (dest, 0, ssb, 0);
+  dest = sort_slice_at (dest, 1);
+  ssb = sort_slice_at (ssb, 1);
+  if (--nb == 0)
+    goto succeed;
+  if (na == 1)
+    goto copy_b;
+
+  while (true)
+    {
+      ptrdiff_t acount = 0, bcount = 0, k;
+
+      /* Compare one element at a time until a run seems to win
+	 consistently.  */
+      while (true)
+	{
+	  if (ms->lessp (ms, ssb.keys[0], ssa.keys[0]))
+	    {
+	      sort_slice_copy (dest, 0, ssb, 0);
+	      dest = sort_slice_at (dest, 1);
+	      ssb = sort_slice_at (ssb, 1);
+	      bcount++;
+	      acount = 0;
+	      if (--nb == 0)
+		goto succeed;
+	      if (bcount >= min_gallop)
+		break;
+	    }
+	  else
+	    {
+	      sort_slice_copy (dest, 0, ssa, 0);
+	      dest = sort_slice_at (dest, 1);
+	      ssa = sort_slice_at (ssa, 1);
+	      acount++;
+	      bcount = 0;
+	      if (--na == 1)
+		goto copy_b;
+	      if (acount >= min_gallop)
+		break;
+	    }
+	}
+
+      /* Gallop, until it stops paying off.  */
+      min_gallop++;
+      do
+	{
+	  min_gallop -= min_gallop > 1;
+	  ms->min_gallop = min_gallop;
+
+	  k = gallop_right (ms, ssb.keys[0], ssa.keys, na, 0);
+	  acount = k;
+	  if (k)
+	    {
+	      sort_slice_move (dest, ssa, k);
+	      dest = sort_slice_at (dest, k);
+	      ssa = sort_slice_at (ssa, k);
+	      na -= k;
+	      if (na == 1)
+		goto copy_b;
+	      /* NA can be 0 only if the predicate is inconsistent.  */
+	      if (na == 0)
+		goto succeed;
+	    }
+	  sort_slice_copy (dest, 0, ssb, 0);
+	  dest = sort_slice_at (dest, 1);
+	  ssb = sort_slice_at (ssb, 1);
+	  if (--nb == 0)
+	    goto succeed;
+
+	  k = gallop_left (ms, ssa.keys[0], ssb.keys, nb, 0);
+	  bcount = k;
+	  if (k)
+	    {
+	      sort_slice_move (dest, ssb, k);
+	      dest = sort_slice_at (dest, k);
+	      ssb = sort_slice_at (ssb, k);
+	      nb -= k;
+	      if (nb == 0)
+		goto succeed;
+	    }
+	  sort_slice_copy (dest, 0, ssa, 0);
+	  dest = sort_slice_at (dest, 1);
+	  ssa = sort_slice_at (ssa, 1);
+	  if (--na == 1)
+	    goto copy_b;
+	}
+      while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+      min_gallop++;
+      ms->min_gallop = min_gallop;
+    }
+
+ succeed:
+  if (na)
+    sort_slice_move (dest, ssa, na);
+  return;
+
+ copy_b:
+  /* The last element of SSA goes after all that is left of SSB.  */
+  sort_slice_move (dest, ssb, nb);
+  sort_slice_copy (dest, nb, ssa, 0);
+}
+
+/* Like merge_lo, but for 0 < NB <= NA: copy SSB out of the way and
+   merge from the right.  */
+
+static void
+merge_hi (struct merge_state *ms, struct sort_slice ssa, ptrdiff_t na,
+	  struct sort_slice ssb, ptrdiff_t nb)
+{
+  struct sort_slice basea = ssa, baseb = ms->temp;
+  ptrdiff_t min_gallop = ms->min_gallop;
+  /* The indexes of the next places to fill in the merged run, and of
+     the last elements left of SSA, copied to BASEB, and SSB.  */
+  ptrdiff_t d = na + nb - 1, ia = na - 1, ib = nb - 1;
+
+  eassume (0 < na && 0 < nb && ssa.keys + na == ssb.keys);
+  sort_slice_move (baseb, ssb, nb);
+
+  sort_slice_copy (basea, d--, basea, ia--);
+  if (--na == 0)
+    goto succeed;
+  if (nb == 1)
+    goto copy_a;
+
+  while (true)
+    {
+      ptrdiff_t acount = 0, bcount = 0, k;
+
+      while (true)
+	{
+	  if (ms->lessp (ms, baseb.keys[ib], basea.keys[ia]))
+	    {
+	      sort_slice_copy (basea, d--, basea, ia--);
+	      acount++;
+	      bcount = 0;
+	      if (--na == 0)
+		goto succeed;
+	      if (acount >= min_gallop)
+		break;
+	    }
+	  else
+	    {
+	      sort_slice_copy (basea, d--, baseb, ib--);
+	      bcount++;
+	      acount = 0;
+	      if (--nb == 1)
+		goto copy_a;
+	      if (bcount >= min_gallop)
+		break;
+	    }
+	}
+
+      min_gallop++;
+      do
+	{
+	  min_gallop -= min_gallop > 1;
+	  ms->min_gallop = min_gallop;
+
+	  k = na - gallop_right (ms, baseb.keys[ib], basea.keys, na, na - 1);
+	  acount = k;
+	  if (k)
+	    {
+	      d -= k;
+	      ia -= k;
+	      sort_slice_move (sort_slice_at (basea, d + 1),
+			       sort_slice_at (basea, ia + 1), k);
+	      na -= k;
+	      if (na == 0)
+		goto succeed;
+	    }
+	  sort_slice_copy (basea, d--, baseb, ib--);
+	  if (--nb == 1)
+	    goto copy_a;
+
+	  k = nb - gallop_left (ms, basea.keys[ia], baseb.keys, nb, nb - 1);
+	  bcount = k;
+	  if (k)
+	    {
+	      d -= k;
+	      ib -= k;
+	      sort_slice_move (sort_slice_at (basea, d + 1),
+			       sort_slice_at (baseb, ib + 1), k);
+	      nb -= k;
+	      if (nb == 1)
+		goto copy_a;
+	      /* NB can be 0 only if the predicate is inconsistent.  */
+	      if (nb == 0)
+		goto succeed;
+	    }
+	  sort_slice_copy (basea, d--, basea, ia--);
+	  if (--na == 0)
+	    goto succeed;
+	}
+      while (acount >= MIN_GALLOP || bcount >= MIN_GALLOP);
+      min_gallop++;
+      ms->min_gallop = min_gallop;
+    }
+
+ succeed:
+  if (nb)
+    sort_slice_move (sort_slice_at (basea, d - nb + 1), baseb, nb);
+  return;
+
+ copy_a:
+  /* The first element of SSB goes before all that is left of SSA.  */
+  sort_slice_move (sort_slice_at (basea, d - na + 1), basea, na);
+  sort_slice_copy (basea, d - na, baseb, 0);
+}
+
+/* Merge the runs at indexes I and I + 1 of the stack of MS.  */
+
+static void
+merge_at (struct merge_state *ms, int i)
+{
+  struct sort_slice ssa = ms->pending[i].base;
+  struct sort_slice ssb = ms->pending[i + 1].base;
+  ptrdiff_t na = ms->pending[i].len;
+  ptrdiff_t nb = ms->pending[i + 1].len;
+  ptrdiff_t k;
+
+  ms->pending[i].len = na + nb;
+  if (i == ms->n - 3)
+    ms->pending[i + 1] = ms->pending[i + 2];
+  ms->n--;
+
+  /* The elements of SSA that go before the first element of SSB, and
+     those of SSB that go after the last element of SSA, are where
+     they belong already.  */
+  k = gallop_right (ms, ssb.keys[0], ssa.keys, na, 0);
+  ssa = sort_slice_at (ssa, k);
+  na -= k;
+  if (na == 0)
+    return;
+  nb = gallop_left (ms, ssa.keys[na - 1], ssb.keys, nb, nb - 1);
+  if (nb == 0)
+    return;
+
+  if (na <= nb)
+    merge_lo (ms, ssa, na, ssb, nb);
+  else
+    merge_hi (ms, ssa, na, ssb, nb);
+}
+
+/* Merge runs on the stack of MS until the lengths of the runs, from
+   the top, grow faster than the Fibonacci numbers.  */
+
+static void
+merge_collapse (struct merge_state *ms)
+{
+  struct sort_run *p = ms->pending;
+
+  while (ms->n > 1)
+    {
+      int n = ms->n - 2;
+      if ((n > 0 && p[n - 1].len <= p[n].len + p[n + 1].len)
+	  || (n > 1 && p[n - 2].len <= p[n - 1].len + p[n].len))
+	{
+	  if (p[n - 1].len < p[n + 1].len)
+	    n--;
+	  merge_at (ms, n);
+	}
+      else if (p[n].len <= p[n + 1].len)
+	merge_at (ms, n);
+      else
+	break;
+    }
+}
+
+/* Merge all the runs on the stack of MS.  */
+
+static void
+merge_force_collapse (struct merge_state *ms)
+{
+  struct sort_run *p = ms->pending;
+
+  while (ms->n > 1)
+    {
+      int n = ms->n - 2;
+      if (n > 0 && p[n - 1].len < p[n + 1].len)
+	n--;
+      merge_at (ms, n);
+    }
+}
+
+/* Return the minimum length of a run for sorting N elements: N if N
+   is less than 64, and otherwise a length between 32 and 64 such
+   that N divided by it is a power of two or a little less.  */
+
+static ptrdiff_t
+merge_compute_minrun (ptrdiff_t n)
+{
+  ptrdiff_t r = 0;
+
+  while (64 <= n)
+    {
+      r |= n & 1;
+      n >>= 1;
+    }
+  return n + r;
+}
+
+/* Sort the N objects in KEYS stably using PREDICATE, and move the
+   objects in VALUES along with them, unless VALUES is NULL.  KEYS and
+   VALUES must be visible to the garbage collector.  */
+
+void
+tim_sort (Lisp_Object predicate, Lisp_Object *keys, Lisp_Object *values,
+	  ptrdiff_t n)
+{
+  struct merge_state ms;
+  struct sort_slice lo = { keys, values };
+  ptrdiff_t minrun, half = n >> 1;
+  Lisp_Object *temp;
+  USE_SAFE_ALLOCA;
+
+  if (n < 2)
+    return;
+
+  /* Merges may leave some elements only in the temporary storage, so
+     it must be visible to the garbage collector too.  */
+  SAFE_ALLOCA_LISP (temp, values ? 2 * half : half);
+  for (ptrdiff_t i = 0; i < (values ? 2 * half : half); i++)
+    temp[i] = Qnil;
+
+  ms.predicate = predicate;
+  set_sort_lessp (&ms, keys, n);
+  ms.min_gallop = MIN_GALLOP;
+  ms.temp.keys = temp;
+  ms.temp.values = values ? temp + half : NULL;
+  ms.n = 0;
+
+  minrun = merge_compute_minrun (n);
+  do
+    {
+      ptrdiff_t len = count_run (&ms, lo, n);
+
+      /* Make short runs MINRUN long, or as long as what is left.  */
+      if (len < minrun)
+	{
+	  ptrdiff_t force = min (n, minrun);
+	  binary_sort (&ms, lo, force, len);
+	  len = force;
+	}
+
+      eassert (ms.n < MAX_MERGE_PENDING);
+      ms.pending[ms.n].base = lo;
+      ms.pending[ms.n].len = len;
+      ms.n++;
+      merge_collapse (&ms);
+
+      lo = sort_slice_at (lo, len);
+      n -= len;
+    }
+  while (n);
+
+  merge_force_collapse (&ms);
+  eassert (ms.n == 1);
+  SAFE_FREE ();
+}
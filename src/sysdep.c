@@ -356,6 +356,42 @@ init_baud_rate (int fd)
 
 #ifndef MSDOS
 
+struct waitpid_args
+{
+  pid_t child;
+  int *status;
+  int options;
+  pid_t result;
+  int err;
+};
+
+static void
+call_waitpid (void *arg)
+{
+  struct waitpid_args *wa = arg;
+  wa->result = waitpid (wa->child, wa->status, wa->options);
+  wa->err = errno;
+}
+
+/* Like waitpid, but let other threads run while waiting.  */
+static pid_t
+waitpid_without_lock (pid_t child, int *status, int options)
+{
+#ifdef WINDOWSNT
+  /* The MS-Windows emulation of waitpid calls QUIT.  */
+  return waitpid (child, status, options);
+#else
+  struct waitpid_args wa;
+
+  wa.child = child;
+  wa.status = status;
+  wa.options = options;
+  thread_call_without_lock (call_waitpid, &wa);
+  errno = wa.err;
+  return wa.result;
+#endif
+}
+
 /* Wait for the subprocess with process id CHILD to terminate or change status.
    CHILD must be a child process that has not been reaped.
    If STATUS is non-null, store the waitpid-style exit status into *STATUS
@@ -377,7 +413,10 @@ get_child_status (pid_t child, int *status, int options, bool interruptible)
      so that another thread running glib won't find them.  */
   eassert (child > 0);
 
-  while ((pid = waitpid (child, status, options)) < 0)
+  while ((pid = (options & WNOHANG
+		 ? waitpid (child, status, options)
+		 : waitpid_without_lock (child, status, options)))
+	 < 0)
     {
       /* Check that CHILD is a child process that has not been reaped,
 	 and that STATUS and OPTIONS are valid.  Otherwise abort,
@@ -1706,9 +1745,14 @@ handle_arith_signal (int sig)
 
 #if defined HAVE_STACK_OVERFLOW_HANDLING && !defined WINDOWSNT
 
-/* Alternate stack used by SIGSEGV handler below.  */
+/* Alternate stack used by SIGSEGV handler below.
 
-static unsigned char sigsegv_stack[SIGSTKSZ];
+   SIGSTKSZ is not a constant in glibc 2.34 and later, so it cannot
+   size a static array.  64 KiB is not too large for Emacs, and is large
+   enough for all known platforms.  */
+
+static max_align_t sigsegv_stack[(64 * 1024 + sizeof (max_align_t) - 1)
+				 / sizeof (max_align_t)];
 
 
 /* Return true if SIGINFO indicates a stack overflow.  */
@@ -2495,6 +2539,41 @@ emacs_read (int fildes, void *buf, ptrdiff_t nbyte)
   return (rtnval);
 }
 
+struct read_args
+{
+  int fildes;
+  void *buf;
+  ptrdiff_t nbyte;
+  ssize_t result;
+  int err;
+};
+
+static void
+call_read (void *arg)
+{
+  struct read_args *ra = arg;
+  ra->result = read (ra->fildes, ra->buf, ra->nbyte);
+  ra->err = errno;
+}
+
+/* Like emacs_read, but let other threads run while reading.  BUF must
+   not be buffer text or anything else that Lisp code could change or
+   free in the meantime.  */
+ptrdiff_t
+emacs_read_without_lock (int fildes, void *buf, ptrdiff_t nbyte)
+{
+  struct read_args ra;
+
+  ra.fildes = fildes;
+  ra.buf = buf;
+  ra.nbyte = nbyte;
+  while (thread_call_without_lock (call_read, &ra),
+	 ra.result == -1 && ra.err == EINTR)
+    QUIT;
+  errno = ra.err;
+  return ra.result;
+}
+
 /* Write to FILEDES from a buffer BUF with size NBYTE, retrying if interrupted
    or if a partial write occurs.  If interrupted, process pending
    signals if PROCESS SIGNALS.  Return the number of bytes written, setting
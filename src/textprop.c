@@ -628,7 +628,7 @@ get_char_property_and_overlay (Lisp_Object position, register Lisp_Object prop,
       set_buffer_temp (XBUFFER (object));
 
       USE_SAFE_ALLOCA;
-      GET_OVERLAYS_AT (XINT (position), overlay_vec, noverlays, NULL, false);
+      GET_OVERLAYS_AT (XINT (position), overlay_vec, noverlays, NULL);
       noverlays = sort_overlays (overlay_vec, noverlays, w);
 
       set_buffer_temp (obuf);
@@ -1335,6 +1335,242 @@ into it.  */)
   return Qnil;
 }
 
+/* Merge the undo entries that BUFFER's undo list gained since it was
+   OLD_LIST and that give the same property the same old value over
+   adjacent stretches of text.  Fadd_text_property_spans records the
+   changes to each interval separately, in increasing order of
+   position; this leaves one entry per property for each run of text
+   that had the same value before.  */
+
+static void
+merge_property_undo_entries (Lisp_Object buffer, Lisp_Object old_list)
+{
+  Lisp_Object tail, prev = Qnil, last = Qnil;
+
+  for (tail = BVAR (XBUFFER (buffer), undo_list);
+       CONSP (tail) && !EQ (tail, old_list);
+       tail = XCDR (tail))
+    {
+      Lisp_Object entry = XCAR (tail), range, cell, kept, kept_range;
+
+      /* Property changes look like (nil PROP VAL BEG . END).  */
+      if (! (CONSP (entry) && NILP (XCAR (entry))
+	     && CONSP (XCDR (entry)) && CONSP (XCDR (XCDR (entry)))
+	     && CONSP (XCDR (XCDR (XCDR (entry))))))
+	{
+	  prev = tail;
+	  continue;
+	}
+      range = XCDR (XCDR (XCDR (entry)));
+
+      /* LAST maps each property to its entry nearest to this one.  */
+      cell = Fassq (XCAR (XCDR (entry)), last);
+      if (CONSP (cell))
+	{
+	  kept = XCDR (cell);
+	  kept_range = XCDR (XCDR (XCDR (kept)));
+	  if (EQ (XCAR (XCDR (XCDR (kept))), XCAR (XCDR (XCDR (entry))))
+	      && EQ (XCAR (kept_range), XCDR (range)))
+	    {
+	      XSETCAR (kept_range, XCAR (range));
+	      XSETCDR (prev, XCDR (tail));
+	      continue;
+	    }
+	  XSETCDR (cell, entry);
+	}
+      else
+	last = Fcons (Fcons (XCAR (XCDR (entry)), entry), last);
+      prev = tail;
+    }
+}
+
+DEFUN ("add-text-property-spans", Fadd_text_property_spans,
+       Sadd_text_property_spans, 1, 2, 0,
+       doc: /* Add properties to several spans of text at once.
+SPANS is a vector whose elements have the form (START END PROPERTIES),
+meaning to add the property list PROPERTIES to the text from START to
+END, as `add-text-properties' does.  The spans must be sorted by
+position and must not overlap.
+If the optional second argument OBJECT is a buffer (or nil, which means
+the current buffer), START and END are buffer positions (integers or
+markers).  If OBJECT is a string, START and END are 0-based indices into it.
+
+This has the same effect as calling `add-text-properties' on each span,
+but looks at the text properties of OBJECT in a single pass, and, if
+OBJECT is a buffer, runs the modification hooks only once for the whole
+stretch of text changed.
+Return t if any property value actually changed, nil otherwise.  */)
+  (Lisp_Object spans, Lisp_Object object)
+{
+  ptrdiff_t nspans, k, first, last_end, changed_beg = 0, *bounds;
+  Lisp_Object *plists, old_undo_list = Qt;
+  INTERVAL tree, i = NULL, prev = NULL, unchanged;
+  bool modified = false;
+  USE_SAFE_ALLOCA;
+
+  if (NILP (object))
+    XSETBUFFER (object, current_buffer);
+  CHECK_STRING_OR_BUFFER (object);
+  CHECK_VECTOR (spans);
+  nspans = ASIZE (spans);
+  SAFE_NALLOCA (bounds, 2, nspans);
+  SAFE_ALLOCA_LISP (plists, nspans);
+
+  /* Check all the spans before changing anything.  */
+  first = -1;
+  last_end = PTRDIFF_MIN;
+  for (k = 0; k < nspans; k++)
+    {
+      Lisp_Object span = AREF (spans, k), start, end;
+      ptrdiff_t min, max;
+
+      if (! (CONSP (span) && CONSP (XCDR (span))
+	     && CONSP (XCDR (XCDR (span)))
+	     && NILP (XCDR (XCDR (XCDR (span))))))
+	wrong_type_argument (Qlistp, span);
+      start = XCAR (span);
+      end = XCAR (XCDR (span));
+      CHECK_NUMBER_COERCE_MARKER (start);
+      CHECK_NUMBER_COERCE_MARKER (end);
+      if (XINT (start) > XINT (end))
+	args_out_of_range (start, end);
+      if (BUFFERP (object))
+	{
+	  min = BUF_BEGV (XBUFFER (object));
+	  max = BUF_ZV (XBUFFER (object));
+	}
+      else
+	{
+	  min = 0;
+	  max = SCHARS (object);
+	}
+      if (! (min <= XINT (start) && XINT (end) <= max))
+	args_out_of_range (start, end);
+      if (XINT (start) < last_end)
+	error ("Text property spans overlap or are out of order");
+      bounds[2 * k] = XINT (start);
+      bounds[2 * k + 1] = last_end = XINT (end);
+      plists[k] = validate_plist (XCAR (XCDR (XCDR (span))));
+      if (first < 0 && XINT (start) < XINT (end) && !NILP (plists[k]))
+	first = k;
+    }
+
+  if (first < 0)
+    {
+      SAFE_FREE ();
+      return Qnil;
+    }
+
+  tree = (BUFFERP (object) ? buffer_intervals (XBUFFER (object))
+	  : string_intervals (object));
+  if (!tree)
+    tree = create_root_interval (object);
+
+  for (k = first; k < nspans; k++)
+    {
+      ptrdiff_t s = bounds[2 * k], len = bounds[2 * k + 1] - s;
+      Lisp_Object properties = plists[k];
+
+      if (len == 0 || NILP (properties))
+	continue;
+
+      /* Move forward to the interval containing S.  */
+      if (!i)
+	i = find_interval (tree, s);
+      else
+	while (i->position + LENGTH (i) <= s)
+	  {
+	    prev = i;
+	    i = next_interval (i);
+	  }
+
+      while (len > 0)
+	{
+	  eassert (i != 0);
+
+	  /* If this interval already has the properties, skip it.  */
+	  if (interval_has_all_properties (properties, i))
+	    {
+	      ptrdiff_t got = i->position + LENGTH (i) - s;
+
+	      if (got >= len)
+		break;
+	      s += got;
+	      len -= got;
+	      prev = i;
+	      i = next_interval (i);
+	      continue;
+	    }
+
+	  if (BUFFERP (object) && !modified)
+	    {
+	      struct buffer *b = XBUFFER (object);
+
+	      /* This runs the hooks, which might change the text or
+		 its properties; look for S again when they are done.  */
+	      modify_text_properties (object, make_number (s),
+				      make_number (last_end));
+	      modified = true;
+	      changed_beg = s;
+	      if (! (BUF_BEGV (b) <= s && last_end <= BUF_ZV (b)))
+		args_out_of_range (make_number (s), make_number (last_end));
+	      tree = buffer_intervals (b);
+	      if (!tree)
+		tree = create_root_interval (object);
+	      i = find_interval (tree, s);
+	      prev = NULL;
+	      old_undo_list = BVAR (b, undo_list);
+	      continue;
+	    }
+	  modified = true;
+
+	  if (i->position != s)
+	    {
+	      prev = unchanged = i;
+	      i = split_interval_right (unchanged, s - unchanged->position);
+	      copy_properties (unchanged, i);
+	    }
+	  if (LENGTH (i) > len)
+	    {
+	      unchanged = i;
+	      i = split_interval_left (unchanged, len);
+	      copy_properties (unchanged, i);
+	    }
+	  add_properties (properties, i, object, TEXT_PROPERTY_REPLACE);
+
+	  /* Keep the tree small by merging I with the interval before
+	     it if they now have the same properties.  */
+	  if (prev && intervals_equal (prev, i))
+	    {
+	      i = merge_interval_left (i);
+	      eassert (i == prev);
+	    }
+
+	  s = i->position + LENGTH (i);
+	  len = bounds[2 * k + 1] - s;
+	  if (len > 0)
+	    {
+	      prev = i;
+	      i = next_interval (i);
+	    }
+	}
+    }
+
+  SAFE_FREE ();
+
+  if (!modified)
+    return Qnil;
+
+  if (BUFFERP (object))
+    {
+      if (!EQ (old_undo_list, Qt))
+	merge_property_undo_entries (object, old_undo_list);
+      signal_after_change (changed_beg, last_end - changed_beg,
+			   last_end - changed_beg);
+    }
+  return Qt;
+}
+
 /* Replace properties of text from START to END with new list of
    properties PROPERTIES.  OBJECT is the buffer or string containing
    the text.  OBJECT nil means use the current buffer.
@@ -2381,6 +2617,7 @@ inherits it if NONSTICKINESS is nil.  The `front-sticky' and
   defsubr (&Sput_text_property);
   defsubr (&Sset_text_properties);
   defsubr (&Sadd_face_text_property);
+  defsubr (&Sadd_text_property_spans);
   defsubr (&Sremove_text_properties);
   defsubr (&Sremove_list_of_text_properties);
   defsubr (&Stext_property_any);
@@ -516,6 +516,62 @@ thread_select (select_func *func, int max_fds, fd_set *rfds,
 
 
 
+/* Return true if there are threads besides the current one, which
+   could run while it does not hold the global lock.  */
+
+bool
+other_threads_p (void)
+{
+  return all_threads->next_thread != NULL;
+}
+
+struct without_lock_args
+{
+  void (*func) (void *);
+  void *arg;
+};
+
+static void
+really_call_without_lock (void *arg)
+{
+  struct without_lock_args *wa = arg;
+  struct thread_state *self = current_thread;
+  bool saved_immediate_quit = immediate_quit;
+
+  /* A quit must not longjmp out of FUNC while another thread runs.  */
+  immediate_quit = false;
+  release_global_lock ();
+  wa->func (wa->arg);
+  acquire_global_lock (self);
+  immediate_quit = saved_immediate_quit;
+}
+
+/* Call FUNC with argument ARG, letting other threads run meanwhile.
+   This is for long sections of C code, such as system calls that can
+   block, that neither use nor change any Lisp object, buffer text, or
+   other state that other threads might use or change: FUNC must not
+   signal, quit, allocate Lisp data, or look at memory that Lisp code
+   can free or move, and the caller must be prepared for other threads
+   to have changed anything else, including the current buffer's
+   text, once FUNC returns.  */
+
+void
+thread_call_without_lock (void (*func) (void *), void *arg)
+{
+  if (other_threads_p ())
+    {
+      struct without_lock_args wa;
+
+      wa.func = func;
+      wa.arg = arg;
+      flush_stack_call_func (really_call_without_lock, &wa);
+    }
+  else
+    func (arg);
+}
+
+
+
 static void
 mark_one_thread (struct thread_state *thread)
 {
@@ -232,6 +232,9 @@ int thread_select  (select_func *func, int max_fds, fd_set *rfds,
 		    fd_set *wfds, fd_set *efds, struct timespec *timeout,
 		    sigset_t *sigmask);
 
+bool other_threads_p (void);
+void thread_call_without_lock (void (*) (void *), void *);
+
 bool thread_check_current_buffer (struct buffer *);
 
 #endif /* THREAD_H */
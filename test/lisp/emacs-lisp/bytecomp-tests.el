@@ -462,6 +462,54 @@ bytecompiled code, and their results compared.")
   (dolist (pat bytecomp-lexbind-tests)
     (should (bytecomp-lexbind-check-1 pat))))
 
+;; Files compiled by `bytecomp-tests-parallel'.
+(defconst bytecomp-tests--parallel-files
+  '(("bytecomp-tests-a.el"
+     (defmacro bytecomp-tests-a-macro () 1)
+     (provide 'bytecomp-tests-a))
+    ("bytecomp-tests-b.el"
+     (require 'bytecomp-tests-a)
+     (defun bytecomp-tests-b () (bytecomp-tests-a-macro)))
+    ("bytecomp-tests-c.el"
+     (eval-when-compile
+       (when (featurep 'bytecomp-tests-a)
+         (error "Compiled after another file")))
+     (defun bytecomp-tests-c () 3))))
+
+(ert-deftest bytecomp-tests-parallel ()
+  "Each file is compiled as if by a fresh Emacs."
+  (let* ((dir (make-temp-file "bytecomp-tests" t))
+         (default-directory (file-name-as-directory dir)))
+    (unwind-protect
+        (progn
+          (dolist (file bytecomp-tests--parallel-files)
+            (with-temp-file (car file)
+              (insert ";;; -*- lexical-binding: t -*-\n")
+              (dolist (form (cdr file))
+                (print form (current-buffer)))))
+          ;; This one cannot be compiled.
+          (with-temp-file "bytecomp-tests-d.el"
+            (insert "(defun bytecomp-tests-d ()"))
+          (should (= (call-process
+                      (expand-file-name invocation-name invocation-directory)
+                      nil nil nil
+                      "-Q" "-batch" "-L" "."
+                      "--eval" "(setq byte-compile-parallel-jobs 2)"
+                      "--eval" "(setq byte-compile-write-dependencies t)"
+                      "-l" "bytecomp" "-f" "batch-byte-compile-parallel"
+                      "bytecomp-tests-a.el" "bytecomp-tests-b.el"
+                      "bytecomp-tests-c.el" "bytecomp-tests-d.el")
+                     1))
+          (should (file-exists-p "bytecomp-tests-a.elc"))
+          (should (file-exists-p "bytecomp-tests-b.elc"))
+          (should (file-exists-p "bytecomp-tests-c.elc"))
+          (should-not (file-exists-p "bytecomp-tests-d.elc"))
+          (with-temp-buffer
+            (insert-file-contents "bytecomp-tests-b.d")
+            (should (looking-at "bytecomp-tests-b\\.elc: "))
+            (should (search-forward "bytecomp-tests-a.el" nil t))))
+      (delete-directory dir t))))
+
 ;; Local Variables:
 ;; no-byte-compile: t
 ;; End:
@@ -34,6 +34,34 @@
     (sit-for 0 t)
     (should timer-ran)))
 
+(ert-deftest timer-tests-order ()
+  "Timers are kept sorted by time, and run in that order."
+  (let ((timer-list nil)
+        (ran nil)
+        (noninteractive nil))
+    (dolist (n '(3 1 4 1 5 9 2 6))
+      (run-at-time (list 0 0 0 n) nil (lambda () (push n ran))))
+    (should (equal (sort (mapcar (lambda (timer) (timer--psecs timer))
+                                 timer-list)
+                         #'<)
+                   (mapcar (lambda (timer) (timer--psecs timer))
+                           timer-list)))
+    (sit-for 0 t)
+    (should (equal ran '(9 6 5 4 3 2 1 1)))))
+
+(ert-deftest timer-tests-run-from-timer ()
+  "A ripe timer started by a timer is run without waiting."
+  (let ((timer-list nil)
+        (ran nil))
+    (run-at-time '(0 0 0 0) nil
+                 (lambda ()
+                   (run-at-time '(0 0 0 0) nil (lambda () (setq ran t)))))
+    (run-at-time 1000 nil #'ignore)
+    (let ((start (float-time)))
+      (while (and (not ran) (< (- (float-time) start) 5))
+        (accept-process-output nil 0.5)))
+    (should ran)))
+
 (ert-deftest timer-tests-debug-timer-check ()
   ;; This function exists only if --enable-checking.
   (if (fboundp 'debug-timer-check)
@@ -0,0 +1,45 @@
+;;; jka-compr-tests.el --- Tests for jka-compr.el  -*- lexical-binding: t; -*-
+
+;; Copyright (C) 2017 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+(require 'jka-compr)
+
+(ert-deftest jka-compr-tests-invalid-data ()
+  "Invalid compressed data is not reported as a file error."
+  (skip-unless (and (fboundp 'zlib-available-p) (zlib-available-p)))
+  (let ((file (make-temp-file "jka-compr-tests" nil ".gz")))
+    (unwind-protect
+        (let ((coding-system-for-write 'no-conversion))
+          (with-temp-file file
+            (set-buffer-multibyte nil)
+            (insert "\037\213\010\000garbage"))
+          (with-temp-buffer
+            (let ((jka-compr-inhibit nil))
+              (with-auto-compression-mode
+                (let ((err (should-error (insert-file-contents file)
+                                         :type 'zlib-data-error)))
+                  (should-not (memq 'file-error
+                                    (get (car err) 'error-conditions)))
+                  (should (equal (car (last err)) file)))))))
+      (delete-file file))))
+
+(provide 'jka-compr-tests)
+;;; jka-compr-tests.el ends here
@@ -0,0 +1,210 @@
+;;; bytecode-bench.el --- time the byte-code interpreter  -*- lexical-binding: t -*-
+
+;; Copyright (C) 2017 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Byte-compile this file and run it with
+;; "emacs -Q --batch -l bytecode-bench.elc -f bytecode-bench-run",
+;; or run 'make' in this directory.  The micro-benchmarks each time
+;; a loop around a single kind of function call or variable access in
+;; `exec_byte_code'; the macro-benchmarks time larger Lisp programs
+;; that mix them.  Every benchmark runs a few times and reports the
+;; processor time of the fastest run, so that garbage collection and
+;; other noise do not hide differences between two builds.
+
+;;; Code:
+
+(require 'cl-lib)
+(require 'json)
+
+(defvar bytecode-bench-repetitions 3
+  "Number of times to run each benchmark.")
+
+(defvar bytecode-bench-benchmarks nil
+  "List of (NAME GROUP . FUNCTION) of the benchmarks to run.")
+
+(defmacro bytecode-bench-define (name group &rest body)
+  "Define the benchmark NAME in GROUP, which runs BODY."
+  (declare (indent 2))
+  `(push (cons ,name (cons ,group (lambda () ,@body)))
+         bytecode-bench-benchmarks))
+
+(defconst bytecode-bench-iterations 5000000
+  "Number of iterations of the micro-benchmark loops.")
+
+;;;; Micro-benchmarks.
+
+(defvar bytecode-bench--special 0)
+(defvar-local bytecode-bench--local 0)
+
+(defun bytecode-bench--ident (x)
+  x)
+
+(defalias 'bytecode-bench--alias #'bytecode-bench--ident)
+(defalias 'bytecode-bench--alias-2 'bytecode-bench--alias)
+
+(bytecode-bench-define "empty loop" 'micro
+  (dotimes (_ bytecode-bench-iterations)))
+
+(bytecode-bench-define "call byte-code" 'micro
+  (dotimes (i bytecode-bench-iterations)
+    (bytecode-bench--ident i)))
+
+(bytecode-bench-define "call alias chain" 'micro
+  (dotimes (i bytecode-bench-iterations)
+    (bytecode-bench--alias-2 i)))
+
+(bytecode-bench-define "call primitive" 'micro
+  (let ((plist '(:a 1 :b 2 :c 3)))
+    (dotimes (_ bytecode-bench-iterations)
+      (plist-get plist :c))))
+
+(bytecode-bench-define "funcall variable" 'micro
+  (let ((f #'bytecode-bench--ident))
+    (dotimes (i bytecode-bench-iterations)
+      (funcall f i))))
+
+(bytecode-bench-define "varref special" 'micro
+  (let ((sum 0))
+    (dotimes (_ bytecode-bench-iterations)
+      (setq sum (+ sum bytecode-bench--special)))
+    sum))
+
+(bytecode-bench-define "varset special" 'micro
+  (dotimes (i bytecode-bench-iterations)
+    (setq bytecode-bench--special i)))
+
+(bytecode-bench-define "varref forwarded" 'micro
+  (let ((n 0))
+    (dotimes (_ bytecode-bench-iterations)
+      (when gc-cons-threshold
+        (setq n (1+ n))))
+    n))
+
+(bytecode-bench-define "varref per-buffer" 'micro
+  (let ((n 0))
+    (dotimes (_ bytecode-bench-iterations)
+      (when case-fold-search
+        (setq n (1+ n))))
+    n))
+
+(bytecode-bench-define "varref buffer-local" 'micro
+  (with-temp-buffer
+    (setq bytecode-bench--local 1)
+    (let ((sum 0))
+      (dotimes (_ bytecode-bench-iterations)
+        (setq sum (+ sum bytecode-bench--local)))
+      sum)))
+
+(bytecode-bench-define "varref buffer-local, switching" 'micro
+  (let ((a (generate-new-buffer " *bytecode-bench-a*"))
+        (b (generate-new-buffer " *bytecode-bench-b*"))
+        (sum 0))
+    (unwind-protect
+        (progn
+          (dolist (buffer (list a b))
+            (with-current-buffer buffer
+              ;; Give the buffers a realistic number of local variables.
+              (dotimes (i 30)
+                (set (make-local-variable (intern (format "bytecode-bench--v%d" i)))
+                     i))
+              (setq bytecode-bench--local 1)))
+          (dotimes (_ (/ bytecode-bench-iterations 10))
+            (set-buffer a)
+            (setq sum (+ sum bytecode-bench--local))
+            (set-buffer b)
+            (setq sum (+ sum bytecode-bench--local))))
+      (kill-buffer a)
+      (kill-buffer b))
+    sum))
+
+;;;; Macro-benchmarks.
+
+(defun bytecode-bench--fib (n)
+  (if (< n 2)
+      n
+    (+ (bytecode-bench--fib (- n 1)) (bytecode-bench--fib (- n 2)))))
+
+(bytecode-bench-define "fibonacci" 'macro
+  (bytecode-bench--fib 30))
+
+(defun bytecode-bench--sieve (n)
+  (let ((composite (make-bool-vector (1+ n) nil))
+        (count 0))
+    (cl-loop for i from 2 to n
+             unless (aref composite i)
+             do (cl-incf count)
+             (cl-loop for j from (* i i) to n by i
+                      do (aset composite j t)))
+    count))
+
+(bytecode-bench-define "sieve" 'macro
+  (dotimes (_ 10)
+    (bytecode-bench--sieve 1000000)))
+
+(bytecode-bench-define "sort with predicate" 'macro
+  (let ((items (cl-loop for i below 100000
+                        collect (cons (% (* i 7919) 100003) i))))
+    (dotimes (_ 3)
+      (sort (copy-sequence items)
+            (lambda (a b) (< (car a) (car b)))))))
+
+(defvar bytecode-bench--json
+  (cl-loop for i below 5000
+           collect (list (cons 'id i)
+                         (cons 'name (format "item %d" i))
+                         (cons 'tags (vector "a" "b" (number-to-string i)))
+                         (cons 'ratio (/ i 7.0)))))
+
+(bytecode-bench-define "json round trip" 'macro
+  (let ((json-object-type 'alist))
+    (json-read-from-string (json-encode bytecode-bench--json))))
+
+(bytecode-bench-define "pp" 'macro
+  (pp-to-string (cl-subseq bytecode-bench--json 0 500)))
+
+(bytecode-bench-define "font-lock a C file" 'macro
+  (let ((file (expand-file-name "src/bytecode.c" source-directory)))
+    (with-temp-buffer
+      (insert-file-contents file)
+      (delay-mode-hooks (c-mode))
+      (let ((font-lock-maximum-decoration t))
+        (font-lock-mode 1)
+        (font-lock-ensure)))))
+
+;;;; Driver.
+
+(defun bytecode-bench-run ()
+  "Run all the benchmarks and report their times."
+  (garbage-collect)
+  (dolist (benchmark (reverse bytecode-bench-benchmarks))
+    (let ((best nil))
+      (dotimes (_ bytecode-bench-repetitions)
+        (garbage-collect)
+        ;; Use processor time rather than elapsed time, which other
+        ;; processes on the machine would disturb more.
+        (let* ((start (get-internal-run-time))
+               (time (progn
+                       (funcall (cddr benchmark))
+                       (float-time (time-subtract (get-internal-run-time)
+                                                  start)))))
+          (setq best (if best (min best time) time))))
+      (message "  %-6s %-32s %.3fs" (cadr benchmark) (car benchmark) best))))
+
+;;; bytecode-bench.el ends here
@@ -0,0 +1,108 @@
+/* Benchmark of the newline counting in src/count-newlines.h.
+
+Copyright (C) 2017 Free Software Foundation, Inc.
+
+This file is part of GNU Emacs.
+
+GNU Emacs is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or (at
+your option) any later version.
+
+GNU Emacs is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.  */
+
+/* Usage: newline-bench LINE-LENGTH [MEGABYTES]
+
+   Count the newlines in text made of lines of about LINE-LENGTH
+   bytes, first with a memchr per line, as find_newline does when
+   looking for a single newline, then with count_newlines.  */
+
+#define INLINE EXTERN_INLINE
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "count-newlines.h"
+
+static double
+now (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static ptrdiff_t
+count_by_memchr (unsigned char const *p, ptrdiff_t n)
+{
+  unsigned char const *lim = p + n;
+  ptrdiff_t count = 0;
+
+  while ((p = memchr (p, '\n', lim - p)))
+    {
+      p++;
+      count++;
+    }
+  return count;
+}
+
+static void
+report (char const *name, ptrdiff_t count, double seconds, ptrdiff_t size)
+{
+  printf ("  %-16s %10td newlines  %8.1f MB/s\n",
+	  name, count, size / seconds / 1e6);
+}
+
+int
+main (int argc, char **argv)
+{
+  ptrdiff_t line_length, size, i, c1, c2;
+  unsigned char *text;
+  double t0, t1, t2;
+  int round;
+
+  if (argc < 2 || (line_length = atol (argv[1])) < 1)
+    {
+      fprintf (stderr, "Usage: %s LINE-LENGTH [MEGABYTES]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+  size = (argc > 2 ? atol (argv[2]) : 256) * 1000 * 1000;
+  text = malloc (size);
+  if (!text)
+    {
+      perror ("malloc");
+      return EXIT_FAILURE;
+    }
+
+  srand (0);
+  for (i = 0; i < size; i++)
+    text[i] = (rand () % line_length == 0 ? '\n' : 'a' + rand () % 26);
+
+  printf ("Lines of about %td bytes, %td MB:\n", line_length, size / 1000000);
+  for (round = 0; round < 3; round++)
+    {
+      t0 = now ();
+      c1 = count_by_memchr (text, size);
+      t1 = now ();
+      c2 = count_newlines (text, size);
+      t2 = now ();
+      if (c1 != c2)
+	{
+	  fprintf (stderr, "Mismatch: %td != %td\n", c1, c2);
+	  return EXIT_FAILURE;
+	}
+    }
+  report ("memchr per line", c1, t1 - t0, size);
+  report ("count_newlines", c2, t2 - t1, size);
+  free (text);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,54 @@
+;;; newline-bench.el --- time the commands that count lines  -*- lexical-binding: t -*-
+
+;; Copyright (C) 2017 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Run with "emacs -Q --batch -l newline-bench.el".  This times
+;; `count-lines', `forward-line' and `line-number-at-pos' on a buffer
+;; of about 100 MB, with and without the newline cache.
+
+;;; Code:
+
+(defmacro newline-bench-time (name &rest body)
+  (declare (indent 1))
+  `(let ((start (float-time)))
+     ,@body
+     (message "  %-32s %.3fs" ,name (- (float-time) start))))
+
+(with-temp-buffer
+  (let ((line "2017-01-01 12:00:00 INFO something happened in module foo\n"))
+    (dotimes (_ 2000000)
+      (insert line)))
+  ;; Put the gap in the middle.
+  (goto-char (/ (point-max) 2))
+  (insert "x")
+  (message "Buffer of %d MB, %d lines:"
+           (/ (buffer-size) 1000000) (count-lines (point-min) (point-max)))
+  (dolist (cache '(t nil))
+    (setq cache-long-scans cache)
+    (message "cache-long-scans %s:" cache)
+    (newline-bench-time "count-lines"
+      (count-lines (point-min) (point-max)))
+    (newline-bench-time "forward-line backward"
+      (goto-char (point-max))
+      (forward-line (- (buffer-size))))
+    (newline-bench-time "line-number-at-pos (point-max)"
+      (line-number-at-pos (point-max)))))
+
+;;; newline-bench.el ends here
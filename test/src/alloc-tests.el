@@ -29,5 +29,67 @@
 (require 'ert)
 (require 'cl-lib)
 
+(ert-deftest gc-pause-statistics ()
+  (let ((gcs gcs-done)
+        (gc-pause-max 0.0))
+    (garbage-collect)
+    (should (> gcs-done gcs))
+    (should (floatp gc-pause-last))
+    (should (<= 0.0 gc-pause-last gc-pause-max))
+    (should (<= gc-pause-max gc-elapsed))))
+
+(defun alloc-tests--gc-data ()
+  "Return data with enough conses for the helper threads to be used."
+  (cl-loop for i below 300000
+           collect (list i (float i) (number-to-string i)
+                         (make-symbol "x") (vector (cons i i)))))
+
+(defun alloc-tests--gc-data-intact-p (data)
+  "Return non-nil if DATA is as `alloc-tests--gc-data' made it."
+  (cl-loop for e in data
+           for i from 0
+           always (and (= (nth 0 e) i)
+                       (= (nth 1 e) (float i))
+                       (equal (nth 2 e) (number-to-string i))
+                       (symbolp (nth 3 e))
+                       (equal (aref (nth 4 e) 0) (cons i i)))))
+
+(ert-deftest gc-mark-threads ()
+  (let ((data (alloc-tests--gc-data)))
+    (dolist (threads '(0 3))
+      (let ((gc-mark-threads threads))
+        (garbage-collect)
+        (should (alloc-tests--gc-data-intact-p data))))))
+
+(defun alloc-tests--thread-count ()
+  "Return the number of threads of this Emacs process."
+  (length (directory-files "/proc/self/task" nil "\\`[0-9]")))
+
+(ert-deftest gc-mark-threads-helpers ()
+  "Run garbage collections with helper threads, then stop them."
+  (skip-unless (and (fboundp 'make-thread)
+                    (file-directory-p "/proc/self/task")))
+  (let ((data (alloc-tests--gc-data))
+        before)
+    ;; Stop any helpers, and measure the heap for the next GC.
+    (let ((gc-mark-threads 0))
+      (garbage-collect))
+    (setq before (alloc-tests--thread-count))
+    (let ((gc-mark-threads 3))
+      (dotimes (i 3)
+        ;; Leave garbage among the live objects.
+        (make-list 100000 i)
+        (garbage-collect)
+        (should (= (alloc-tests--thread-count) (+ before 3)))
+        (should (alloc-tests--gc-data-intact-p data))))
+    (let ((gc-mark-threads 1))
+      (garbage-collect)
+      (should (= (alloc-tests--thread-count) (+ before 1)))
+      (should (alloc-tests--gc-data-intact-p data)))
+    (let ((gc-mark-threads 0))
+      (garbage-collect)
+      (should (= (alloc-tests--thread-count) before))
+      (should (alloc-tests--gc-data-intact-p data)))))
+
 (ert-deftest finalizer-object-type ()
   (should (equal (type-of (make-finalizer nil)) 'finalizer)))
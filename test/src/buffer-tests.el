@@ -45,4 +45,185 @@ with parameters from the *Messages* buffer modification."
             (should (eq buf (current-buffer))))
         (when msg-ov (delete-overlay msg-ov))))))
 
+(ert-deftest overlay-adjust-for-insert-and-delete ()
+  "Overlays follow insertions and deletions like markers do."
+  (with-temp-buffer
+    (insert "0123456789")
+    (let ((a (make-overlay 3 6))
+          (b (make-overlay 3 6 nil t nil))
+          (c (make-overlay 3 6 nil nil t))
+          (e (make-overlay 5 5)))
+      (goto-char 3)
+      (insert "xx")
+      (should (equal (list (overlay-start a) (overlay-end a)) '(3 8)))
+      (should (equal (list (overlay-start b) (overlay-end b)) '(5 8)))
+      (should (equal (list (overlay-start c) (overlay-end c)) '(3 8)))
+      (should (equal (list (overlay-start e) (overlay-end e)) '(7 7)))
+      (goto-char 8)
+      (insert "y")
+      (should (= (overlay-end a) 8))
+      (should (= (overlay-end c) 9))
+      (goto-char 3)
+      (insert-before-markers "z")
+      (should (equal (list (overlay-start a) (overlay-end a)) '(4 9)))
+      (delete-region 2 6)
+      (should (equal (list (overlay-start a) (overlay-end a)) '(2 5)))
+      (should (equal (list (overlay-start e) (overlay-end e)) '(4 4)))
+      (delete-region 1 (point-max))
+      (dolist (ov (list a b c e))
+        (should (eq (overlay-buffer ov) (current-buffer)))
+        (should (= (overlay-start ov) 1))
+        (should (= (overlay-end ov) 1))))))
+
+(ert-deftest overlay-front-advance-empty ()
+  "An empty front-advance overlay never ends up with start > end."
+  (with-temp-buffer
+    (insert "abc")
+    (let ((ov (make-overlay 2 2 nil t nil)))
+      (goto-char 2)
+      (insert "x")
+      (should (= (overlay-start ov) 2))
+      (should (= (overlay-end ov) 2)))))
+
+(ert-deftest overlay-lookup-functions ()
+  (with-temp-buffer
+    (insert (make-string 100 ?a))
+    (let ((a (make-overlay 10 20))
+          (b (make-overlay 15 30))
+          (c (make-overlay 40 40)))
+      (should (equal (sort (mapcar #'overlay-start (overlays-at 16)) #'<)
+                     '(10 15)))
+      (should (equal (overlays-at 35) nil))
+      (should (equal (overlays-in 20 40) (list b)))
+      (should (equal (sort (mapcar #'overlay-start (overlays-in 20 41)) #'<)
+                     '(15 40)))
+      (should (equal (overlays-in 41 50) nil))
+      (should (= (next-overlay-change 1) 10))
+      (should (= (next-overlay-change 10) 15))
+      (should (= (next-overlay-change 15) 20))
+      (should (= (next-overlay-change 20) 30))
+      (should (= (next-overlay-change 30) 40))
+      (should (= (next-overlay-change 40) (point-max)))
+      (should (= (previous-overlay-change (point-max)) 40))
+      (should (= (previous-overlay-change 40) 30))
+      (should (= (previous-overlay-change 30) 20))
+      (should (= (previous-overlay-change 16) 15))
+      (should (= (previous-overlay-change 10) (point-min)))
+      (narrow-to-region 12 25)
+      (should (= (previous-overlay-change 14) 12))
+      (should (= (next-overlay-change 21) 25))
+      (widen)
+      (move-overlay a 50 60)
+      (should (equal (overlays-at 12) nil))
+      (should (equal (overlays-at 55) (list a)))
+      (delete-overlay b)
+      (should (null (overlay-start b)))
+      (should (equal (sort (mapcar #'overlay-start
+                                   (overlays-in 1 (point-max)))
+                           #'<)
+                     '(40 50))))))
+
+(ert-deftest overlay-many-random-edits ()
+  "Check overlays against markers under many random edits."
+  (with-temp-buffer
+    (insert (make-string 1000 ?a))
+    (let ((state (random "overlay-many-random-edits"))
+          (entries nil))
+      (ignore state)
+      (dotimes (_ 300)
+        (let* ((beg (1+ (random 1000)))
+               (end (min 1001 (+ beg (random 20))))
+               (front (zerop (random 2)))
+               (rear (zerop (random 2)))
+               (sm (copy-marker beg front))
+               (em (copy-marker end rear)))
+          (push (list (make-overlay beg end nil front rear) sm em) entries)))
+      (dotimes (_ 500)
+        (let ((pos (1+ (random (buffer-size)))))
+          (goto-char pos)
+          (pcase (random 3)
+            (0 (insert (make-string (1+ (random 5)) ?b)))
+            (1 (insert-before-markers "c"))
+            (_ (delete-region pos (min (point-max) (+ pos (random 5)))))))
+        (dolist (e entries)
+          (let ((ov (nth 0 e)) (sm (nth 1 e)) (em (nth 2 e)))
+            (should (= (overlay-start ov) (min sm em)))
+            (should (= (overlay-end ov) em))
+            (set-marker sm (overlay-start ov))))
+        ;; Edits must also keep the tree in order for lookups.
+        (let ((pos (1+ (random (buffer-size)))))
+          (should (equal (sort (mapcar #'overlay-start (overlays-at pos)) #'<)
+                         (sort (delq nil (mapcar
+                                          (lambda (e)
+                                            (let ((ov (car e)))
+                                              (and (<= (overlay-start ov) pos)
+                                                   (< pos (overlay-end ov))
+                                                   (overlay-start ov))))
+                                          entries))
+                               #'<))))))))
+
+(ert-deftest overlay-indirect-buffer ()
+  "Overlays of indirect buffers follow edits in the base buffer."
+  (with-temp-buffer
+    (insert "0123456789")
+    (let* ((base (current-buffer))
+           (ind (make-indirect-buffer base " *overlay-test-indirect*"))
+           (ov (with-current-buffer ind (make-overlay 5 8))))
+      (unwind-protect
+          (progn
+            (goto-char 2)
+            (insert "abc")
+            (should (equal (list (overlay-start ov) (overlay-end ov)) '(8 11)))
+            (with-current-buffer ind
+              (delete-region 1 9))
+            (should (equal (list (overlay-start ov) (overlay-end ov)) '(1 3))))
+        (kill-buffer ind)))))
+
+(ert-deftest overlay-transpose-regions ()
+  (with-temp-buffer
+    (insert "aaabbbbcc")
+    (let ((a (make-overlay 2 3))
+          (b (make-overlay 5 7))
+          (c (make-overlay 8 9)))
+      (transpose-regions 1 4 4 8)
+      (should (equal (buffer-string) "bbbbaaacc"))
+      (should (equal (list (overlay-start a) (overlay-end a)) '(6 7)))
+      (should (equal (list (overlay-start b) (overlay-end b)) '(2 4)))
+      (should (equal (list (overlay-start c) (overlay-end c)) '(8 9))))))
+
+(ert-deftest overlay-transpose-regions-indirect ()
+  "Transposing text in an indirect buffer moves the overlays of the
+base buffer and of the other buffers sharing its text."
+  (with-temp-buffer
+    (insert "aaabbbbcc")
+    (let* ((base (current-buffer))
+           (ind1 (make-indirect-buffer base " *overlay-test-indirect-1*"))
+           (ind2 (make-indirect-buffer base " *overlay-test-indirect-2*"))
+           (a (make-overlay 2 3))
+           (b (with-current-buffer ind1 (make-overlay 5 7)))
+           (c (with-current-buffer ind2 (make-overlay 2 3))))
+      (unwind-protect
+          (progn
+            (with-current-buffer ind1
+              (transpose-regions 1 4 4 8)
+              (should (equal (buffer-string) "bbbbaaacc")))
+            (should (equal (list (overlay-start a) (overlay-end a)) '(6 7)))
+            (should (equal (list (overlay-start b) (overlay-end b)) '(2 4)))
+            (should (equal (list (overlay-start c) (overlay-end c)) '(6 7)))
+            (should (equal (overlays-at 6) (list a)))
+            (with-current-buffer ind2
+              (should (equal (overlays-at 6) (list c)))))
+        (kill-buffer ind1)
+        (kill-buffer ind2)))))
+
+(ert-deftest overlay-set-buffer-multibyte ()
+  (with-temp-buffer
+    (insert "été abc")
+    (let ((ov (make-overlay 5 8)))
+      (set-buffer-multibyte nil)
+      (should (equal (buffer-substring (overlay-start ov) (overlay-end ov))
+                     "abc"))
+      (set-buffer-multibyte t)
+      (should (equal (list (overlay-start ov) (overlay-end ov)) '(5 8))))))
+
 ;;; buffer-tests.el ends here
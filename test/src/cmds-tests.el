@@ -30,5 +30,125 @@
   (let ((last-command-event ?a))
     (should-error (self-insert-command -1))))
 
+(defun cmds-tests--line-motions (buffers)
+  "Move over lines in BUFFERS, which have the same text.
+Check that `forward-line' and `count-lines' agree in all of them."
+  (let ((size (with-current-buffer (car buffers) (buffer-size))))
+    (dotimes (_ 20)
+      (let* ((pos (1+ (random size)))
+             (n (- (random 20000) 10000))
+             (results
+              (mapcar (lambda (buffer)
+                        (with-current-buffer buffer
+                          (goto-char pos)
+                          (list (forward-line n) (point)
+                                (count-lines (point-min) pos))))
+                      buffers)))
+        (should (equal (car results) (cadr results)))))))
+
+(ert-deftest forward-line-line-index ()
+  "Test that the line index agrees with scanning the text."
+  (let ((indexed (generate-new-buffer "indexed"))
+        (scanned (generate-new-buffer "scanned")))
+    (unwind-protect
+        (progn
+          (with-current-buffer indexed
+            (setq cache-long-scans t))
+          (with-current-buffer scanned
+            (setq cache-long-scans nil))
+          (dolist (buffer (list indexed scanned))
+            (with-current-buffer buffer
+              (dotimes (i 40000)
+                (insert (make-string (% (* i 7) 50) (if (zerop (% i 9)) ?é ?x))
+                        "\n"))))
+          (cmds-tests--line-motions (list indexed scanned))
+          ;; Change the text in both buffers, and check again.
+          (dotimes (i 20)
+            (let ((pos (1+ (random (with-current-buffer indexed
+                                     (buffer-size)))))
+                  (len (random 5000)))
+              (dolist (buffer (list indexed scanned))
+                (with-current-buffer buffer
+                  (goto-char pos)
+                  (if (zerop (% i 2))
+                      (insert (make-string len ?\n))
+                    (delete-region pos (min (point-max) (+ pos len)))))))
+            (cmds-tests--line-motions (list indexed scanned))))
+      (kill-buffer indexed)
+      (kill-buffer scanned))))
+
+(defun cmds-tests--forward-line-reference (n)
+  "Return where `forward-line' N should move, found with `search-forward'."
+  (save-excursion
+    (if (> n 0)
+        (if (search-forward "\n" nil t n) (point) (point-max))
+      (if (search-backward "\n" nil t (- 1 n)) (1+ (point)) (point-min)))))
+
+(defun cmds-tests--check-forward-line (from counts)
+  "Check `forward-line' from FROM by each of COUNTS."
+  (dolist (n counts)
+    (goto-char from)
+    (let ((expected (cmds-tests--forward-line-reference n)))
+      (forward-line n)
+      (should (equal (list from n (point)) (list from n expected))))))
+
+(ert-deftest forward-line-chunk-boundaries ()
+  "Test skipping many lines where the newlines are at chunk boundaries.
+`find_newline' counts newlines in chunks of 256 bytes and more when
+skipping many lines."
+  (let ((boundaries (let ((chunk 256) (pos 0) (list nil))
+                      (while (< pos 190000)
+                        (setq pos (+ pos chunk))
+                        (push pos list)
+                        (setq chunk (min (* 2 chunk) 65536)))
+                      (nreverse list))))
+    (dolist (cache '(nil t))
+      (with-temp-buffer
+        (setq cache-long-scans cache)
+        (insert (make-string (+ (car (last boundaries)) 1000) ?x))
+        ;; Put newlines on both sides of the boundaries of the chunks
+        ;; counted forward from the start and backward from the end.
+        (let ((end (point-max)))
+          (dolist (b boundaries)
+            (dolist (pos (list b (1+ b) (- end b) (- end b 1)))
+              (goto-char pos)
+              (delete-char 1)
+              (insert "\n"))))
+        (let* ((lines (count-lines (point-min) (point-max)))
+               (forward (number-sequence 2 (+ lines 2)))
+               (backward (mapcar #'- (number-sequence 1 (+ lines 2)))))
+          ;; Move the gap to the end, the middle and onto a boundary.
+          (dolist (gap (list (point-max) (/ (point-max) 2) (nth 3 boundaries)))
+            (goto-char gap)
+            (insert "x")
+            (delete-char -1)
+            ;; With the newline cache, the second time around uses what
+            ;; the first time recorded.
+            (dotimes (_ (if cache 2 1))
+              (cmds-tests--check-forward-line (point-min) forward)
+              (cmds-tests--check-forward-line (point-max) backward)
+              (cmds-tests--check-forward-line gap (append forward backward)))))))))
+
+(ert-deftest forward-line-many-lines-multibyte ()
+  "Test skipping many lines in text with multibyte characters."
+  (let ((state (random "forward-line-many-lines-multibyte")))
+    (ignore state)
+    (dolist (cache '(nil t))
+      (with-temp-buffer
+        (setq cache-long-scans cache)
+        (dotimes (i 3000)
+          (insert (make-string (random (if (zerop (% i 50)) 2000 40))
+                               (if (zerop (% i 3)) ?é ?x))
+                  "\n"))
+        (dotimes (_ 10)
+          (let ((gap (1+ (random (buffer-size)))))
+            (goto-char gap)
+            (insert "é")
+            (delete-char -1)
+            (dotimes (_ 20)
+              (cmds-tests--check-forward-line
+               (1+ (random (buffer-size)))
+               (list (+ 2 (random 3000)) (- (1+ (random 3000))))))))))))
+
 (provide 'cmds-tests)
 ;;; cmds-tests.el ends here
@@ -292,6 +292,40 @@
     (coding-tests-remove-files)))
 
 
+(ert-deftest coding-tests-insert-file-contents-decoding ()
+  "Decoding file contents agrees with `decode-coding-string'.
+The decoder skips plain ASCII a word at a time, so use texts that
+have other bytes at various positions."
+  (let* ((file (make-temp-file "coding-tests"))
+         (line "The quick brown fox jumps over the lazy dog.\n")
+         (text (apply #'concat (make-list 10 line)))
+         (samples
+          (list text
+                (concat text "\r\n" text)
+                (concat text "\e$B" text)
+                (concat text "\0" text)
+                (concat text "\303\274\342\202\254" text)
+                (concat "\357\273\277" text "\303\274")
+                (concat text "\377" text)
+                (concat text "\303A" text)
+                (concat text "\342\202")
+                (concat (substring text 0 13) "\303\274" (substring text 13)))))
+    (unwind-protect
+        (dolist (bytes samples)
+          (let ((coding-system-for-write 'no-conversion))
+            (write-region (string-to-unibyte bytes) nil file nil 'silent))
+          (dolist (coding '(undecided utf-8 utf-8-unix utf-8-dos prefer-utf-8
+                            utf-8-with-signature latin-1))
+            (with-temp-buffer
+              (let ((coding-system-for-read coding))
+                (insert-file-contents file))
+              ;; Compare with the coding system that was detected,
+              ;; since detection looks at the file differently.
+              (should (equal (buffer-string)
+                             (decode-coding-string
+                              bytes last-coding-system-used))))))
+      (delete-file file))))
+
 ;;; The following is for benchmark testing of the new optimized
 ;;; decoder, not for regression testing.
 
@@ -40,6 +40,122 @@
 	       (buffer-string))
 	     "foo\n"))))
 
+;; Compress TEXT into a new buffer with FORMAT, feeding it in pieces of
+;; PIECE bytes, and return the buffer.
+(defun zlib-tests--compress (text format piece)
+  (let* ((buffer (generate-new-buffer " *zlib-tests*"))
+         (stream (zlib-make-compressor buffer format)))
+    (with-current-buffer buffer
+      (set-buffer-multibyte nil))
+    (dotimes (i (ceiling (length text) piece))
+      (zlib-stream-feed stream (substring text (* i piece)
+                                          (min (length text)
+                                               (* (1+ i) piece)))))
+    (zlib-stream-finish stream)
+    buffer))
+
+(ert-deftest zlib--streams ()
+  "Test compressing and decompressing data a piece at a time."
+  (skip-unless (and (fboundp 'zlib-available-p)
+                    (zlib-available-p)))
+  (let ((text (with-temp-buffer
+                (set-buffer-multibyte nil)
+                (dotimes (i 10000)
+                  (insert (format "line %d \377\n" i)))
+                (buffer-string))))
+    (dolist (format '(gzip zlib deflate))
+      (let ((compressed (zlib-tests--compress text format 1000)))
+        (unwind-protect
+            (with-temp-buffer
+              (set-buffer-multibyte nil)
+              (let ((stream (zlib-make-decompressor (current-buffer)
+                                                    format)))
+                (should (zlib-stream-p stream))
+                (should (zlib-stream-feed stream compressed))
+                (zlib-stream-finish stream))
+              (should (equal (buffer-string) text))
+              (when (eq format 'gzip)
+                (erase-buffer)
+                (insert-buffer-substring compressed)
+                (should (zlib-decompress-region (point-min) (point-max)))
+                (should (equal (buffer-string) text))))
+          (kill-buffer compressed))))))
+
+(ert-deftest zlib--stream-members ()
+  "Test decompressing several gzip members, and invalid data."
+  (skip-unless (and (fboundp 'zlib-available-p)
+                    (zlib-available-p)))
+  (let ((first (zlib-tests--compress "foo\n" 'gzip 10))
+        (second (zlib-tests--compress "b\344r\n" 'gzip 10)))
+    (unwind-protect
+        (let ((data (concat (with-current-buffer first (buffer-string))
+                            (with-current-buffer second (buffer-string))
+                            (make-string 10 0))))
+          (with-temp-buffer
+            (let ((stream (zlib-make-decompressor (current-buffer))))
+              (dotimes (i (length data))
+                (zlib-stream-feed stream (substring data i (1+ i))))
+              (zlib-stream-finish stream))
+            (should (multibyte-string-p (buffer-string)))
+            (should (equal (buffer-string)
+                           (string-to-multibyte "foo\nb\344r\n"))))
+          (with-temp-buffer
+            (let ((stream (zlib-make-decompressor (current-buffer))))
+              (should-error (zlib-stream-feed stream "not compressed")
+                            :type 'zlib-data-error))
+            (let ((stream (zlib-make-decompressor (current-buffer))))
+              (zlib-stream-feed stream (substring data 0 10))
+              (should-error (zlib-stream-finish stream)
+                            :type 'zlib-data-error)
+              (should-error (zlib-stream-feed stream data)))))
+      (kill-buffer first)
+      (kill-buffer second))))
+
+(defvar zlib-tests--done nil)
+
+;; Move the gap of BUFFER back, without modifying it, until
+;; `zlib-tests--done' is non-nil.  Sending text around the gap to
+;; PROCESS moves the gap to the start of that text.
+(defun zlib-tests--move-gap (buffer process)
+  (while (not zlib-tests--done)
+    (with-current-buffer buffer
+      (let ((gap (gap-position)))
+        (when (< (point-min) gap (point-max))
+          (process-send-region process (1- gap) (1+ gap)))))
+    (thread-yield)))
+
+(ert-deftest zlib--decompress-region-threads ()
+  "Test decompressing while another thread moves the gap."
+  (skip-unless (and (fboundp 'zlib-available-p)
+                    (zlib-available-p)
+                    (fboundp 'make-thread)
+                    (executable-find "cat")))
+  (let* ((text (with-temp-buffer
+                 (set-buffer-multibyte nil)
+                 (dotimes (i 100000)
+                   (insert (format "line %d \377\n" i)))
+                 (buffer-string)))
+         (compressed (zlib-tests--compress text 'gzip 10000))
+         (process (start-process "zlib-tests" nil "cat")))
+    (setq zlib-tests--done nil)
+    (unwind-protect
+        (with-temp-buffer
+          (set-buffer-multibyte nil)
+          (insert-buffer-substring compressed)
+          ;; Keep the gap away from the end of the buffer.
+          (insert "tail")
+          (let ((thread (make-thread (apply-partially #'zlib-tests--move-gap
+                                                      (current-buffer)
+                                                      process))))
+            (thread-yield)
+            (should (zlib-decompress-region (point-min) (- (point-max) 4)))
+            (setq zlib-tests--done t)
+            (thread-join thread))
+          (should (equal (buffer-string) (concat text "tail"))))
+      (setq zlib-tests--done t)
+      (delete-process process)
+      (kill-buffer compressed))))
+
 (provide 'decompress-tests)
 
 ;;; decompress-tests.el ends here.
@@ -0,0 +1,107 @@
+;;; fileio-tests.el --- fileio.c tests -*- lexical-binding: t -*-
+
+;; Copyright (C) 2017 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Code:
+
+(require 'ert)
+
+(defun fileio-tests--large-text ()
+  "Return a string of a few megabytes, so that files holding it are
+compared with buffer text through a memory mapping."
+  (with-temp-buffer
+    (dotimes (i 100000)
+      (insert (format "line %d of a large file, \u00fc \u20ac \U0001F600\n" i)))
+    (buffer-string)))
+
+(ert-deftest fileio-tests-insert-file-contents-replace ()
+  "Replacing buffer text keeps the parts that match the file."
+  (let ((file (make-temp-file "fileio-tests"))
+        (text (fileio-tests--large-text))
+        (coding-system-for-write 'utf-8-unix))
+    (unwind-protect
+        (progn
+          (write-region text nil file nil 'silent)
+          (dolist (coding-system-for-read '(nil utf-8-unix latin-1-unix))
+            (dolist (edit '((100 . "changed near the start")
+                            (1500000 . "changed in the middle")
+                            (-100 . "changed near the end")))
+              (with-temp-buffer
+                (insert-file-contents file)
+                (let* ((pos (if (< (car edit) 0)
+                                (+ (point-max) (car edit))
+                              (car edit)))
+                       (before (copy-marker 10))
+                       (after (copy-marker (- (point-max) 10))))
+                  (goto-char pos)
+                  (insert (cdr edit))
+                  ;; Put the gap somewhere else than at the change.
+                  (goto-char (/ (point-max) 3))
+                  (insert "x")
+                  (delete-char -1)
+                  (let ((bytes file-read-bytes))
+                    (insert-file-contents file nil nil nil t)
+                    (should (> file-read-bytes bytes)))
+                  (should (equal (buffer-string)
+                                 (with-temp-buffer
+                                   (insert-file-contents file)
+                                   (buffer-string))))
+                  (should (= before 10))
+                  (should (= after (- (point-max) 10))))))))
+      (delete-file file))))
+
+(ert-deftest fileio-tests-insert-file-contents-large ()
+  "Large files are inserted whole."
+  (let ((file (make-temp-file "fileio-tests"))
+        (text (fileio-tests--large-text))
+        (coding-system-for-write 'utf-8-unix))
+    (unwind-protect
+        (progn
+          (write-region text nil file nil 'silent)
+          (with-temp-buffer
+            (insert-file-contents file)
+            (should (equal (buffer-string) text)))
+          (with-temp-buffer
+            (set-buffer-multibyte nil)
+            (insert-file-contents-literally file nil 1000 2000000)
+            (should (equal (buffer-string)
+                           (substring (encode-coding-string text 'utf-8-unix)
+                                      1000 2000000)))))
+      (delete-file file))))
+
+(ert-deftest fileio-tests-insert-file-contents-replace-past-end ()
+  "Replacing buffer text with an END past the end of the file."
+  (let ((file (make-temp-file "fileio-tests"))
+        (text (fileio-tests--large-text))
+        (coding-system-for-write 'utf-8-unix)
+        (coding-system-for-read 'no-conversion))
+    (unwind-protect
+        (progn
+          (write-region text nil file nil 'silent)
+          (with-temp-buffer
+            (insert-file-contents file)
+            (goto-char 1000)
+            (insert "changed")
+            (insert-file-contents file nil 0 (* 64 1024 1024) t)
+            (should (equal (buffer-string)
+                           (with-temp-buffer
+                             (insert-file-contents file)
+                             (buffer-string))))))
+      (delete-file file))))
+
+;;; fileio-tests.el ends here
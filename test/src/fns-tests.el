@@ -154,6 +154,83 @@
 	   [(8 . "xxx") (8 . "bbb") (8 . "ttt") (8 . "eee")
 	    (9 . "aaa") (9 . "zzz") (9 . "ppp") (9 . "fff")])))
 
+(defun fns-tests--sort-inputs ()
+  "Return lists of conses (KEY . INDEX) of various sizes and shapes."
+  (let ((inputs nil))
+    (random "fns-tests-sort")
+    (dolist (n '(0 1 2 3 31 32 33 64 65 1000 5000))
+      (dolist (shape '(random few ascending descending noisy sawtooth))
+        (let ((keys (number-sequence 0 (1- n))))
+          (setq keys
+                (pcase shape
+                  (`random (mapcar (lambda (_) (random 100000)) keys))
+                  (`few (mapcar (lambda (_) (random 4)) keys))
+                  (`ascending keys)
+                  (`descending (nreverse keys))
+                  (`noisy (mapcar (lambda (k) (if (zerop (random 50))
+                                                  (random n)
+                                                k))
+                                  keys))
+                  (`sawtooth (mapcar (lambda (k) (% k 100)) keys))))
+          (let ((i -1))
+            (push (mapcar (lambda (k) (cons k (setq i (1+ i)))) keys)
+                  inputs)))))
+    inputs))
+
+(defun fns-tests--sorted-stably-p (sorted lessp)
+  "Return non-nil if SORTED, a sequence of (KEY . INDEX), is sorted by
+KEY using LESSP, and by INDEX where keys are equal."
+  (let ((ok t)
+        (prev nil))
+    (mapc (lambda (x)
+            (when (and prev
+                       (or (funcall lessp (car x) (car prev))
+                           (and (not (funcall lessp (car prev) (car x)))
+                                (< (cdr x) (cdr prev)))))
+              (setq ok nil))
+            (setq prev x))
+          sorted)
+    ok))
+
+(ert-deftest fns-tests-sort-stable ()
+  "Sorting is stable for inputs with and without runs."
+  (dolist (input (fns-tests--sort-inputs))
+    (dolist (pred (list (lambda (a b) (< (car a) (car b)))
+                        (lambda (a b) (> (car a) (car b)))))
+      (let ((lessp (lambda (a b) (funcall pred (list a) (list b))))
+            (sorted (sort (copy-sequence input) pred)))
+        (should (= (length sorted) (length input)))
+        (should (fns-tests--sorted-stably-p sorted lessp))
+        (should (fns-tests--sorted-stably-p (sort (vconcat input) pred)
+                                           lessp))))
+    ;; Built-in predicates, and KEY.
+    (dolist (pred '(< >))
+      (should (fns-tests--sorted-stably-p
+               (sort (copy-sequence input) pred #'car) pred))
+      (should (fns-tests--sorted-stably-p
+               (sort (vconcat input) pred #'car) pred)))
+    ;; The elements stay in their cons cells.
+    (let* ((list (copy-sequence input))
+           (tail list)
+           (cells nil))
+      (while tail
+        (push (cons tail (car tail)) cells)
+        (setq tail (cdr tail)))
+      (setq list (sort list #'< #'car))
+      (dolist (cell cells)
+        (should (eq (car (car cell)) (cdr cell))))
+      (should (= (length list) (length input))))))
+
+(ert-deftest fns-tests-sort-builtin-predicates ()
+  "Built-in predicates sort like the functions they name."
+  (should (equal (sort (list 3 1.5 2 -1 1.5) #'<) '(-1 1.5 1.5 2 3)))
+  (should (equal (sort (vector 3 1.5 2 -1) '>) [3 2 1.5 -1]))
+  (should (equal (sort (list "b" 'a "c" "a") #'string<) '(a "a" "b" "c")))
+  (should (equal (sort (list "bb" "a" "ccc") #'< #'length) '("a" "bb" "ccc")))
+  (should-error (sort (list 1 'a 2) #'<) :type 'wrong-type-argument)
+  (cl-letf (((symbol-function 'fns-tests--less) #'<))
+    (should (equal (sort (list 2 1 3) 'fns-tests--less) '(1 2 3)))))
+
 (ert-deftest fns-tests-collate-sort ()
   ;; See https://lists.gnu.org/archive/html/emacs-devel/2015-10/msg02505.html.
   :expected-result (if (eq system-type 'cygwin) :failed :passed)
@@ -245,3 +322,67 @@
   (let ((data '((foo) (bar))))
     (should (equal (mapcan #'identity data) '(foo bar)))
     (should (equal data                     '((foo bar) (bar))))))
+
+(defun fns-tests--hash-key (test i)
+  "Return a fresh key for I in a hash table using TEST."
+  (pcase test
+    (`eq (* i 7))
+    (`eql (* i 7.0))
+    (_ (format "%d" (* i 7)))))
+
+(ert-deftest fns-tests-hash-table-churn ()
+  "Hash tables stay consistent across many insertions and removals."
+  (dolist (test '(eq eql equal))
+    (let ((h (make-hash-table :test test :size 3)))
+      (dotimes (round 20)
+        (dotimes (i 500)
+          (if (= (% (+ i round) 3) 0)
+              (remhash (fns-tests--hash-key test i) h)
+            (puthash (fns-tests--hash-key test i) (+ i round) h))))
+      (let ((copy (copy-hash-table h))
+            (count 0))
+        (dotimes (i 500)
+          (let ((key (fns-tests--hash-key test i))
+                (expected (if (= (% (+ i 19) 3) 0) nil (+ i 19))))
+            (when expected (setq count (1+ count)))
+            (should (equal (gethash key h) expected))
+            (should (equal (gethash key copy) expected))))
+        (should (= (hash-table-count h) count))
+        (remhash (fns-tests--hash-key test 1) copy)
+        (should (gethash (fns-tests--hash-key test 1) h))
+        (clrhash h)
+        (should (= (hash-table-count h) 0))
+        (should-not (gethash (fns-tests--hash-key test 2) h))
+        (puthash 'x 1 h)
+        (should (= (gethash 'x h) 1))
+        (should (= (hash-table-count copy) (1- count)))))))
+
+(ert-deftest fns-tests-hash-table-full-churn ()
+  "A full hash table stays consistent as entries are replaced."
+  (let ((h (make-hash-table :size 895 :rehash-threshold 1.0)))
+    (dotimes (i 895)
+      (puthash i i h))
+    (dotimes (i 5000)
+      (remhash i h)
+      (puthash (+ i 895) i h))
+    (should (= (hash-table-count h) 895))
+    (should (= (hash-table-size h) 895))
+    (should-not (gethash 4999 h))
+    (should (= (gethash 5000 h) 4105))
+    (should (= (gethash 5894 h) 4999))))
+
+(ert-deftest fns-tests-hash-table-weak ()
+  "Entries of weak hash tables go away with their keys."
+  (let ((h (make-hash-table :test 'eq :weakness 'key))
+        (kept (make-list 100 nil)))
+    (dotimes (i 100)
+      (setf (nth i kept) (list i))
+      (puthash (nth i kept) i h)
+      (puthash (list i) i h))
+    (garbage-collect)
+    (should (= (hash-table-count h) 100))
+    (dotimes (i 100)
+      (should (= (gethash (nth i kept) h) i)))
+    (let ((n 0))
+      (maphash (lambda (_k _v) (setq n (1+ n))) h)
+      (should (= n 100)))))
@@ -0,0 +1,170 @@
+;;; json-tests.el --- unit tests for json.c          -*- lexical-binding: t; -*-
+
+;; Copyright (C) 2017 Free Software Foundation, Inc.
+
+;; This file is part of GNU Emacs.
+
+;; GNU Emacs is free software: you can redistribute it and/or modify
+;; it under the terms of the GNU General Public License as published by
+;; the Free Software Foundation, either version 3 of the License, or
+;; (at your option) any later version.
+
+;; GNU Emacs is distributed in the hope that it will be useful,
+;; but WITHOUT ANY WARRANTY; without even the implied warranty of
+;; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+;; GNU General Public License for more details.
+
+;; You should have received a copy of the GNU General Public License
+;; along with GNU Emacs.  If not, see <http://www.gnu.org/licenses/>.
+
+;;; Commentary:
+
+;; Unit tests for src/json.c.
+
+;;; Code:
+
+(require 'ert)
+(require 'cl-lib)
+(require 'map)
+
+(ert-deftest json-serialize/roundtrip ()
+  (let ((lisp [:null :false t 0 123 -456 3.75 "abc\u00e9\n\"\\"])
+        (json "[null,false,true,0,123,-456,3.75,\"abc\u00e9\\n\\\"\\\\\"]"))
+    (should (equal (json-serialize lisp) json))
+    (with-temp-buffer
+      (json-insert lisp)
+      (should (equal (buffer-string) json))
+      (should (eobp)))
+    (should (equal (json-parse-string json) lisp))
+    (with-temp-buffer
+      (insert json)
+      (goto-char 1)
+      (should (equal (json-parse-buffer) lisp))
+      (should (eobp)))))
+
+(ert-deftest json-serialize/object ()
+  (let ((table (make-hash-table :test #'equal)))
+    (puthash "abc" [1 2 t] table)
+    (puthash "def" :null table)
+    (should (equal (json-serialize table)
+                   "{\"abc\":[1,2,true],\"def\":null}")))
+  (should (equal (json-serialize '((abc . [1 2 t]) (def . :null)))
+                 "{\"abc\":[1,2,true],\"def\":null}"))
+  (should (equal (json-serialize '(:abc [1 2 t] :def :null))
+                 "{\"abc\":[1,2,true],\"def\":null}"))
+  (should (equal (json-serialize nil) "{}"))
+  ;; The first of duplicate keys wins.
+  (should (equal (json-serialize '((a . 1) (b . 2) (a . 3))) "{\"a\":1,\"b\":2}"))
+  (let ((alist (mapcar (lambda (i) (cons (intern (format "k%d" (% i 20))) i))
+                       (number-sequence 0 39))))
+    (should (equal (length (json-parse-string (json-serialize alist)
+                                              :object-type 'alist))
+                   20))))
+
+(ert-deftest json-serialize/invalid ()
+  (should-error (json-serialize '((1 . 2))) :type 'wrong-type-argument)
+  (should-error (json-serialize (vector (/ 0.0 0.0)))
+                :type 'wrong-type-argument)
+  (should-error (json-serialize (string-to-multibyte "\377"))
+                :type 'wrong-type-argument)
+  (should-error (json-serialize (make-marker)) :type 'wrong-type-argument)
+  (let ((v (vector nil)))
+    (aset v 0 v)
+    (should-error (json-serialize v) :type 'json-object-too-deep))
+  (let ((l (list (cons 'a 1))))
+    (setcdr l l)
+    (should-error (json-serialize l) :type 'circular-list)))
+
+(ert-deftest json-serialize/float ()
+  (should (equal (json-serialize [1.0 -0.5 1e300]) "[1.0,-0.5,1e+300]"))
+  (should (floatp (aref (json-parse-string (json-serialize [1.0])) 0))))
+
+(ert-deftest json-parse-string/object ()
+  (let ((actual
+         (json-parse-string
+          "{ \"abc\" : [1, 2, true], \"def\" : null, \"abc\" : [9, false] }\n")))
+    (should (hash-table-p actual))
+    (should (equal (hash-table-count actual) 2))
+    (should (equal (cl-sort (map-pairs actual) #'string< :key #'car)
+                   '(("abc" . [9 :false]) ("def" . :null)))))
+  (should (equal (json-parse-string "{\"a\": 1, \"b\": 2, \"a\": 3}"
+                                    :object-type 'alist)
+                 '((a . 1) (b . 2) (a . 3))))
+  (should (equal (json-parse-string "{\"a\": {\"b\": [1]}}"
+                                    :object-type 'plist :array-type 'list)
+                 '(:a (:b (1))))))
+
+(ert-deftest json-parse-string/options ()
+  (should (equal (json-parse-string "[null, false]"
+                                    :null-object nil :false-object 'no)
+                 [nil no]))
+  (should (equal (json-serialize [nil no] :null-object nil :false-object 'no)
+                 "[null,false]"))
+  (should-error (json-parse-string "[]" :object-type 'vector))
+  (should-error (json-parse-string "[]" :bogus t))
+  (should-error (json-parse-string "[]" :array-type)))
+
+(ert-deftest json-parse-string/string ()
+  (should (equal (json-parse-string "\"\\u00e9\\ud83d\\ude00\\t\\/\"")
+                 "\u00e9\U0001F600\t/"))
+  (should (multibyte-string-p (json-parse-string "\"\u00e9\"")))
+  (should (equal (json-parse-string (encode-coding-string "\"\u00e9\"" 'utf-8))
+                 "\u00e9"))
+  (should-error (json-parse-string "\"\\ud83d\"") :type 'json-parse-error)
+  (should-error (json-parse-string "\"a\nb\"") :type 'json-parse-error)
+  (should-error (json-parse-string "\"\\x\"") :type 'json-parse-error)
+  (should-error (json-parse-string "\"\300\200\"") :type 'json-parse-error))
+
+(ert-deftest json-parse-string/number ()
+  (should (equal (json-parse-string "[0, -0, 12, -3.5e2, 1E-1]")
+                 [0 0 12 -350.0 0.1]))
+  (should (floatp (json-parse-string "123456789012345678901234567890")))
+  (dolist (bad '("01" "1." ".5" "-" "1e" "+1"))
+    (should-error (json-parse-string bad) :type 'json-parse-error)))
+
+(ert-deftest json-parse-string/errors ()
+  (should-error (json-parse-string "") :type 'json-end-of-file)
+  (should-error (json-parse-string "[1, 2") :type 'json-end-of-file)
+  (should-error (json-parse-string "{\"a\"") :type 'json-end-of-file)
+  (should-error (json-parse-string "[1] [2]") :type 'json-trailing-content)
+  (should-error (json-parse-string "[1,]") :type 'json-parse-error)
+  (should-error (json-parse-string "{1: 2}") :type 'json-parse-error)
+  (should-error (json-parse-string "nul") :type 'json-end-of-file)
+  (should-error (json-parse-string "nulx") :type 'json-parse-error)
+  (should-error (json-parse-string (concat (make-string 3000 ?\[)
+                                           (make-string 3000 ?\])))
+                :type 'json-object-too-deep)
+  (should (equal (cdr (should-error (json-parse-string "[1, x]")))
+                 '("Unexpected character" 4))))
+
+(ert-deftest json-parse-buffer/incremental ()
+  "Values can be read one by one as they arrive in a buffer."
+  (with-temp-buffer
+    (insert "{\"a\": 1} [2]  {\"b\": \"\u00e9")
+    (goto-char (point-min))
+    (should (equal (json-parse-buffer :object-type 'alist) '((a . 1))))
+    (should (equal (json-parse-buffer) [2]))
+    (let ((pos (point)))
+      (should-error (json-parse-buffer) :type 'json-end-of-file)
+      (should (= (point) pos))
+      ;; Move the gap into the middle of the value.
+      (save-excursion
+        (goto-char (- (point-max) 3))
+        (insert "x")
+        (delete-char -1)
+        (goto-char (point-max))
+        (insert "\"}"))
+      (should (equal (json-parse-buffer :object-type 'plist) '(:b "\u00e9")))
+      (should (eobp)))))
+
+(ert-deftest json-parse-buffer/narrowing ()
+  (with-temp-buffer
+    (insert "[1, 2] garbage")
+    (narrow-to-region 1 5)
+    (goto-char 1)
+    (should-error (json-parse-buffer) :type 'json-end-of-file)
+    (widen)
+    (should (equal (json-parse-buffer) [1 2]))
+    (should (= (point) 7))))
+
+;;; json-tests.el ends here
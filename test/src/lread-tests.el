@@ -104,4 +104,167 @@
 (ert-deftest lread-string-char-name ()
   (should (equal (read "\"a\\N{SYLOTI NAGRI  LETTER DHO}b\"") "a\uA817b")))
 
+(ert-deftest lread-tests-obarray-index ()
+  "Symbols stay found while the index of `obarray' grows."
+  (let* ((n 50000)
+         (names (mapcar (lambda (i) (format "lread-tests--sym-%d" i))
+                        (number-sequence 1 n)))
+         (count (lambda ()
+                  (let ((count 0))
+                    (mapatoms (lambda (_) (setq count (1+ count))))
+                    count)))
+         (before (funcall count))
+         symbols)
+    (unwind-protect
+        (progn
+          (setq symbols (mapcar #'intern names))
+          (should (= (funcall count) (+ before n)))
+          (let ((stats (obarray-statistics)))
+            (should (= (alist-get 'symbols stats) (+ before n)))
+            (should (>= (alist-get 'index-size stats) (+ before n))))
+          (let ((syms symbols))
+            (dolist (name names)
+              (should (eq (intern-soft name) (pop syms)))))
+          ;; Unintern every other symbol, and intern others anew.
+          (let ((i 0))
+            (dolist (sym symbols)
+              (when (= (% (setq i (1+ i)) 2) 0)
+                (should (unintern sym obarray)))))
+          (should (= (funcall count) (+ before (/ n 2))))
+          (let ((i 0))
+            (dolist (name names)
+              (if (= (% (setq i (1+ i)) 2) 0)
+                  (should-not (intern-soft name))
+                (should (intern-soft name)))))
+          (dolist (name names)
+            (should (eq (intern name) (intern-soft name))))
+          (should (= (funcall count) (+ before n))))
+      (dolist (name names)
+        (unintern name obarray)))
+    (should (= (funcall count) before))
+    ;; Fill an index much bigger than the symbols left need to just
+    ;; below the point where it is replaced, and unintern the symbols
+    ;; that filled it.  The index that replaces it when the next
+    ;; symbol is interned is then much smaller, and must not fill up
+    ;; before the symbols of the big one are all moved to it.  That is
+    ;; likeliest when the symbols left fill half of their index.
+    (let* ((live (1- (ash 1 (1+ (logb before)))))
+           (i 0)
+           (pad (cl-loop for j below (- live before)
+                         collect (intern (format "lread-tests--pad-%d" j))))
+           (grown nil)
+           size)
+      (unwind-protect
+          (progn
+            (unwind-protect
+                (progn
+                  (while (< (alist-get 'index-size (obarray-statistics))
+                            (* 32 (1+ live)))
+                    (dotimes (_ 10000)
+                      (push (intern (format "lread-tests--grow-%d"
+                                            (setq i (1+ i))))
+                            grown)))
+                  (setq size (alist-get 'index-size (obarray-statistics)))
+                  (dotimes (_ (- (* 3 (/ size 4)) (funcall count)))
+                    (push (intern (format "lread-tests--grow-%d"
+                                          (setq i (1+ i))))
+                          grown))
+                  (should (= (alist-get 'index-size (obarray-statistics))
+                             size)))
+              (dolist (sym grown)
+                (unintern sym obarray)))
+            (setq grown nil)
+            (dotimes (j (/ size 8))
+              (push (intern (format "lread-tests--new-%d" j)) grown))
+            (let ((stats (obarray-statistics)))
+              (should (< (alist-get 'index-size stats) size))
+              (should-not (alist-get 'rehashing stats))
+              (should (< (alist-get 'longest-probe stats) 100)))
+            (dolist (sym grown)
+              (should (eq (intern-soft (symbol-name sym)) sym))))
+        (dolist (sym (nconc grown pad))
+          (unintern sym obarray))))
+    (should (= (funcall count) before))))
+
+(ert-deftest lread-tests-obarray-statistics ()
+  (let ((ob (make-vector 7 0)))
+    (dolist (name '("a" "b" "c" "d" "e" "f" "g" "h"))
+      (intern name ob))
+    (let ((stats (obarray-statistics ob)))
+      (should (= (alist-get 'symbols stats) 8))
+      (should (= (alist-get 'buckets stats) 7))
+      (should (>= (alist-get 'longest-chain stats) 2))
+      (should-not (assq 'index-size stats)))))
+
+(defvar lread-tests--image-loaded nil)
+(defvar lread-tests--image-interned nil)
+
+(defconst lread-tests--image-forms
+  '((setq lread-tests--image-interned
+          (intern-soft "lread-tests--image-late"))
+    (defvar lread-tests--image-data
+      (list 1 -7 most-negative-fixnum most-positive-fixnum 1.5 -0.0 1.0e+INF
+            "abc" "über \U0001F600" (unibyte-string 192 255)
+            #s(hash-table test equal data ("a" 1 (b) 2))
+            (bool-vector t nil t t nil nil nil nil t)
+            [1 [2 "x"] nil]
+            (propertize "face" 'face 'bold)
+            '#1=(a b . #1#)
+            (let ((s (make-symbol "g"))) (list s s))
+            (make-char-table 'test 'x)
+            :keyword '## 'sym\ with\ space 'lread-tests--image-late))
+    (defun lread-tests--image-fn (x)
+      "Doc string of lread-tests--image-fn."
+      (list x lread-tests--image-data))
+    (setq lread-tests--image-loaded 'lread-tests--from-text))
+  "Forms to compile into a file with an image.")
+
+(ert-deftest lread-tests-elc-image ()
+  "Loading a compiled file from its image gives what reading it gives."
+  (let* ((dir (make-temp-file "lread-tests" t))
+         (source (expand-file-name "lread-tests-image.el" dir))
+         (compiled (concat source "c"))
+         (byte-compile-elc-image t)
+         (print-circle t)
+         text)
+    (unwind-protect
+        (progn
+          (with-temp-file source
+            (setq buffer-file-coding-system 'utf-8-emacs)
+            (insert ";;; -*- lexical-binding: t -*-\n")
+            (dolist (form lread-tests--image-forms)
+              (prin1 form (current-buffer))
+              (insert "\n")))
+          (should (byte-compile-file source))
+          (let ((load-elc-images nil))
+            (load compiled nil t t))
+          (setq text (prin1-to-string
+                      (list lread-tests--image-data
+                            (symbol-function 'lread-tests--image-fn))))
+          (makunbound 'lread-tests--image-data)
+          (fmakunbound 'lread-tests--image-fn)
+          ;; Each form is made just before it is evaluated, so symbols
+          ;; that only later forms refer to are not interned yet.
+          (unintern "lread-tests--image-late" obarray)
+          (load compiled nil t t)
+          (should-not lread-tests--image-interned)
+          (should (equal (prin1-to-string
+                          (list lread-tests--image-data
+                                (symbol-function 'lread-tests--image-fn)))
+                         text))
+          (should (string-prefix-p "Doc string of lread-tests--image-fn."
+                                   (documentation 'lread-tests--image-fn)))
+          (should (equal (car (lread-tests--image-fn 3)) 3))
+          ;; Change the text but not the image; `load' must notice and
+          ;; parse the text.
+          (with-temp-buffer
+            (set-buffer-multibyte nil)
+            (insert-file-contents-literally compiled)
+            (should (search-forward "lread-tests--from-text" nil t))
+            (replace-match "lread-tests--from-imag")
+            (write-region nil nil compiled nil 'silent))
+          (load compiled nil t t)
+          (should (eq lread-tests--image-loaded 'lread-tests--from-imag)))
+      (delete-directory dir t))))
+
 ;;; lread-tests.el ends here
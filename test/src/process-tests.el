@@ -162,5 +162,123 @@
                               (error nil))))
     (should (equal path samepath))))
 
+;; Read NBYTES bytes of output from a process, and return its output
+;; statistics.
+(defun process-test-read-output (nbytes)
+  (let* ((total 0)
+         (proc (make-process
+                :name "test"
+                :command (list "bash" "-c"
+                               (format "yes 0123456789 | head -c %d" nbytes))
+                :connection-type 'pipe
+                :coding 'binary
+                :filter (lambda (_proc string)
+                          (setq total (+ total (length string)))))))
+    (while (accept-process-output proc 10))
+    (should (= total nbytes))
+    (process-output-statistics proc)))
+
+(ert-deftest process-test-read-output-size ()
+  "Output that keeps coming is read in large chunks."
+  (skip-unless (executable-find "bash"))
+  (let* ((nbytes (* 10 1024 1024))
+         (stats (process-test-read-output nbytes)))
+    (should (= (plist-get stats :bytes) nbytes))
+    (should (> (plist-get stats :read-size) 4096))
+    (should (< (plist-get stats :filter-calls) (/ nbytes 4096))))
+  (let ((read-process-output-max 4096))
+    (should (= (plist-get (process-test-read-output 100000) :read-size)
+               4096))))
+
+(ert-deftest process-test-many-processes ()
+  "Output of many processes running at once is all read."
+  (skip-unless (executable-find "bash"))
+  (let ((processes nil))
+    (dotimes (i 50)
+      (push (make-process
+             :name (format "test %d" i)
+             :command
+             (list "bash" "-c"
+                   (format "for j in 1 2 3; do echo %d $j; sleep 0.0$j; done"
+                           i))
+             :noquery t
+             :filter (lambda (proc string)
+                       (process-put proc 'output
+                                    (concat (process-get proc 'output)
+                                            string)))
+             :sentinel #'ignore)
+            processes))
+    (while (delq nil (mapcar #'process-live-p processes))
+      (accept-process-output nil 0.05))
+    (dolist (proc processes)
+      (while (accept-process-output proc 0)))
+    (let ((i 50))
+      (dolist (proc processes)
+        (setq i (1- i))
+        (should (equal (process-get proc 'output)
+                       (format "%d 1\n%d 2\n%d 3\n" i i i)))))))
+
+(ert-deftest process-test-send-nowait ()
+  "Sending without waiting queues what the process cannot read yet."
+  (skip-unless (executable-find "bash"))
+  (let* ((text (make-string 1000000 ?x))
+         (proc (make-process :name "test"
+                             :command '("bash" "-c" "sleep 0.2; wc -c")
+                             :connection-type 'pipe
+                             :noquery t
+                             :buffer (generate-new-buffer "*test*")
+                             :sentinel #'ignore))
+         (sent nil))
+    (unwind-protect
+        (progn
+          (process-send-string proc text
+                               (lambda (p)
+                                 (setq sent (process-send-queue-size p))
+                                 (process-send-eof p)))
+          (should-not sent)
+          (should (> (process-send-queue-size proc) 0))
+          (while (process-live-p proc)
+            (accept-process-output proc 0.05))
+          (should (eql sent 0))
+          (should (= (process-send-queue-size proc) 0))
+          (should (= (with-current-buffer (process-buffer proc)
+                       (string-to-number (buffer-string)))
+                     1000000)))
+      (kill-buffer (process-buffer proc)))))
+
+;; The copy has none of the threads that help the GC, and must start
+;; its own.
+(ert-deftest process-test-fork-gc-helpers ()
+  (skip-unless (and (fboundp 'process--fork)
+                    (fboundp 'make-thread)
+                    (file-directory-p "/proc/self/task")))
+  (let ((data (cl-loop for i below 300000 collect (list i (float i))))
+        (gc-mark-threads 2)
+        (count-threads (lambda ()
+                         (length (directory-files "/proc/self/task"
+                                                  nil "\\`[0-9]"))))
+        copy)
+    ;; Collect twice, so that the heap is big enough for the helpers
+    ;; the second time.
+    (garbage-collect)
+    (garbage-collect)
+    (setq copy (process--fork))
+    (when (eq copy 0)
+      (kill-emacs
+       (condition-case nil
+           (let ((before (funcall count-threads)))
+             (garbage-collect)
+             (if (and (= (funcall count-threads) (+ before 2))
+                      (cl-loop for e in data
+                               for i from 0
+                               always (equal e (list i (float i)))))
+                 0
+               1))
+         (error 2))))
+    (while (process-live-p copy)
+      (accept-process-output copy))
+    (should (eq (process-status copy) 'exit))
+    (should (= (process-exit-status copy) 0))))
+
 (provide 'process-tests)
 ;; process-tests.el ends here.
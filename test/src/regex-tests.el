@@ -677,4 +677,91 @@ This evaluates the PTESTS test cases from glibc."
 This evaluates the TESTS test cases from glibc."
   (should-not (regex-tests-TESTS)))
 
+;; The regexp cache.
+
+(ert-deftest regex-tests-cache-hits ()
+  "Check that a regexp is compiled only once."
+  (let ((re (format "cache-test-%d" (random))))
+    (let ((misses regexp-cache-misses)
+          (hits regexp-cache-hits))
+      (should (string-match re (concat "x" re)))
+      (should (= regexp-cache-misses (1+ misses)))
+      (should (string-match re re))
+      (should (= regexp-cache-hits (1+ hits)))
+      (should (= regexp-cache-misses (1+ misses))))))
+
+(ert-deftest regex-tests-cache-size ()
+  "Check that matching works when the cache is smaller than the working set."
+  (let ((regexp-cache-size 1))
+    (dotimes (i 50)
+      (should (= (string-match "a+" "baa") 1))
+      (should (= (string-match "b+" "abb") 1))
+      (should-not (string-match (format "c%d" i) "abc")))))
+
+(ert-deftest regex-tests-cache-syntax-table ()
+  "Check that compiled regexps depend on the current syntax table."
+  (with-temp-buffer
+    (insert "a-b")
+    (let ((table (make-syntax-table)))
+      (goto-char (point-min))
+      (should (equal (progn (re-search-forward "\\sw+") (match-string 0))
+                     "a"))
+      (modify-syntax-entry ?- "w" table)
+      (with-syntax-table table
+        (goto-char (point-min))
+        (should (equal (progn (re-search-forward "\\sw+") (match-string 0))
+                       "a-b"))))))
+
+;; The DFA that rules out places where no match starts.
+
+(ert-deftest regex-tests-dfa-no-backtracking ()
+  "Check that a search doesn't backtrack where nothing can match."
+  (should-not (string-match "\\(?:a\\|aa\\)*c" (make-string 50 ?a)))
+  (should (= (string-match "\\(?:a\\|aa\\)*c" (concat (make-string 50 ?a) "c"))
+             0)))
+
+(ert-deftest regex-tests-dfa-anchors ()
+  "Check the anchors in the places the DFA rules out."
+  (should (= (string-match "^b$" "a\nb\nc") 2))
+  (should (= (string-match "^b" "b\nb" 1) 2))
+  (should-not (string-match "\\`b" "ab" 1))
+  (should (= (string-match "b\\'" "bb") 1))
+  (with-temp-buffer
+    (insert "ab\ncd")
+    (goto-char (point-min))
+    (should-not (re-search-forward "a$" 2 t))
+    (should (= (re-search-forward "b$" 3 t) 3))
+    (should-not (re-search-forward "c\\'" 5 t))
+    (goto-char (point-max))
+    (should (= (re-search-backward "^c" nil t) 4))))
+
+(ert-deftest regex-tests-dfa-too-many-states ()
+  "Check a search whose DFA grows too large and is dropped."
+  ;; Searching for this needs a DFA state for each of the 1024 ways
+  ;; the last ten characters can be a or b.
+  (let ((regexp "a[ab][ab][ab][ab][ab][ab][ab][ab][ab]c")
+        (state (random "regex-tests-dfa-too-many-states"))
+        (text nil))
+    (ignore state)
+    (dotimes (_ 5000)
+      (push (if (zerop (random 2)) ?a ?b) text))
+    (setq text (apply #'string text))
+    (should-not (string-match regexp text))
+    (should (= (string-match regexp (concat text "abababababc")) 5000))
+    (should (= (match-end 0) 5011))
+    (with-temp-buffer
+      (insert text "aaaaaaaaaac" text)
+      (goto-char (point-min))
+      (should (= (re-search-forward regexp nil t) 5012))
+      (should (= (match-beginning 0) 5001))
+      (should-not (re-search-forward regexp nil t)))))
+
+(ert-deftest regex-tests-dfa-back-references ()
+  "Check searches for regexps that the DFA does not handle."
+  (should (= (string-match "\\([ab]+\\)c\\1" "xxabcab") 2))
+  (should (equal (match-string 1 "xxabcab") "ab"))
+  (should-not (string-match "\\([ab]+\\)c\\1" "xxabcaa"))
+  (should (= (string-match "\\(?:a\\|b\\)\\{3\\}c" "ababc") 1))
+  (should (= (string-match "\\_<ab\\_>" "xab ab") 4)))
+
 ;;; regex-tests.el ends here
@@ -68,5 +68,100 @@
     (should (and (equal-including-properties (pop stack) string)
 		 (null stack)))))
 
+(ert-deftest textprop-tests-lookup-after-changes ()
+  "Properties looked up near earlier lookups are right after changes."
+  (random "textprop-tests")
+  (with-temp-buffer
+    (let ((expected (make-vector 1000 nil)))
+      (insert (make-string 1000 ?x))
+      (dotimes (_ 200)
+        (let* ((beg (1+ (random (1- (point-max)))))
+               (end (min (point-max) (+ beg 1 (random 50))))
+               (val (random 5))
+               (probe (+ beg (random 100))))
+          ;; Look up a property near the change, so that lookups after
+          ;; it start from there.
+          (get-text-property (min probe (1- (point-max))) 'p)
+          (pcase (random 3)
+            (0 (put-text-property beg end 'p val)
+               (dotimes (i (- end beg))
+                 (aset expected (+ beg i -1) val)))
+            (1 (goto-char beg)
+               (insert (propertize (make-string (- end beg) ?y) 'p val))
+               (setq expected (vconcat (substring expected 0 (1- beg))
+                                       (make-vector (- end beg) val)
+                                       (substring expected (1- beg)))))
+            (2 (delete-region beg end)
+               (setq expected (vconcat (substring expected 0 (1- beg))
+                                       (substring expected (1- end))))))
+          (when (< probe (point-max))
+            (should (eq (get-text-property probe 'p)
+                        (aref expected (1- probe)))))
+          (dotimes (i (length expected))
+            (should (eq (get-text-property (1+ i) 'p)
+                        (aref expected i))))
+          (let ((i (length expected)))
+            (while (> i 0)
+              (should (eq (get-text-property i 'p)
+                          (aref expected (1- i))))
+              (setq i (- i 1 (random 3))))))))))
+
+;; Hold the arguments of each call to the change functions.
+(defvar textprop-tests--changes)
+
+(defun textprop-tests--record-change (&rest args)
+  (push args textprop-tests--changes))
+
+(ert-deftest textprop-tests-add-spans ()
+  "Adding spans is like adding the properties of each one in turn."
+  (random "textprop-tests-spans")
+  (dotimes (_ 20)
+    (let ((text (make-string 500 ?x))
+          (spans nil)
+          (pos 1))
+      (dotimes (_ 10)
+        (let ((beg (+ 1 (random 500))))
+          (put-text-property (1- beg) (min 500 (+ beg (random 30)))
+                             'p (random 3) text)))
+      (while (< pos 480)
+        (let ((beg (+ pos (random 20))))
+          (setq pos (min 501 (+ beg (random 20))))
+          (push (list beg pos (list 'p (random 3) 'q (random 2))) spans)))
+      (setq spans (vconcat (nreverse spans)))
+      (with-temp-buffer
+        (insert text)
+        (let* ((reference (with-temp-buffer
+                            (insert text)
+                            (buffer-enable-undo)
+                            (mapc (lambda (span)
+                                    (apply #'add-text-properties span))
+                                  spans)
+                            (cons (buffer-string)
+                                  (progn (primitive-undo 1 buffer-undo-list)
+                                         (buffer-string)))))
+               (expected (car reference))
+               (textprop-tests--changes nil)
+               (before-change-functions '(textprop-tests--record-change))
+               (after-change-functions '(textprop-tests--record-change)))
+          (buffer-enable-undo)
+          (add-text-property-spans spans)
+          (should (equal-including-properties (buffer-string) expected))
+          (should (= (length textprop-tests--changes) 2))
+          (primitive-undo 1 buffer-undo-list)
+          (should (equal-including-properties (buffer-string)
+                                              (cdr reference)))))))
+  (should (equal-including-properties
+           (let ((s (copy-sequence "abcdef")))
+             (add-text-property-spans [(0 2 (a 1)) (2 4 (a 1)) (5 6 (b 2))]
+                                      s)
+             s)
+           #("abcdef" 0 4 (a 1) 5 6 (b 2))))
+  (with-temp-buffer
+    (insert "abcdef")
+    (should-error (add-text-property-spans [(1 3 (a 1)) (2 4 (b 1))]))
+    (should-error (add-text-property-spans [(1 30 (a 1))]))
+    (should (equal-including-properties (buffer-string) "abcdef"))
+    (should-not (add-text-property-spans [(1 1 (a 1)) (2 4 nil)]))))
+
 (provide 'textprop-tests)
 ;; textprop-tests.el ends here.
@@ -210,4 +210,22 @@
 	      (condition-name (make-condition-variable (make-mutex)
 						       "hi bob")))))
 
+(defvar threads-test-count 0)
+
+(ert-deftest threads-call-process ()
+  "other threads run while `call-process' waits"
+  (skip-unless (executable-find "sh"))
+  (setq threads-test-count 0)
+  (let ((thread (make-thread (lambda ()
+                               (while t
+                                 (setq threads-test-count
+                                       (1+ threads-test-count))
+                                 (thread-yield))))))
+    (unwind-protect
+        (with-temp-buffer
+          (call-process "sh" nil t nil "-c" "sleep 0.5; echo done")
+          (should (equal (buffer-string) "done\n"))
+          (should (> threads-test-count 0)))
+      (thread-signal thread 'error nil))))
+
 ;;; threads.el ends here